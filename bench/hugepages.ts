@@ -0,0 +1,43 @@
+// Compares regular and huge page backing of the scrypt scratch memory.
+//
+// Usage: npm run bench:hugepages [-- iterations]
+//
+// Transparent huge pages need /sys/kernel/mm/transparent_hugepage/enabled
+// set to "madvise" or "always"; MAP_HUGETLB needs pages reserved through
+// /proc/sys/vm/nr_hugepages (otherwise "hugetlb" falls back to "thp").
+
+import * as scrypt from "../";
+
+const iterations = parseInt(process.argv[2] ?? "", 10) || 5;
+const modes = ["off", "thp", "hugetlb"] as const;
+
+function best(logN: number): number {
+  let fastest = Infinity;
+  for (let i = 0; i < iterations; i++) {
+    const start = process.hrtime.bigint();
+    scrypt.hashSync("benchmark", { N: logN, r: 8, p: 1 }, 64, "NaCl");
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+    if (elapsed < fastest) fastest = elapsed;
+  }
+  return fastest;
+}
+
+console.log(`best of ${iterations} hashes, r=8, p=1 (ms per hash)`);
+console.log(["N".padEnd(6), ...modes.map((mode) => mode.padStart(14))].join(""));
+
+for (let logN = 14; logN <= 17; logN++) {
+  const row = [`2^${logN}`.padEnd(6)];
+  let baseline = 0;
+  for (const hugePages of modes) {
+    scrypt.configure({ hugePages });
+    best(logN); // warm the arena with the new backing
+    const ms = best(logN);
+    if (hugePages === "off") baseline = ms;
+    row.push(`${ms.toFixed(1)}${hugePages === "off" ? "" : ` (${((baseline / ms - 1) * 100).toFixed(0)}%)`}`.padStart(14));
+  }
+  console.log(row.join(""));
+}
+
+const stats = scrypt.stats();
+console.log(`regions mapped with MAP_HUGETLB: ${stats.arenaHugeTlb}, advised for THP: ${stats.arenaThp}`);
+scrypt.configure({ hugePages: "off" });
@@ -0,0 +1,55 @@
+// Measures the per-call overhead of the async functions, using parameters so
+// small that the hash itself costs next to nothing.
+//
+// Usage: npm run bench:overhead [-- calls]
+//
+// "callback" goes through the full argument checks in index.ts and a native
+// callback; "promise (wrapped)" is how promises were made before the native
+// fast path, a closure around the callback form; "promise" is the native fast
+// path. "in flight" keeps 64 calls outstanding at once.
+
+import * as scrypt from "../";
+
+const calls = parseInt(process.argv[2] ?? "", 10) || 20000;
+const params = { N: 1, r: 1, p: 1 };
+const key = Buffer.from("benchmark");
+const salt = Buffer.from("NaCl");
+
+type Call = () => Promise<unknown>;
+
+const forms: [string, Call][] = [
+  ["callback", () => new Promise((resolve) => scrypt.hash(key, params, 32, salt, resolve))],
+  ["promise (wrapped)", () => new Promise((resolve, reject) => scrypt.hash(key, params, 32, salt, (err: Error | null, hash: Buffer) => err ? reject(err) : resolve(hash)))],
+  ["promise", () => scrypt.hash(key, params, 32, salt) as Promise<Buffer>],
+];
+
+async function sequential(call: Call): Promise<number> {
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < calls; i++) await call();
+  return Number(process.hrtime.bigint() - start) / 1e3 / calls;
+}
+
+async function inFlight(call: Call): Promise<number> {
+  const start = process.hrtime.bigint();
+  let next = 0;
+  const lane = async () => { while (next++ < calls) await call(); };
+  await Promise.all(Array.from({ length: 64 }, lane));
+  return Number(process.hrtime.bigint() - start) / 1e3 / calls;
+}
+
+async function main() {
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < calls; i++) scrypt.hashSync(key, params, 32, salt);
+  const floor = Number(process.hrtime.bigint() - start) / 1e3 / calls;
+
+  console.log(`${calls} calls, N=2^1 r=1 p=1 (us per call; hashSync takes ${floor.toFixed(2)})`);
+  console.log(["".padEnd(20), "sequential".padStart(12), "in flight".padStart(12)].join(""));
+
+  for (const [name, call] of forms) {
+    await sequential(call); // warm up
+    const row = [name.padEnd(20), (await sequential(call)).toFixed(2).padStart(12), (await inFlight(call)).toFixed(2).padStart(12)];
+    console.log(row.join(""));
+  }
+}
+
+main();
@@ -0,0 +1,30 @@
+// Checks that paramsForThroughput keeps its promise on this machine: hashes
+// with the params it picks, as many at once as the concurrency asked for, and
+// reports the rate they are actually verified at.
+//
+// Usage: npm run bench:throughput [-- verifiesPerSecond concurrency rounds]
+//
+// The rate should come out near the one asked for. It falls short on a busy
+// machine, or when the hashes are so small that the cost of each call counts.
+
+import * as scrypt from "../";
+
+const verifiesPerSecond = parseFloat(process.argv[2] ?? "") || 100;
+const concurrency = parseInt(process.argv[3] ?? "", 10) || 2;
+const rounds = parseInt(process.argv[4] ?? "", 10) || 20;
+
+async function main() {
+  scrypt.configure({ poolSize: concurrency });
+  const params = scrypt.paramsForThroughputSync({ verifiesPerSecond, concurrency, maxmem: 256 * 1024 * 1024 });
+  console.log(`${verifiesPerSecond}/s with ${concurrency} at once: N=2^${params.N} r=${params.r} p=${params.p}`);
+
+  const hashes = () => Promise.all(Array.from({ length: concurrency }, () => scrypt.hash("benchmark", params, 64, "NaCl")));
+  await hashes(); // warm up
+
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < rounds; i++) await hashes();
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  console.log(`${rounds * concurrency} hashes in ${seconds.toFixed(3)} s: ${(rounds * concurrency / seconds).toFixed(1)}/s`);
+}
+
+main();
@@ -3,6 +3,7 @@
     'compiler-flags': [],
     'scrypt_platform_specific_files': [],
     'scrypt_platform_specific_includes': [],
+    'scrypt_cpusupport_defines': [],
     'conditions': [
       ['OS=="win"', {
         'scrypt_platform_specific_files': [
@@ -21,6 +22,17 @@
           'OTHER_CPLUSPLUSFLAGS' : ['-stdlib=libc++'],
         },
       }],
+      # Runtime CPU feature detection relies on <cpuid.h>, so SIMD smix
+      # kernels are only enabled for x86 toolchains that provide it
+      ['OS!="win" and (target_arch=="x64" or target_arch=="ia32")', {
+        'scrypt_cpusupport_defines': [
+          'CPUSUPPORT_X86_CPUID',
+          'CPUSUPPORT_X86_SSE2',
+          'CPUSUPPORT_X86_AVX2',
+          'CPUSUPPORT_X86_AVX512VL',
+          'CPUSUPPORT_X86_SHANI',
+        ],
+      }],
     ],
   },
 
@@ -50,15 +62,116 @@
         }]
       ]
     },
+    {
+      'target_name': 'scrypt_lib_sse2',
+      'type' : 'static_library',
+      'sources': [
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_sse2.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_lanes_sse2.c',
+      ],
+      'include_dirs': [
+        'scrypt/scrypt-1.2.0/',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport',
+        'scrypt/scrypt-1.2.0/libcperciva/util',
+        'scrypt/scrypt-1.2.0/lib/crypto',
+      ],
+      'defines': [
+        'HAVE_CONFIG_H',
+        '<@(scrypt_cpusupport_defines)',
+      ],
+      'conditions': [
+        ['target_arch=="ia32"', { 'cflags': ['-msse2'] }],
+      ],
+    },
+    {
+      'target_name': 'scrypt_lib_avx2',
+      'type' : 'static_library',
+      'sources': [
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_avx2.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_lanes_avx2.c',
+        'scrypt/scrypt-1.2.0/libcperciva/alg/sha256_avx2.c',
+      ],
+      'include_dirs': [
+        'scrypt/scrypt-1.2.0/',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport',
+        'scrypt/scrypt-1.2.0/libcperciva/alg',
+        'scrypt/scrypt-1.2.0/libcperciva/util',
+        'scrypt/scrypt-1.2.0/lib/crypto',
+      ],
+      'defines': [
+        'HAVE_CONFIG_H',
+        '<@(scrypt_cpusupport_defines)',
+      ],
+      'conditions': [
+        ['target_arch=="x64" or target_arch=="ia32"', {
+          'cflags': ['-mavx2'],
+          'xcode_settings': { 'OTHER_CFLAGS': ['-mavx2'] },
+        }],
+      ],
+    },
+    {
+      'target_name': 'scrypt_lib_avx512',
+      'type' : 'static_library',
+      'sources': [
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_avx512.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix_lanes_avx512.c',
+      ],
+      'include_dirs': [
+        'scrypt/scrypt-1.2.0/',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport',
+        'scrypt/scrypt-1.2.0/libcperciva/util',
+        'scrypt/scrypt-1.2.0/lib/crypto',
+      ],
+      'defines': [
+        'HAVE_CONFIG_H',
+        '<@(scrypt_cpusupport_defines)',
+      ],
+      'conditions': [
+        ['target_arch=="x64" or target_arch=="ia32"', {
+          'cflags': ['-mavx512f', '-mavx512vl'],
+          'xcode_settings': { 'OTHER_CFLAGS': ['-mavx512f', '-mavx512vl'] },
+        }],
+      ],
+    },
+    {
+      'target_name': 'scrypt_lib_shani',
+      'type' : 'static_library',
+      'sources': [
+        'scrypt/scrypt-1.2.0/libcperciva/alg/sha256_shani.c',
+      ],
+      'include_dirs': [
+        'scrypt/scrypt-1.2.0/',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport',
+        'scrypt/scrypt-1.2.0/libcperciva/alg',
+      ],
+      'defines': [
+        'HAVE_CONFIG_H',
+        '<@(scrypt_cpusupport_defines)',
+      ],
+      'conditions': [
+        ['target_arch=="x64" or target_arch=="ia32"', {
+          'cflags': ['-msse4.1', '-msha'],
+          'xcode_settings': { 'OTHER_CFLAGS': ['-msse4.1', '-msha'] },
+        }],
+      ],
+    },
     {
       'target_name': 'scrypt_lib',
       'type' : 'static_library',
       'sources': [
-        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt-ref.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_arena.c',
+        'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_budget.c',
         'scrypt/scrypt-1.2.0/lib/crypto/crypto_scrypt_smix.c',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport/cpusupport_x86_sse2.c',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport/cpusupport_x86_avx2.c',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport/cpusupport_x86_avx512vl.c',
+        'scrypt/scrypt-1.2.0/libcperciva/cpusupport/cpusupport_x86_shani.c',
         'scrypt/scrypt-1.2.0/libcperciva/util/warnp.c',
         'scrypt/scrypt-1.2.0/libcperciva/alg/sha256.c',
         'scrypt/scrypt-1.2.0/libcperciva/util/insecure_memzero.c',
+        'scrypt/scrypt-1.2.0/libcperciva/util/entropy.c',
+        'scrypt/scrypt-1.2.0/libcperciva/crypto/crypto_entropy.c',
         'scrypt/scrypt-1.2.0/lib/scryptenc/scryptenc_cpuperf.c',
         '<@(scrypt_platform_specific_files)',
       ],
@@ -67,16 +180,22 @@
         'scrypt/scrypt-1.2.0/libcperciva/cpusupport',
         'scrypt/scrypt-1.2.0/libcperciva/alg',
         'scrypt/scrypt-1.2.0/libcperciva/util',
+        'scrypt/scrypt-1.2.0/libcperciva/crypto',
         'scrypt/scrypt-1.2.0/lib/crypto',
         '<@(scrypt_platform_specific_includes)',
       ],
       'defines': [
-        'HAVE_CONFIG_H'
+        'HAVE_CONFIG_H',
+        '<@(scrypt_cpusupport_defines)',
       ],
       'conditions': [
-        ['OS=="win"', { 'defines' : [ 'inline=__inline' ] }],
+        ['OS=="win"', {
+          'defines' : [ 'inline=__inline' ],
+          'link_settings': { 'libraries': [ 'bcrypt.lib' ] },
+        }],
+        ['OS!="win"', { 'defines' : [ 'HAVE_PTHREAD' ] }],
       ],
-      'dependencies': ['copied_files'],
+      'dependencies': ['copied_files', 'scrypt_lib_sse2', 'scrypt_lib_avx2', 'scrypt_lib_avx512', 'scrypt_lib_shani'],
     },
     {
       'target_name': 'scrypt_wrapper',
@@ -92,6 +211,7 @@
         'src',
         'scrypt/scrypt-1.2.0/libcperciva/alg',
         'scrypt/scrypt-1.2.0/libcperciva/util',
+        'scrypt/scrypt-1.2.0/libcperciva/crypto',
         'scrypt/scrypt-1.2.0/lib/crypto',
         'scrypt/scrypt-1.2.0/lib/util/',
         'scrypt/scrypt-1.2.0/lib/scryptenc/',
@@ -102,20 +222,28 @@
       ],
       'conditions': [
         ['OS=="win"', { 'defines' : [ 'inline=__inline' ] }],
+        ['OS!="win"', { 'defines' : [ 'HAVE_PTHREAD' ] }],
       ],
     },
     {
       'target_name': 'scrypt',
       'sources': [
         'src/node-boilerplate/scrypt_common.cc',
+        'src/node-boilerplate/scrypt_pool.cc',
+        'src/node-boilerplate/scrypt_async.cc',
         'src/node-boilerplate/scrypt_params_async.cc',
         'src/node-boilerplate/scrypt_params_sync.cc',
         'src/node-boilerplate/scrypt_kdf_async.cc',
         'src/node-boilerplate/scrypt_kdf_sync.cc',
         'src/node-boilerplate/scrypt_kdf-verify_sync.cc',
         'src/node-boilerplate/scrypt_kdf-verify_async.cc',
+        'src/node-boilerplate/scrypt_kdf-verify-many_async.cc',
         'src/node-boilerplate/scrypt_hash_sync.cc',
         'src/node-boilerplate/scrypt_hash_async.cc',
+        'src/node-boilerplate/scrypt_hash-many_async.cc',
+        'src/node-boilerplate/scrypt_pbkdf2_sync.cc',
+        'src/node-boilerplate/scrypt_pbkdf2_async.cc',
+        'src/node-boilerplate/scrypt_configure.cc',
         'scrypt_node.cc'
       ],
       'include_dirs': [
@@ -125,6 +253,7 @@
         'src/scryptwrapper/inc',
         'src/node-boilerplate/inc',
         'scrypt/scrypt-1.2.0/lib/crypto',
+        'scrypt/scrypt-1.2.0/libcperciva/util',
       ],
       'defines': [
         'NAPI_VERSION=6',
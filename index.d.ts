@@ -1,5 +1,9 @@
 // Type definitions for the native scrypt module
 
+export type ScryptInput = string | Buffer | NodeJS.TypedArray | DataView | ArrayBuffer;
+
+export type ScryptTarget = Buffer | NodeJS.TypedArray | DataView | ArrayBuffer;
+
 export interface ScryptParams {
   N: number;
   r: number;
@@ -7,6 +11,88 @@ export interface ScryptParams {
   [key: string]: any;
 }
 
+export interface ScryptSchedule {
+  deadline?: number;
+  priority?: number;
+  signal?: AbortSignal;
+  onProgress?: (fraction: number) => void;
+}
+
+export interface ScryptConfig {
+  threads: number;
+  threadMemory: number;
+  arenaHighWater: number;
+  arenaPolicy: "keep" | "release";
+  hugePages: "off" | "thp" | "hugetlb";
+  kernel: string;
+  poolSize: number;
+  poolAffinity: number[];
+  maxQueueLength: number;
+  maxQueueWait: number;
+  timeSlice: number;
+  memoryBudget: number | "auto";
+}
+
+export interface ScryptCalibration {
+  cpu: string;
+  kernel: string;
+  spread: number;
+  points: { memory: number; r: number; opsPerSecond: number }[];
+}
+
+export interface ScryptCalibrateOptions {
+  file?: string;
+  force?: boolean;
+}
+
+export interface ScryptThroughput {
+  verifiesPerSecond: number;
+  concurrency?: number;
+  maxmem?: number;
+}
+
+export interface ScryptKernels {
+  active: string;
+  forced: boolean;
+  batchLanes: number;
+  kernels: { name: string; usable: boolean }[];
+}
+
+export interface ScryptStats {
+  arenaBytes: number;
+  arenas: number;
+  arenaHits: number;
+  arenaMisses: number;
+  arenaTrims: number;
+  arenaHugeTlb: number;
+  arenaThp: number;
+  poolThreads: number;
+  poolBusy: number;
+  poolQueued: number;
+  poolRejected: number;
+  poolExpired: number;
+  poolMissed: number;
+  memoryBudget: number;
+  memoryUsed: number;
+  memoryPeak: number;
+  memoryWaiting: number;
+  memoryWaits: number;
+}
+
+export function configure(
+  options?: Partial<ScryptConfig>
+): ScryptConfig;
+
+export function stats(): ScryptStats;
+
+export function trim(): void;
+
+export function kernels(): ScryptKernels;
+
+export function warmup(params?: ScryptParams): ScryptKernels;
+
+export function calibrate(options?: ScryptCalibrateOptions): ScryptCalibration;
+
 export function paramsSync(
   maxtime: number,
   maxmem?: number,
@@ -21,55 +107,182 @@ export function params(
   totalmem?: number,
   cb?: (err: Error | null, params: ScryptParams) => void
 ): void | Promise<ScryptParams>;
+export function params(
+  maxtime: number,
+  schedule: ScryptSchedule,
+  cb?: (err: Error | null, params: ScryptParams) => void
+): void | Promise<ScryptParams>;
+export function params(
+  maxtime: number,
+  maxmem: number | undefined,
+  max_memfrac: number | undefined,
+  schedule: ScryptSchedule,
+  cb?: (err: Error | null, params: ScryptParams) => void
+): void | Promise<ScryptParams>;
+
+export function paramsForThroughputSync(
+  throughput: ScryptThroughput
+): ScryptParams;
+
+export function paramsForThroughput(
+  throughput: ScryptThroughput,
+  cb?: (err: Error | null, params: ScryptParams) => void
+): void | Promise<ScryptParams>;
+export function paramsForThroughput(
+  throughput: ScryptThroughput,
+  schedule: ScryptSchedule,
+  cb?: (err: Error | null, params: ScryptParams) => void
+): void | Promise<ScryptParams>;
 
 export function kdfSync(
-  key: Buffer | string,
+  key: ScryptInput,
   params: ScryptParams,
   salt?: Buffer
 ): Buffer;
 
 export function kdf(
-  key: Buffer | string,
+  key: ScryptInput,
+  params: ScryptParams,
+  cb: (err: Error | null, kdfResult: Buffer) => void
+): void;
+export function kdf(
+  key: ScryptInput,
   params: ScryptParams,
+  schedule: ScryptSchedule,
   cb: (err: Error | null, kdfResult: Buffer) => void
 ): void;
 export function kdf(
-  key: Buffer | string,
-  params: ScryptParams
+  key: ScryptInput,
+  params: ScryptParams,
+  schedule?: ScryptSchedule
 ): Promise<Buffer>;
 
 export function verifyKdfSync(
-  kdf: Buffer | string,
-  key: Buffer | string
+  kdf: ScryptInput,
+  key: ScryptInput
 ): boolean;
 
 export function verifyKdf(
-  kdf: Buffer | string,
-  key: Buffer | string,
+  kdf: ScryptInput,
+  key: ScryptInput,
+  cb: (err: Error | null, match: boolean) => void
+): void;
+export function verifyKdf(
+  kdf: ScryptInput,
+  key: ScryptInput,
+  schedule: ScryptSchedule,
   cb: (err: Error | null, match: boolean) => void
 ): void;
 export function verifyKdf(
-  kdf: Buffer | string,
-  key: Buffer | string
+  kdf: ScryptInput,
+  key: ScryptInput,
+  schedule?: ScryptSchedule
 ): Promise<boolean>;
 
+export function verifyKdfMany(
+  pairs: [ScryptInput, ScryptInput][],
+  cb: (err: Error | null, matches: boolean[]) => void
+): void;
+export function verifyKdfMany(
+  pairs: [ScryptInput, ScryptInput][]
+): Promise<boolean[]>;
+
 export function hashSync(
-  key: Buffer | string,
+  key: ScryptInput,
   params: ScryptParams,
   outlen: number,
-  salt: Buffer | string
+  salt: ScryptInput
 ): Buffer;
 
 export function hash(
-  key: Buffer | string,
+  key: ScryptInput,
   params: ScryptParams,
   outlen: number,
-  salt: Buffer | string,
+  salt: ScryptInput,
   cb: (err: Error | null, hash: Buffer) => void
 ): void;
 export function hash(
-  key: Buffer | string,
+  key: ScryptInput,
+  params: ScryptParams,
+  outlen: number,
+  salt: ScryptInput,
+  schedule: ScryptSchedule,
+  cb: (err: Error | null, hash: Buffer) => void
+): void;
+export function hash(
+  key: ScryptInput,
+  params: ScryptParams,
+  outlen: number,
+  salt: ScryptInput,
+  schedule?: ScryptSchedule
+): Promise<Buffer>;
+
+export function hashIntoSync<T extends ScryptTarget>(
+  key: ScryptInput,
+  params: ScryptParams,
+  outlen: number,
+  salt: ScryptInput,
+  target: T,
+  offset?: number
+): T;
+
+export function hashInto<T extends ScryptTarget>(
+  key: ScryptInput,
+  params: ScryptParams,
+  outlen: number,
+  salt: ScryptInput,
+  target: T,
+  offset: number,
+  cb: (err: Error | null, target: T) => void
+): void;
+export function hashInto<T extends ScryptTarget>(
+  key: ScryptInput,
   params: ScryptParams,
   outlen: number,
-  salt: Buffer | string
-): Promise<Buffer>;
\ No newline at end of file
+  salt: ScryptInput,
+  target: T,
+  cb: (err: Error | null, target: T) => void
+): void;
+export function hashInto<T extends ScryptTarget>(
+  key: ScryptInput,
+  params: ScryptParams,
+  outlen: number,
+  salt: ScryptInput,
+  target: T,
+  offset?: number
+): Promise<T>;
+
+export function hashMany(
+  keys: (ScryptInput)[],
+  params: ScryptParams,
+  outlen: number,
+  salts: (ScryptInput)[],
+  cb: (err: Error | null, hashes: Buffer[]) => void
+): void;
+export function hashMany(
+  keys: (ScryptInput)[],
+  params: ScryptParams,
+  outlen: number,
+  salts: (ScryptInput)[]
+): Promise<Buffer[]>;
+
+export function pbkdf2Sync(
+  key: ScryptInput,
+  salt: ScryptInput,
+  iterations: number,
+  keylen: number
+): Buffer;
+
+export function pbkdf2(
+  key: ScryptInput,
+  salt: ScryptInput,
+  iterations: number,
+  keylen: number,
+  cb: (err: Error | null, derivedKey: Buffer) => void
+): void;
+export function pbkdf2(
+  key: ScryptInput,
+  salt: ScryptInput,
+  iterations: number,
+  keylen: number
+): Promise<Buffer>;
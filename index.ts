@@ -1,7 +1,7 @@
 // TypeScript migration of index.js
 
+import * as Fs from "node:fs";
 import * as Os from "node:os";
-import * as Crypto from "node:crypto";
 import scryptNative from "./build/Release/scrypt.node";
 
 interface ScryptParams {
@@ -11,8 +11,79 @@ interface ScryptParams {
   [key: string]: any;
 }
 
+interface ScryptSchedule {
+  deadline?: number;
+  priority?: number;
+  signal?: AbortSignal;
+  onProgress?: (fraction: number) => void;
+}
+
+interface ScryptConfig {
+  threads: number;
+  threadMemory: number;
+  arenaHighWater: number;
+  arenaPolicy: "keep" | "release";
+  hugePages: "off" | "thp" | "hugetlb";
+  kernel: string;
+  poolSize: number;
+  poolAffinity: number[];
+  maxQueueLength: number;
+  maxQueueWait: number;
+  timeSlice: number;
+  memoryBudget: number | "auto";
+}
+
+interface ScryptCalibration {
+  cpu: string;
+  kernel: string;
+  spread: number;
+  points: { memory: number; r: number; opsPerSecond: number }[];
+}
+
+interface ScryptCalibrateOptions {
+  file?: string;
+  force?: boolean;
+}
+
+interface ScryptKernels {
+  active: string;
+  forced: boolean;
+  batchLanes: number;
+  kernels: { name: string; usable: boolean }[];
+}
+
+interface ScryptStats {
+  arenaBytes: number;
+  arenas: number;
+  arenaHits: number;
+  arenaMisses: number;
+  arenaTrims: number;
+  arenaHugeTlb: number;
+  arenaThp: number;
+  poolThreads: number;
+  poolBusy: number;
+  poolQueued: number;
+  poolRejected: number;
+  poolExpired: number;
+  poolMissed: number;
+  memoryBudget: number;
+  memoryUsed: number;
+  memoryPeak: number;
+  memoryWaiting: number;
+  memoryWaits: number;
+}
+
 type Callback<T> = (err: Error | null, result?: T) => void;
 
+//
+// Promise calls with well-formed arguments go straight to a native function which checks them and returns
+// the Promise itself. It returns undefined for anything it would not accept, and the call then takes the
+// full path below, which reports exactly what is wrong (including a missing global Promise).
+//
+function isPromiseCall(args: any[], numberOfArguments: number): boolean {
+  return args.length === numberOfArguments && typeof args[numberOfArguments - 1] !== "function" && typeof Promise !== "undefined";
+}
+
 function checkNumberOfArguments(args: any[], message = "No arguments present", numberOfArguments = 1): void {
   if (args.length < numberOfArguments) {
     throw new SyntaxError(message);
@@ -42,6 +113,55 @@ function checkAsyncArguments(args: any[], callback_least_needed_pos: number, mes
   return callback_index;
 }
 
+//
+// Scheduling options sit after the arguments of hash, kdf, verifyKdf and params, before any callback.
+// Returns them, or undefined if the argument at that position is not an options object.
+//
+function processScheduleArgument(args: any[], index: number): ScryptSchedule | undefined {
+  const options = args[index];
+  let error: Error | undefined = undefined;
+
+  if (typeof options !== "object" || options === null) return undefined;
+
+  if (options.deadline !== undefined && (typeof options.deadline !== "number" || !Number.isFinite(options.deadline))) {
+    error = new TypeError("deadline must be a timestamp in milliseconds, as returned by Date.now()");
+    (error as any).propertyName = "deadline";
+    (error as any).propertyValue = options.deadline;
+  } else if (options.priority !== undefined && (typeof options.priority !== "number" || !Number.isInteger(options.priority))) {
+    error = new TypeError("priority must be an integer");
+    (error as any).propertyName = "priority";
+    (error as any).propertyValue = options.priority;
+  } else if (options.signal !== undefined && (typeof options.signal !== "object" || options.signal === null ||
+             typeof options.signal.aborted !== "boolean" || typeof options.signal.addEventListener !== "function")) {
+    error = new TypeError("signal must be an AbortSignal");
+    (error as any).propertyName = "signal";
+    (error as any).propertyValue = options.signal;
+  } else if (options.onProgress !== undefined && typeof options.onProgress !== "function") {
+    error = new TypeError("onProgress must be a function");
+    (error as any).propertyName = "onProgress";
+    (error as any).propertyValue = options.onProgress;
+  }
+
+  if (error) throw error;
+  return options;
+}
+
+//
+// Strings and any binary view go to the native side as they are; there is no copy into a Buffer here
+//
+function isInput(value: any): boolean {
+  return typeof value === "string" || ArrayBuffer.isView(value) || value instanceof ArrayBuffer;
+}
+
+function checkInput(value: any, propertyName: string, label: string): void {
+  if (!isInput(value)) {
+    const error = new TypeError(`${label} type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer`);
+    (error as any).propertyName = propertyName;
+    (error as any).propertyValue = value;
+    throw error;
+  }
+}
+
 function checkScryptParametersObject(params: any): void {
   let error: Error | undefined = undefined;
 
@@ -120,17 +240,58 @@ function processParamsArguments(args: any[]): any[] {
   return args;
 }
 
-function processKDFArguments(args: any[]): any[] {
-  checkNumberOfArguments(args, "At least two arguments are needed - the key and the Scrypt paramaters object", 2);
+//
+// Throughput options: verifiesPerSecond, and optionally concurrency (one per CPU by default) and maxmem.
+// Returns the native arguments: verifiesPerSecond, concurrency, maxmem and the memory to share
+//
+function processThroughputArguments(args: any[]): any[] {
+  let error: Error | undefined = undefined;
 
-  if (typeof args[0] === "string") args[0] = Buffer.from(args[0]);
-  else if (!Buffer.isBuffer(args[0])) {
-    const error = new TypeError("Key type is incorrect: It can only be of type string or Buffer");
-    (error as any).propertyName = "key";
-    (error as any).propertyValue = args[0];
+  checkNumberOfArguments(args, "At least one argument is needed - the throughput options object", 1);
+
+  const options = args[0];
+  if (typeof options !== "object" || options === null) {
+    error = new TypeError("Throughput options type is incorrect: It must be a JSON object");
+    (error as any).propertyName = "options";
+    (error as any).propertyValue = options;
     throw error;
   }
 
+  const values: { [propertyName: string]: any } = {
+    verifiesPerSecond: options.verifiesPerSecond,
+    concurrency: options.concurrency === undefined ? Math.max(Os.cpus().length, 1) : options.concurrency,
+    maxmem: options.maxmem === undefined ? 0 : options.maxmem,
+  };
+
+  for (const propertyName of ["verifiesPerSecond", "concurrency", "maxmem"]) {
+    const value = values[propertyName];
+
+    if (propertyName === "verifiesPerSecond") {
+      if (typeof value !== "number" || !Number.isFinite(value)) error = new TypeError(`${propertyName} must be a number`);
+      else if (value <= 0) error = new RangeError(`${propertyName} must be greater than 0`);
+    } else if (typeof value !== "number" || !Number.isInteger(value)) {
+      error = new TypeError(`${propertyName} must be an integer`);
+    } else if (propertyName === "concurrency" && (value < 1 || value > 1024)) {
+      error = new RangeError(`${propertyName} must be between 1 and 1024 inclusive`);
+    } else if (value < 0) {
+      error = new RangeError(`${propertyName} must be greater than or equal to 0`);
+    }
+
+    if (error) {
+      (error as any).propertyName = propertyName;
+      (error as any).propertyValue = value;
+      throw error;
+    }
+  }
+
+  return [values.verifiesPerSecond, values.concurrency, values.maxmem, Os.totalmem()];
+}
+
+function processKDFArguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least two arguments are needed - the key and the Scrypt paramaters object", 2);
+
+  checkInput(args[0], "key", "Key");
+
   checkScryptParametersObject(args[1]);
   return args;
 }
@@ -138,32 +299,94 @@ function processKDFArguments(args: any[]): any[] {
 function processVerifyArguments(args: any[]): any[] {
   checkNumberOfArguments(args, "At least two arguments are needed - the KDF and the key", 2);
 
-  if (typeof args[0] === "string") args[0] = Buffer.from(args[0]);
-  else if (!Buffer.isBuffer(args[0])) {
-    const error = new TypeError("KDF type is incorrect: It can only be of type string or Buffer");
-    (error as any).propertyName = "KDF";
-    (error as any).propertyValue = args[0];
+  checkInput(args[0], "KDF", "KDF");
+
+  checkInput(args[1], "key", "Key");
+
+  return args;
+}
+
+function processHashArguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least four arguments are needed - the key to hash, the scrypt params object, the output length of the hash and the salt", 4);
+
+  checkInput(args[0], "KDF", "Key");
+
+  checkScryptParametersObject(args[1]);
+
+  if (typeof args[2] !== "number" || !Number.isInteger(args[2])) {
+    throw new TypeError("Hash length must be an integer");
+  }
+
+  checkInput(args[3], "salt", "Salt");
+
+  return args;
+}
+
+function processHashIntoArguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least five arguments are needed - the key to hash, the scrypt params object, the output length of the hash, the salt and the target", 5);
+  processHashArguments(args);
+
+  if (!ArrayBuffer.isView(args[4]) && !(args[4] instanceof ArrayBuffer)) {
+    const error = new TypeError("Target type is incorrect: It can only be of type Buffer, TypedArray, DataView or ArrayBuffer");
+    (error as any).propertyName = "target";
+    (error as any).propertyValue = args[4];
     throw error;
   }
 
-  if (typeof args[1] === "string") args[1] = Buffer.from(args[1]);
-  else if (!Buffer.isBuffer(args[1])) {
-    const error = new TypeError("Key type is incorrect: It can only be of type string or Buffer");
-    (error as any).propertyName = "key";
-    (error as any).propertyValue = args[1];
+  if (args[5] === undefined || typeof args[5] === "function") args.splice(5, args[5] === undefined ? 1 : 0, 0);
+
+  let error: Error | undefined = undefined;
+  if (typeof args[5] !== "number" || !Number.isInteger(args[5])) error = new TypeError("Offset must be an integer");
+  else if (args[5] < 0 || args[5] + args[2] > args[4].byteLength) error = new RangeError("The hash does not fit into the target at this offset");
+  if (error) {
+    (error as any).propertyName = "offset";
+    (error as any).propertyValue = args[5];
     throw error;
   }
 
   return args;
 }
 
-function processHashArguments(args: any[]): any[] {
-  checkNumberOfArguments(args, "At least four arguments are needed - the key to hash, the scrypt params object, the output length of the hash and the salt", 4);
+function checkInputArray(array: any[], propertyName: string, label: string): any[] {
+  for (let i = 0; i < array.length; i++) checkInput(array[i], `${propertyName}[${i}]`, label);
+  return array;
+}
 
-  if (typeof args[0] === "string") args[0] = Buffer.from(args[0]);
-  else if (!Buffer.isBuffer(args[0])) {
-    const error = new TypeError("Key type is incorrect: It can only be of type string or Buffer");
-    (error as any).propertyName = "KDF";
+function processVerifyManyArguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least one argument is needed - the array of KDF and key pairs", 1);
+
+  if (!Array.isArray(args[0])) {
+    const error = new TypeError("Pairs type is incorrect: It must be an array of [KDF, key] pairs");
+    (error as any).propertyName = "pairs";
+    (error as any).propertyValue = args[0];
+    throw error;
+  }
+
+  const kdfs = new Array<any>(args[0].length);
+  const keys = new Array<any>(args[0].length);
+  for (let i = 0; i < args[0].length; i++) {
+    const pair = args[0][i];
+    if (!Array.isArray(pair) || pair.length < 2) {
+      const error = new TypeError("Pairs type is incorrect: It must be an array of [KDF, key] pairs");
+      (error as any).propertyName = `pairs[${i}]`;
+      (error as any).propertyValue = pair;
+      throw error;
+    }
+    kdfs[i] = pair[0];
+    keys[i] = pair[1];
+  }
+
+  args[0] = checkInputArray(kdfs, "KDF", "KDF");
+  args.splice(1, 0, checkInputArray(keys, "key", "Key"));
+  return args;
+}
+
+function processHashManyArguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least four arguments are needed - the keys to hash, the scrypt params object, the output length of the hashes and the salts", 4);
+
+  if (!Array.isArray(args[0])) {
+    const error = new TypeError("Keys type is incorrect: It must be an array of strings or binary data");
+    (error as any).propertyName = "keys";
     (error as any).propertyValue = args[0];
     throw error;
   }
@@ -174,17 +397,215 @@ function processHashArguments(args: any[]): any[] {
     throw new TypeError("Hash length must be an integer");
   }
 
-  if (typeof args[3] === "string") args[3] = Buffer.from(args[3]);
-  else if (!Buffer.isBuffer(args[3])) {
-    const error = new TypeError("Salt type is incorrect: It can only be of type string or Buffer");
-    (error as any).propertyName = "salt";
+  if (!Array.isArray(args[3]) || args[3].length !== args[0].length) {
+    const error = new TypeError("Salts type is incorrect: It must be an array of strings or binary data, one for each key");
+    (error as any).propertyName = "salts";
     (error as any).propertyValue = args[3];
     throw error;
   }
 
+  checkInputArray(args[0], "keys", "Key");
+  checkInputArray(args[3], "salts", "Salt");
+  return args;
+}
+
+function splitHashes(hashes: Buffer, count: number, hashLength: number): Buffer[] {
+  const result = new Array<Buffer>(count);
+  for (let i = 0; i < count; i++) result[i] = hashes.subarray(i * hashLength, (i + 1) * hashLength);
+  return result;
+}
+
+function processPbkdf2Arguments(args: any[]): any[] {
+  checkNumberOfArguments(args, "At least four arguments are needed - the key, the salt, the number of iterations and the output length of the key", 4);
+
+  checkInput(args[0], "key", "Key");
+
+  checkInput(args[1], "salt", "Salt");
+
+  let error: Error | undefined = undefined;
+  if (typeof args[2] !== "number" || !Number.isInteger(args[2])) error = new TypeError("Iterations must be an integer");
+  else if (args[2] < 1) error = new RangeError("Iterations must be greater than 0");
+  if (error) {
+    (error as any).propertyName = "iterations";
+    (error as any).propertyValue = args[2];
+    throw error;
+  }
+
+  if (typeof args[3] !== "number" || !Number.isInteger(args[3])) error = new TypeError("Key length must be an integer");
+  else if (args[3] < 0 || args[3] > (2 ** 32 - 1) * 32) error = new RangeError("Key length must be between 0 and (2^32 - 1) * 32");
+  if (error) {
+    (error as any).propertyName = "keylen";
+    (error as any).propertyValue = args[3];
+    throw error;
+  }
+
+  return args;
+}
+
+function processConfigureArguments(args: any[]): any[] {
+  let error: Error | undefined = undefined;
+
+  if (args[0] === undefined) args[0] = {};
+
+  if (typeof args[0] !== "object" || args[0] === null) {
+    error = new TypeError("Configuration options type is incorrect: It must be a JSON object");
+    (error as any).propertyName = "options";
+    (error as any).propertyValue = args[0];
+    throw error;
+  }
+
+  for (const propertyName of ["threads", "threadMemory", "arenaHighWater", "poolSize", "maxQueueLength", "maxQueueWait", "timeSlice"]) {
+    if (!Object.prototype.hasOwnProperty.call(args[0], propertyName)) continue;
+
+    const value = args[0][propertyName];
+    if (typeof value !== "number" || !Number.isInteger(value)) error = new TypeError(`${propertyName} must be an integer`);
+    else if (value < 0) error = new RangeError(`${propertyName} must be greater than or equal to 0`);
+
+    if (error) {
+      (error as any).propertyName = propertyName;
+      (error as any).propertyValue = value;
+      throw error;
+    }
+  }
+
+  if (Object.prototype.hasOwnProperty.call(args[0], "arenaPolicy") && args[0].arenaPolicy !== "keep" && args[0].arenaPolicy !== "release") {
+    error = new TypeError("arenaPolicy must be either \"keep\" or \"release\"");
+    (error as any).propertyName = "arenaPolicy";
+    (error as any).propertyValue = args[0].arenaPolicy;
+    throw error;
+  }
+
+  if (Object.prototype.hasOwnProperty.call(args[0], "hugePages") && !["off", "thp", "hugetlb"].includes(args[0].hugePages)) {
+    error = new TypeError("hugePages must be one of \"off\", \"thp\" or \"hugetlb\"");
+    (error as any).propertyName = "hugePages";
+    (error as any).propertyValue = args[0].hugePages;
+    throw error;
+  }
+
+  if (Object.prototype.hasOwnProperty.call(args[0], "kernel") && typeof args[0].kernel !== "string") {
+    error = new TypeError("kernel must be a string");
+    (error as any).propertyName = "kernel";
+    (error as any).propertyValue = args[0].kernel;
+    throw error;
+  }
+
+  if (Object.prototype.hasOwnProperty.call(args[0], "memoryBudget") && args[0].memoryBudget !== "auto") {
+    const value = args[0].memoryBudget;
+    if (typeof value !== "number" || !Number.isInteger(value)) error = new TypeError("memoryBudget must be an integer or \"auto\"");
+    else if (value < 0) error = new RangeError("memoryBudget must be greater than or equal to 0");
+
+    if (error) {
+      (error as any).propertyName = "memoryBudget";
+      (error as any).propertyValue = value;
+      throw error;
+    }
+  }
+
+  if (Object.prototype.hasOwnProperty.call(args[0], "poolAffinity") &&
+      (!Array.isArray(args[0].poolAffinity) || !args[0].poolAffinity.every((cpu: any) => Number.isInteger(cpu) && cpu >= 0))) {
+    error = new TypeError("poolAffinity must be an array of CPU numbers");
+    (error as any).propertyName = "poolAffinity";
+    (error as any).propertyValue = args[0].poolAffinity;
+    throw error;
+  }
+
   return args;
 }
 
+export function configure(...args: any[]): ScryptConfig {
+  const processed = processConfigureArguments(args);
+  return scryptNative.configure(processed[0]);
+}
+
+export function stats(): ScryptStats {
+  return scryptNative.stats();
+}
+
+export function trim(): void {
+  scryptNative.trim();
+}
+
+export function kernels(): ScryptKernels {
+  return scryptNative.kernels();
+}
+
+export function warmup(...args: any[]): ScryptKernels {
+  if (args[0] !== undefined) checkScryptParametersObject(args[0]);
+  return scryptNative.warmup(args[0]);
+}
+
+//
+// Calibration options are an object with an optional file path and force flag
+//
+function processCalibrateArguments(args: any[]): ScryptCalibrateOptions {
+  let error: Error | undefined = undefined;
+
+  if (args[0] === undefined) args[0] = {};
+
+  if (typeof args[0] !== "object" || args[0] === null) {
+    error = new TypeError("Calibration options type is incorrect: It must be a JSON object");
+    (error as any).propertyName = "options";
+    (error as any).propertyValue = args[0];
+  } else if (args[0].file !== undefined && (typeof args[0].file !== "string" || args[0].file.length === 0)) {
+    error = new TypeError("file must be a path");
+    (error as any).propertyName = "file";
+    (error as any).propertyValue = args[0].file;
+  } else if (args[0].force !== undefined && typeof args[0].force !== "boolean") {
+    error = new TypeError("force must be a boolean");
+    (error as any).propertyName = "force";
+    (error as any).propertyValue = args[0].force;
+  }
+
+  if (error) throw error;
+  return args[0];
+}
+
+//
+// A calibration read from a file must have a spread and between 1 and 16 well-formed points
+//
+function isCalibration(value: any): value is ScryptCalibration {
+  return typeof value === "object" && value !== null && typeof value.spread === "number" &&
+    Array.isArray(value.points) && value.points.length > 0 && value.points.length <= 16 &&
+    value.points.every((point: any) => typeof point === "object" && point !== null &&
+      Number.isSafeInteger(point.memory) && point.memory > 0 &&
+      Number.isInteger(point.r) && point.r > 0 && point.r < 0x40000000 &&
+      typeof point.opsPerSecond === "number" && Number.isFinite(point.opsPerSecond) && point.opsPerSecond > 0);
+}
+
+export function calibrate(...args: any[]): ScryptCalibration {
+  const options = processCalibrateArguments(args);
+  const cpu = Os.cpus().length > 0 ? Os.cpus()[0].model.trim() : "unknown";
+  const key = `${cpu} / ${scryptNative.kernels().active}`;
+
+  // A profile file holds one calibration per CPU model and kernel; one that cannot be read is measured afresh
+  let profiles: { [key: string]: ScryptCalibration } = {};
+  if (options.file !== undefined) {
+    try {
+      profiles = JSON.parse(Fs.readFileSync(options.file, "utf8"));
+    } catch {
+      profiles = {};
+    }
+    if (typeof profiles !== "object" || profiles === null || Array.isArray(profiles)) profiles = {};
+
+    const saved = Object.prototype.hasOwnProperty.call(profiles, key) ? profiles[key] : undefined;
+    if (!options.force && isCalibration(saved)) {
+      return { cpu, ...scryptNative.calibrate(false, saved.points, saved.spread) };
+    }
+  }
+
+  const calibration: ScryptCalibration = { cpu, ...scryptNative.calibrate(options.force === true) };
+
+  // Written next to the file and renamed over it, so that processes starting together never read half a file
+  if (options.file !== undefined) {
+    profiles[key] = calibration;
+    const temporary = `${options.file}.${process.pid}.tmp`;
+    Fs.writeFileSync(temporary, JSON.stringify(profiles, null, 2) + "\n");
+    Fs.renameSync(temporary, options.file);
+  }
+
+  return calibration;
+}
+
 export function paramsSync(...args: any[]): ScryptParams {
   const processed = processParamsArguments(args);
   return scryptNative.paramsSync(processed[0], processed[1], processed[2], Os.totalmem());
@@ -193,50 +614,80 @@ export function paramsSync(...args: any[]): ScryptParams {
 export function params(...args: any[]): Promise<ScryptParams> | void {
   const callback_index = checkAsyncArguments(args, 1, "At least one argument is needed before the callback - the maxtime");
 
+  // The options object may follow any of maxtime, maxmem and max_memfrac, which then take their defaults
+  const options_index = args.findIndex((arg, i) => i > 0 && typeof arg === "object" && arg !== null);
+  let schedule: ScryptSchedule | undefined = undefined;
+  if (options_index !== -1 && (callback_index === undefined || options_index < callback_index)) {
+    schedule = processScheduleArgument(args, options_index);
+    delete args[options_index];
+  }
+
   if (callback_index === undefined) {
     return new Promise((resolve, reject) => {
       const processed = processParamsArguments(args);
       scryptNative.params(processed[0], processed[1], processed[2], Os.totalmem(), (err: Error | null, params: ScryptParams) => {
         if (err) reject(err);
         else resolve(params);
-      });
+      }, schedule);
     });
   } else {
     const callback = args[callback_index];
     delete args[callback_index];
     const processed = processParamsArguments(args);
     processed[3] = callback;
-    scryptNative.params(processed[0], processed[1], processed[2], Os.totalmem(), processed[3]);
+    scryptNative.params(processed[0], processed[1], processed[2], Os.totalmem(), processed[3], schedule);
+  }
+}
+
+export function paramsForThroughputSync(...args: any[]): ScryptParams {
+  const processed = processThroughputArguments(args);
+  return scryptNative.paramsForThroughputSync(processed[0], processed[1], processed[2], processed[3]);
+}
+
+export function paramsForThroughput(...args: any[]): Promise<ScryptParams> | void {
+  const callback_index = checkAsyncArguments(args, 1, "At least one argument is needed before the callback - the throughput options object");
+
+  if (callback_index === undefined) {
+    return new Promise((resolve, reject) => {
+      const processed = processThroughputArguments(args);
+      const schedule = processScheduleArgument(args, 1);
+      scryptNative.paramsForThroughput(processed[0], processed[1], processed[2], processed[3], (err: Error | null, params: ScryptParams) => {
+        if (err) reject(err);
+        else resolve(params);
+      }, schedule);
+    });
+  } else {
+    const processed = processThroughputArguments(args);
+    const schedule = processScheduleArgument(args, 1);
+    scryptNative.paramsForThroughput(processed[0], processed[1], processed[2], processed[3], args[callback_index], schedule);
   }
 }
 
 export function kdfSync(...args: any[]): Buffer {
   const processed = processKDFArguments(args);
-  return scryptNative.kdfSync(processed[0], processed[1], Crypto.randomBytes(256));
+  return scryptNative.kdfSync(processed[0], processed[1]);
 }
 
 export function kdf(...args: any[]): Promise<Buffer> | void {
+  if (isPromiseCall(args, 2)) {
+    const promise = scryptNative.kdfPromise(args[0], args[1]);
+    if (promise !== undefined) return promise;
+  }
+
   const callback_index = checkAsyncArguments(args, 2, "At least two arguments are needed before the call back function - the key and the Scrypt parameters object");
 
   const processed = processKDFArguments(args);
+  const schedule = processScheduleArgument(processed, 2);
 
   if (callback_index === undefined) {
     return new Promise((resolve, reject) => {
-      Crypto.randomBytes(256, (err, salt) => {
+      scryptNative.kdf(processed[0], processed[1], (err: Error | null, kdfResult: Buffer) => {
         if (err) reject(err);
-        else {
-          scryptNative.kdf(processed[0], processed[1], salt, (err: Error | null, kdfResult: Buffer) => {
-            if (err) reject(err);
-            else resolve(kdfResult);
-          });
-        }
-      });
+        else resolve(kdfResult);
+      }, schedule);
     });
   } else {
-    Crypto.randomBytes(256, (err, salt) => {
-      if (err) processed[2](err);
-      else scryptNative.kdf(processed[0], processed[1], salt, processed[2]);
-    });
+    scryptNative.kdf(processed[0], processed[1], processed[callback_index], schedule);
   }
 }
 
@@ -246,19 +697,43 @@ export function verifyKdfSync(...args: any[]): boolean {
 }
 
 export function verifyKdf(...args: any[]): Promise<boolean> | void {
+  if (isPromiseCall(args, 2)) {
+    const promise = scryptNative.verifyPromise(args[0], args[1]);
+    if (promise !== undefined) return promise;
+  }
+
   const callback_index = checkAsyncArguments(args, 2, "At least two arguments are needed before the callback function - the KDF and the key");
 
   if (callback_index === undefined) {
     return new Promise((resolve, reject) => {
       const processed = processVerifyArguments(args);
+      const schedule = processScheduleArgument(processed, 2);
       scryptNative.verify(processed[0], processed[1], (err: Error | null, match: boolean) => {
         if (err) reject(err);
         else resolve(match);
-      });
+      }, schedule);
     });
   } else {
     const processed = processVerifyArguments(args);
-    scryptNative.verify(processed[0], processed[1], processed[2]);
+    const schedule = processScheduleArgument(processed, 2);
+    scryptNative.verify(processed[0], processed[1], processed[callback_index], schedule);
+  }
+}
+
+export function verifyKdfMany(...args: any[]): Promise<boolean[]> | void {
+  const callback_index = checkAsyncArguments(args, 1, "At least one argument is needed before the callback function - the array of KDF and key pairs");
+
+  const processed = processVerifyManyArguments(args);
+
+  if (callback_index === undefined) {
+    return new Promise((resolve, reject) => {
+      scryptNative.verifyMany(processed[0], processed[1], (err: Error | null, matches: boolean[]) => {
+        if (err) reject(err);
+        else resolve(matches);
+      });
+    });
+  } else {
+    scryptNative.verifyMany(processed[0], processed[1], processed[2]);
   }
 }
 
@@ -268,18 +743,99 @@ export function hashSync(...args: any[]): Buffer {
 }
 
 export function hash(...args: any[]): Promise<Buffer> | void {
+  if (isPromiseCall(args, 4)) {
+    const promise = scryptNative.hashPromise(args[0], args[1], args[2], args[3]);
+    if (promise !== undefined) return promise;
+  }
+
   const callback_index = checkAsyncArguments(args, 4, "At least four arguments are needed before the callback - the key to hash, the scrypt params object, the output length of the hash and the salt");
 
   const processed = processHashArguments(args);
+  const schedule = processScheduleArgument(processed, 4);
 
   if (callback_index === undefined) {
     return new Promise((resolve, reject) => {
       scryptNative.hash(processed[0], processed[1], processed[2], processed[3], (err: Error | null, hash: Buffer) => {
         if (err) reject(err);
         else resolve(hash);
+      }, schedule);
+    });
+  } else {
+    scryptNative.hash(processed[0], processed[1], processed[2], processed[3], processed[callback_index], schedule);
+  }
+}
+
+export function hashIntoSync(...args: any[]): Buffer | ArrayBufferView | ArrayBuffer {
+  const processed = processHashIntoArguments(args);
+  return scryptNative.hashIntoSync(processed[0], processed[1], processed[2], processed[3], processed[4], processed[5]);
+}
+
+export function hashInto(...args: any[]): Promise<Buffer | ArrayBufferView | ArrayBuffer> | void {
+  if (isPromiseCall(args, 5) || isPromiseCall(args, 6)) {
+    const promise = scryptNative.hashIntoPromise(args[0], args[1], args[2], args[3], args[4], args.length === 5 ? 0 : args[5]);
+    if (promise !== undefined) return promise;
+  }
+
+  const callback_index = checkAsyncArguments(args, 5, "At least five arguments are needed before the callback - the key to hash, the scrypt params object, the output length of the hash, the salt and the target");
+
+  const processed = processHashIntoArguments(args);
+
+  if (callback_index === undefined) {
+    return new Promise((resolve, reject) => {
+      scryptNative.hashInto(processed[0], processed[1], processed[2], processed[3], processed[4], processed[5], (err: Error | null, target: Buffer) => {
+        if (err) reject(err);
+        else resolve(target);
+      });
+    });
+  } else {
+    scryptNative.hashInto(processed[0], processed[1], processed[2], processed[3], processed[4], processed[5], processed[6]);
+  }
+}
+
+export function hashMany(...args: any[]): Promise<Buffer[]> | void {
+  const callback_index = checkAsyncArguments(args, 4, "At least four arguments are needed before the callback - the keys to hash, the scrypt params object, the output length of the hashes and the salts");
+
+  const processed = processHashManyArguments(args);
+  const count = processed[0].length;
+
+  if (callback_index === undefined) {
+    return new Promise((resolve, reject) => {
+      scryptNative.hashMany(processed[0], processed[1], processed[2], processed[3], (err: Error | null, hashes: Buffer) => {
+        if (err) reject(err);
+        else resolve(splitHashes(hashes, count, processed[2]));
+      });
+    });
+  } else {
+    scryptNative.hashMany(processed[0], processed[1], processed[2], processed[3], (err: Error | null, hashes: Buffer) => {
+      if (err) processed[4](err);
+      else processed[4](null, splitHashes(hashes, count, processed[2]));
+    });
+  }
+}
+
+export function pbkdf2Sync(...args: any[]): Buffer {
+  const processed = processPbkdf2Arguments(args);
+  return scryptNative.pbkdf2Sync(processed[0], processed[1], processed[2], processed[3]);
+}
+
+export function pbkdf2(...args: any[]): Promise<Buffer> | void {
+  if (isPromiseCall(args, 4)) {
+    const promise = scryptNative.pbkdf2Promise(args[0], args[1], args[2], args[3]);
+    if (promise !== undefined) return promise;
+  }
+
+  const callback_index = checkAsyncArguments(args, 4, "At least four arguments are needed before the callback - the key, the salt, the number of iterations and the output length of the key");
+
+  const processed = processPbkdf2Arguments(args);
+
+  if (callback_index === undefined) {
+    return new Promise((resolve, reject) => {
+      scryptNative.pbkdf2(processed[0], processed[1], processed[2], processed[3], (err: Error | null, key: Buffer) => {
+        if (err) reject(err);
+        else resolve(key);
       });
     });
   } else {
-    scryptNative.hash(processed[0], processed[1], processed[2], processed[3], processed[4]);
+    scryptNative.pbkdf2(processed[0], processed[1], processed[2], processed[3], processed[4]);
   }
-}
\ No newline at end of file
+}
@@ -28,133 +28,710 @@
  */
 #include "scrypt_platform.h"
 
+#if !defined(HAVE_PTHREAD) && defined(_WIN32)
+#include <windows.h>
+#endif
+
 #include <sys/types.h>
-#include <sys/mman.h>
 
 #include <errno.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cpusupport.h"
+#include "insecure_memzero.h"
 #include "sha256.h"
+#include "sysendian.h"
 #include "warnp.h"
 
+#include "crypto_scrypt_arena.h"
+#include "crypto_scrypt_budget.h"
 #include "crypto_scrypt_smix.h"
+#include "crypto_scrypt_smix_avx2.h"
+#include "crypto_scrypt_smix_avx512.h"
+#include "crypto_scrypt_smix_lanes_avx2.h"
+#include "crypto_scrypt_smix_lanes_avx512.h"
+#include "crypto_scrypt_smix_lanes_sse2.h"
 #include "crypto_scrypt_smix_sse2.h"
 
 #include "crypto_scrypt.h"
 
-static void (*smix_func)(uint8_t *, size_t, uint64_t, void *, void *) = NULL;
+/*
+ * The smix kernels in use.  They may be changed while hashes are running, so
+ * each computation copies them once, under the kernel lock, and keeps them.
+ */
+static void (*smix_func)(uint8_t *, size_t, uint64_t, void *, void *,
+    uint64_t *, uint64_t) = NULL;
+static void (*smix_lanes_func)(uint8_t **, size_t, uint64_t, void *,
+    void *) = NULL;
+static size_t smix_lanes = 0;
+
+/*
+ * Fan-out limits for running the p smix computations of a hash in parallel.
+ * They may be changed while hashes are running, so each computation reads
+ * them once, under the lock.
+ */
+static size_t smix_maxthreads = 1;
+static size_t smix_maxthreadmem = 0;
+
+/*
+ * The kernel lock is held while the known-answer tests run, and they take
+ * the thread lock, so the two are separate.
+ */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t smix_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t kernel_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+#define LOCK(m)		pthread_mutex_lock(&(m))
+#define UNLOCK(m)	pthread_mutex_unlock(&(m))
+#elif defined(_WIN32)
+static SRWLOCK smix_mtx = SRWLOCK_INIT;
+static SRWLOCK kernel_mtx = SRWLOCK_INIT;
+
+#define LOCK(m)		AcquireSRWLockExclusive(&(m))
+#define UNLOCK(m)	ReleaseSRWLockExclusive(&(m))
+#else
+#error "crypto_scrypt needs pthreads or Windows threads"
+#endif
+
+/* The smix kernels one computation uses, as copied by getsmix. */
+struct smix_selection {
+	void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	    uint64_t *, uint64_t);
+	void (*smix_lanes)(uint8_t **, size_t, uint64_t, void *, void *);
+	size_t lanes;
+};
+
+#ifdef HAVE_PTHREAD
+/* Work done by one of the threads computing the p smix blocks of a hash. */
+struct smix_thread {
+	pthread_t thr;
+	uint8_t * B;
+	size_t r;
+	uint64_t N;
+	size_t p;
+	size_t t;
+	size_t nthreads;
+	void * V;
+	void * XY;
+	void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	    uint64_t *, uint64_t);
+	const volatile int * cancel;
+	int cancelled;
+};
+
+/* Work done by one of the threads computing a range of PBKDF2 blocks. */
+struct pbkdf2_thread {
+	pthread_t thr;
+	const HMAC_SHA256_KEY * key;
+	const uint8_t * salt;
+	size_t saltlen;
+	uint64_t c;
+	size_t first;
+	uint8_t * buf;
+	size_t buflen;
+	int started;
+};
+#endif
+
+/*
+ * Salsa20/8 cores an smix computation does between two looks at its cancel
+ * flag: about a millisecond of work, whatever the value of r.
+ */
+#define SMIX_SLICE	16384
+
+/*
+ * Fewest HMAC computations (output blocks times iterations) worth handing to
+ * a PBKDF2 thread; below this, starting the thread costs more than it saves.
+ */
+#define PBKDF2_THREAD_MINWORK	4096
 
 /**
- * _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen, smix):
- * Perform the requested scrypt computation, using ${smix} as the smix routine.
+ * checkparams(N, r, p, buflen, lanes):
+ * Check that the scrypt parameters are valid and that the storage needed to
+ * run ${lanes} smix computations side by side fits into a size_t.  Return 0
+ * if so; or set errno and return -1 otherwise.
  */
 static int
-_crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
-    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
-    uint8_t * buf, size_t buflen,
-    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
+checkparams(uint64_t N, size_t r, size_t p, size_t buflen, size_t lanes)
 {
-	void * B0, * V0, * XY0;
-	uint8_t * B;
-	uint32_t * V;
-	uint32_t * XY;
-	size_t r = _r, p = _p;
-	uint32_t i;
 
-	/* Sanity-check parameters. */
 #if SIZE_MAX > UINT32_MAX
 	if (buflen > (((uint64_t)(1) << 32) - 1) * 32) {
 		errno = EFBIG;
-		goto err0;
+		return (-1);
 	}
+#else
+	(void)buflen; /* UNUSED */
 #endif
 	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30)) {
 		errno = EFBIG;
-		goto err0;
+		return (-1);
 	}
 	if (((N & (N - 1)) != 0) || (N < 2)) {
 		errno = EINVAL;
-		goto err0;
+		return (-1);
 	}
-	if ((r > SIZE_MAX / 128 / p) ||
+	if ((r > SIZE_MAX / 128 / p / lanes) ||
 #if SIZE_MAX / 256 <= UINT32_MAX
-	    (r > (SIZE_MAX - 64) / 256) ||
+	    (r > (SIZE_MAX / lanes - 64) / 256) ||
 #endif
-	    (N > SIZE_MAX / 128 / r)) {
+	    (N > SIZE_MAX / 128 / r / lanes)) {
 		errno = ENOMEM;
-		goto err0;
+		return (-1);
 	}
 
-	/* Allocate memory. */
-#ifdef HAVE_POSIX_MEMALIGN
-	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
-		goto err0;
-	B = (uint8_t *)(B0);
-	if ((errno = posix_memalign(&XY0, 64, 256 * r + 64)) != 0)
-		goto err1;
-	XY = (uint32_t *)(XY0);
-#if !defined(MAP_ANON) || !defined(HAVE_MMAP)
-	if ((errno = posix_memalign(&V0, 64, 128 * r * N)) != 0)
-		goto err2;
-	V = (uint32_t *)(V0);
-#endif
+	/* Parameters are fine. */
+	return (0);
+}
+
+/* Where scratch_get takes storage from, and whether it counts it. */
+#define SCRATCH_SHARED		1	/* Not from the thread's arena. */
+#define SCRATCH_UNBUDGETED	2	/* Not against the memory budget. */
+
+/**
+ * scratch_get(Blen, n, XYlen, Vlen, B, XY, V, len, flags, cancel):
+ * Obtain scratch storage for ${Blen} bytes of B followed by ${n} XY buffers
+ * of ${XYlen} bytes each and ${n} V buffers of ${Vlen} bytes each, all of
+ * which must be multiples of 64 bytes.  Store pointers to the first of each
+ * in ${B}, ${XY}, and ${V} and the total length in ${len}.  Unless ${flags}
+ * includes SCRATCH_UNBUDGETED, wait for the storage to fit within the memory
+ * budget first, giving up as described for crypto_scrypt_budget_reserve (with
+ * ${cancel}).  If ${flags} includes SCRATCH_SHARED, the storage does not come
+ * from the calling thread's arena, so that other threads may use it.  Return
+ * the storage, to be passed to scratch_put; or NULL on error.
+ */
+static void *
+scratch_get(size_t Blen, size_t n, size_t XYlen, size_t Vlen,
+    uint8_t ** B, uint32_t ** XY, uint32_t ** V, size_t * len, int flags,
+    const volatile int * cancel)
+{
+	uint8_t * S;
+
+	/* Make sure the total fits into a size_t. */
+	if ((Vlen > SIZE_MAX - XYlen) ||
+	    (n > (SIZE_MAX - Blen) / (XYlen + Vlen))) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	*len = Blen + n * (XYlen + Vlen);
+
+	/* Wait for our share of the memory budget. */
+	if (!(flags & SCRATCH_UNBUDGETED) &&
+	    crypto_scrypt_budget_reserve(*len, cancel))
+		return (NULL);
+
+	/* Carve B, XY, and V out of the calling thread's arena, or not. */
+	if ((S = (flags & SCRATCH_SHARED) ? crypto_scrypt_arena_alloc(*len) :
+	    crypto_scrypt_arena_get(*len)) == NULL) {
+		if (!(flags & SCRATCH_UNBUDGETED))
+			crypto_scrypt_budget_release(*len);
+		return (NULL);
+	}
+	*B = S;
+	*XY = (uint32_t *)(S + Blen);
+	*V = (uint32_t *)(S + Blen + n * XYlen);
+
+	return (S);
+}
+
+/**
+ * scratch_put(S, len, flags):
+ * Return the ${len} bytes of scratch storage ${S} obtained from scratch_get
+ * with the same ${flags}, and their share of the memory budget.
+ */
+static void
+scratch_put(void * S, size_t len, int flags)
+{
+
+	if (flags & SCRATCH_SHARED)
+		crypto_scrypt_arena_free(S, len);
+	else
+		crypto_scrypt_arena_put(S, len);
+	if (!(flags & SCRATCH_UNBUDGETED))
+		crypto_scrypt_budget_release(len);
+}
+
+/**
+ * smix_slice(r):
+ * Return the number of smix iterations which make up a slice of about
+ * SMIX_SLICE salsa20/8 cores when the block size is ${r}.
+ */
+static uint64_t
+smix_slice(size_t r)
+{
+	uint64_t slice;
+
+	/* Every iteration runs 2r salsa20/8 cores; slices must be even. */
+	slice = (SMIX_SLICE / (2 * r)) & ~(uint64_t)1;
+	if (slice < 2)
+		slice = 2;
+
+	return (slice);
+}
+
+/**
+ * smix_run(smix, B, r, N, V, XY, cancel):
+ * Compute B <-- MF(B, N) with ${smix}, giving up between slices of about
+ * SMIX_SLICE salsa20/8 cores if ${cancel} is not NULL and *${cancel} is
+ * nonzero.  Return 0 on success, or -1 if the computation was given up.
+ */
+static int
+smix_run(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+    uint64_t *, uint64_t), uint8_t * B, size_t r, uint64_t N, void * V,
+    void * XY, const volatile int * cancel)
+{
+	uint64_t pos = 0;
+	uint64_t slice;
+
+	/* Nobody can cancel this computation; do it in one go. */
+	if (cancel == NULL) {
+		(smix)(B, r, N, V, XY, &pos, 2 * N);
+		return (0);
+	}
+
+	slice = smix_slice(r);
+	while (pos < 2 * N) {
+		if (*cancel)
+			return (-1);
+		(smix)(B, r, N, V, XY, &pos, slice);
+	}
+
+	return (0);
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * smix_thread_main(cookie):
+ * Compute B_i <-- MF(B_i, N) for every i = t (mod nthreads), using the V and
+ * XY buffers owned by the struct smix_thread ${cookie}.
+ */
+static void *
+smix_thread_main(void * cookie)
+{
+	struct smix_thread * T = cookie;
+	size_t i;
+
+	for (i = T->t; i < T->p; i += T->nthreads) {
+		if (smix_run(T->smix, &T->B[i * 128 * T->r], T->r, T->N,
+		    T->V, T->XY, T->cancel)) {
+			T->cancelled = 1;
+			break;
+		}
+	}
+
+	return (NULL);
+}
+
+/**
+ * smix_threads(B, r, N, p, nthreads, V, XY, smix, cancel):
+ * Compute B_i <-- MF(B_i, N) for i = 0 ... p - 1, spread over ${nthreads}
+ * threads.  Thread t uses the t-th 128rN-byte V buffer in ${V} and the t-th
+ * (256r + 64)-byte XY buffer in ${XY}; the calling thread is thread 0.  If a
+ * thread cannot be started, the calling thread does its share as well.
+ * Return 0 on success, or -1 if ${cancel} stopped any thread (see smix_run).
+ */
+static int
+smix_threads(uint8_t * B, size_t r, uint64_t N, size_t p, size_t nthreads,
+    void * V, void * XY,
+    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	uint64_t *, uint64_t), const volatile int * cancel)
+{
+	struct smix_thread * T;
+	size_t t, i;
+	int rc, cancelled = 0;
+
+	/* Without memory for the thread state, do everything ourselves. */
+	if ((T = calloc(nthreads, sizeof(struct smix_thread))) == NULL) {
+		for (i = 0; i < p; i++) {
+			if (smix_run(smix, &B[i * 128 * r], r, N, V, XY,
+			    cancel))
+				return (-1);
+		}
+		return (0);
+	}
+
+	/* Start the helper threads. */
+	for (t = 0; t < nthreads; t++) {
+		T[t].B = B;
+		T[t].r = r;
+		T[t].N = N;
+		T[t].p = p;
+		T[t].t = t;
+		T[t].nthreads = nthreads;
+		T[t].V = (uint8_t *)(V) + t * 128 * r * N;
+		T[t].XY = (uint8_t *)(XY) + t * (256 * r + 64);
+		T[t].smix = smix;
+		T[t].cancel = cancel;
+		if ((t > 0) && ((rc = pthread_create(&T[t].thr, NULL,
+		    smix_thread_main, &T[t])) != 0)) {
+			/* Do this thread's share ourselves. */
+			T[t].nthreads = 0;
+		}
+	}
+
+	/* Do our share, plus the share of any thread which didn't start. */
+	smix_thread_main(&T[0]);
+	for (t = 1; t < nthreads; t++) {
+		if (T[t].nthreads == 0) {
+			T[t].nthreads = nthreads;
+			smix_thread_main(&T[t]);
+		} else if ((rc = pthread_join(T[t].thr, NULL)) != 0) {
+			/* This should never happen. */
+			warn0("pthread_join: %s", strerror(rc));
+			abort();
+		}
+	}
+
+	/* Did any thread give up? */
+	for (t = 0; t < nthreads; t++)
+		cancelled |= T[t].cancelled;
+
+	free(T);
+	return (cancelled ? -1 : 0);
+}
 #else
-	if ((B0 = malloc(128 * r * p + 63)) == NULL)
-		goto err0;
-	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~ (uintptr_t)(63));
-	if ((XY0 = malloc(256 * r + 64 + 63)) == NULL)
-		goto err1;
-	XY = (uint32_t *)(((uintptr_t)(XY0) + 63) & ~ (uintptr_t)(63));
-#if !defined(MAP_ANON) || !defined(HAVE_MMAP)
-	if ((V0 = malloc(128 * r * N + 63)) == NULL)
-		goto err2;
-	V = (uint32_t *)(((uintptr_t)(V0) + 63) & ~ (uintptr_t)(63));
+static int
+smix_threads(uint8_t * B, size_t r, uint64_t N, size_t p, size_t nthreads,
+    void * V, void * XY,
+    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	uint64_t *, uint64_t), const volatile int * cancel)
+{
+	size_t i;
+
+	/* No threads on this platform; smix_fanout() never asks for them. */
+	(void)nthreads; /* UNUSED */
+	for (i = 0; i < p; i++) {
+		if (smix_run(smix, &B[i * 128 * r], r, N, V, XY, cancel))
+			return (-1);
+	}
+	return (0);
+}
 #endif
+
+/**
+ * smix_fanout(N, r, p):
+ * Return the number of threads over which the p smix computations of a hash
+ * with parameters ${N}, ${r}, and ${p} should be spread.
+ */
+static size_t
+smix_fanout(uint64_t N, size_t r, size_t p)
+{
+	size_t nthreads, maxthreadmem;
+	size_t lanemem = 128 * r * N + 256 * r + 64;
+	size_t budget = crypto_scrypt_budget_get();
+
+#ifndef HAVE_PTHREAD
+	/* No threads on this platform. */
+	return (1);
 #endif
-#if defined(MAP_ANON) && defined(HAVE_MMAP)
-	if ((V0 = mmap(NULL, 128 * r * N, PROT_READ | PROT_WRITE,
-#ifdef MAP_NOCORE
-	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
-#else
-	    MAP_ANON | MAP_PRIVATE,
+
+	/* Take one consistent look at the limits. */
+	LOCK(smix_mtx);
+	nthreads = smix_maxthreads;
+	maxthreadmem = smix_maxthreadmem;
+	UNLOCK(smix_mtx);
+
+	/* Never more threads than smix computations. */
+	if (nthreads > p)
+		nthreads = p;
+
+	/* Every thread needs its own V and XY. */
+	if ((maxthreadmem != 0) && (nthreads > maxthreadmem / lanemem))
+		nthreads = maxthreadmem / lanemem;
+
+	/* Don't ask for more than the memory budget could ever admit. */
+	if ((budget != 0) && (nthreads > budget / lanemem))
+		nthreads = budget / lanemem;
+
+	return ((nthreads > 0) ? nthreads : 1);
+}
+
+/**
+ * pbkdf2_fanout(nblocks, c):
+ * Return the number of threads over which the ${nblocks} output blocks of a
+ * PBKDF2 computation with ${c} iterations should be spread.
+ */
+static size_t
+pbkdf2_fanout(size_t nblocks, uint64_t c)
+{
+	size_t nthreads;
+
+#ifndef HAVE_PTHREAD
+	/* No threads on this platform. */
+	return (1);
 #endif
-	    -1, 0)) == MAP_FAILED)
-		goto err2;
-	V = (uint32_t *)(V0);
+
+	LOCK(smix_mtx);
+	nthreads = smix_maxthreads;
+	UNLOCK(smix_mtx);
+
+	/* Give every thread enough work to be worth starting. */
+	if (c < PBKDF2_THREAD_MINWORK &&
+	    nthreads > nblocks * c / PBKDF2_THREAD_MINWORK)
+		nthreads = nblocks * c / PBKDF2_THREAD_MINWORK;
+	if (nthreads > nblocks)
+		nthreads = nblocks;
+
+	return ((nthreads > 0) ? nthreads : 1);
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * pbkdf2_thread_main(cookie):
+ * Compute the range of PBKDF2 output described by the struct pbkdf2_thread
+ * ${cookie}.
+ */
+static void *
+pbkdf2_thread_main(void * cookie)
+{
+	struct pbkdf2_thread * T = cookie;
+
+	PBKDF2_SHA256_key_at(T->key, T->salt, T->saltlen, T->c, T->first,
+	    T->buf, T->buflen);
+
+	return (NULL);
+}
+
+/**
+ * pbkdf2_threads(key, salt, saltlen, c, buf, dkLen, nthreads):
+ * Compute PBKDF2_SHA256_key(key, salt, saltlen, c, buf, dkLen) with the
+ * output blocks split into ${nthreads} contiguous ranges, each computed by
+ * its own thread; the calling thread is thread 0.  Ranges are a multiple of
+ * eight blocks long, so that multi-buffer SHA256 code can be used for them.
+ * If a thread cannot be started, the calling thread does its share as well.
+ */
+static void
+pbkdf2_threads(const HMAC_SHA256_KEY * key, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen, size_t nthreads)
+{
+	struct pbkdf2_thread * T;
+	size_t nblocks = (dkLen + 31) / 32;
+	size_t chunk, t;
+	int rc;
+
+	/* Without memory for the thread state, do everything ourselves. */
+	if ((T = calloc(nthreads, sizeof(struct pbkdf2_thread))) == NULL) {
+		PBKDF2_SHA256_key(key, salt, saltlen, c, buf, dkLen);
+		return;
+	}
+
+	/* Blocks per thread, rounded up to a multiple of 8. */
+	chunk = ((nblocks + nthreads - 1) / nthreads + 7) & ~(size_t)7;
+
+	/* Start the helper threads. */
+	for (t = 0; t < nthreads; t++) {
+		T[t].key = key;
+		T[t].salt = salt;
+		T[t].saltlen = saltlen;
+		T[t].c = c;
+		T[t].first = t * chunk;
+		T[t].buf = buf;
+		T[t].buflen = 0;
+		if (T[t].first < nblocks) {
+			/* This thread has blocks; the last may be partial. */
+			T[t].buf = &buf[T[t].first * 32];
+			T[t].buflen = dkLen - T[t].first * 32;
+			if (T[t].buflen > chunk * 32)
+				T[t].buflen = chunk * 32;
+		}
+		if ((t > 0) && (T[t].buflen > 0) && ((rc = pthread_create(
+		    &T[t].thr, NULL, pbkdf2_thread_main, &T[t])) == 0))
+			T[t].started = 1;
+	}
+
+	/* Do our share, plus the share of any thread which didn't start. */
+	pbkdf2_thread_main(&T[0]);
+	for (t = 1; t < nthreads; t++) {
+		if (T[t].started == 0) {
+			pbkdf2_thread_main(&T[t]);
+		} else if ((rc = pthread_join(T[t].thr, NULL)) != 0) {
+			/* This should never happen. */
+			warn0("pthread_join: %s", strerror(rc));
+			abort();
+		}
+	}
+
+	free(T);
+}
+#else
+static void
+pbkdf2_threads(const HMAC_SHA256_KEY * key, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen, size_t nthreads)
+{
+
+	/* No threads on this platform; pbkdf2_fanout() never asks for them. */
+	(void)nthreads; /* UNUSED */
+	PBKDF2_SHA256_key(key, salt, saltlen, c, buf, dkLen);
+}
 #endif
 
+/**
+ * _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen, smix,
+ *     cancel, flags):
+ * Perform the requested scrypt computation, using ${smix} as the smix routine
+ * and scratch storage obtained with ${flags}.  If ${cancel} is not NULL, give
+ * up with errno set to ECANCELED once *${cancel} becomes nonzero.
+ */
+static int
+_crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * buf, size_t buflen,
+    void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	uint64_t *, uint64_t), const volatile int * cancel, int flags)
+{
+	HMAC_SHA256_KEY Pkey;
+	void * S;
+	uint8_t * B;
+	uint32_t * V;
+	uint32_t * XY;
+	size_t r = _r, p = _p;
+	size_t Slen, nthreads;
+	uint32_t i;
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen, 1))
+		goto err0;
+
+	/* Allocate memory: B, plus XY and V for each thread. */
+	nthreads = smix_fanout(N, r, p);
+	if ((S = scratch_get(128 * r * p, nthreads, 256 * r + 64, 128 * r * N,
+	    &B, &XY, &V, &Slen, flags, cancel)) == NULL) {
+		/* If there's not enough for the threads, do without them. */
+		if ((nthreads == 1) || (errno != ENOMEM))
+			goto err0;
+		nthreads = 1;
+		if ((S = scratch_get(128 * r * p, 1, 256 * r + 64,
+		    128 * r * N, &B, &XY, &V, &Slen, flags, cancel)) == NULL)
+			goto err0;
+	}
+
+	/* Absorb P once; both PBKDF2 computations are keyed with it. */
+	HMAC_SHA256_Key(&Pkey, passwd, passwdlen);
+
 	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
-	PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, 1, B, p * 128 * r);
+	PBKDF2_SHA256_key(&Pkey, salt, saltlen, 1, B, p * 128 * r);
 
 	/* 2: for i = 0 to p - 1 do */
-	for (i = 0; i < p; i++) {
-		/* 3: B_i <-- MF(B_i, N) */
-		(smix)(&B[i * 128 * r], r, N, V, XY);
+	if (nthreads > 1) {
+		/* 3: B_i <-- MF(B_i, N), with the B_i spread over threads */
+		if (smix_threads(B, r, N, p, nthreads, V, XY, smix, cancel))
+			goto err1;
+	} else {
+		for (i = 0; i < p; i++) {
+			/* 3: B_i <-- MF(B_i, N) */
+			if (smix_run(smix, &B[i * 128 * r], r, N, V, XY,
+			    cancel))
+				goto err1;
+		}
 	}
 
 	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
-	PBKDF2_SHA256(passwd, passwdlen, B, p * 128 * r, 1, buf, buflen);
+	PBKDF2_SHA256_key(&Pkey, B, p * 128 * r, 1, buf, buflen);
 
 	/* Free memory. */
-#if defined(MAP_ANON) && defined(HAVE_MMAP)
-	if (munmap(V0, 128 * r * N))
-		goto err2;
-#else
-	free(V0);
-#endif
-	free(XY0);
-	free(B0);
+	scratch_put(S, Slen, flags);
+	insecure_memzero(&Pkey, sizeof(HMAC_SHA256_KEY));
 
 	/* Success! */
 	return (0);
 
-err2:
-	free(XY0);
 err1:
-	free(B0);
+	/* Cancelled: hand the memory back straight away. */
+	scratch_put(S, Slen, flags);
+	insecure_memzero(&Pkey, sizeof(HMAC_SHA256_KEY));
+	errno = ECANCELED;
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * _crypto_scrypt_batch(passwds, passwdlens, salts, saltlens, K, N, r, p, bufs,
+ *     buflen, smix_lanes, lanes, smix):
+ * Perform the requested batch of ${K} scrypt computations, using
+ * ${smix_lanes} to run ${lanes} smix computations at once and ${smix} for
+ * any that are left over.
+ */
+static int
+_crypto_scrypt_batch(const uint8_t * const * passwds,
+    const size_t * passwdlens, const uint8_t * const * salts,
+    const size_t * saltlens, size_t K, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * const * bufs, size_t buflen,
+    void (*smix_lanes)(uint8_t **, size_t, uint64_t, void *, void *),
+    size_t lanes, void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	uint64_t *, uint64_t))
+{
+	HMAC_SHA256_KEY Pkeys[16];
+	void * S;
+	uint8_t * B;
+	uint8_t * Bl[16];
+	uint32_t * V;
+	uint32_t * XY;
+	size_t r = _r, p = _p;
+	size_t Slen, k, m, i, j, l;
+
+	/* Sanity-check parameters. */
+	if (lanes > sizeof(Bl) / sizeof(Bl[0])) {
+		errno = EINVAL;
+		goto err0;
+	}
+	if (checkparams(N, r, p, buflen, lanes))
+		goto err0;
+
+	/*
+	 * Hashes are processed ${lanes} at a time; B holds the p blocks of
+	 * each of them, V holds one 128rN-byte slice per lane, and XY holds
+	 * the per-lane X, Y, and Z vectors.
+	 */
+	if ((S = scratch_get(128 * r * p * lanes, lanes, 256 * r + 64,
+	    128 * r * N, &B, &XY, &V, &Slen, 0, NULL)) == NULL)
+		goto err0;
+
+	for (k = 0; k < K; k += m) {
+		/* Process up to ${lanes} hashes in this group. */
+		m = (K - k < lanes) ? K - k : lanes;
+
+		/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+		for (j = 0; j < m; j++) {
+			HMAC_SHA256_Key(&Pkeys[j], passwds[k + j],
+			    passwdlens[k + j]);
+			PBKDF2_SHA256_key(&Pkeys[j], salts[k + j],
+			    saltlens[k + j], 1, &B[j * p * 128 * r],
+			    p * 128 * r);
+		}
+
+		/*
+		 * 2: for i = 0 to p - 1 do
+		 * 3: B_i <-- MF(B_i, N)
+		 * The m * p blocks are independent, so fill the lanes with
+		 * them regardless of which hash they belong to.
+		 */
+		for (i = 0; i + lanes <= m * p; i += lanes) {
+			for (l = 0; l < lanes; l++)
+				Bl[l] = &B[(i + l) * 128 * r];
+			(smix_lanes)(Bl, r, N, V, XY);
+		}
+		for (; i < m * p; i++)
+			smix_run(smix, &B[i * 128 * r], r, N, V, XY, NULL);
+
+		/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+		for (j = 0; j < m; j++)
+			PBKDF2_SHA256_key(&Pkeys[j], &B[j * p * 128 * r],
+			    p * 128 * r, 1, bufs[k + j], buflen);
+	}
+
+	/* Free memory. */
+	scratch_put(S, Slen, 0);
+	insecure_memzero(Pkeys, sizeof(Pkeys));
+
+	/* Success! */
+	return (0);
+
 err0:
 	/* Failure! */
 	return (-1);
@@ -168,74 +745,444 @@ static struct scrypt_test {
 	uint32_t r;
 	uint32_t p;
 	uint8_t result[TESTLEN];
-} testcase = {
-	.passwd = "pleaseletmein",
-	.salt = "SodiumChloride",
-	.N = 16,
-	.r = 8,
-	.p = 1,
-	.result = {
-		0x25, 0xa9, 0xfa, 0x20, 0x7f, 0x87, 0xca, 0x09,
-		0xa4, 0xef, 0x8b, 0x9f, 0x77, 0x7a, 0xca, 0x16,
-		0xbe, 0xb7, 0x84, 0xae, 0x18, 0x30, 0xbf, 0xbf,
-		0xd3, 0x83, 0x25, 0xaa, 0xbb, 0x93, 0x77, 0xdf,
-		0x1b, 0xa7, 0x84, 0xd7, 0x46, 0xea, 0x27, 0x3b,
-		0xf5, 0x16, 0xa4, 0x6f, 0xbf, 0xac, 0xf5, 0x11,
-		0xc5, 0xbe, 0xba, 0x4c, 0x4a, 0xb3, 0xac, 0xc7,
-		0xfa, 0x6f, 0x46, 0x0b, 0x6c, 0x0f, 0x47, 0x7b,
+} testcases[] = {
+	{
+		.passwd = "pleaseletmein",
+		.salt = "SodiumChloride",
+		.N = 16,
+		.r = 8,
+		.p = 1,
+		.result = {
+			0x25, 0xa9, 0xfa, 0x20, 0x7f, 0x87, 0xca, 0x09,
+			0xa4, 0xef, 0x8b, 0x9f, 0x77, 0x7a, 0xca, 0x16,
+			0xbe, 0xb7, 0x84, 0xae, 0x18, 0x30, 0xbf, 0xbf,
+			0xd3, 0x83, 0x25, 0xaa, 0xbb, 0x93, 0x77, 0xdf,
+			0x1b, 0xa7, 0x84, 0xd7, 0x46, 0xea, 0x27, 0x3b,
+			0xf5, 0x16, 0xa4, 0x6f, 0xbf, 0xac, 0xf5, 0x11,
+			0xc5, 0xbe, 0xba, 0x4c, 0x4a, 0xb3, 0xac, 0xc7,
+			0xfa, 0x6f, 0x46, 0x0b, 0x6c, 0x0f, 0x47, 0x7b,
+		}
+	},
+	{
+		/* Test vector 1 from the scrypt paper (RFC 7914). */
+		.passwd = "",
+		.salt = "",
+		.N = 16,
+		.r = 1,
+		.p = 1,
+		.result = {
+			0x77, 0xd6, 0x57, 0x62, 0x38, 0x65, 0x7b, 0x20,
+			0x3b, 0x19, 0xca, 0x42, 0xc1, 0x8a, 0x04, 0x97,
+			0xf1, 0x6b, 0x48, 0x44, 0xe3, 0x07, 0x4a, 0xe8,
+			0xdf, 0xdf, 0xfa, 0x3f, 0xed, 0xe2, 0x14, 0x42,
+			0xfc, 0xd0, 0x06, 0x9d, 0xed, 0x09, 0x48, 0xf8,
+			0x32, 0x6a, 0x75, 0x3a, 0x0f, 0xc8, 0x1f, 0x17,
+			0xe8, 0xd3, 0xe0, 0xfb, 0x2e, 0x0d, 0x36, 0x28,
+			0xcf, 0x35, 0xe2, 0x0c, 0x38, 0xd1, 0x89, 0x06,
+		}
+	},
+	{
+		/* Exercise r > 8 and more than one smix per hash. */
+		.passwd = "password",
+		.salt = "NaCl",
+		.N = 16,
+		.r = 16,
+		.p = 2,
+		.result = {
+			0x9d, 0x4c, 0x53, 0x97, 0x74, 0xdc, 0xec, 0xe2,
+			0x8b, 0x74, 0x85, 0xf3, 0xd6, 0x4e, 0xe8, 0xb0,
+			0x94, 0x0f, 0x18, 0xae, 0x70, 0x68, 0x38, 0x48,
+			0x41, 0xe4, 0x7b, 0x2a, 0x89, 0x8c, 0xec, 0x60,
+			0x02, 0xdb, 0x16, 0x8d, 0x95, 0x20, 0x06, 0xcc,
+			0xa0, 0x3d, 0x45, 0xef, 0x51, 0x0f, 0x9a, 0x73,
+			0x38, 0x51, 0x3e, 0xa6, 0x11, 0xd5, 0x96, 0xf7,
+			0xc0, 0xf9, 0x40, 0xf5, 0x7a, 0x2c, 0x8c, 0x13,
+		}
 	}
 };
+#define NTESTCASES (sizeof(testcases) / sizeof(testcases[0]))
 
+/**
+ * testpbkdf2(void):
+ * Compute 300 bytes of PBKDF2-SHA256 output, which is not a whole number of
+ * blocks or of eight-block groups, with 1 and 3 iterations, a 100-byte
+ * password (which is hashed to form the HMAC key), and 3- and 60-byte salts,
+ * from a cached HMAC-SHA256 key schedule; and compare it with the same output
+ * computed one HMAC at a time from the raw password.  Return 0 if it all
+ * matches, or nonzero otherwise.
+ */
 static int
-testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *))
+testpbkdf2(void)
 {
-	uint8_t hbuf[TESTLEN];
+	static const uint64_t cs[] = {1, 3};
+	static const size_t saltlens[] = {3, 60};
+	HMAC_SHA256_KEY Pkey;
+	uint8_t passwd[100];
+	uint8_t salt[60 + 4];
+	uint8_t buf[300];
+	uint8_t U[32];
+	uint8_t T[32];
+	size_t i, j, k, b, clen;
+	uint64_t n;
 
-	/* Perform the computation. */
-	if (_crypto_scrypt(
-	    (const uint8_t *)testcase.passwd, strlen(testcase.passwd),
-	    (const uint8_t *)testcase.salt, strlen(testcase.salt),
-	    testcase.N, testcase.r, testcase.p, hbuf, TESTLEN, smix))
-		return (-1);
+	/* Absorb the password once. */
+	for (i = 0; i < sizeof(passwd); i++)
+		passwd[i] = (uint8_t)(i * 3 + 5);
+	HMAC_SHA256_Key(&Pkey, passwd, sizeof(passwd));
 
-	/* Does it match? */
-	return (memcmp(testcase.result, hbuf, TESTLEN));
-}
+	for (i = 0; i < sizeof(cs) / sizeof(cs[0]); i++) {
+		for (j = 0; j < sizeof(saltlens) / sizeof(saltlens[0]); j++) {
+			/* Compute the output with the key schedule. */
+			for (k = 0; k < sizeof(salt); k++)
+				salt[k] = (uint8_t)(k * 7 + 1);
+			PBKDF2_SHA256_key(&Pkey, salt, saltlens[j], cs[i],
+			    buf, sizeof(buf));
 
-static void
-selectsmix(void)
-{
+			/* Recompute each block from the raw password. */
+			for (b = 0; b * 32 < sizeof(buf); b++) {
+				be32enc(&salt[saltlens[j]], (uint32_t)(b + 1));
+				HMAC_SHA256_Buf(passwd, sizeof(passwd), salt,
+				    saltlens[j] + 4, U);
+				memcpy(T, U, 32);
+				for (n = 2; n <= cs[i]; n++) {
+					HMAC_SHA256_Buf(passwd, sizeof(passwd),
+					    U, 32, U);
+					for (k = 0; k < 32; k++)
+						T[k] ^= U[k];
+				}
 
-#ifdef CPUSUPPORT_X86_SSE2
-	/* If we're running on an SSE2-capable CPU, try that code. */
-	if (cpusupport_x86_sse2()) {
-		/* If SSE2ized smix works, use it. */
-		if (!testsmix(crypto_scrypt_smix_sse2)) {
-			smix_func = crypto_scrypt_smix_sse2;
-			return;
+				/* Does it match? */
+				clen = sizeof(buf) - b * 32;
+				if (clen > 32)
+					clen = 32;
+				if (memcmp(T, &buf[b * 32], clen))
+					return (-1);
+			}
 		}
-		warn0("Disabling broken SSE2 scrypt support - please report bug!");
-	}
-#endif
-
-	/* If generic smix works, use it. */
-	if (!testsmix(crypto_scrypt_smix)) {
-		smix_func = crypto_scrypt_smix;
-		return;
 	}
-	warn0("Generic scrypt code is broken - please report bug!");
 
-	/* If we get here, something really bad happened. */
-	abort();
+	/* All test cases passed. */
+	return (0);
 }
 
 /**
- * crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen):
- * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
- * p, buflen) and write the result into buf.  The parameters r, p, and buflen
- * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
- * must be a power of 2 greater than 1.
- *
+ * testsmix(smix):
+ * Run every known-answer test case through ${smix}.  Return 0 if all of
+ * them produce the expected output, or nonzero otherwise.
+ */
+static int
+testsmix(void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+    uint64_t *, uint64_t))
+{
+	const struct scrypt_test * t;
+	uint8_t hbuf[TESTLEN];
+	size_t i;
+
+	for (i = 0; i < NTESTCASES; i++) {
+		t = &testcases[i];
+
+		/* Perform the computation. */
+		if (_crypto_scrypt(
+		    (const uint8_t *)t->passwd, strlen(t->passwd),
+		    (const uint8_t *)t->salt, strlen(t->salt),
+		    t->N, t->r, t->p, hbuf, TESTLEN, smix, NULL, 0))
+			return (-1);
+
+		/* Does it match? */
+		if (memcmp(t->result, hbuf, TESTLEN))
+			return (-1);
+	}
+
+	/* All test cases passed. */
+	return (0);
+}
+
+/**
+ * testsmix_lanes(smix_lanes, lanes):
+ * Run batches of 1 to ${lanes} + 1 distinct hashes for each known-answer test
+ * case through ${smix_lanes}, so that full, partial, and left-over groups of
+ * lanes are all used, and compare them against the output of the (already
+ * tested) single-hash code.  The hashes in a batch have passwords and salts
+ * of differing lengths.  Return 0 if all of them match, or nonzero otherwise.
+ */
+static int
+testsmix_lanes(void (*smix_lanes)(uint8_t **, size_t, uint64_t, void *,
+    void *), size_t lanes)
+{
+	const struct scrypt_test * t;
+	uint8_t passwdbuf[17][64 + 17];
+	uint8_t saltbuf[17][64 + 17];
+	uint8_t hbuf[17][TESTLEN];
+	uint8_t hbuf1[17][TESTLEN];
+	const uint8_t * passwds[17];
+	const uint8_t * salts[17];
+	size_t passwdlens[17];
+	size_t saltlens[17];
+	uint8_t * bufs[17];
+	size_t i, k, K, passwdlen, saltlen;
+
+	for (i = 0; i < NTESTCASES; i++) {
+		t = &testcases[i];
+		passwdlen = strlen(t->passwd);
+		saltlen = strlen(t->salt);
+
+		/* Give every hash its own password and salt lengths. */
+		for (k = 0; k <= lanes; k++) {
+			memcpy(passwdbuf[k], t->passwd, passwdlen);
+			memset(&passwdbuf[k][passwdlen], (int)k, k);
+			memcpy(saltbuf[k], t->salt, saltlen);
+			memset(&saltbuf[k][saltlen], (int)(k + 1),
+			    (k * 7) % 17);
+			passwds[k] = passwdbuf[k];
+			passwdlens[k] = passwdlen + k;
+			salts[k] = saltbuf[k];
+			saltlens[k] = saltlen + (k * 7) % 17;
+
+			/* Compute the expected output one hash at a time. */
+			if (_crypto_scrypt(passwds[k], passwdlens[k],
+			    salts[k], saltlens[k], t->N, t->r, t->p,
+			    hbuf1[k], TESTLEN, smix_func, NULL, 0))
+				return (-1);
+		}
+
+		for (K = 1; K <= lanes + 1; K++) {
+			/* Perform the computation. */
+			for (k = 0; k < K; k++) {
+				memset(hbuf[k], 0, TESTLEN);
+				bufs[k] = hbuf[k];
+			}
+			if (_crypto_scrypt_batch(passwds, passwdlens, salts,
+			    saltlens, K, t->N, t->r, t->p, bufs, TESTLEN,
+			    smix_lanes, lanes, smix_func))
+				return (-1);
+
+			/* Does each hash match the single-hash output? */
+			for (k = 0; k < K; k++) {
+				if (memcmp(hbuf[k], hbuf1[k], TESTLEN))
+					return (-1);
+			}
+		}
+	}
+
+	/* All test cases passed. */
+	return (0);
+}
+
+/* The smix kernels compiled into this library, most preferred first. */
+static struct smix_kernel {
+	const char * name;
+	const char * descr;
+	int (* cpusupport)(void);
+	void (* smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	    uint64_t *, uint64_t);
+	void (* smix_lanes)(uint8_t **, size_t, uint64_t, void *, void *);
+	size_t lanes;
+	int works;		/* 0 if untested, 1 if working, -1 if broken. */
+	int lanes_work;		/* Likewise for smix_lanes. */
+} smix_kernels[] = {
+#ifdef CPUSUPPORT_X86_AVX512VL
+	{ "avx512", "AVX-512", cpusupport_x86_avx512vl,
+	    crypto_scrypt_smix_avx512, crypto_scrypt_smix_lanes_avx512, 16,
+	    0, 0 },
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	{ "avx2", "AVX2", cpusupport_x86_avx2,
+	    crypto_scrypt_smix_avx2, crypto_scrypt_smix_lanes_avx2, 8,
+	    0, 0 },
+#endif
+#ifdef CPUSUPPORT_X86_SSE2
+	{ "sse2", "SSE2", cpusupport_x86_sse2,
+	    crypto_scrypt_smix_sse2, crypto_scrypt_smix_lanes_sse2, 4,
+	    0, 0 },
+#endif
+	{ "generic", "Generic", NULL, crypto_scrypt_smix, NULL, 1, 0, 0 }
+};
+#define NKERNELS (sizeof(smix_kernels) / sizeof(smix_kernels[0]))
+
+/* The kernel in use, and the kernel forced by the caller or environment. */
+static struct smix_kernel * smix_kernel = NULL;
+static struct smix_kernel * smix_forced = NULL;
+static int smix_forced_init = 0;
+
+/**
+ * findkernel(name):
+ * Return the kernel called ${name}, or NULL if there is no such kernel.
+ */
+static struct smix_kernel *
+findkernel(const char * name)
+{
+	size_t i;
+
+	for (i = 0; i < NKERNELS; i++) {
+		if (strcmp(smix_kernels[i].name, name) == 0)
+			return (&smix_kernels[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * kernel_works(k):
+ * Return nonzero if this CPU can run the kernel ${k} and its smix passes
+ * the known-answer tests.  The tests are only run the first time.  Must be
+ * called with the kernel lock held.
+ */
+static int
+kernel_works(struct smix_kernel * k)
+{
+
+	/* Does this CPU have the instructions this kernel uses? */
+	if ((k->cpusupport != NULL) && !k->cpusupport())
+		return (0);
+
+	/* Test the kernel if we haven't already. */
+	if (k->works == 0) {
+		if (testsmix(k->smix)) {
+			warn0("Disabling broken %s scrypt support"
+			    " - please report bug!", k->descr);
+			k->works = -1;
+		} else
+			k->works = 1;
+	}
+
+	return (k->works > 0);
+}
+
+/**
+ * kernel_lanes_work(k):
+ * Return nonzero if the kernel ${k} has a multi-lane smix which this CPU
+ * can run and which passes the known-answer tests.  This must be called
+ * after selectsmix(), with the kernel lock held.
+ */
+static int
+kernel_lanes_work(struct smix_kernel * k)
+{
+
+	/* The lanes need the single-hash smix of the same kernel. */
+	if ((k->smix_lanes == NULL) || !kernel_works(k))
+		return (0);
+
+	/* Test the kernel if we haven't already. */
+	if (k->lanes_work == 0) {
+		if (testsmix_lanes(k->smix_lanes, k->lanes)) {
+			warn0("Disabling broken %s scrypt batch support"
+			    " - please report bug!", k->descr);
+			k->lanes_work = -1;
+		} else
+			k->lanes_work = 1;
+	}
+
+	return (k->lanes_work > 0);
+}
+
+/**
+ * selectsmix(void):
+ * Pick the smix kernel which crypto_scrypt uses: the forced kernel if there
+ * is one which works, or else the most preferred kernel which works.  The
+ * first time through, a kernel named by $SCRYPT_KERNEL is forced.  Must be
+ * called with the kernel lock held.
+ */
+static void
+selectsmix(void)
+{
+	const char * name;
+	size_t i;
+
+	/* Honour $SCRYPT_KERNEL unless crypto_scrypt_set_kernel came first. */
+	if (!smix_forced_init) {
+		name = getenv("SCRYPT_KERNEL");
+		if ((name != NULL) && (name[0] != '\0') &&
+		    (strcmp(name, "auto") != 0) &&
+		    ((smix_forced = findkernel(name)) == NULL))
+			warn0("Ignoring unknown SCRYPT_KERNEL %s", name);
+		smix_forced_init = 1;
+	}
+
+	/* Every kernel, and its known-answer tests, rely on PBKDF2. */
+	if (testpbkdf2()) {
+		warn0("PBKDF2-SHA256 code is broken - please report bug!");
+		abort();
+	}
+
+	/* Use the forced kernel if it works. */
+	if (smix_forced != NULL) {
+		if (kernel_works(smix_forced)) {
+			smix_kernel = smix_forced;
+			smix_func = smix_forced->smix;
+			return;
+		}
+		warn0("Ignoring SCRYPT_KERNEL %s, which this CPU cannot run",
+		    smix_forced->name);
+		smix_forced = NULL;
+	}
+
+	/* Use the most preferred kernel which works. */
+	for (i = 0; i < NKERNELS; i++) {
+		if (kernel_works(&smix_kernels[i])) {
+			smix_kernel = &smix_kernels[i];
+			smix_func = smix_kernels[i].smix;
+			return;
+		}
+	}
+	warn0("Generic scrypt code is broken - please report bug!");
+
+	/* If we get here, something really bad happened. */
+	abort();
+}
+
+/**
+ * selectsmix_lanes(void):
+ * Pick the widest working multi-lane smix for this CPU, if any; a forced
+ * kernel only uses its own.  This must be called after selectsmix(), with
+ * the kernel lock held.
+ */
+static void
+selectsmix_lanes(void)
+{
+	size_t i;
+
+	for (i = 0; i < NKERNELS; i++) {
+		if ((smix_forced != NULL) && (&smix_kernels[i] != smix_kernel))
+			continue;
+		if (kernel_lanes_work(&smix_kernels[i])) {
+			smix_lanes_func = smix_kernels[i].smix_lanes;
+			smix_lanes = smix_kernels[i].lanes;
+			return;
+		}
+	}
+
+	/* No multi-lane code; crypto_scrypt_batch will hash one at a time. */
+	smix_lanes_func = NULL;
+	smix_lanes = 1;
+}
+
+/**
+ * getsmix(sel, batch):
+ * Copy the smix kernel used by crypto_scrypt, and if ${batch} is nonzero the
+ * multi-lane kernel used by crypto_scrypt_batch, into ${sel}; select them
+ * first if that has not been done yet.
+ */
+static void
+getsmix(struct smix_selection * sel, int batch)
+{
+
+	LOCK(kernel_mtx);
+	if (smix_func == NULL)
+		selectsmix();
+	if (batch && (smix_lanes == 0))
+		selectsmix_lanes();
+	sel->smix = smix_func;
+	sel->smix_lanes = smix_lanes_func;
+	sel->lanes = smix_lanes;
+	UNLOCK(kernel_mtx);
+}
+
+/**
+ * crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf.  The parameters r, p, and buflen
+ * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
+ * must be a power of 2 greater than 1.
+ *
  * Return 0 on success; or -1 on error.
  */
 int
@@ -243,10 +1190,468 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
     const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
     uint8_t * buf, size_t buflen)
 {
+	struct smix_selection sel;
+
+	getsmix(&sel, 0);
+
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
+	    buf, buflen, sel.smix, NULL, 0));
+}
+
+/**
+ * crypto_scrypt_cancellable(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, cancel):
+ * As crypto_scrypt, but give up if *${cancel} becomes nonzero, which may be
+ * done from another thread.  The flag is checked about once a millisecond
+ * inside the smix computations, and every few milliseconds while waiting for
+ * the memory budget; the scratch memory is returned as soon as they stop.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ECANCELED if the
+ * computation was given up.
+ */
+int
+crypto_scrypt_cancellable(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * buf, size_t buflen, const volatile int * cancel)
+{
+	struct smix_selection sel;
+
+	getsmix(&sel, 0);
+
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
+	    buf, buflen, sel.smix, cancel, 0));
+}
+
+/**
+ * crypto_scrypt_unbudgeted(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen):
+ * As crypto_scrypt, but without counting the scratch memory against the
+ * memory budget, so that the computation never waits for others; for timing
+ * measurements, which must not see that wait.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_unbudgeted(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * buf, size_t buflen)
+{
+	struct smix_selection sel;
+
+	getsmix(&sel, 0);
+
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
+	    buf, buflen, sel.smix, NULL, SCRATCH_UNBUDGETED));
+}
+
+/* A scrypt computation which crypto_scrypt_job_step advances. */
+struct crypto_scrypt_job {
+	HMAC_SHA256_KEY Pkey;
+	void (*smix)(uint8_t *, size_t, uint64_t, void *, void *,
+	    uint64_t *, uint64_t);
+	void * S;
+	size_t Slen;
+	uint8_t * B;
+	uint32_t * V;
+	uint32_t * XY;
+	uint64_t N;
+	size_t r;
+	size_t p;
+	size_t i;		/* Block being mixed. */
+	uint64_t pos;		/* Iterations of block i done so far. */
+	int parked;		/* Budget share handed back? */
+};
+
+/**
+ * crypto_scrypt_job_init(passwd, passwdlen, salt, saltlen, N, r, p, buflen,
+ *     cancel):
+ * Start computing scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1],
+ * N, r, p, buflen) as a job, which crypto_scrypt_job_step advances a slice
+ * at a time.  The parameters are subject to the same limits as for
+ * crypto_scrypt.  The job may be stepped and finished on any thread, but on
+ * one thread at a time.  If ${cancel} is not NULL, give up waiting for memory
+ * with errno set to ECANCELED once *${cancel} becomes nonzero.
+ *
+ * Return the job; or NULL on error.
+ */
+struct crypto_scrypt_job *
+crypto_scrypt_job_init(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t _r, uint32_t _p,
+    size_t buflen, const volatile int * cancel)
+{
+	struct crypto_scrypt_job * J;
+	struct smix_selection sel;
+	size_t r = _r, p = _p;
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen, 1))
+		goto err0;
+
+	/* The kernel is fixed for the life of the job. */
+	getsmix(&sel, 0);
+
+	/* Allocate the job. */
+	if ((J = malloc(sizeof(struct crypto_scrypt_job))) == NULL)
+		goto err0;
+	J->smix = sel.smix;
+	J->N = N;
+	J->r = r;
+	J->p = p;
+	J->i = 0;
+	J->pos = 0;
+	J->parked = 0;
+
+	/* Allocate B, XY, and V where any thread can use them. */
+	if ((J->S = scratch_get(128 * r * p, 1, 256 * r + 64, 128 * r * N,
+	    &J->B, &J->XY, &J->V, &J->Slen, SCRATCH_SHARED, cancel)) == NULL)
+		goto err1;
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	HMAC_SHA256_Key(&J->Pkey, passwd, passwdlen);
+	PBKDF2_SHA256_key(&J->Pkey, salt, saltlen, 1, J->B, p * 128 * r);
+
+	/* Success! */
+	return (J);
+
+err1:
+	free(J);
+err0:
+	/* Failure! */
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_job_step(job):
+ * Advance ${job} by about SMIX_SLICE salsa20/8 cores, roughly a millisecond
+ * of work.  Return 1 if its smix computations are all done, or 0 if not.
+ */
+int
+crypto_scrypt_job_step(struct crypto_scrypt_job * J)
+{
+
+	/* 2: for i = 0 to p - 1 do */
+	if (J->i < J->p) {
+		/* 3: B_i <-- MF(B_i, N), a slice at a time */
+		(J->smix)(&J->B[J->i * 128 * J->r], J->r, J->N, J->V, J->XY,
+		    &J->pos, smix_slice(J->r));
+		if (J->pos == 2 * J->N) {
+			J->i++;
+			J->pos = 0;
+		}
+	}
+
+	return (J->i == J->p);
+}
+
+/**
+ * crypto_scrypt_job_steps(N, r, p):
+ * Return the number of calls to crypto_scrypt_job_step which a job with the
+ * parameters ${N}, ${r}, and ${p} needs.
+ */
+uint64_t
+crypto_scrypt_job_steps(uint64_t N, uint32_t r, uint32_t p)
+{
+	uint64_t slice = smix_slice(r);
+
+	return (p * ((2 * N + slice - 1) / slice));
+}
+
+/**
+ * crypto_scrypt_job_progress(job, done, total):
+ * Store the number of smix iterations ${job} has done in ${done}, and the
+ * number it does in all in ${total}.
+ */
+void
+crypto_scrypt_job_progress(const struct crypto_scrypt_job * J,
+    uint64_t * done, uint64_t * total)
+{
+
+	*done = J->i * 2 * J->N + J->pos;
+	*total = J->p * 2 * J->N;
+}
+
+/**
+ * crypto_scrypt_job_park(job):
+ * Hand the share of the memory budget held by ${job} back while the job
+ * waits to be stepped again, so that other work can have it.  The memory of
+ * the job stays allocated.  A parked job must be resumed before it is
+ * stepped or finished.
+ */
+void
+crypto_scrypt_job_park(struct crypto_scrypt_job * J)
+{
+
+	if (J->parked)
+		return;
+	crypto_scrypt_budget_release(J->Slen);
+	J->parked = 1;
+}
+
+/**
+ * crypto_scrypt_job_resume(job, cancel):
+ * If ${job} is parked, wait for its share of the memory budget again,
+ * giving up as described for crypto_scrypt_job_init (with ${cancel}).
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_job_resume(struct crypto_scrypt_job * J,
+    const volatile int * cancel)
+{
+
+	if (!J->parked)
+		return (0);
+	if (crypto_scrypt_budget_reserve(J->Slen, cancel))
+		return (-1);
+	J->parked = 0;
 
+	/* Success! */
+	return (0);
+}
+
+/**
+ * crypto_scrypt_job_finish(job, buf, buflen):
+ * Write the result of ${job}, whose smix computations must all be done, to
+ * ${buf}; ${buflen} must be the value passed to crypto_scrypt_job_init.
+ * Free the job.
+ */
+void
+crypto_scrypt_job_finish(struct crypto_scrypt_job * J, uint8_t * buf,
+    size_t buflen)
+{
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256_key(&J->Pkey, J->B, J->p * 128 * J->r, 1, buf, buflen);
+
+	/* Free memory. */
+	crypto_scrypt_job_free(J);
+}
+
+/**
+ * crypto_scrypt_job_free(job):
+ * Give up on ${job}, returning its memory straight away.
+ */
+void
+crypto_scrypt_job_free(struct crypto_scrypt_job * J)
+{
+
+	/* A parked job has handed its share of the budget back already. */
+	scratch_put(J->S, J->Slen,
+	    SCRATCH_SHARED | (J->parked ? SCRATCH_UNBUDGETED : 0));
+	insecure_memzero(&J->Pkey, sizeof(HMAC_SHA256_KEY));
+	free(J);
+}
+
+/**
+ * crypto_scrypt_batch(passwds, passwdlens, salts, saltlens, K, N, r, p, bufs,
+ *     buflen):
+ * Compute scrypt(passwds[k][0 .. passwdlens[k] - 1], salts[k][0 ..
+ * saltlens[k] - 1], N, r, p, buflen) for k = 0 ... K - 1 and write the
+ * results into bufs[k].  The parameters are subject to the same limits as
+ * for crypto_scrypt.  Where the CPU allows, the smix computations of several
+ * hashes are run side by side in SIMD lanes.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_batch(const uint8_t * const * passwds,
+    const size_t * passwdlens, const uint8_t * const * salts,
+    const size_t * saltlens, size_t K, uint64_t N, uint32_t _r, uint32_t _p,
+    uint8_t * const * bufs, size_t buflen)
+{
+	struct smix_selection sel;
+	size_t k;
+
+	getsmix(&sel, 1);
+
+	/* Too few smix computations to fill the lanes: hash one at a time. */
+	if ((sel.smix_lanes == NULL) ||
+	    ((K < sel.lanes) && (K * _p < sel.lanes))) {
+		for (k = 0; k < K; k++) {
+			if (_crypto_scrypt(passwds[k], passwdlens[k],
+			    salts[k], saltlens[k], N, _r, _p, bufs[k], buflen,
+			    sel.smix, NULL, 0))
+				return (-1);
+		}
+		return (0);
+	}
+
+	return (_crypto_scrypt_batch(passwds, passwdlens, salts, saltlens, K,
+	    N, _r, _p, bufs, buflen, sel.smix_lanes, sel.lanes, sel.smix));
+}
+
+/**
+ * crypto_scrypt_pbkdf2(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], c,
+ * dkLen) using HMAC-SHA256 as the PRF, and write the result into buf.  The
+ * password is absorbed once, and the output blocks are spread over the
+ * threads allowed by crypto_scrypt_set_threads when there are enough of
+ * them.  The parameters must satisfy c >= 1 and dkLen <= (2^32 - 1) * 32.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_pbkdf2(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t c, uint8_t * buf,
+    size_t dkLen)
+{
+	struct smix_selection sel;
+	HMAC_SHA256_KEY Pkey;
+	size_t nthreads;
+
+	/* Sanity-check parameters. */
+#if SIZE_MAX > UINT32_MAX
+	if (dkLen > (((uint64_t)(1) << 32) - 1) * 32) {
+		errno = EFBIG;
+		return (-1);
+	}
+#endif
+	if (c < 1) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* Run the self-tests if that has not been done yet. */
+	getsmix(&sel, 0);
+
+	/* Absorb P once, then compute the blocks. */
+	HMAC_SHA256_Key(&Pkey, passwd, passwdlen);
+	if ((nthreads = pbkdf2_fanout((dkLen + 31) / 32, c)) > 1)
+		pbkdf2_threads(&Pkey, salt, saltlen, c, buf, dkLen, nthreads);
+	else
+		PBKDF2_SHA256_key(&Pkey, salt, saltlen, c, buf, dkLen);
+
+	/* Clean the stack. */
+	insecure_memzero(&Pkey, sizeof(HMAC_SHA256_KEY));
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * crypto_scrypt_set_threads(maxthreads, maxmem):
+ * Allow crypto_scrypt to spread the p smix computations of a hash over up to
+ * ${maxthreads} threads, each of which needs its own 128rN + 256r + 64 bytes
+ * of storage; if ${maxmem} is nonzero, fewer threads are used where needed
+ * to keep the total within ${maxmem} bytes.  A ${maxthreads} value of 0 or 1
+ * disables threading, which is the default.  crypto_scrypt_pbkdf2 spreads
+ * its output blocks over the same number of threads.  Computations already
+ * in progress keep the limits they started with.
+ */
+void
+crypto_scrypt_set_threads(size_t maxthreads, size_t maxmem)
+{
+
+	LOCK(smix_mtx);
+	smix_maxthreads = (maxthreads > 0) ? maxthreads : 1;
+	smix_maxthreadmem = maxmem;
+	UNLOCK(smix_mtx);
+}
+
+/**
+ * crypto_scrypt_get_threads(maxthreads, maxmem):
+ * Store the values most recently passed to crypto_scrypt_set_threads in
+ * ${maxthreads} and ${maxmem}.
+ */
+void
+crypto_scrypt_get_threads(size_t * maxthreads, size_t * maxmem)
+{
+
+	LOCK(smix_mtx);
+	*maxthreads = smix_maxthreads;
+	*maxmem = smix_maxthreadmem;
+	UNLOCK(smix_mtx);
+}
+
+/**
+ * crypto_scrypt_list_kernels(names, usable, max):
+ * Store the names of up to ${max} of the smix kernels compiled into this
+ * library, most preferred first, in ${names}, and whether this CPU can run
+ * each of them and its known-answer tests pass in ${usable}.  Return the
+ * number of kernels compiled in.
+ */
+size_t
+crypto_scrypt_list_kernels(const char ** names, int * usable, size_t max)
+{
+	size_t i;
+
+	LOCK(kernel_mtx);
+	for (i = 0; (i < NKERNELS) && (i < max); i++) {
+		names[i] = smix_kernels[i].name;
+		usable[i] = kernel_works(&smix_kernels[i]);
+	}
+	UNLOCK(kernel_mtx);
+
+	return (NKERNELS);
+}
+
+/**
+ * crypto_scrypt_get_kernel(name, lanes, forced):
+ * Store the name of the smix kernel used by crypto_scrypt in ${name}, the
+ * number of hashes crypto_scrypt_batch runs side by side in ${lanes}, and
+ * whether the kernel was forced in ${forced}.
+ */
+void
+crypto_scrypt_get_kernel(const char ** name, size_t * lanes, int * forced)
+{
+
+	LOCK(kernel_mtx);
 	if (smix_func == NULL)
 		selectsmix();
+	if (smix_lanes == 0)
+		selectsmix_lanes();
+	*name = smix_kernel->name;
+	*lanes = smix_lanes;
+	*forced = (smix_forced != NULL);
+	UNLOCK(kernel_mtx);
+}
 
-	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, _r, _p,
-	    buf, buflen, smix_func));
+/**
+ * crypto_scrypt_set_kernel(name):
+ * Make crypto_scrypt and crypto_scrypt_batch use the smix kernel called
+ * ${name}, or the fastest working kernel if ${name} is NULL or "auto"; this
+ * overrides $SCRYPT_KERNEL.  Return 0 on success; or set errno to EINVAL and
+ * return -1 if there is no such kernel or this CPU cannot run it.
+ * Computations already in progress finish with the kernel they started with.
+ */
+int
+crypto_scrypt_set_kernel(const char * name)
+{
+	struct smix_kernel * k = NULL;
+
+	LOCK(kernel_mtx);
+
+	/* Look up the kernel and make sure it works. */
+	if ((name != NULL) && (strcmp(name, "auto") != 0)) {
+		if (((k = findkernel(name)) == NULL) || !kernel_works(k)) {
+			UNLOCK(kernel_mtx);
+			errno = EINVAL;
+			return (-1);
+		}
+	}
+
+	/* Select again; the multi-lane kernel is tested when first needed. */
+	smix_forced = k;
+	smix_forced_init = 1;
+	smix_lanes_func = NULL;
+	smix_lanes = 0;
+	selectsmix();
+
+	UNLOCK(kernel_mtx);
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * crypto_scrypt_warmup(void):
+ * Run the known-answer tests and select the smix kernels now, rather than
+ * in the first call to crypto_scrypt or crypto_scrypt_batch.
+ */
+void
+crypto_scrypt_warmup(void)
+{
+	struct smix_selection sel;
+
+	getsmix(&sel, 1);
 }
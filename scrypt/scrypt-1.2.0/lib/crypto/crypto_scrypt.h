@@ -44,4 +44,186 @@
 int crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t, uint64_t,
     uint32_t, uint32_t, uint8_t *, size_t);
 
+/**
+ * crypto_scrypt_cancellable(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, cancel):
+ * As crypto_scrypt, but give up if *${cancel} becomes nonzero while the
+ * computation runs or waits for memory; another thread may set it at any
+ * time.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ECANCELED if the
+ * computation was given up.
+ */
+int crypto_scrypt_cancellable(const uint8_t *, size_t, const uint8_t *,
+    size_t, uint64_t, uint32_t, uint32_t, uint8_t *, size_t,
+    const volatile int *);
+
+/* A scrypt computation which can be advanced a slice at a time. */
+struct crypto_scrypt_job;
+
+/**
+ * crypto_scrypt_unbudgeted(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen):
+ * As crypto_scrypt, but without counting the scratch memory against the
+ * memory budget, so that the computation never waits for others; for timing
+ * measurements, which must not see that wait.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_unbudgeted(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t);
+
+/**
+ * crypto_scrypt_job_init(passwd, passwdlen, salt, saltlen, N, r, p, buflen,
+ *     cancel):
+ * Start computing scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1],
+ * N, r, p, buflen) as a job, which crypto_scrypt_job_step advances a slice
+ * at a time.  The parameters are subject to the same limits as for
+ * crypto_scrypt.  The job may be stepped and finished on any thread, but on
+ * one thread at a time; its p smix computations run one after another.  If
+ * ${cancel} is not NULL, give up waiting for memory with errno set to
+ * ECANCELED once *${cancel} becomes nonzero.
+ *
+ * Return the job; or NULL on error.
+ */
+struct crypto_scrypt_job * crypto_scrypt_job_init(const uint8_t *, size_t,
+    const uint8_t *, size_t, uint64_t, uint32_t, uint32_t, size_t,
+    const volatile int *);
+
+/**
+ * crypto_scrypt_job_step(job):
+ * Advance ${job} by roughly a millisecond of work.  Return 1 if its smix
+ * computations are all done, or 0 if not.
+ */
+int crypto_scrypt_job_step(struct crypto_scrypt_job *);
+
+/**
+ * crypto_scrypt_job_steps(N, r, p):
+ * Return the number of calls to crypto_scrypt_job_step which a job with the
+ * parameters ${N}, ${r}, and ${p} needs.
+ */
+uint64_t crypto_scrypt_job_steps(uint64_t, uint32_t, uint32_t);
+
+/**
+ * crypto_scrypt_job_progress(job, done, total):
+ * Store the number of smix iterations ${job} has done in ${done}, and the
+ * number it does in all in ${total}.
+ */
+void crypto_scrypt_job_progress(const struct crypto_scrypt_job *, uint64_t *,
+    uint64_t *);
+
+/**
+ * crypto_scrypt_job_park(job):
+ * Hand the share of the memory budget held by ${job} back while the job
+ * waits to be stepped again, so that other work can have it.  The memory of
+ * the job stays allocated.  A parked job must be resumed before it is
+ * stepped or finished.
+ */
+void crypto_scrypt_job_park(struct crypto_scrypt_job *);
+
+/**
+ * crypto_scrypt_job_resume(job, cancel):
+ * If ${job} is parked, wait for its share of the memory budget again,
+ * giving up as described for crypto_scrypt_job_init (with ${cancel}).
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_job_resume(struct crypto_scrypt_job *,
+    const volatile int *);
+
+/**
+ * crypto_scrypt_job_finish(job, buf, buflen):
+ * Write the result of ${job}, whose smix computations must all be done, to
+ * ${buf}; ${buflen} must be the value passed to crypto_scrypt_job_init.
+ * Free the job.
+ */
+void crypto_scrypt_job_finish(struct crypto_scrypt_job *, uint8_t *, size_t);
+
+/**
+ * crypto_scrypt_job_free(job):
+ * Give up on ${job}, returning its memory straight away.
+ */
+void crypto_scrypt_job_free(struct crypto_scrypt_job *);
+
+/**
+ * crypto_scrypt_batch(passwds, passwdlens, salts, saltlens, K, N, r, p, bufs,
+ *     buflen):
+ * Compute scrypt(passwds[k][0 .. passwdlens[k] - 1], salts[k][0 ..
+ * saltlens[k] - 1], N, r, p, buflen) for k = 0 ... K - 1 and write the
+ * results into bufs[k].  The parameters are subject to the same limits as
+ * for crypto_scrypt.  Where the CPU allows, the smix computations of several
+ * hashes are run side by side in SIMD lanes.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_batch(const uint8_t * const *, const size_t *,
+    const uint8_t * const *, const size_t *, size_t, uint64_t, uint32_t,
+    uint32_t, uint8_t * const *, size_t);
+
+/**
+ * crypto_scrypt_pbkdf2(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], c,
+ * dkLen) using HMAC-SHA256 as the PRF, and write the result into buf.  The
+ * password is absorbed once, and the output blocks are spread over the
+ * threads allowed by crypto_scrypt_set_threads when there are enough of
+ * them.  The parameters must satisfy c >= 1 and dkLen <= (2^32 - 1) * 32.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_pbkdf2(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+/**
+ * crypto_scrypt_set_threads(maxthreads, maxmem):
+ * Allow crypto_scrypt to spread the p smix computations of a hash over up to
+ * ${maxthreads} threads, each of which needs its own 128rN + 256r + 64 bytes
+ * of storage; if ${maxmem} is nonzero, fewer threads are used where needed
+ * to keep the total within ${maxmem} bytes.  A ${maxthreads} value of 0 or 1
+ * disables threading, which is the default.  crypto_scrypt_pbkdf2 spreads
+ * its output blocks over the same number of threads.  Computations already
+ * in progress keep the limits they started with.
+ */
+void crypto_scrypt_set_threads(size_t, size_t);
+
+/**
+ * crypto_scrypt_get_threads(maxthreads, maxmem):
+ * Store the values most recently passed to crypto_scrypt_set_threads in
+ * ${maxthreads} and ${maxmem}.
+ */
+void crypto_scrypt_get_threads(size_t *, size_t *);
+
+/**
+ * crypto_scrypt_list_kernels(names, usable, max):
+ * Store the names of up to ${max} of the smix kernels compiled into this
+ * library, most preferred first, in ${names}, and whether this CPU can run
+ * each of them and its known-answer tests pass in ${usable}.  Return the
+ * number of kernels compiled in.
+ */
+size_t crypto_scrypt_list_kernels(const char **, int *, size_t);
+
+/**
+ * crypto_scrypt_get_kernel(name, lanes, forced):
+ * Store the name of the smix kernel used by crypto_scrypt in ${name}, the
+ * number of hashes crypto_scrypt_batch runs side by side in ${lanes}, and
+ * whether the kernel was forced in ${forced}.
+ */
+void crypto_scrypt_get_kernel(const char **, size_t *, int *);
+
+/**
+ * crypto_scrypt_set_kernel(name):
+ * Make crypto_scrypt and crypto_scrypt_batch use the smix kernel called
+ * ${name}, or the fastest working kernel if ${name} is NULL or "auto"; this
+ * overrides $SCRYPT_KERNEL.  Return 0 on success; or set errno to EINVAL and
+ * return -1 if there is no such kernel or this CPU cannot run it.
+ * Computations already in progress finish with the kernel they started with.
+ */
+int crypto_scrypt_set_kernel(const char *);
+
+/**
+ * crypto_scrypt_warmup(void):
+ * Run the known-answer tests and select the smix kernels now, rather than
+ * in the first call to crypto_scrypt or crypto_scrypt_batch.
+ */
+void crypto_scrypt_warmup(void);
+
 #endif /* !_CRYPTO_SCRYPT_H_ */
@@ -0,0 +1,578 @@
+#include "scrypt_platform.h"
+
+#if !defined(HAVE_PTHREAD) && defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <errno.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "warnp.h"
+
+#include "crypto_scrypt_arena.h"
+
+/* Cached arenas are rounded up to a multiple of this many bytes. */
+#define ARENA_GRAIN	65536
+
+/* Default high-water mark: enough for N = 2^17, r = 8 with some room. */
+#define ARENA_HIGHWATER	(256 * 1024 * 1024)
+
+/* Size of a (2 MiB) huge page. */
+#define HUGEPAGE_SIZE	(2 * 1024 * 1024)
+
+/* Every region starts with a header saying how to free it. */
+#define REGION_HDR	64
+
+/* Kinds of backing, for the statistics. */
+#define REGION_PLAIN	0
+#define REGION_THP	1
+#define REGION_HUGETLB	2
+struct region {
+	void * alloc;		/* Pointer to pass to munmap or free. */
+	size_t maplen;		/* Bytes mapped or allocated. */
+};
+
+/* The scratch storage cached by one thread. */
+struct arena {
+	struct arena * next;
+	struct arena * prev;
+	void * base;		/* Cached storage, or NULL. */
+	size_t len;		/* Length of ${base}. */
+	int inuse;		/* Handed out by crypto_scrypt_arena_get. */
+	int stale;		/* Release when returned. */
+};
+
+static size_t arena_highwater = ARENA_HIGHWATER;
+static int arena_policy = CRYPTO_SCRYPT_ARENA_KEEP;
+static int arena_hugepages = CRYPTO_SCRYPT_HUGEPAGES_OFF;
+static struct crypto_scrypt_arena_stats arena_stats;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t arena_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_key;
+static int arena_key_ok = 0;
+static struct arena * arenas = NULL;
+
+#define LOCK()		pthread_mutex_lock(&arena_mtx)
+#define UNLOCK()	pthread_mutex_unlock(&arena_mtx)
+#elif defined(_WIN32)
+/* There are no arenas on Windows; only the settings and statistics. */
+static SRWLOCK arena_mtx = SRWLOCK_INIT;
+
+#define LOCK()		AcquireSRWLockExclusive(&arena_mtx)
+#define UNLOCK()	ReleaseSRWLockExclusive(&arena_mtx)
+#else
+#error "The scratch arenas need pthreads or Windows threads"
+#endif
+
+static void * region_alloc(size_t, int);
+static void region_free(void *);
+
+#if defined(MAP_ANON) && defined(HAVE_MMAP)
+/**
+ * region_map(len, flags):
+ * Map ${len} bytes of anonymous memory with the additional mmap ${flags}.
+ * Return a pointer to the mapping, or NULL on error.
+ */
+static void *
+region_map(size_t len, int flags)
+{
+	void * ptr;
+
+	if ((ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+#ifdef MAP_NOCORE
+	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE | flags,
+#else
+	    MAP_ANON | MAP_PRIVATE | flags,
+#endif
+	    -1, 0)) == MAP_FAILED)
+		return (NULL);
+	return (ptr);
+}
+
+#ifdef MADV_HUGEPAGE
+/**
+ * region_map_thp(len):
+ * Map ${len} bytes of anonymous memory, which must be a multiple of
+ * HUGEPAGE_SIZE, aligned to HUGEPAGE_SIZE so that the kernel can back it
+ * with transparent huge pages, and ask it to do so.  Return a pointer to
+ * the mapping, or NULL on error.
+ */
+static void *
+region_map_thp(size_t len)
+{
+	uint8_t * ptr, * aptr;
+	size_t head;
+
+	/* Over-allocate, then unmap the unaligned head and the tail. */
+	if ((ptr = region_map(len + HUGEPAGE_SIZE, 0)) == NULL)
+		return (NULL);
+	aptr = (uint8_t *)(((uintptr_t)(ptr) + HUGEPAGE_SIZE - 1) &
+	    ~ (uintptr_t)(HUGEPAGE_SIZE - 1));
+	head = aptr - ptr;
+	if ((head > 0) && munmap(ptr, head))
+		warnp("munmap");
+	if (munmap(aptr + len, HUGEPAGE_SIZE - head))
+		warnp("munmap");
+
+	/* This is only a hint; if the kernel ignores it, so be it. */
+	(void)madvise(aptr, len, MADV_HUGEPAGE);
+
+	return (aptr);
+}
+#endif
+#endif
+
+/**
+ * region_alloc(len, hugepages):
+ * Allocate ${len} bytes aligned to a multiple of 64 bytes, backed by huge
+ * pages if ${hugepages} (a CRYPTO_SCRYPT_HUGEPAGES_* value) asks for them
+ * and they are available.  Return a pointer to be passed to region_free, or
+ * NULL on error.
+ */
+static void *
+region_alloc(size_t len, int hugepages)
+{
+	struct region * R = NULL;
+	size_t maplen;
+	int kind = REGION_PLAIN;
+
+	/* Leave room for the header and for rounding up to a huge page. */
+	if (len > SIZE_MAX - REGION_HDR - HUGEPAGE_SIZE) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	maplen = len + REGION_HDR;
+
+#if defined(MAP_ANON) && defined(HAVE_MMAP)
+	/* Only regions of at least one huge page are worth backing so. */
+	if ((hugepages != CRYPTO_SCRYPT_HUGEPAGES_OFF) &&
+	    (maplen >= HUGEPAGE_SIZE)) {
+		maplen = (maplen + HUGEPAGE_SIZE - 1) &
+		    ~ (size_t)(HUGEPAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+		/* Try explicitly reserved huge pages first. */
+		if ((hugepages == CRYPTO_SCRYPT_HUGEPAGES_HUGETLB) &&
+		    ((R = region_map(maplen, MAP_HUGETLB)) != NULL))
+			kind = REGION_HUGETLB;
+#endif
+#ifdef MADV_HUGEPAGE
+		/* Fall back to transparent huge pages. */
+		if ((R == NULL) && ((R = region_map_thp(maplen)) != NULL))
+			kind = REGION_THP;
+#endif
+	}
+
+	/* Fall back to regular pages. */
+	if ((R == NULL) && ((R = region_map(maplen, 0)) == NULL))
+		return (NULL);
+	R->alloc = R;
+#elif defined(HAVE_POSIX_MEMALIGN)
+	(void)hugepages; /* UNUSED */
+	if ((errno = posix_memalign((void **)&R, 64, maplen)) != 0)
+		return (NULL);
+	R->alloc = R;
+#else
+	void * base;
+
+	(void)hugepages; /* UNUSED */
+	if ((base = malloc(maplen + 63)) == NULL)
+		return (NULL);
+	R = (struct region *)(((uintptr_t)(base) + 63) & ~ (uintptr_t)(63));
+	R->alloc = base;
+#endif
+
+	/* Record how to free the region. */
+	R->maplen = maplen;
+	LOCK();
+	if (kind == REGION_HUGETLB)
+		arena_stats.hugetlb++;
+	else if (kind == REGION_THP)
+		arena_stats.thp++;
+	UNLOCK();
+
+	return ((uint8_t *)(R) + REGION_HDR);
+}
+
+/**
+ * region_free(ptr):
+ * Free the region ${ptr} allocated by region_alloc.
+ */
+static void
+region_free(void * ptr)
+{
+	struct region * R = (struct region *)((uint8_t *)(ptr) - REGION_HDR);
+
+#if defined(MAP_ANON) && defined(HAVE_MMAP)
+	if (munmap(R->alloc, R->maplen))
+		warnp("munmap");
+#else
+	free(R->alloc);
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * arena_release(A):
+ * Release the storage cached by the arena ${A}.  Must be called with the
+ * arena lock held.
+ */
+static void
+arena_release(struct arena * A)
+{
+
+	if (A->base == NULL)
+		return;
+	region_free(A->base);
+	arena_stats.held -= A->len;
+	arena_stats.trims++;
+	A->base = NULL;
+	A->len = 0;
+	A->stale = 0;
+}
+
+/**
+ * arena_destroy(cookie):
+ * Free the arena ${cookie} of a thread which is exiting.
+ */
+static void
+arena_destroy(void * cookie)
+{
+	struct arena * A = cookie;
+
+	LOCK();
+	if (A->base != NULL) {
+		region_free(A->base);
+		arena_stats.held -= A->len;
+	}
+	if (A->prev != NULL)
+		A->prev->next = A->next;
+	else
+		arenas = A->next;
+	if (A->next != NULL)
+		A->next->prev = A->prev;
+	arena_stats.arenas--;
+	UNLOCK();
+
+	free(A);
+}
+
+static void
+arena_init(void)
+{
+
+	if (pthread_key_create(&arena_key, arena_destroy) == 0)
+		arena_key_ok = 1;
+}
+
+/**
+ * arena_self(create):
+ * Return the calling thread's arena, creating it if it does not exist and
+ * ${create} is nonzero.  Return NULL if there is no arena.
+ */
+static struct arena *
+arena_self(int create)
+{
+	struct arena * A;
+
+	if (pthread_once(&arena_once, arena_init) || !arena_key_ok)
+		return (NULL);
+	if (((A = pthread_getspecific(arena_key)) != NULL) || !create)
+		return (A);
+
+	/* Create an empty arena and add it to the list. */
+	if ((A = calloc(1, sizeof(struct arena))) == NULL)
+		return (NULL);
+	if (pthread_setspecific(arena_key, A)) {
+		free(A);
+		return (NULL);
+	}
+	LOCK();
+	A->next = arenas;
+	if (arenas != NULL)
+		arenas->prev = A;
+	arenas = A;
+	arena_stats.arenas++;
+	UNLOCK();
+
+	return (A);
+}
+
+/**
+ * arena_trim_locked(all):
+ * Release every idle arena if ${all} is nonzero, or every idle arena which
+ * the current policy does not allow to be kept otherwise; arenas which are
+ * in use are released when returned.  Must be called with the arena lock
+ * held.
+ */
+static void
+arena_trim_locked(int all)
+{
+	struct arena * A;
+
+	for (A = arenas; A != NULL; A = A->next) {
+		if (!all && (arena_policy == CRYPTO_SCRYPT_ARENA_KEEP) &&
+		    (A->len <= arena_highwater))
+			continue;
+		if (A->inuse)
+			A->stale = 1;
+		else
+			arena_release(A);
+	}
+}
+#endif
+
+/**
+ * crypto_scrypt_arena_get(len):
+ * Return ${len} bytes of scratch storage aligned to a multiple of 64 bytes,
+ * from the calling thread's arena if possible, or NULL on error.  The
+ * storage must be returned with crypto_scrypt_arena_put by the same thread.
+ */
+void *
+crypto_scrypt_arena_get(size_t len)
+{
+	int hugepages;
+#ifdef HAVE_PTHREAD
+	struct arena * A;
+	void * old;
+	size_t oldlen, alen;
+	size_t highwater;
+	int policy;
+
+	/* The settings may change under us; use one consistent view. */
+	LOCK();
+	highwater = arena_highwater;
+	policy = arena_policy;
+	hugepages = arena_hugepages;
+	UNLOCK();
+
+	/* Requests above the high-water mark are never cached. */
+	if ((len > highwater) || (policy != CRYPTO_SCRYPT_ARENA_KEEP) ||
+	    ((A = arena_self(1)) == NULL))
+		goto oneoff;
+
+	LOCK();
+
+	/* Nested use (e.g., the self-tests) gets storage of its own. */
+	if (A->inuse) {
+		UNLOCK();
+		goto oneoff;
+	}
+
+	/* Is the cached storage large enough? */
+	if (A->len >= len) {
+		A->inuse = 1;
+		arena_stats.hits++;
+		UNLOCK();
+		return (A->base);
+	}
+
+	/* Replace the cached storage with a larger region. */
+	old = A->base;
+	oldlen = A->len;
+	if (old != NULL)
+		arena_stats.held -= oldlen;
+	A->base = NULL;
+	A->len = 0;
+	A->inuse = 1;
+	arena_stats.misses++;
+	UNLOCK();
+	if (old != NULL)
+		region_free(old);
+
+	/* Round up so that slightly larger parameters still hit. */
+	alen = len;
+	if (len <= SIZE_MAX - (ARENA_GRAIN - 1))
+		alen = (len + (ARENA_GRAIN - 1)) & ~ (size_t)(ARENA_GRAIN - 1);
+	if (alen > highwater)
+		alen = len;
+	if ((A->base = region_alloc(alen, hugepages)) == NULL) {
+		LOCK();
+		A->inuse = 0;
+		UNLOCK();
+		return (NULL);
+	}
+
+	LOCK();
+	A->len = alen;
+	arena_stats.held += alen;
+	UNLOCK();
+	return (A->base);
+
+oneoff:
+#endif
+	LOCK();
+	arena_stats.misses++;
+	hugepages = arena_hugepages;
+	UNLOCK();
+	return (region_alloc(len, hugepages));
+}
+
+/**
+ * crypto_scrypt_arena_put(ptr, len):
+ * Return the ${len} bytes of scratch storage ${ptr} obtained from
+ * crypto_scrypt_arena_get.  The calling thread's arena keeps the storage
+ * for reuse unless the trim policy says otherwise.
+ */
+void
+crypto_scrypt_arena_put(void * ptr, size_t len)
+{
+#ifdef HAVE_PTHREAD
+	struct arena * A;
+
+	if (((A = arena_self(0)) != NULL) && A->inuse && (ptr == A->base)) {
+		LOCK();
+		A->inuse = 0;
+		if (A->stale ||
+		    (arena_policy != CRYPTO_SCRYPT_ARENA_KEEP) ||
+		    (A->len > arena_highwater))
+			arena_release(A);
+		UNLOCK();
+		return;
+	}
+#endif
+
+	/* Not cached storage. */
+	(void)len; /* UNUSED */
+	region_free(ptr);
+}
+
+/**
+ * crypto_scrypt_arena_alloc(len):
+ * Return ${len} bytes of storage aligned to a multiple of 64 bytes which
+ * belongs to no thread's arena, so that any thread may use it and return it
+ * with crypto_scrypt_arena_free; or NULL on error.  It is backed by huge
+ * pages in the same way as arena storage.
+ */
+void *
+crypto_scrypt_arena_alloc(size_t len)
+{
+	int hugepages;
+
+	LOCK();
+	arena_stats.misses++;
+	hugepages = arena_hugepages;
+	UNLOCK();
+	return (region_alloc(len, hugepages));
+}
+
+/**
+ * crypto_scrypt_arena_free(ptr, len):
+ * Free the ${len} bytes of storage ${ptr} obtained from
+ * crypto_scrypt_arena_alloc.
+ */
+void
+crypto_scrypt_arena_free(void * ptr, size_t len)
+{
+
+	(void)len; /* UNUSED */
+	region_free(ptr);
+}
+
+/**
+ * crypto_scrypt_arena_set(highwater, policy):
+ * Set the largest number of bytes each thread's arena keeps between uses to
+ * ${highwater}, and the trim policy to ${policy}, which must be one of
+ * CRYPTO_SCRYPT_ARENA_KEEP or CRYPTO_SCRYPT_ARENA_RELEASE.
+ */
+void
+crypto_scrypt_arena_set(size_t highwater, int policy)
+{
+
+	LOCK();
+	arena_highwater = highwater;
+	arena_policy = policy;
+#ifdef HAVE_PTHREAD
+	arena_trim_locked(0);
+#endif
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_arena_get_config(highwater, policy):
+ * Store the current high-water mark and trim policy in ${highwater} and
+ * ${policy}.
+ */
+void
+crypto_scrypt_arena_get_config(size_t * highwater, int * policy)
+{
+
+	LOCK();
+	*highwater = arena_highwater;
+	*policy = arena_policy;
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_arena_set_hugepages(mode):
+ * Back regions of at least 2 MiB with huge pages according to ${mode}, which
+ * must be one of the CRYPTO_SCRYPT_HUGEPAGES_* values.  Idle arenas are
+ * released so that the next hash picks up the new backing.
+ */
+void
+crypto_scrypt_arena_set_hugepages(int mode)
+{
+
+	LOCK();
+	if (arena_hugepages != mode) {
+		arena_hugepages = mode;
+#ifdef HAVE_PTHREAD
+		arena_trim_locked(1);
+#endif
+	}
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_arena_get_hugepages(void):
+ * Return the current huge page mode.
+ */
+int
+crypto_scrypt_arena_get_hugepages(void)
+{
+	int mode;
+
+	LOCK();
+	mode = arena_hugepages;
+	UNLOCK();
+
+	return (mode);
+}
+
+/**
+ * crypto_scrypt_arena_trim(void):
+ * Release the storage held by every arena which is not in use.  Arenas which
+ * are in use are released when they are returned.
+ */
+void
+crypto_scrypt_arena_trim(void)
+{
+
+#ifdef HAVE_PTHREAD
+	LOCK();
+	arena_trim_locked(1);
+	UNLOCK();
+#endif
+}
+
+/**
+ * crypto_scrypt_arena_stats(stats):
+ * Store the current arena statistics in ${stats}.
+ */
+void
+crypto_scrypt_arena_stats(struct crypto_scrypt_arena_stats * stats)
+{
+
+	LOCK();
+	memcpy(stats, &arena_stats, sizeof(struct crypto_scrypt_arena_stats));
+	UNLOCK();
+}
@@ -0,0 +1,101 @@
+#ifndef _CRYPTO_SCRYPT_ARENA_H_
+#define _CRYPTO_SCRYPT_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Trim policies for crypto_scrypt_arena_set. */
+#define CRYPTO_SCRYPT_ARENA_KEEP	0	/* Keep up to the high-water mark. */
+#define CRYPTO_SCRYPT_ARENA_RELEASE	1	/* Release after every use. */
+
+/* Huge page modes for crypto_scrypt_arena_set_hugepages. */
+#define CRYPTO_SCRYPT_HUGEPAGES_OFF	0	/* Regular pages only. */
+#define CRYPTO_SCRYPT_HUGEPAGES_THP	1	/* madvise(MADV_HUGEPAGE). */
+#define CRYPTO_SCRYPT_HUGEPAGES_HUGETLB	2	/* MAP_HUGETLB, then THP. */
+
+/* Statistics returned by crypto_scrypt_arena_stats. */
+struct crypto_scrypt_arena_stats {
+	size_t held;		/* Bytes held by idle or busy arenas. */
+	size_t arenas;		/* Number of threads holding an arena. */
+	uint64_t hits;		/* Requests served by a cached arena. */
+	uint64_t misses;	/* Requests which needed a fresh mapping. */
+	uint64_t trims;		/* Arenas released by the trim policy. */
+	uint64_t hugetlb;	/* Regions mapped with MAP_HUGETLB. */
+	uint64_t thp;		/* Regions advised to use transparent huge pages. */
+};
+
+/**
+ * crypto_scrypt_arena_get(len):
+ * Return ${len} bytes of scratch storage aligned to a multiple of 64 bytes,
+ * from the calling thread's arena if possible, or NULL on error.  The
+ * storage must be returned with crypto_scrypt_arena_put by the same thread.
+ */
+void * crypto_scrypt_arena_get(size_t);
+
+/**
+ * crypto_scrypt_arena_put(ptr, len):
+ * Return the ${len} bytes of scratch storage ${ptr} obtained from
+ * crypto_scrypt_arena_get.  The calling thread's arena keeps the storage
+ * for reuse unless the trim policy says otherwise.
+ */
+void crypto_scrypt_arena_put(void *, size_t);
+
+/**
+ * crypto_scrypt_arena_alloc(len):
+ * Return ${len} bytes of storage aligned to a multiple of 64 bytes which
+ * belongs to no thread's arena, so that any thread may use it and return it
+ * with crypto_scrypt_arena_free; or NULL on error.  It is backed by huge
+ * pages in the same way as arena storage.
+ */
+void * crypto_scrypt_arena_alloc(size_t);
+
+/**
+ * crypto_scrypt_arena_free(ptr, len):
+ * Free the ${len} bytes of storage ${ptr} obtained from
+ * crypto_scrypt_arena_alloc.
+ */
+void crypto_scrypt_arena_free(void *, size_t);
+
+/**
+ * crypto_scrypt_arena_set(highwater, policy):
+ * Set the largest number of bytes each thread's arena keeps between uses to
+ * ${highwater}, and the trim policy to ${policy}, which must be one of
+ * CRYPTO_SCRYPT_ARENA_KEEP or CRYPTO_SCRYPT_ARENA_RELEASE.
+ */
+void crypto_scrypt_arena_set(size_t, int);
+
+/**
+ * crypto_scrypt_arena_get_config(highwater, policy):
+ * Store the current high-water mark and trim policy in ${highwater} and
+ * ${policy}.
+ */
+void crypto_scrypt_arena_get_config(size_t *, int *);
+
+/**
+ * crypto_scrypt_arena_set_hugepages(mode):
+ * Back regions of at least 2 MiB with huge pages according to ${mode}, which
+ * must be one of the CRYPTO_SCRYPT_HUGEPAGES_* values.  Idle arenas are
+ * released so that the next hash picks up the new backing.
+ */
+void crypto_scrypt_arena_set_hugepages(int);
+
+/**
+ * crypto_scrypt_arena_get_hugepages(void):
+ * Return the current huge page mode.
+ */
+int crypto_scrypt_arena_get_hugepages(void);
+
+/**
+ * crypto_scrypt_arena_trim(void):
+ * Release the storage held by every arena which is not in use.  Arenas which
+ * are in use are released when they are returned.
+ */
+void crypto_scrypt_arena_trim(void);
+
+/**
+ * crypto_scrypt_arena_stats(stats):
+ * Store the current arena statistics in ${stats}.
+ */
+void crypto_scrypt_arena_stats(struct crypto_scrypt_arena_stats *);
+
+#endif /* !_CRYPTO_SCRYPT_ARENA_H_ */
@@ -0,0 +1,370 @@
+#include "scrypt_platform.h"
+
+#include <errno.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "crypto_scrypt_budget.h"
+
+/*
+ * Reservations are admitted in arrival order: a computation which has to wait
+ * joins the end of the queue, and only the one at its head may be admitted,
+ * so small computations cannot starve a large one.  A computation which gives
+ * up waiting leaves the queue wherever it is.
+ */
+struct budget_waiter {
+	struct budget_waiter * next;
+};
+static struct crypto_scrypt_budget_stats budget_stats;
+static int budget_explicit = 0;
+static struct budget_waiter * queue_head = NULL;
+static struct budget_waiter ** queue_tail = &queue_head;
+
+/*
+ * Waiters which can give up look at their cancel flag and deadline this often
+ * (in milliseconds) while they wait.
+ */
+#define BUDGET_POLL	10
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t budget_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t budget_cv = PTHREAD_COND_INITIALIZER;
+static pthread_once_t wait_once = PTHREAD_ONCE_INIT;
+static pthread_key_t wait_key;
+static int wait_key_ok = 0;
+
+#define LOCK()		pthread_mutex_lock(&budget_mtx)
+#define UNLOCK()	pthread_mutex_unlock(&budget_mtx)
+#define WAIT()		pthread_cond_wait(&budget_cv, &budget_mtx)
+#define WAKE()		pthread_cond_broadcast(&budget_cv)
+#elif defined(_WIN32)
+static SRWLOCK budget_mtx = SRWLOCK_INIT;
+static CONDITION_VARIABLE budget_cv = CONDITION_VARIABLE_INIT;
+static __declspec(thread) const struct timespec * wait_deadline = NULL;
+
+#define LOCK()		AcquireSRWLockExclusive(&budget_mtx)
+#define UNLOCK()	ReleaseSRWLockExclusive(&budget_mtx)
+#define WAIT()							\
+	SleepConditionVariableSRW(&budget_cv, &budget_mtx, INFINITE, 0)
+#define WAKE()		WakeAllConditionVariable(&budget_cv)
+#else
+#error "The memory budget needs pthreads or Windows threads"
+#endif
+
+/**
+ * fits(len):
+ * Return nonzero if ${len} more bytes may be reserved now.  Must be called
+ * with the budget lock held.
+ */
+static int
+fits(size_t len)
+{
+
+	if ((budget_stats.limit == 0) || (budget_stats.used == 0))
+		return (1);
+	if (budget_stats.used > budget_stats.limit)
+		return (0);
+	return (len <= budget_stats.limit - budget_stats.used);
+}
+
+/**
+ * take(len):
+ * Count ${len} bytes as in use.  Must be called with the budget lock held.
+ */
+static void
+take(size_t len)
+{
+
+	budget_stats.used += len;
+	if (budget_stats.peak < budget_stats.used)
+		budget_stats.peak = budget_stats.used;
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * wait_init(void):
+ * Create the key under which each thread keeps its wait deadline.
+ */
+static void
+wait_init(void)
+{
+
+	if (pthread_key_create(&wait_key, NULL) == 0)
+		wait_key_ok = 1;
+}
+#endif
+
+/**
+ * wait_get(void):
+ * Return the deadline set by crypto_scrypt_budget_wait on the calling thread,
+ * or NULL if there is none.
+ */
+static const struct timespec *
+wait_get(void)
+{
+
+#ifdef HAVE_PTHREAD
+	pthread_once(&wait_once, wait_init);
+	if (!wait_key_ok)
+		return (NULL);
+	return (pthread_getspecific(wait_key));
+#else
+	return (wait_deadline);
+#endif
+}
+
+/**
+ * wait_poll(void):
+ * Wait until the budget changes, or for BUDGET_POLL milliseconds at most.
+ * Must be called with the budget lock held.
+ */
+static void
+wait_poll(void)
+{
+#ifdef HAVE_PTHREAD
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += BUDGET_POLL * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	pthread_cond_timedwait(&budget_cv, &budget_mtx, &ts);
+#else
+	SleepConditionVariableSRW(&budget_cv, &budget_mtx, BUDGET_POLL, 0);
+#endif
+}
+
+/**
+ * passed(deadline):
+ * Return nonzero if the time ${deadline} on the crypto_scrypt_budget_now
+ * clock has passed.
+ */
+static int
+passed(const struct timespec * deadline)
+{
+	struct timespec now;
+
+	if (crypto_scrypt_budget_now(&now))
+		return (0);
+	return ((now.tv_sec > deadline->tv_sec) ||
+	    ((now.tv_sec == deadline->tv_sec) &&
+	    (now.tv_nsec >= deadline->tv_nsec)));
+}
+
+/**
+ * dequeue(w):
+ * Take the waiter ${w} out of the queue.  Must be called with the budget
+ * lock held.
+ */
+static void
+dequeue(struct budget_waiter * w)
+{
+	struct budget_waiter ** wp;
+
+	for (wp = &queue_head; *wp != w; wp = &(*wp)->next)
+		continue;
+	if ((*wp = w->next) == NULL)
+		queue_tail = wp;
+	budget_stats.waiting--;
+}
+
+/**
+ * crypto_scrypt_budget_reserve(len, cancel):
+ * Wait until ${len} more bytes of scratch storage fit within the memory
+ * budget, then count them as in use.
+ */
+int
+crypto_scrypt_budget_reserve(size_t len, const volatile int * cancel)
+{
+	struct budget_waiter w;
+	const struct timespec * deadline = wait_get();
+	int error = 0;
+
+	LOCK();
+
+	/* Go straight in if nobody is queued ahead of us. */
+	if ((queue_head == NULL) && fits(len)) {
+		take(len);
+		UNLOCK();
+		return (0);
+	}
+
+	/* A deadline of zero means we may not wait at all. */
+	if ((deadline != NULL) &&
+	    (deadline->tv_sec == 0) && (deadline->tv_nsec == 0)) {
+		UNLOCK();
+		errno = EAGAIN;
+		return (-1);
+	}
+
+	/* Queue up. */
+	w.next = NULL;
+	*queue_tail = &w;
+	queue_tail = &w.next;
+	budget_stats.waiting++;
+	budget_stats.waits++;
+	while ((queue_head != &w) || !fits(len)) {
+		/* Wait for memory, or for good if nothing can stop us. */
+		if ((cancel == NULL) && (deadline == NULL)) {
+			WAIT();
+			continue;
+		}
+
+		/* Give up if we have been cancelled or are out of time. */
+		if ((cancel != NULL) && *cancel) {
+			error = ECANCELED;
+			break;
+		}
+		if ((deadline != NULL) && passed(deadline)) {
+			error = ETIMEDOUT;
+			break;
+		}
+
+		/* Wait for memory, but look again in a little while. */
+		wait_poll();
+	}
+
+	/* Leave the queue; the next in line may fit now, or fit as well. */
+	dequeue(&w);
+	if (error == 0)
+		take(len);
+	WAKE();
+
+	UNLOCK();
+
+	/* Did we give up? */
+	if (error) {
+		errno = error;
+		return (-1);
+	}
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * crypto_scrypt_budget_now(ts):
+ * Store the current time on the clock which crypto_scrypt_budget_wait
+ * deadlines are measured against in ${ts}.  Return 0 on success or -1 on
+ * error.
+ */
+int
+crypto_scrypt_budget_now(struct timespec * ts)
+{
+#ifdef _WIN32
+	ULONGLONG ms = GetTickCount64();
+
+	ts->tv_sec = (time_t)(ms / 1000);
+	ts->tv_nsec = (long)(ms % 1000) * 1000000L;
+
+	/* Success! */
+	return (0);
+#else
+	return (clock_gettime(CLOCK_MONOTONIC, ts));
+#endif
+}
+
+/**
+ * crypto_scrypt_budget_wait(deadline):
+ * Make crypto_scrypt_budget_reserve give up waiting on the calling thread at
+ * the crypto_scrypt_budget_now time ${deadline}, or not wait at all if
+ * ${deadline} is zero; or wait for as long as it takes if ${deadline} is
+ * NULL.
+ */
+void
+crypto_scrypt_budget_wait(const struct timespec * deadline)
+{
+
+#ifdef HAVE_PTHREAD
+	pthread_once(&wait_once, wait_init);
+	if (wait_key_ok)
+		pthread_setspecific(wait_key, deadline);
+#else
+	wait_deadline = deadline;
+#endif
+}
+
+/**
+ * crypto_scrypt_budget_release(len):
+ * Return ${len} bytes reserved with crypto_scrypt_budget_reserve.
+ */
+void
+crypto_scrypt_budget_release(size_t len)
+{
+
+	LOCK();
+	budget_stats.used -= len;
+	if (budget_stats.waiting > 0)
+		WAKE();
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_budget_set(limit):
+ * Limit the scratch storage of all running scrypt computations together to
+ * ${limit} bytes, or lift the limit if ${limit} is 0.
+ */
+void
+crypto_scrypt_budget_set(size_t limit)
+{
+
+	LOCK();
+	budget_stats.limit = limit;
+	budget_explicit = 1;
+	WAKE();
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_budget_set_default(limit):
+ * As crypto_scrypt_budget_set, unless crypto_scrypt_budget_set has already
+ * been called.
+ */
+void
+crypto_scrypt_budget_set_default(size_t limit)
+{
+
+	LOCK();
+	if (!budget_explicit) {
+		budget_stats.limit = limit;
+		WAKE();
+	}
+	UNLOCK();
+}
+
+/**
+ * crypto_scrypt_budget_get(void):
+ * Return the current budget in bytes, or 0 if there is no limit.
+ */
+size_t
+crypto_scrypt_budget_get(void)
+{
+	size_t limit;
+
+	LOCK();
+	limit = budget_stats.limit;
+	UNLOCK();
+
+	return (limit);
+}
+
+/**
+ * crypto_scrypt_budget_stats(stats):
+ * Store the current budget statistics in ${stats}.
+ */
+void
+crypto_scrypt_budget_stats(struct crypto_scrypt_budget_stats * stats)
+{
+
+	LOCK();
+	memcpy(stats, &budget_stats, sizeof(struct crypto_scrypt_budget_stats));
+	UNLOCK();
+}
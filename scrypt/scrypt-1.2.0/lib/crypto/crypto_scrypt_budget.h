@@ -0,0 +1,82 @@
+#ifndef _CRYPTO_SCRYPT_BUDGET_H_
+#define _CRYPTO_SCRYPT_BUDGET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Statistics returned by crypto_scrypt_budget_stats. */
+struct crypto_scrypt_budget_stats {
+	size_t limit;		/* Budget in bytes, or 0 if unlimited. */
+	size_t used;		/* Bytes reserved by running computations. */
+	size_t peak;		/* Largest number of bytes ever reserved. */
+	size_t waiting;		/* Computations waiting for memory. */
+	uint64_t waits;		/* Computations which have had to wait. */
+};
+
+/**
+ * crypto_scrypt_budget_reserve(len, cancel):
+ * Wait until ${len} more bytes of scratch storage fit within the memory
+ * budget, then count them as in use.  Waiting computations are admitted in
+ * the order in which they arrived; one which needs more than the whole
+ * budget is admitted once nothing else is in use.  Give up waiting with
+ * errno set to ECANCELED if ${cancel} is not NULL and *${cancel} becomes
+ * nonzero, or as set by crypto_scrypt_budget_wait.
+ *
+ * Return 0 on success; or -1 if nothing was reserved.
+ */
+int crypto_scrypt_budget_reserve(size_t, const volatile int *);
+
+/**
+ * crypto_scrypt_budget_now(ts):
+ * Store the current time on the clock which crypto_scrypt_budget_wait
+ * deadlines are measured against in ${ts}: CLOCK_MONOTONIC, or the tick
+ * count on Windows.  Return 0 on success or -1 on error.
+ */
+int crypto_scrypt_budget_now(struct timespec *);
+
+/**
+ * crypto_scrypt_budget_wait(deadline):
+ * Make crypto_scrypt_budget_reserve give up waiting on the calling thread,
+ * with errno set to ETIMEDOUT, once the crypto_scrypt_budget_now time
+ * ${deadline} has passed; or, if ${deadline} is zero, fail at once with errno
+ * set to EAGAIN rather than wait at all.  A NULL ${deadline} restores the
+ * default of waiting for as long as it takes.  The deadline is not copied, so
+ * it must stay valid until it is replaced.
+ */
+void crypto_scrypt_budget_wait(const struct timespec *);
+
+/**
+ * crypto_scrypt_budget_release(len):
+ * Return ${len} bytes reserved with crypto_scrypt_budget_reserve.
+ */
+void crypto_scrypt_budget_release(size_t);
+
+/**
+ * crypto_scrypt_budget_set(limit):
+ * Limit the scratch storage of all running scrypt computations together to
+ * ${limit} bytes, or lift the limit if ${limit} is 0.  Computations which
+ * are already running are not affected.
+ */
+void crypto_scrypt_budget_set(size_t);
+
+/**
+ * crypto_scrypt_budget_set_default(limit):
+ * As crypto_scrypt_budget_set, unless crypto_scrypt_budget_set has already
+ * been called.
+ */
+void crypto_scrypt_budget_set_default(size_t);
+
+/**
+ * crypto_scrypt_budget_get(void):
+ * Return the current budget in bytes, or 0 if there is no limit.
+ */
+size_t crypto_scrypt_budget_get(void);
+
+/**
+ * crypto_scrypt_budget_stats(stats):
+ * Store the current budget statistics in ${stats}.
+ */
+void crypto_scrypt_budget_stats(struct crypto_scrypt_budget_stats *);
+
+#endif /* !_CRYPTO_SCRYPT_BUDGET_H_ */
@@ -33,31 +33,27 @@
 #include "sysendian.h"
 
 #include "crypto_scrypt_smix.h"
+#include "crypto_scrypt_smix_specialize.h"
 
-static void blkcpy(void *, const void *, size_t);
-static void blkxor(void *, const void *, size_t);
+SMIX_INLINE void blkcpy(void *, const void *, size_t);
+SMIX_INLINE void blkxor(void *, const void *, size_t);
 static void salsa20_8(uint32_t[16]);
-static void blockmix_salsa8(const uint32_t *, uint32_t *, uint32_t *, size_t);
-static uint64_t integerify(const void *, size_t);
+SMIX_INLINE void blockmix_salsa8(const uint32_t *, uint32_t *, uint32_t *, size_t);
+SMIX_INLINE uint64_t integerify(const void *, size_t);
 
-static void
+SMIX_INLINE void
 blkcpy(void * dest, const void * src, size_t len)
 {
-	size_t * D = dest;
-	const size_t * S = src;
-	size_t L = len / sizeof(size_t);
-	size_t i;
 
-	for (i = 0; i < L; i++)
-		D[i] = S[i];
+	memcpy(dest, src, len);
 }
 
-static void
+SMIX_INLINE void
 blkxor(void * dest, const void * src, size_t len)
 {
-	size_t * D = dest;
-	const size_t * S = src;
-	size_t L = len / sizeof(size_t);
+	uint32_t * D = dest;
+	const uint32_t * S = src;
+	size_t L = len / sizeof(uint32_t);
 	size_t i;
 
 	for (i = 0; i < L; i++)
@@ -114,7 +110,7 @@ salsa20_8(uint32_t B[16])
  * bytes in length; the output Bout must also be the same size.  The
  * temporary space X must be 64 bytes.
  */
-static void
+SMIX_INLINE void
 blockmix_salsa8(const uint32_t * Bin, uint32_t * Bout, uint32_t * X, size_t r)
 {
 	size_t i;
@@ -123,6 +119,7 @@ blockmix_salsa8(const uint32_t * Bin, uint32_t * Bout, uint32_t * X, size_t r)
 	blkcpy(X, &Bin[(2 * r - 1) * 16], 64);
 
 	/* 2: for i = 0 to 2r - 1 do */
+	SMIX_UNROLL
 	for (i = 0; i < 2 * r; i += 2) {
 		/* 3: X <-- H(X \xor B_i) */
 		blkxor(X, &Bin[i * 16], 64);
@@ -146,7 +143,7 @@ blockmix_salsa8(const uint32_t * Bin, uint32_t * Bout, uint32_t * X, size_t r)
  * integerify(B, r):
  * Return the result of parsing B_{2r-1} as a little-endian integer.
  */
-static uint64_t
+SMIX_INLINE uint64_t
 integerify(const void * B, size_t r)
 {
 	const uint32_t * X = (const void *)((uintptr_t)(B) + (2 * r - 1) * 64);
@@ -155,30 +152,30 @@ integerify(const void * B, size_t r)
 }
 
 /**
- * crypto_scrypt_smix(B, r, N, V, XY):
- * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
- * the temporary storage V must be 128rN bytes in length; the temporary
- * storage XY must be 256r + 64 bytes in length.  The value N must be a
- * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
- * multiple of 64 bytes.
+ * smix(B, r, N, V, XY, pos, steps):
+ * The body of crypto_scrypt_smix, inlined into each of its specializations.
  */
-void
-crypto_scrypt_smix(uint8_t * B, size_t r, uint64_t N, void * _V, void * XY)
+SMIX_INLINE void
+smix(uint8_t * B, size_t r, uint64_t N, void * _V, void * XY,
+    uint64_t * pos, uint64_t steps)
 {
 	uint32_t * X = XY;
 	uint32_t * Y = (void *)((uint8_t *)(XY) + 128 * r);
 	uint32_t * Z = (void *)((uint8_t *)(XY) + 256 * r);
 	uint32_t * V = _V;
-	uint64_t i;
+	uint64_t i = *pos;
+	uint64_t end = (steps < 2 * N - i) ? i + steps : 2 * N;
 	uint64_t j;
 	size_t k;
 
 	/* 1: X <-- B */
-	for (k = 0; k < 32 * r; k++)
-		X[k] = le32dec(&B[4 * k]);
+	if (i == 0) {
+		for (k = 0; k < 32 * r; k++)
+			X[k] = le32dec(&B[4 * k]);
+	}
 
 	/* 2: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i += 2) {
+	for (; (i < N) && (i < end); i += 2) {
 		/* 3: V_i <-- X */
 		blkcpy(&V[i * (32 * r)], X, 128 * r);
 
@@ -192,8 +189,8 @@ crypto_scrypt_smix(uint8_t * B, size_t r, uint64_t N, void * _V, void * XY)
 		blockmix_salsa8(Y, X, Z, r);
 	}
 
-	/* 6: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i += 2) {
+	/* 6: for i = 0 to N - 1 do (counted here as N to 2N - 1) */
+	for (; i < end; i += 2) {
 		/* 7: j <-- Integerify(X) mod N */
 		j = integerify(X, r) & (N - 1);
 
@@ -210,6 +207,30 @@ crypto_scrypt_smix(uint8_t * B, size_t r, uint64_t N, void * _V, void * XY)
 	}
 
 	/* 10: B' <-- X */
-	for (k = 0; k < 32 * r; k++)
-		le32enc(&B[4 * k], X[k]);
+	if (i == 2 * N) {
+		for (k = 0; k < 32 * r; k++)
+			le32enc(&B[4 * k], X[k]);
+	}
+	*pos = i;
+}
+
+/**
+ * crypto_scrypt_smix(B, r, N, V, XY, pos, steps):
+ * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
+ * the temporary storage V must be 128rN bytes in length; the temporary
+ * storage XY must be 256r + 64 bytes in length.  The value N must be a
+ * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
+ * multiple of 64 bytes.
+ *
+ * Only do up to ${steps} of the 2N iterations, an even number, starting at
+ * iteration ${*pos}, and advance ${*pos} past them; B holds the result once
+ * ${*pos} reaches 2N.  Start with ${*pos} = 0, and pass the same V and XY to
+ * the same smix kernel until then.
+ */
+void
+crypto_scrypt_smix(uint8_t * B, size_t r, uint64_t N, void * V, void * XY,
+    uint64_t * pos, uint64_t steps)
+{
+
+	SMIX_SPECIALIZE(smix, B, r, N, V, XY, pos, steps);
 }
@@ -0,0 +1,22 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_AVX2_H_
+#define _CRYPTO_SCRYPT_SMIX_AVX2_H_
+
+/**
+ * crypto_scrypt_smix_avx2(B, r, N, V, XY, pos, steps):
+ * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
+ * the temporary storage V must be 128rN bytes in length; the temporary
+ * storage XY must be 256r + 64 bytes in length.  The value N must be a
+ * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
+ * multiple of 64 bytes.
+ *
+ * Only do up to ${steps} of the 2N iterations, an even number, starting at
+ * iteration ${*pos}, and advance ${*pos} past them; B holds the result once
+ * ${*pos} reaches 2N.  Start with ${*pos} = 0, and pass the same V and XY to
+ * the same smix kernel until then.
+ *
+ * Use AVX2 instructions.
+ */
+void crypto_scrypt_smix_avx2(uint8_t *, size_t, uint64_t, void *, void *,
+    uint64_t *, uint64_t);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_AVX2_H_ */
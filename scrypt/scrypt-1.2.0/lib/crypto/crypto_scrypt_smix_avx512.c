@@ -0,0 +1,267 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX512VL
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_avx512.h"
+#include "crypto_scrypt_smix_specialize.h"
+
+SMIX_INLINE void blkcpy(void *, const void *, size_t);
+SMIX_INLINE void blkxor(void *, const void *, size_t);
+static void salsa20_8_xor(__m128i *, const __m128i *);
+SMIX_INLINE void blockmix_salsa8(const __m128i *, __m128i *, size_t);
+SMIX_INLINE uint64_t integerify(const void *, size_t);
+
+SMIX_INLINE void
+blkcpy(void * dest, const void * src, size_t len)
+{
+	__m512i * D = dest;
+	const __m512i * S = src;
+	size_t L = len / 64;
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] = S[i];
+}
+
+SMIX_INLINE void
+blkxor(void * dest, const void * src, size_t len)
+{
+	__m512i * D = dest;
+	const __m512i * S = src;
+	size_t L = len / 64;
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] = _mm512_xor_si512(D[i], S[i]);
+}
+
+/**
+ * salsa20_8_xor(X, B):
+ * Compute X <-- salsa20/8(X xor B).  The XOR is folded into the loads of
+ * the core and the rotations use the AVX-512 vprold instruction.
+ */
+static inline void
+salsa20_8_xor(__m128i * X, const __m128i * B)
+{
+	__m128i X0, X1, X2, X3;
+	__m128i Y0, Y1, Y2, Y3;
+	size_t i;
+
+	X0 = Y0 = _mm_xor_si128(X[0], B[0]);
+	X1 = Y1 = _mm_xor_si128(X[1], B[1]);
+	X2 = Y2 = _mm_xor_si128(X[2], B[2]);
+	X3 = Y3 = _mm_xor_si128(X[3], B[3]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on "columns". */
+		X1 = _mm_xor_si128(X1, _mm_rol_epi32(_mm_add_epi32(X0, X3), 7));
+		X2 = _mm_xor_si128(X2, _mm_rol_epi32(_mm_add_epi32(X1, X0), 9));
+		X3 = _mm_xor_si128(X3, _mm_rol_epi32(_mm_add_epi32(X2, X1), 13));
+		X0 = _mm_xor_si128(X0, _mm_rol_epi32(_mm_add_epi32(X3, X2), 18));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x93);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x39);
+
+		/* Operate on "rows". */
+		X3 = _mm_xor_si128(X3, _mm_rol_epi32(_mm_add_epi32(X0, X1), 7));
+		X2 = _mm_xor_si128(X2, _mm_rol_epi32(_mm_add_epi32(X3, X0), 9));
+		X1 = _mm_xor_si128(X1, _mm_rol_epi32(_mm_add_epi32(X2, X3), 13));
+		X0 = _mm_xor_si128(X0, _mm_rol_epi32(_mm_add_epi32(X1, X2), 18));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x39);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x93);
+	}
+
+	X[0] = _mm_add_epi32(Y0, X0);
+	X[1] = _mm_add_epi32(Y1, X1);
+	X[2] = _mm_add_epi32(Y2, X2);
+	X[3] = _mm_add_epi32(Y3, X3);
+}
+
+/**
+ * blockmix_salsa8(Bin, Bout, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin).  The input Bin must be 128r
+ * bytes in length; the output Bout must also be the same size.  The running
+ * 64-byte state X is kept in registers rather than in a temporary buffer.
+ */
+SMIX_INLINE void
+blockmix_salsa8(const __m128i * Bin, __m128i * Bout, size_t r)
+{
+	__m128i X[4];
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	X[0] = Bin[8 * r - 4];
+	X[1] = Bin[8 * r - 3];
+	X[2] = Bin[8 * r - 2];
+	X[3] = Bin[8 * r - 1];
+
+	/* 2: for i = 0 to 2r - 1 do */
+	SMIX_UNROLL
+	for (i = 0; i < r; i++) {
+		/* 3: X <-- H(X \xor B_i) */
+		salsa20_8_xor(X, &Bin[i * 8]);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		Bout[i * 4] = X[0];
+		Bout[i * 4 + 1] = X[1];
+		Bout[i * 4 + 2] = X[2];
+		Bout[i * 4 + 3] = X[3];
+
+		/* 3: X <-- H(X \xor B_i) */
+		salsa20_8_xor(X, &Bin[i * 8 + 4]);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		Bout[(r + i) * 4] = X[0];
+		Bout[(r + i) * 4 + 1] = X[1];
+		Bout[(r + i) * 4 + 2] = X[2];
+		Bout[(r + i) * 4 + 3] = X[3];
+	}
+}
+
+/**
+ * integerify(B, r):
+ * Return the result of parsing B_{2r-1} as a little-endian integer.
+ */
+SMIX_INLINE uint64_t
+integerify(const void * B, size_t r)
+{
+	const uint32_t * X = (const void *)((uintptr_t)(B) + (2 * r - 1) * 64);
+
+	return (((uint64_t)(X[13]) << 32) + X[0]);
+}
+
+/**
+ * smix(B, r, N, V, XY, pos, steps):
+ * The body of crypto_scrypt_smix_avx512, inlined into each of its specializations.
+ */
+SMIX_INLINE void
+smix(uint8_t * B, size_t r, uint64_t N, void * V, void * XY,
+    uint64_t * pos, uint64_t steps)
+{
+	__m128i * X = XY;
+	__m128i * Y = (void *)((uintptr_t)(XY) + 128 * r);
+	uint32_t * X32 = (void *)X;
+	uint64_t i = *pos;
+	uint64_t end = (steps < 2 * N - i) ? i + steps : 2 * N;
+	uint64_t j;
+	size_t k, w;
+
+	/* 1: X <-- B */
+	if (i == 0) {
+		for (k = 0; k < 2 * r; k++) {
+			for (w = 0; w < 16; w++) {
+				X32[k * 16 + w] =
+				    le32dec(&B[(k * 16 + (w * 5 % 16)) * 4]);
+			}
+		}
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (; (i < N) && (i < end); i += 2) {
+		/* 3: V_i <-- X */
+		blkcpy((void *)((uintptr_t)(V) + i * 128 * r), X, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, r);
+
+		/* 3: V_i <-- X */
+		blkcpy((void *)((uintptr_t)(V) + (i + 1) * 128 * r),
+		    Y, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(Y, X, r);
+	}
+
+	/* 6: for i = 0 to N - 1 do (counted here as N to 2N - 1) */
+	for (; i < end; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(X, (void *)((uintptr_t)(V) + j * 128 * r), 128 * r);
+		blockmix_salsa8(X, Y, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(Y, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(Y, (void *)((uintptr_t)(V) + j * 128 * r), 128 * r);
+		blockmix_salsa8(Y, X, r);
+	}
+
+	/* 10: B' <-- X */
+	if (i == 2 * N) {
+		for (k = 0; k < 2 * r; k++) {
+			for (w = 0; w < 16; w++) {
+				le32enc(&B[(k * 16 + (w * 5 % 16)) * 4],
+				    X32[k * 16 + w]);
+			}
+		}
+	}
+	*pos = i;
+}
+
+/**
+ * crypto_scrypt_smix_avx512(B, r, N, V, XY, pos, steps):
+ * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
+ * the temporary storage V must be 128rN bytes in length; the temporary
+ * storage XY must be 256r + 64 bytes in length.  The value N must be a
+ * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
+ * multiple of 64 bytes.
+ *
+ * Only do up to ${steps} of the 2N iterations, an even number, starting at
+ * iteration ${*pos}, and advance ${*pos} past them; B holds the result once
+ * ${*pos} reaches 2N.  Start with ${*pos} = 0, and pass the same V and XY to
+ * the same smix kernel until then.
+ *
+ * Use AVX-512F and AVX-512VL instructions.
+ */
+void
+crypto_scrypt_smix_avx512(uint8_t * B, size_t r, uint64_t N, void * V,
+    void * XY,
+    uint64_t * pos, uint64_t steps)
+{
+
+	SMIX_SPECIALIZE(smix, B, r, N, V, XY, pos, steps);
+}
+
+#endif /* CPUSUPPORT_X86_AVX512VL */
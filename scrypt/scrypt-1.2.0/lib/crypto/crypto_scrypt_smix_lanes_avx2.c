@@ -0,0 +1,80 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX2
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_lanes_avx2.h"
+
+#define LANES 8
+#define lvec __m256i
+#define LADD(a, b) _mm256_add_epi32((a), (b))
+#define LXOR(a, b) _mm256_xor_si256((a), (b))
+#define LROTL(a, n) \
+	_mm256_or_si256(_mm256_slli_epi32((a), (n)),		\
+	    _mm256_srli_epi32((a), 32 - (n)))
+#define SMIX_LANES crypto_scrypt_smix_lanes_avx2
+#define LTRANSPOSE(t) ltranspose(t)
+
+/**
+ * ltranspose(t):
+ * Transpose the 8 x 8 matrix of 32-bit words held in ${t}.  Each group of
+ * four rows is transposed within the 128-bit halves, and the halves are
+ * then exchanged between the two groups.
+ */
+static inline void
+ltranspose(__m256i t[8])
+{
+	__m256i T[8];
+	__m256i U[8];
+	size_t g;
+
+	for (g = 0; g < 8; g += 4) {
+		T[0] = _mm256_unpacklo_epi32(t[g + 0], t[g + 1]);
+		T[1] = _mm256_unpacklo_epi32(t[g + 2], t[g + 3]);
+		T[2] = _mm256_unpackhi_epi32(t[g + 0], t[g + 1]);
+		T[3] = _mm256_unpackhi_epi32(t[g + 2], t[g + 3]);
+		U[g + 0] = _mm256_unpacklo_epi64(T[0], T[1]);
+		U[g + 1] = _mm256_unpackhi_epi64(T[0], T[1]);
+		U[g + 2] = _mm256_unpacklo_epi64(T[2], T[3]);
+		U[g + 3] = _mm256_unpackhi_epi64(T[2], T[3]);
+	}
+	for (g = 0; g < 4; g++) {
+		t[g] = _mm256_permute2x128_si256(U[g], U[g + 4], 0x20);
+		t[g + 4] = _mm256_permute2x128_si256(U[g], U[g + 4], 0x31);
+	}
+}
+
+#include "crypto_scrypt_smix_lanes_template.h"
+
+#endif /* CPUSUPPORT_X86_AVX2 */
@@ -0,0 +1,17 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_LANES_AVX2_H_
+#define _CRYPTO_SCRYPT_SMIX_LANES_AVX2_H_
+
+/**
+ * crypto_scrypt_smix_lanes_avx2(B, r, N, V, XY):
+ * Compute B[l] = SMix_r(B[l], N) for l = 0 ... 7.  Each B[l] must be
+ * 128r bytes in length; the temporary storage V must be 128rN * 8 bytes in
+ * length; the temporary storage XY must be (256r + 64) * 8 bytes in length.
+ * The value N must be a power of 2 greater than 1.  The arrays V and XY must
+ * be aligned to a multiple of 64 bytes.
+ *
+ * Use AVX2 instructions to compute 8 independent hashes at once.
+ */
+void crypto_scrypt_smix_lanes_avx2(uint8_t * [8], size_t, uint64_t, void *,
+    void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_LANES_AVX2_H_ */
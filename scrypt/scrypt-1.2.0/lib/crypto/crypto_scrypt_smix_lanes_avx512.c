@@ -0,0 +1,85 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX512VL
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_lanes_avx512.h"
+
+#define LANES 16
+#define lvec __m512i
+#define LADD(a, b) _mm512_add_epi32((a), (b))
+#define LXOR(a, b) _mm512_xor_si512((a), (b))
+#define LROTL(a, n) _mm512_rol_epi32((a), (n))
+#define SMIX_LANES crypto_scrypt_smix_lanes_avx512
+#define LTRANSPOSE(t) ltranspose(t)
+
+/**
+ * ltranspose(t):
+ * Transpose the 16 x 16 matrix of 32-bit words held in ${t}.  Each group of
+ * four rows is transposed within the 128-bit quarters, and the quarters are
+ * then transposed as a 4 x 4 matrix across the four groups.
+ */
+static inline void
+ltranspose(__m512i t[16])
+{
+	__m512i T[4];
+	__m512i U[16];
+	__m512i E0, E1, E2, E3;
+	size_t g, m;
+
+	for (g = 0; g < 16; g += 4) {
+		T[0] = _mm512_unpacklo_epi32(t[g + 0], t[g + 1]);
+		T[1] = _mm512_unpacklo_epi32(t[g + 2], t[g + 3]);
+		T[2] = _mm512_unpackhi_epi32(t[g + 0], t[g + 1]);
+		T[3] = _mm512_unpackhi_epi32(t[g + 2], t[g + 3]);
+		U[g + 0] = _mm512_unpacklo_epi64(T[0], T[1]);
+		U[g + 1] = _mm512_unpackhi_epi64(T[0], T[1]);
+		U[g + 2] = _mm512_unpacklo_epi64(T[2], T[3]);
+		U[g + 3] = _mm512_unpackhi_epi64(T[2], T[3]);
+	}
+	for (m = 0; m < 4; m++) {
+		E0 = _mm512_shuffle_i32x4(U[m], U[m + 4], 0x44);
+		E1 = _mm512_shuffle_i32x4(U[m], U[m + 4], 0xEE);
+		E2 = _mm512_shuffle_i32x4(U[m + 8], U[m + 12], 0x44);
+		E3 = _mm512_shuffle_i32x4(U[m + 8], U[m + 12], 0xEE);
+		t[m] = _mm512_shuffle_i32x4(E0, E2, 0x88);
+		t[m + 4] = _mm512_shuffle_i32x4(E0, E2, 0xDD);
+		t[m + 8] = _mm512_shuffle_i32x4(E1, E3, 0x88);
+		t[m + 12] = _mm512_shuffle_i32x4(E1, E3, 0xDD);
+	}
+}
+
+#include "crypto_scrypt_smix_lanes_template.h"
+
+#endif /* CPUSUPPORT_X86_AVX512VL */
@@ -0,0 +1,17 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_LANES_AVX512_H_
+#define _CRYPTO_SCRYPT_SMIX_LANES_AVX512_H_
+
+/**
+ * crypto_scrypt_smix_lanes_avx512(B, r, N, V, XY):
+ * Compute B[l] = SMix_r(B[l], N) for l = 0 ... 15.  Each B[l] must be
+ * 128r bytes in length; the temporary storage V must be 128rN * 16 bytes in
+ * length; the temporary storage XY must be (256r + 64) * 16 bytes in length.
+ * The value N must be a power of 2 greater than 1.  The arrays V and XY must
+ * be aligned to a multiple of 64 bytes.
+ *
+ * Use AVX-512 instructions to compute 16 independent hashes at once.
+ */
+void crypto_scrypt_smix_lanes_avx512(uint8_t * [16], size_t, uint64_t, void *,
+    void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_LANES_AVX512_H_ */
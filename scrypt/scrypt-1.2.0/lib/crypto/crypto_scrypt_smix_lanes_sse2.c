@@ -0,0 +1,69 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_SSE2
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_lanes_sse2.h"
+
+#define LANES 4
+#define lvec __m128i
+#define LADD(a, b) _mm_add_epi32((a), (b))
+#define LXOR(a, b) _mm_xor_si128((a), (b))
+#define LROTL(a, n) \
+	_mm_or_si128(_mm_slli_epi32((a), (n)), _mm_srli_epi32((a), 32 - (n)))
+#define SMIX_LANES crypto_scrypt_smix_lanes_sse2
+#define LTRANSPOSE(t) ltranspose(t)
+
+/**
+ * ltranspose(t):
+ * Transpose the 4 x 4 matrix of 32-bit words held in ${t}.
+ */
+static inline void
+ltranspose(__m128i t[4])
+{
+	__m128i T0, T1, T2, T3;
+
+	T0 = _mm_unpacklo_epi32(t[0], t[1]);
+	T1 = _mm_unpacklo_epi32(t[2], t[3]);
+	T2 = _mm_unpackhi_epi32(t[0], t[1]);
+	T3 = _mm_unpackhi_epi32(t[2], t[3]);
+	t[0] = _mm_unpacklo_epi64(T0, T1);
+	t[1] = _mm_unpackhi_epi64(T0, T1);
+	t[2] = _mm_unpacklo_epi64(T2, T3);
+	t[3] = _mm_unpackhi_epi64(T2, T3);
+}
+
+#include "crypto_scrypt_smix_lanes_template.h"
+
+#endif /* CPUSUPPORT_X86_SSE2 */
@@ -0,0 +1,17 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_LANES_SSE2_H_
+#define _CRYPTO_SCRYPT_SMIX_LANES_SSE2_H_
+
+/**
+ * crypto_scrypt_smix_lanes_sse2(B, r, N, V, XY):
+ * Compute B[l] = SMix_r(B[l], N) for l = 0 ... 3.  Each B[l] must be
+ * 128r bytes in length; the temporary storage V must be 128rN * 4 bytes in
+ * length; the temporary storage XY must be (256r + 64) * 4 bytes in length.
+ * The value N must be a power of 2 greater than 1.  The arrays V and XY must
+ * be aligned to a multiple of 64 bytes.
+ *
+ * Use SSE2 instructions to compute 4 independent hashes at once.
+ */
+void crypto_scrypt_smix_lanes_sse2(uint8_t * [4], size_t, uint64_t, void *,
+    void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_LANES_SSE2_H_ */
@@ -0,0 +1,271 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+
+/*
+ * Multi-lane smix, shared by the SIMD lane kernels.  Before including this
+ * file, the including source file must define:
+ *   LANES		- the number of 32-bit lanes in a vector;
+ *   lvec		- the vector type;
+ *   LADD(a, b)	- lane-wise 32-bit addition;
+ *   LXOR(a, b)	- lane-wise XOR;
+ *   LROTL(a, n)	- lane-wise 32-bit left rotation by a constant;
+ *   LTRANSPOSE(t)	- transpose, in place, the LANES x LANES matrix of
+ *			  32-bit words held in the vectors t[0 ... LANES - 1];
+ *   SMIX_LANES	- the name of the function to define.
+ *
+ * Lane l of every vector holds one word of hash number l, so the salsa20/8
+ * cores of LANES independent hashes run side by side in the same
+ * instructions.  X and Y are stored word-major (word w of lane l is at
+ * X32[w * LANES + l]) while each lane keeps its own V in the canonical
+ * word order, so that the random V_j reads of one lane stay within one
+ * contiguous 128r-byte block.  Moving a block between the two layouts is
+ * done LANES words at a time with an in-register transpose, so that V is
+ * only ever written and read with whole-vector stores and loads.
+ */
+
+static void salsa20_8_lanes(lvec[16]);
+static void blockmix_salsa8_lanes(const lvec *, lvec *, lvec *, size_t);
+static uint64_t integerify_lane(const uint32_t *, size_t, size_t);
+static void blkcpy_to_lanes(uint32_t * [LANES], uint64_t, const lvec *,
+    size_t);
+static void blkxor_from_lanes(lvec *, uint32_t * [LANES], size_t, uint64_t);
+
+/**
+ * salsa20_8_lanes(B):
+ * Apply the salsa20/8 core to each of the LANES blocks held in ${B}.
+ */
+static void
+salsa20_8_lanes(lvec B[16])
+{
+	lvec x[16];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i];
+	for (i = 0; i < 8; i += 2) {
+#define R(a, b, c, n) a = LXOR(a, LROTL(LADD(b, c), n))
+		/* Operate on columns. */
+		R(x[ 4], x[ 0], x[12], 7);  R(x[ 8], x[ 4], x[ 0], 9);
+		R(x[12], x[ 8], x[ 4],13);  R(x[ 0], x[12], x[ 8],18);
+
+		R(x[ 9], x[ 5], x[ 1], 7);  R(x[13], x[ 9], x[ 5], 9);
+		R(x[ 1], x[13], x[ 9],13);  R(x[ 5], x[ 1], x[13],18);
+
+		R(x[14], x[10], x[ 6], 7);  R(x[ 2], x[14], x[10], 9);
+		R(x[ 6], x[ 2], x[14],13);  R(x[10], x[ 6], x[ 2],18);
+
+		R(x[ 3], x[15], x[11], 7);  R(x[ 7], x[ 3], x[15], 9);
+		R(x[11], x[ 7], x[ 3],13);  R(x[15], x[11], x[ 7],18);
+
+		/* Operate on rows. */
+		R(x[ 1], x[ 0], x[ 3], 7);  R(x[ 2], x[ 1], x[ 0], 9);
+		R(x[ 3], x[ 2], x[ 1],13);  R(x[ 0], x[ 3], x[ 2],18);
+
+		R(x[ 6], x[ 5], x[ 4], 7);  R(x[ 7], x[ 6], x[ 5], 9);
+		R(x[ 4], x[ 7], x[ 6],13);  R(x[ 5], x[ 4], x[ 7],18);
+
+		R(x[11], x[10], x[ 9], 7);  R(x[ 8], x[11], x[10], 9);
+		R(x[ 9], x[ 8], x[11],13);  R(x[10], x[ 9], x[ 8],18);
+
+		R(x[12], x[15], x[14], 7);  R(x[13], x[12], x[15], 9);
+		R(x[14], x[13], x[12],13);  R(x[15], x[14], x[13],18);
+#undef R
+	}
+	for (i = 0; i < 16; i++)
+		B[i] = LADD(B[i], x[i]);
+}
+
+/**
+ * blockmix_salsa8_lanes(Bin, Bout, X, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin) in each lane.  The input Bin
+ * must be 128r * LANES bytes in length; the output Bout must also be the
+ * same size.  The temporary space X must be 64 * LANES bytes.
+ */
+static void
+blockmix_salsa8_lanes(const lvec * Bin, lvec * Bout, lvec * X, size_t r)
+{
+	size_t i, k;
+
+	/* 1: X <-- B_{2r - 1} */
+	for (k = 0; k < 16; k++)
+		X[k] = Bin[(2 * r - 1) * 16 + k];
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < 2 * r; i += 2) {
+		/* 3: X <-- H(X \xor B_i) */
+		for (k = 0; k < 16; k++)
+			X[k] = LXOR(X[k], Bin[i * 16 + k]);
+		salsa20_8_lanes(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		for (k = 0; k < 16; k++)
+			Bout[i * 8 + k] = X[k];
+
+		/* 3: X <-- H(X \xor B_i) */
+		for (k = 0; k < 16; k++)
+			X[k] = LXOR(X[k], Bin[i * 16 + 16 + k]);
+		salsa20_8_lanes(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		for (k = 0; k < 16; k++)
+			Bout[i * 8 + r * 16 + k] = X[k];
+	}
+}
+
+/**
+ * integerify_lane(X32, r, l):
+ * Return the result of parsing B_{2r-1} of lane ${l} as a little-endian
+ * integer.
+ */
+static uint64_t
+integerify_lane(const uint32_t * X32, size_t r, size_t l)
+{
+	const uint32_t * X = &X32[(2 * r - 1) * 16 * LANES];
+
+	return (((uint64_t)(X[LANES + l]) << 32) + X[l]);
+}
+
+/**
+ * blkcpy_to_lanes(Vl, i, X, r):
+ * Copy block X into block V_i of every lane, converting from the word-major
+ * lane layout to each lane's canonical word order.
+ */
+static void
+blkcpy_to_lanes(uint32_t * Vl[LANES], uint64_t i, const lvec * X, size_t r)
+{
+	lvec T[LANES];
+	size_t k, l;
+
+	for (k = 0; k < 32 * r; k += LANES) {
+		for (l = 0; l < LANES; l++)
+			T[l] = X[k + l];
+		LTRANSPOSE(T);
+		for (l = 0; l < LANES; l++)
+			*(lvec *)&Vl[l][i * (32 * r) + k] = T[l];
+	}
+}
+
+/**
+ * blkxor_from_lanes(X, Vl, r, N):
+ * Compute j <-- Integerify(X) mod N and X <-- X \xor V_j in every lane.
+ * The V_j blocks of all lanes are prefetched before any of them is read, so
+ * that the LANES random reads are in flight at the same time.
+ */
+static void
+blkxor_from_lanes(lvec * X, uint32_t * Vl[LANES], size_t r, uint64_t N)
+{
+	const uint32_t * X32 = (const void *)X;
+	const uint32_t * Vj[LANES];
+	lvec T[LANES];
+	size_t k, l;
+
+	/* 7: j <-- Integerify(X) mod N */
+	for (l = 0; l < LANES; l++) {
+		Vj[l] = &Vl[l][(integerify_lane(X32, r, l) & (N - 1)) *
+		    (32 * r)];
+		for (k = 0; k < 128 * r; k += 64)
+			_mm_prefetch((const char *)Vj[l] + k, _MM_HINT_T0);
+	}
+
+	/* 8: X <-- X \xor V_j */
+	for (k = 0; k < 32 * r; k += LANES) {
+		for (l = 0; l < LANES; l++)
+			T[l] = *(const lvec *)&Vj[l][k];
+		LTRANSPOSE(T);
+		for (l = 0; l < LANES; l++)
+			X[k + l] = LXOR(X[k + l], T[l]);
+	}
+}
+
+/**
+ * SMIX_LANES(B, r, N, V, XY):
+ * Compute B[l] = SMix_r(B[l], N) for l = 0 ... LANES - 1.  Each B[l] must
+ * be 128r bytes in length; the temporary storage V must be 128rN * LANES
+ * bytes in length; the temporary storage XY must be (256r + 64) * LANES
+ * bytes in length.  The value N must be a power of 2 greater than 1.  The
+ * arrays V and XY must be aligned to a multiple of 64 bytes.
+ */
+void
+SMIX_LANES(uint8_t * B[LANES], size_t r, uint64_t N, void * _V, void * XY)
+{
+	lvec * X = XY;
+	lvec * Y = (void *)((uint8_t *)(XY) + 128 * r * LANES);
+	lvec * Z = (void *)((uint8_t *)(XY) + 256 * r * LANES);
+	uint32_t * X32 = (void *)X;
+	uint32_t * V = _V;
+	uint32_t * Vl[LANES];
+	uint64_t i;
+	size_t k, l;
+
+	/* Each lane uses its own 128rN-byte slice of V. */
+	for (l = 0; l < LANES; l++)
+		Vl[l] = &V[l * (32 * r) * N];
+
+	/* 1: X <-- B */
+	for (k = 0; k < 32 * r; k++) {
+		for (l = 0; l < LANES; l++)
+			X32[k * LANES + l] = le32dec(&B[l][4 * k]);
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 3: V_i <-- X */
+		blkcpy_to_lanes(Vl, i, X, r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8_lanes(X, Y, Z, r);
+
+		/* 3: V_i <-- X */
+		blkcpy_to_lanes(Vl, i + 1, Y, r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8_lanes(Y, X, Z, r);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor_from_lanes(X, Vl, r, N);
+		blockmix_salsa8_lanes(X, Y, Z, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor_from_lanes(Y, Vl, r, N);
+		blockmix_salsa8_lanes(Y, X, Z, r);
+	}
+
+	/* 10: B' <-- X */
+	for (k = 0; k < 32 * r; k++) {
+		for (l = 0; l < LANES; l++)
+			le32enc(&B[l][4 * k], X32[k * LANES + l]);
+	}
+}
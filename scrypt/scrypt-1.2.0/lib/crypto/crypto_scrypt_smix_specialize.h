@@ -0,0 +1,53 @@
+#ifndef _CRYPTO_SCRYPT_SMIX_SPECIALIZE_H_
+#define _CRYPTO_SCRYPT_SMIX_SPECIALIZE_H_
+
+/*
+ * SMIX_INLINE forces a function into its caller, so that an smix body and
+ * the blockmix it calls are compiled afresh for every value of r passed by
+ * SMIX_SPECIALIZE.  SMIX_UNROLL asks for the loop which follows it to be
+ * fully unrolled once its trip count is a compile-time constant.
+ */
+#if defined(__clang__)
+#define SMIX_INLINE static inline __attribute__((always_inline))
+#define SMIX_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define SMIX_INLINE static inline __attribute__((always_inline))
+#if (__GNUC__ >= 8)
+#define SMIX_UNROLL _Pragma("GCC unroll 16")
+#else
+#define SMIX_UNROLL
+#endif
+#elif defined(_MSC_VER)
+#define SMIX_INLINE static __forceinline
+#define SMIX_UNROLL
+#else
+#define SMIX_INLINE static inline
+#define SMIX_UNROLL
+#endif
+
+/**
+ * SMIX_SPECIALIZE(smix, B, r, N, V, XY, pos, steps):
+ * Call smix(B, r, N, V, XY, pos, steps), where smix is an SMIX_INLINE
+ * function, with ${r} replaced by a constant when it is one of the common
+ * values 1, 8 or 16.  The blockmix loops of those copies are unrolled and
+ * their block offsets folded into the instructions; any other r uses the
+ * generic copy.
+ */
+#define SMIX_SPECIALIZE(smix, B, r, N, V, XY, pos, steps) do {		\
+	switch (r) {							\
+	case 1:								\
+		smix(B, 1, N, V, XY, pos, steps);			\
+		break;							\
+	case 8:								\
+		smix(B, 8, N, V, XY, pos, steps);			\
+		break;							\
+	case 16:							\
+		smix(B, 16, N, V, XY, pos, steps);			\
+		break;							\
+	default:							\
+		smix(B, r, N, V, XY, pos, steps);			\
+		break;							\
+	}								\
+} while (0)
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_SPECIALIZE_H_ */
@@ -35,14 +35,15 @@
 #include "sysendian.h"
 
 #include "crypto_scrypt_smix_sse2.h"
+#include "crypto_scrypt_smix_specialize.h"
 
-static void blkcpy(void *, const void *, size_t);
-static void blkxor(void *, const void *, size_t);
-static void salsa20_8(__m128i *);
-static void blockmix_salsa8(const __m128i *, __m128i *, __m128i *, size_t);
-static uint64_t integerify(const void *, size_t);
+SMIX_INLINE void blkcpy(void *, const void *, size_t);
+SMIX_INLINE void blkxor(void *, const void *, size_t);
+static void salsa20_8(__m128i[4]);
+SMIX_INLINE void blockmix_salsa8(const __m128i *, __m128i *, __m128i *, size_t);
+SMIX_INLINE uint64_t integerify(const void *, size_t);
 
-static void
+SMIX_INLINE void
 blkcpy(void * dest, const void * src, size_t len)
 {
 	__m128i * D = dest;
@@ -54,7 +55,7 @@ blkcpy(void * dest, const void * src, size_t len)
 		D[i] = S[i];
 }
 
-static void
+SMIX_INLINE void
 blkxor(void * dest, const void * src, size_t len)
 {
 	__m128i * D = dest;
@@ -134,7 +135,7 @@ salsa20_8(__m128i B[4])
  * bytes in length; the output Bout must also be the same size.  The
  * temporary space X must be 64 bytes.
  */
-static void
+SMIX_INLINE void
 blockmix_salsa8(const __m128i * Bin, __m128i * Bout, __m128i * X, size_t r)
 {
 	size_t i;
@@ -143,6 +144,7 @@ blockmix_salsa8(const __m128i * Bin, __m128i * Bout, __m128i * X, size_t r)
 	blkcpy(X, &Bin[8 * r - 4], 64);
 
 	/* 2: for i = 0 to 2r - 1 do */
+	SMIX_UNROLL
 	for (i = 0; i < r; i++) {
 		/* 3: X <-- H(X \xor B_i) */
 		blkxor(X, &Bin[i * 8], 64);
@@ -166,7 +168,7 @@ blockmix_salsa8(const __m128i * Bin, __m128i * Bout, __m128i * X, size_t r)
  * integerify(B, r):
  * Return the result of parsing B_{2r-1} as a little-endian integer.
  */
-static uint64_t
+SMIX_INLINE uint64_t
 integerify(const void * B, size_t r)
 {
 	const uint32_t * X = (const void *)((uintptr_t)(B) + (2 * r - 1) * 64);
@@ -175,35 +177,34 @@ integerify(const void * B, size_t r)
 }
 
 /**
- * crypto_scrypt_smix_sse2(B, r, N, V, XY):
- * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
- * the temporary storage V must be 128rN bytes in length; the temporary
- * storage XY must be 256r + 64 bytes in length.  The value N must be a
- * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
- * multiple of 64 bytes.
- *
- * Use SSE2 instructions.
+ * smix(B, r, N, V, XY, pos, steps):
+ * The body of crypto_scrypt_smix_sse2, inlined into each of its specializations.
  */
-void
-crypto_scrypt_smix_sse2(uint8_t * B, size_t r, uint64_t N, void * V, void * XY)
+SMIX_INLINE void
+smix(uint8_t * B, size_t r, uint64_t N, void * V, void * XY,
+    uint64_t * pos, uint64_t steps)
 {
 	__m128i * X = XY;
 	__m128i * Y = (void *)((uintptr_t)(XY) + 128 * r);
 	__m128i * Z = (void *)((uintptr_t)(XY) + 256 * r);
 	uint32_t * X32 = (void *)X;
-	uint64_t i, j;
-	size_t k;
+	uint64_t i = *pos;
+	uint64_t end = (steps < 2 * N - i) ? i + steps : 2 * N;
+	uint64_t j;
+	size_t k, w;
 
 	/* 1: X <-- B */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			X32[k * 16 + i] =
-			    le32dec(&B[(k * 16 + (i * 5 % 16)) * 4]);
+	if (i == 0) {
+		for (k = 0; k < 2 * r; k++) {
+			for (w = 0; w < 16; w++) {
+				X32[k * 16 + w] =
+				    le32dec(&B[(k * 16 + (w * 5 % 16)) * 4]);
+			}
 		}
 	}
 
 	/* 2: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i += 2) {
+	for (; (i < N) && (i < end); i += 2) {
 		/* 3: V_i <-- X */
 		blkcpy((void *)((uintptr_t)(V) + i * 128 * r), X, 128 * r);
 
@@ -218,8 +219,8 @@ crypto_scrypt_smix_sse2(uint8_t * B, size_t r, uint64_t N, void * V, void * XY)
 		blockmix_salsa8(Y, X, Z, r);
 	}
 
-	/* 6: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i += 2) {
+	/* 6: for i = 0 to N - 1 do (counted here as N to 2N - 1) */
+	for (; i < end; i += 2) {
 		/* 7: j <-- Integerify(X) mod N */
 		j = integerify(X, r) & (N - 1);
 
@@ -236,12 +237,38 @@ crypto_scrypt_smix_sse2(uint8_t * B, size_t r, uint64_t N, void * V, void * XY)
 	}
 
 	/* 10: B' <-- X */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			le32enc(&B[(k * 16 + (i * 5 % 16)) * 4],
-			    X32[k * 16 + i]);
+	if (i == 2 * N) {
+		for (k = 0; k < 2 * r; k++) {
+			for (w = 0; w < 16; w++) {
+				le32enc(&B[(k * 16 + (w * 5 % 16)) * 4],
+				    X32[k * 16 + w]);
+			}
 		}
 	}
+	*pos = i;
+}
+
+/**
+ * crypto_scrypt_smix_sse2(B, r, N, V, XY, pos, steps):
+ * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
+ * the temporary storage V must be 128rN bytes in length; the temporary
+ * storage XY must be 256r + 64 bytes in length.  The value N must be a
+ * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
+ * multiple of 64 bytes.
+ *
+ * Only do up to ${steps} of the 2N iterations, an even number, starting at
+ * iteration ${*pos}, and advance ${*pos} past them; B holds the result once
+ * ${*pos} reaches 2N.  Start with ${*pos} = 0, and pass the same V and XY to
+ * the same smix kernel until then.
+ *
+ * Use SSE2 instructions.
+ */
+void
+crypto_scrypt_smix_sse2(uint8_t * B, size_t r, uint64_t N, void * V, void * XY,
+    uint64_t * pos, uint64_t steps)
+{
+
+	SMIX_SPECIALIZE(smix, B, r, N, V, XY, pos, steps);
 }
 
 #endif /* CPUSUPPORT_X86_SSE2 */
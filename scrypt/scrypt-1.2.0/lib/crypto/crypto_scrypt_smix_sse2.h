@@ -2,15 +2,21 @@
 #define _CRYPTO_SCRYPT_SMIX_SSE2_H_
 
 /**
- * crypto_scrypt_smix_sse2(B, r, N, V, XY):
+ * crypto_scrypt_smix_sse2(B, r, N, V, XY, pos, steps):
  * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
  * the temporary storage V must be 128rN bytes in length; the temporary
  * storage XY must be 256r + 64 bytes in length.  The value N must be a
  * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
  * multiple of 64 bytes.
  *
+ * Only do up to ${steps} of the 2N iterations, an even number, starting at
+ * iteration ${*pos}, and advance ${*pos} past them; B holds the result once
+ * ${*pos} reaches 2N.  Start with ${*pos} = 0, and pass the same V and XY to
+ * the same smix kernel until then.
+ *
  * Use SSE2 instructions.
  */
-void crypto_scrypt_smix_sse2(uint8_t *, size_t, uint64_t, void *, void *);
+void crypto_scrypt_smix_sse2(uint8_t *, size_t, uint64_t, void *, void *,
+    uint64_t *, uint64_t);
 
 #endif /* !_CRYPTO_SCRYPT_SMIX_SSE2_H_ */
@@ -35,8 +35,12 @@
 #include "gettimeofday.h"
 #endif /* _MSC_VER */
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
 #include "crypto_scrypt.h"
@@ -188,3 +192,156 @@ scryptenc_cpuperf(double * opps)
 	*opps = i / diffd;
 	return (0);
 }
+
+/* Most samples and threads scryptenc_cpuperf_sampled takes. */
+#define SAMPLE_MAX	64
+#define SAMPLE_THREADS_MAX	1024
+
+/* One of the scrypt computations of a round. */
+struct sample_thread {
+#ifdef HAVE_PTHREAD
+	pthread_t thr;
+#endif
+	uint64_t N;
+	uint32_t r;
+	int rc;
+};
+
+static void *
+sample_run(void * cookie)
+{
+	struct sample_thread * T = cookie;
+
+	/* The budget would make the round wait rather than contend. */
+	T->rc = crypto_scrypt_unbudgeted(NULL, 0, NULL, 0, T->N, T->r, 1,
+	    NULL, 0);
+	return (NULL);
+}
+
+/*
+ * Do ${threads} scrypt computations at once, one of them on this thread.
+ * Return 0 on success, or 3 if any of them fails or cannot be started.
+ */
+static int
+sample_round(struct sample_thread * T, unsigned int threads)
+{
+	unsigned int t, started;
+	int rc = 0;
+
+	/* Start the other threads. */
+	for (started = 1; started < threads; started++) {
+#ifdef HAVE_PTHREAD
+		if (pthread_create(&T[started].thr, NULL, sample_run,
+		    &T[started])) {
+			rc = 3;
+			break;
+		}
+#endif
+	}
+
+	/* Do our own, then wait for theirs. */
+	sample_run(&T[0]);
+	if (T[0].rc)
+		rc = 3;
+	for (t = 1; t < started; t++) {
+#ifdef HAVE_PTHREAD
+		if (pthread_join(T[t].thr, NULL) || T[t].rc)
+			rc = 3;
+#endif
+	}
+
+	return (rc);
+}
+
+int
+scryptenc_cpuperf_sampled(uint64_t N, uint32_t r, unsigned int threads,
+    unsigned int samples, double * opps, double * spread)
+{
+	struct sample_thread * T;
+	struct timespec st;
+	double resd, diffd;
+	double rate[SAMPLE_MAX];
+	double t;
+	unsigned int i, j;
+
+	/* Sanity-check the number of samples and threads. */
+	if ((samples == 0) || (samples > SAMPLE_MAX))
+		return (1);
+	if ((threads == 0) || (threads > SAMPLE_THREADS_MAX))
+		return (1);
+#ifndef HAVE_PTHREAD
+	/* Without threads there is no contention to measure. */
+	threads = 1;
+#endif
+
+	/* Get the clock resolution. */
+	if (getclockres(&resd))
+		return (2);
+
+	/* Allocate the threads' state. */
+	if ((T = malloc(threads * sizeof(struct sample_thread))) == NULL)
+		return (1);
+	for (i = 0; i < threads; i++) {
+		T[i].N = N;
+		T[i].r = r;
+	}
+
+	/*
+	 * Do one untimed round first, so that none of the timed ones pays for
+	 * mapping scratch memory or for cold caches.
+	 */
+	if (sample_round(T, threads))
+		goto err3;
+
+	/* Time each round on its own. */
+	for (i = 0; i < samples; i++) {
+		if (getclocktime(&st))
+			goto err2;
+		if (sample_round(T, threads))
+			goto err3;
+		if (getclockdiff(&st, &diffd))
+			goto err2;
+
+		/*
+		 * Each scrypt invoked the salsa20/8 core 4Nr times in the time
+		 * the slowest of them took.
+		 */
+		if (diffd < resd)
+			diffd = resd;
+		rate[i] = (4.0 * N * r) / diffd;
+	}
+	free(T);
+
+	/* Sort the rates, so that the median and quartiles can be read off. */
+	for (i = 1; i < samples; i++) {
+		t = rate[i];
+		for (j = i; (j > 0) && (rate[j - 1] > t); j--)
+			rate[j] = rate[j - 1];
+		rate[j] = t;
+	}
+
+#ifdef DEBUG
+	fprintf(stderr, "N = %ju, r = %u, %u threads, %u samples: "
+	    "%f to %f salsa20/8 cores per second\n",
+	    (uintmax_t)N, r, threads, samples, rate[0], rate[samples - 1]);
+#endif
+
+	/*
+	 * The median is not moved by a few samples which another process or a
+	 * frequency change slowed down; the interquartile range says how
+	 * noisy the samples were.
+	 */
+	if (samples % 2)
+		*opps = rate[samples / 2];
+	else
+		*opps = (rate[samples / 2 - 1] + rate[samples / 2]) / 2;
+	*spread = (rate[(3 * samples) / 4] - rate[samples / 4]) / *opps;
+	return (0);
+
+err3:
+	free(T);
+	return (3);
+err2:
+	free(T);
+	return (2);
+}
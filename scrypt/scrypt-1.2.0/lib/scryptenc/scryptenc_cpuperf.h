@@ -29,6 +29,8 @@
 #ifndef _SCRYPTENC_CPUPERF_H_
 #define _SCRYPTENC_CPUPERF_H_
 
+#include <stdint.h>
+
 /**
  * scryptenc_cpuperf(opps):
  * Estimate the number of salsa20/8 cores which can be executed per second,
@@ -36,4 +38,18 @@
  */
 int scryptenc_cpuperf(double *);
 
+/**
+ * scryptenc_cpuperf_sampled(N, r, threads, samples, opps, spread):
+ * Estimate the number of salsa20/8 cores which can be executed per second
+ * by each of ${threads} scrypt computations with parameters ${N}, ${r} and
+ * p = 1 running at once, contending for caches and memory bandwidth but
+ * not waiting for the memory budget (see crypto_scrypt_unbudgeted), as the
+ * median of ${samples} timed rounds of them, and return the value via opps;
+ * return the interquartile range of the samples, as a fraction of the
+ * median, via spread.  At most 64 samples and 1024 threads may be used;
+ * without pthreads, only one computation runs at a time.
+ */
+int scryptenc_cpuperf_sampled(uint64_t, uint32_t, unsigned int,
+    unsigned int, double *, double *);
+
 #endif /* !_SCRYPTENC_CPUPERF_H_ */
@@ -2,11 +2,19 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "cpusupport.h"
 #include "insecure_memzero.h"
+#include "sha256_avx2.h"
+#include "sha256_shani.h"
 #include "sysendian.h"
+#include "warnp.h"
 
 #include "sha256.h"
 
+#ifdef CPUSUPPORT_X86_SHANI
+static int useshani(void);
+#endif
+
 /*
  * Encode a length len/4 vector of (uint32_t) into a length len vector of
  * (uint8_t) in big-endian form.  Assumes len is a multiple of 4.
@@ -68,10 +76,11 @@ be32dec_vect(uint32_t * dst, const uint8_t * src, size_t len)
 
 /*
  * SHA256 block compression function.  The 256-bit state is transformed via
- * the 512-bit input block to produce a new state.
+ * the 512-bit input block to produce a new state.  This is the portable code,
+ * against which the accelerated transforms are checked.
  */
 static void
-SHA256_Transform(uint32_t * state, const uint8_t block[64])
+SHA256_Transform_generic(uint32_t * state, const uint8_t block[64])
 {
 	uint32_t W[64];
 	uint32_t S[8];
@@ -163,6 +172,133 @@ SHA256_Transform(uint32_t * state, const uint8_t block[64])
 	insecure_memzero(&t1, sizeof(uint32_t));
 }
 
+/*
+ * SHA256 block compression function, using the SHA-NI instructions if they
+ * are available and work.
+ */
+static void
+SHA256_Transform(uint32_t * state, const uint8_t block[64])
+{
+
+#ifdef CPUSUPPORT_X86_SHANI
+	/* Use the SHA-NI instructions if we can. */
+	if (useshani()) {
+		SHA256_Transform_shani(state, block);
+		return;
+	}
+#endif
+
+	/* Otherwise use the portable code. */
+	SHA256_Transform_generic(state, block);
+}
+
+/* Magic initialization constants. */
+static const uint32_t initstate[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+#ifdef CPUSUPPORT_X86_SHANI
+/**
+ * SHA256_Buf_with(transform, in, len, digest):
+ * Compute the SHA256 hash of ${len} bytes from ${in} and write it to
+ * ${digest}, compressing every block with ${transform}.  The value ${len}
+ * must be less than 256.
+ */
+static void
+SHA256_Buf_with(void (*transform)(uint32_t *, const uint8_t *),
+    const uint8_t * in, size_t len, uint8_t digest[32])
+{
+	uint8_t block[128];
+	uint32_t state[8];
+	size_t i, r, plen;
+
+	/* Whole blocks. */
+	memcpy(state, initstate, sizeof(initstate));
+	for (i = 0; i + 64 <= len; i += 64)
+		transform(state, &in[i]);
+
+	/* Left-over bytes, padding, and the bit count in one or two blocks. */
+	r = len - i;
+	plen = (r < 56) ? 64 : 128;
+	memcpy(block, &in[i], r);
+	block[r] = 0x80;
+	memset(&block[r + 1], 0, plen - 8 - (r + 1));
+	be64enc(&block[plen - 8], (uint64_t)len << 3);
+	for (i = 0; i < plen; i += 64)
+		transform(state, &block[i]);
+
+	/* Write the hash. */
+	be32enc_vect(digest, state, 32);
+}
+
+/**
+ * useshani(void):
+ * Return nonzero if SHA256_Transform should use the SHA-NI instructions.  The
+ * answer is worked out on the first call, by checking that the CPU supports
+ * them, that they compute SHA256("abc") correctly, and that they agree with
+ * the portable code on messages of every length up to 200 bytes.
+ */
+static int
+useshani(void)
+{
+	static int shani = -1;
+	static const uint32_t abcstate[8] = {
+		0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+		0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad
+	};
+	uint8_t block[64];
+	uint32_t state[8];
+	uint8_t msg[200];
+	uint8_t hbuf[32];
+	uint8_t hbuf_generic[32];
+	size_t i;
+
+	/* Have we already decided? */
+	if (shani != -1)
+		return (shani);
+
+	/* Does the CPU support the instructions? */
+	if (!cpusupport_x86_shani()) {
+		shani = 0;
+		return (shani);
+	}
+
+	/* Hash the padded message "abc" and compare with the known answer. */
+	memset(block, 0, 64);
+	memcpy(block, "abc", 3);
+	block[3] = 0x80;
+	block[63] = 24;
+	memcpy(state, initstate, sizeof(initstate));
+	SHA256_Transform_shani(state, block);
+	if (memcmp(state, abcstate, sizeof(abcstate)))
+		goto broken;
+
+	/*
+	 * Hash messages which end anywhere in their first, second, or third
+	 * block, so that the padding spills into a new block for some of
+	 * them, and compare with the portable code.
+	 */
+	for (i = 0; i < sizeof(msg); i++)
+		msg[i] = (uint8_t)(i * 7 + 1);
+	for (i = 0; i <= sizeof(msg); i++) {
+		SHA256_Buf_with(SHA256_Transform_shani, msg, i, hbuf);
+		SHA256_Buf_with(SHA256_Transform_generic, msg, i, hbuf_generic);
+		if (memcmp(hbuf, hbuf_generic, 32))
+			goto broken;
+	}
+
+	/* The instructions work. */
+	shani = 1;
+	return (shani);
+
+broken:
+	warn0("Disabling broken SHA-NI SHA256 support - please report bug!");
+	shani = 0;
+	return (shani);
+}
+#endif
+
 static uint8_t PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -192,12 +328,6 @@ SHA256_Pad(SHA256_CTX * ctx)
 	SHA256_Update(ctx, len, 8);
 }
 
-/* Magic initialization constants. */
-static const uint32_t initstate[8] = {
-	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
-	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
-};
-
 /**
  * SHA256_Init(ctx):
  * Initialize the SHA256 context ${ctx}.
@@ -330,6 +460,40 @@ HMAC_SHA256_Init(HMAC_SHA256_CTX * ctx, const void * _K, size_t Klen)
 	insecure_memzero(pad, 64);
 }
 
+/**
+ * HMAC_SHA256_Key(key, K, Klen):
+ * Compute the HMAC-SHA256 key schedule ${key} for ${Klen} bytes of key from
+ * ${K}, so that the key can be used many times without being absorbed again.
+ */
+void
+HMAC_SHA256_Key(HMAC_SHA256_KEY * key, const void * K, size_t Klen)
+{
+	HMAC_SHA256_CTX ctx;
+
+	/* Absorb the padded key into the inner and outer states. */
+	HMAC_SHA256_Init(&ctx, K, Klen);
+	memcpy(key->istate, ctx.ictx.state, sizeof(key->istate));
+	memcpy(key->ostate, ctx.octx.state, sizeof(key->ostate));
+
+	/* Clean the stack. */
+	insecure_memzero(&ctx, sizeof(HMAC_SHA256_CTX));
+}
+
+/**
+ * HMAC_SHA256_Init_key(ctx, key):
+ * Initialize the HMAC-SHA256 context ${ctx} with the key schedule ${key}.
+ */
+void
+HMAC_SHA256_Init_key(HMAC_SHA256_CTX * ctx, const HMAC_SHA256_KEY * key)
+{
+
+	/* Each state has absorbed exactly one block of padded key. */
+	memcpy(ctx->ictx.state, key->istate, sizeof(key->istate));
+	ctx->ictx.count = 512;
+	memcpy(ctx->octx.state, key->ostate, sizeof(key->ostate));
+	ctx->octx.count = 512;
+}
+
 /**
  * HMAC_SHA256_Update(ctx, in, len):
  * Input ${len} bytes from ${in} into the HMAC-SHA256 context ${ctx}.
@@ -381,6 +545,159 @@ HMAC_SHA256_Buf(const void * K, size_t Klen, const void * in, size_t len,
 	HMAC_SHA256_Final(digest, &ctx);
 }
 
+#ifdef CPUSUPPORT_X86_AVX2
+/**
+ * PBKDF2_SHA256_8way(PShctx, i, U):
+ * Compute U_1 = PRF(P, S || INT(i + 1 + l)) into ${U}[l] for l = 0 ... 7,
+ * where ${PShctx} is the HMAC state after processing P and S.  The eight
+ * inner and eight outer hashes are each finished together.
+ */
+static void
+PBKDF2_SHA256_8way(const HMAC_SHA256_CTX * PShctx, size_t i,
+    uint8_t U[8][32])
+{
+	uint32_t states[8][8];
+	uint8_t blocks[8][128];
+	const uint8_t * bp[8];
+	size_t r, len, b, l;
+
+	/* Bytes of S left in the buffer, and blocks needed to finish. */
+	r = (PShctx->ictx.count >> 3) & 0x3f;
+	len = (r + 4 + 1 + 8 > 64) ? 128 : 64;
+
+	/* Inner hash: buffered bytes || INT(i + 1 + l) || padding. */
+	for (l = 0; l < 8; l++) {
+		memcpy(blocks[l], PShctx->ictx.buf, r);
+		be32enc(&blocks[l][r], (uint32_t)(i + 1 + l));
+		blocks[l][r + 4] = 0x80;
+		memset(&blocks[l][r + 5], 0, len - 8 - (r + 5));
+		be64enc(&blocks[l][len - 8], PShctx->ictx.count + 32);
+		memcpy(states[l], PShctx->ictx.state, 32);
+	}
+	for (b = 0; b < len; b += 64) {
+		for (l = 0; l < 8; l++)
+			bp[l] = &blocks[l][b];
+		SHA256_Transform8_avx2(states, bp);
+	}
+
+	/* Outer hash: inner hash || padding. */
+	for (l = 0; l < 8; l++) {
+		be32enc_vect(blocks[l], states[l], 32);
+		blocks[l][32] = 0x80;
+		memset(&blocks[l][33], 0, 64 - 8 - 33);
+		be64enc(&blocks[l][56], PShctx->octx.count + 256);
+		memcpy(states[l], PShctx->octx.state, 32);
+		bp[l] = blocks[l];
+	}
+	SHA256_Transform8_avx2(states, bp);
+
+	/* Write out U_1 for each lane. */
+	for (l = 0; l < 8; l++)
+		be32enc_vect(U[l], states[l], 32);
+
+	/* Clean the stack. */
+	insecure_memzero(states, sizeof(states));
+	insecure_memzero(blocks, sizeof(blocks));
+}
+
+/**
+ * use8way(void):
+ * Return nonzero if PBKDF2_SHA256 should compute eight blocks at once with
+ * SHA256_Transform8_avx2.  The answer is worked out on the first call, by
+ * checking that the CPU supports AVX2, that SHA256_Transform8_avx2 agrees
+ * with SHA256_Transform on eight different blocks, and that
+ * PBKDF2_SHA256_8way agrees with HMAC_SHA256_Buf for a key longer than a
+ * block and salts of every length up to 71 bytes, so that the inner hash is
+ * finished in one block for some of them and two blocks for the others.
+ * CPUs with SHA-NI are faster one block at a time, so they never take the
+ * eight-way path.
+ */
+static int
+use8way(void)
+{
+	static int avx2 = -1;
+	HMAC_SHA256_KEY Pkey;
+	HMAC_SHA256_CTX PShctx;
+	uint8_t blocks[8][64];
+	const uint8_t * bp[8];
+	uint32_t states[8][8];
+	uint32_t state[8];
+	uint8_t key[100];
+	uint8_t salt[72 + 4];
+	uint8_t U8[8][32];
+	uint8_t U[32];
+	size_t i, l, saltlen;
+
+	/* Have we already decided? */
+	if (avx2 != -1)
+		return (avx2);
+
+	/* Does the CPU support the instructions, and are they worth it? */
+	if (!cpusupport_x86_avx2()) {
+		avx2 = 0;
+		return (avx2);
+	}
+#ifdef CPUSUPPORT_X86_SHANI
+	if (useshani()) {
+		avx2 = 0;
+		return (avx2);
+	}
+#endif
+
+	/* Give every lane its own block and starting state. */
+	for (l = 0; l < 8; l++) {
+		for (i = 0; i < 64; i++)
+			blocks[l][i] = (uint8_t)(l * 64 + i);
+		for (i = 0; i < 8; i++)
+			states[l][i] = initstate[i] ^ (uint32_t)(l << i);
+		bp[l] = blocks[l];
+	}
+	SHA256_Transform8_avx2(states, bp);
+
+	/* Check each lane against the one-block transform. */
+	for (l = 0; l < 8; l++) {
+		for (i = 0; i < 8; i++)
+			state[i] = initstate[i] ^ (uint32_t)(l << i);
+		SHA256_Transform(state, blocks[l]);
+		if (memcmp(state, states[l], sizeof(state)))
+			goto broken;
+	}
+
+	/*
+	 * Compute U_1 for output blocks 251 ... 258, whose indices carry into
+	 * a second byte, with the cached key schedule and the eight-way code,
+	 * and compare each with the HMAC computed from the raw key.
+	 */
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (uint8_t)(i * 3 + 5);
+	for (i = 0; i < sizeof(salt); i++)
+		salt[i] = (uint8_t)(i * 7 + 1);
+	HMAC_SHA256_Key(&Pkey, key, sizeof(key));
+	for (saltlen = 0; saltlen < 72; saltlen++) {
+		HMAC_SHA256_Init_key(&PShctx, &Pkey);
+		HMAC_SHA256_Update(&PShctx, salt, saltlen);
+		PBKDF2_SHA256_8way(&PShctx, 250, U8);
+		for (l = 0; l < 8; l++) {
+			be32enc(&salt[saltlen], (uint32_t)(250 + 1 + l));
+			HMAC_SHA256_Buf(key, sizeof(key), salt, saltlen + 4, U);
+			if (memcmp(U, U8[l], 32))
+				goto broken;
+		}
+		for (i = saltlen; i < saltlen + 4; i++)
+			salt[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	/* The eight-way code works. */
+	avx2 = 1;
+	return (avx2);
+
+broken:
+	warn0("Disabling broken AVX2 SHA256 support - please report bug!");
+	avx2 = 0;
+	return (avx2);
+}
+#endif
+
 /**
  * PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
  * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, and
@@ -389,6 +706,45 @@ HMAC_SHA256_Buf(const void * K, size_t Klen, const void * in, size_t len,
 void
 PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
     size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+	HMAC_SHA256_KEY Pkey;
+
+	/* Absorb the password once, then derive the key from it. */
+	HMAC_SHA256_Key(&Pkey, passwd, passwdlen);
+	PBKDF2_SHA256_key(&Pkey, salt, saltlen, c, buf, dkLen);
+
+	/* Clean the stack. */
+	insecure_memzero(&Pkey, sizeof(HMAC_SHA256_KEY));
+}
+
+/**
+ * PBKDF2_SHA256_key(key, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, where
+ * ${key} is the HMAC-SHA256 key schedule for passwd, and write the output to
+ * buf.  The value dkLen must be at most 32 * (2^32 - 1).
+ */
+void
+PBKDF2_SHA256_key(const HMAC_SHA256_KEY * key, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+
+	/* Sanity-check. */
+	assert(dkLen <= 32 * (size_t)(UINT32_MAX));
+
+	/* Compute the whole output. */
+	PBKDF2_SHA256_key_at(key, salt, saltlen, c, 0, buf, dkLen);
+}
+
+/**
+ * PBKDF2_SHA256_key_at(key, salt, saltlen, c, first, buf, buflen):
+ * Compute bytes 32 * ${first} ... 32 * ${first} + ${buflen} - 1 of the output
+ * of PBKDF2_SHA256_key(key, salt, saltlen, c, ...), and write them to buf.
+ * The output blocks are independent, so disjoint ranges may be computed
+ * separately.  The value ${first} + ${buflen} / 32 must be at most 2^32 - 1.
+ */
+void
+PBKDF2_SHA256_key_at(const HMAC_SHA256_KEY * key, const uint8_t * salt,
+    size_t saltlen, uint64_t c, size_t first, uint8_t * buf, size_t buflen)
 {
 	HMAC_SHA256_CTX PShctx, hctx;
 	size_t i;
@@ -398,18 +754,32 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 	uint64_t j;
 	int k;
 	size_t clen;
+#ifdef CPUSUPPORT_X86_AVX2
+	uint8_t U8[8][32];
+#endif
 
 	/* Sanity-check. */
-	assert(dkLen <= 32 * (size_t)(UINT32_MAX));
+	assert(first <= UINT32_MAX);
+	assert(buflen / 32 <= UINT32_MAX - first);
 
 	/* Compute HMAC state after processing P and S. */
-	HMAC_SHA256_Init(&PShctx, passwd, passwdlen);
+	HMAC_SHA256_Init_key(&PShctx, key);
 	HMAC_SHA256_Update(&PShctx, salt, saltlen);
 
 	/* Iterate through the blocks. */
-	for (i = 0; i * 32 < dkLen; i++) {
+	for (i = 0; i * 32 < buflen; i++) {
+#ifdef CPUSUPPORT_X86_AVX2
+		/* Compute eight whole blocks at once if we can. */
+		if ((c == 1) && (buflen - i * 32 >= 256) && use8way()) {
+			PBKDF2_SHA256_8way(&PShctx, first + i, U8);
+			memcpy(&buf[i * 32], U8, 256);
+			i += 7;
+			continue;
+		}
+#endif
+
 		/* Generate INT(i + 1). */
-		be32enc(ivec, (uint32_t)(i + 1));
+		be32enc(ivec, (uint32_t)(first + i + 1));
 
 		/* Compute U_1 = PRF(P, S || INT(i)). */
 		memcpy(&hctx, &PShctx, sizeof(HMAC_SHA256_CTX));
@@ -421,7 +791,7 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 
 		for (j = 2; j <= c; j++) {
 			/* Compute U_j. */
-			HMAC_SHA256_Init(&hctx, passwd, passwdlen);
+			HMAC_SHA256_Init_key(&hctx, key);
 			HMAC_SHA256_Update(&hctx, U, 32);
 			HMAC_SHA256_Final(U, &hctx);
 
@@ -431,7 +801,7 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 		}
 
 		/* Copy as many bytes as necessary into buf. */
-		clen = dkLen - i * 32;
+		clen = buflen - i * 32;
 		if (clen > 32)
 			clen = 32;
 		memcpy(&buf[i * 32], T, clen);
@@ -439,4 +809,7 @@ PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
 
 	/* Clean PShctx, since we never called _Final on it. */
 	insecure_memzero(&PShctx, sizeof(HMAC_SHA256_CTX));
+#ifdef CPUSUPPORT_X86_AVX2
+	insecure_memzero(U8, sizeof(U8));
+#endif
 }
@@ -18,6 +18,11 @@
 #define HMAC_SHA256_Final libcperciva_HMAC_SHA256_Final
 #define HMAC_SHA256_Buf libcperciva_HMAC_SHA256_Buf
 #define HMAC_SHA256_CTX libcperciva_HMAC_SHA256_CTX
+#define HMAC_SHA256_KEY libcperciva_HMAC_SHA256_KEY
+#define HMAC_SHA256_Key libcperciva_HMAC_SHA256_Key
+#define HMAC_SHA256_Init_key libcperciva_HMAC_SHA256_Init_key
+#define PBKDF2_SHA256_key libcperciva_PBKDF2_SHA256_key
+#define PBKDF2_SHA256_key_at libcperciva_PBKDF2_SHA256_key_at
 
 /* Context structure for SHA256 operations. */
 typedef struct {
@@ -64,6 +69,28 @@ typedef struct {
  */
 void HMAC_SHA256_Init(HMAC_SHA256_CTX *, const void *, size_t);
 
+/*
+ * Key schedule for HMAC-SHA256 operations: the inner and outer SHA256 states
+ * after absorbing the key xor ipad and the key xor opad respectively.
+ */
+typedef struct {
+	uint32_t istate[8];
+	uint32_t ostate[8];
+} HMAC_SHA256_KEY;
+
+/**
+ * HMAC_SHA256_Key(key, K, Klen):
+ * Compute the HMAC-SHA256 key schedule ${key} for ${Klen} bytes of key from
+ * ${K}, so that the key can be used many times without being absorbed again.
+ */
+void HMAC_SHA256_Key(HMAC_SHA256_KEY *, const void *, size_t);
+
+/**
+ * HMAC_SHA256_Init_key(ctx, key):
+ * Initialize the HMAC-SHA256 context ${ctx} with the key schedule ${key}.
+ */
+void HMAC_SHA256_Init_key(HMAC_SHA256_CTX *, const HMAC_SHA256_KEY *);
+
 /**
  * HMAC_SHA256_Update(ctx, in, len):
  * Input ${len} bytes from ${in} into the HMAC-SHA256 context ${ctx}.
@@ -92,4 +119,23 @@ void HMAC_SHA256_Buf(const void *, size_t, const void *, size_t, uint8_t[32]);
 void PBKDF2_SHA256(const uint8_t *, size_t, const uint8_t *, size_t,
     uint64_t, uint8_t *, size_t);
 
+/**
+ * PBKDF2_SHA256_key(key, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, where
+ * ${key} is the HMAC-SHA256 key schedule for passwd, and write the output to
+ * buf.  The value dkLen must be at most 32 * (2^32 - 1).
+ */
+void PBKDF2_SHA256_key(const HMAC_SHA256_KEY *, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+/**
+ * PBKDF2_SHA256_key_at(key, salt, saltlen, c, first, buf, buflen):
+ * Compute bytes 32 * ${first} ... 32 * ${first} + ${buflen} - 1 of the output
+ * of PBKDF2_SHA256_key(key, salt, saltlen, c, ...), and write them to buf.
+ * The output blocks are independent, so disjoint ranges may be computed
+ * separately.  The value ${first} + ${buflen} / 32 must be at most 2^32 - 1.
+ */
+void PBKDF2_SHA256_key_at(const HMAC_SHA256_KEY *, const uint8_t *, size_t,
+    uint64_t, size_t, uint8_t *, size_t);
+
 #endif /* !_SHA256_H_ */
@@ -0,0 +1,133 @@
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_AVX2
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "insecure_memzero.h"
+
+#include "sha256_avx2.h"
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Elementary functions, applied to all eight lanes at once. */
+#define ADD(x, y)	_mm256_add_epi32(x, y)
+#define XOR(x, y)	_mm256_xor_si256(x, y)
+#define ROTR(x, n)	_mm256_or_si256(_mm256_srli_epi32(x, n),	\
+			    _mm256_slli_epi32(x, 32 - (n)))
+#define SHR(x, n)	_mm256_srli_epi32(x, n)
+#define Ch(x, y, z)	XOR(_mm256_and_si256(x, XOR(y, z)), z)
+#define Maj(x, y, z)	_mm256_or_si256(_mm256_and_si256(x,		\
+			    _mm256_or_si256(y, z)), _mm256_and_si256(y, z))
+#define S0(x)		XOR(XOR(ROTR(x, 2), ROTR(x, 13)), ROTR(x, 22))
+#define S1(x)		XOR(XOR(ROTR(x, 6), ROTR(x, 11)), ROTR(x, 25))
+#define s0(x)		XOR(XOR(ROTR(x, 7), ROTR(x, 18)), SHR(x, 3))
+#define s1(x)		XOR(XOR(ROTR(x, 17), ROTR(x, 19)), SHR(x, 10))
+
+/**
+ * transpose(t):
+ * Transpose the 8 x 8 matrix of 32-bit words held in ${t}.
+ */
+static inline void
+transpose(__m256i t[8])
+{
+	__m256i T[4];
+	__m256i U[8];
+	size_t g;
+
+	for (g = 0; g < 8; g += 4) {
+		T[0] = _mm256_unpacklo_epi32(t[g + 0], t[g + 1]);
+		T[1] = _mm256_unpacklo_epi32(t[g + 2], t[g + 3]);
+		T[2] = _mm256_unpackhi_epi32(t[g + 0], t[g + 1]);
+		T[3] = _mm256_unpackhi_epi32(t[g + 2], t[g + 3]);
+		U[g + 0] = _mm256_unpacklo_epi64(T[0], T[1]);
+		U[g + 1] = _mm256_unpackhi_epi64(T[0], T[1]);
+		U[g + 2] = _mm256_unpacklo_epi64(T[2], T[3]);
+		U[g + 3] = _mm256_unpackhi_epi64(T[2], T[3]);
+	}
+	for (g = 0; g < 4; g++) {
+		t[g] = _mm256_permute2x128_si256(U[g], U[g + 4], 0x20);
+		t[g + 4] = _mm256_permute2x128_si256(U[g], U[g + 4], 0x31);
+	}
+}
+
+/**
+ * SHA256_Transform8_avx2(states, blocks):
+ * Compute the SHA256 block compression function eight times at once,
+ * transforming ${states}[l] using the data in ${blocks}[l] for l = 0 ... 7.
+ * This implementation uses x86 AVX2 instructions, and should only be used if
+ * CPUSUPPORT_X86_AVX2 is defined and cpusupport_x86_avx2() returns nonzero.
+ */
+void
+SHA256_Transform8_avx2(uint32_t states[8][8], const uint8_t * const blocks[8])
+{
+	const __m256i BSWAP = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL, 0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+	__m256i W[64];
+	__m256i S[8];
+	__m256i a, b, c, d, e, f, g, h, t0, t1;
+	size_t i, l;
+
+	/* 1. Prepare message schedule W, with word i of lane l in W[i][l]. */
+	for (l = 0; l < 8; l++) {
+		W[l] = _mm256_shuffle_epi8(_mm256_loadu_si256(
+		    (const __m256i *)&blocks[l][0]), BSWAP);
+		W[l + 8] = _mm256_shuffle_epi8(_mm256_loadu_si256(
+		    (const __m256i *)&blocks[l][32]), BSWAP);
+	}
+	transpose(&W[0]);
+	transpose(&W[8]);
+	for (i = 16; i < 64; i++)
+		W[i] = ADD(ADD(s1(W[i - 2]), W[i - 7]),
+		    ADD(s0(W[i - 15]), W[i - 16]));
+
+	/* 2. Initialize working variables. */
+	for (l = 0; l < 8; l++)
+		S[l] = _mm256_loadu_si256((const __m256i *)states[l]);
+	transpose(S);
+	a = S[0]; b = S[1]; c = S[2]; d = S[3];
+	e = S[4]; f = S[5]; g = S[6]; h = S[7];
+
+	/* 3. Mix. */
+	for (i = 0; i < 64; i++) {
+		t0 = ADD(ADD(h, S1(e)), ADD(Ch(e, f, g),
+		    ADD(W[i], _mm256_set1_epi32((int)Krnd[i]))));
+		t1 = ADD(S0(a), Maj(a, b, c));
+		h = g; g = f; f = e; e = ADD(d, t0);
+		d = c; c = b; b = a; a = ADD(t0, t1);
+	}
+
+	/* 4. Mix local working variables into global state. */
+	S[0] = ADD(S[0], a); S[1] = ADD(S[1], b);
+	S[2] = ADD(S[2], c); S[3] = ADD(S[3], d);
+	S[4] = ADD(S[4], e); S[5] = ADD(S[5], f);
+	S[6] = ADD(S[6], g); S[7] = ADD(S[7], h);
+	transpose(S);
+	for (l = 0; l < 8; l++)
+		_mm256_storeu_si256((__m256i *)states[l], S[l]);
+
+	/* Clean the stack. */
+	insecure_memzero(W, sizeof(W));
+	insecure_memzero(S, sizeof(S));
+}
+
+#endif /* CPUSUPPORT_X86_AVX2 */
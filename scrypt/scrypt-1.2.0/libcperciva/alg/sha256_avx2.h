@@ -0,0 +1,15 @@
+#ifndef _SHA256_AVX2_H_
+#define _SHA256_AVX2_H_
+
+#include <stdint.h>
+
+/**
+ * SHA256_Transform8_avx2(states, blocks):
+ * Compute the SHA256 block compression function eight times at once,
+ * transforming ${states}[l] using the data in ${blocks}[l] for l = 0 ... 7.
+ * This implementation uses x86 AVX2 instructions, and should only be used if
+ * CPUSUPPORT_X86_AVX2 is defined and cpusupport_x86_avx2() returns nonzero.
+ */
+void SHA256_Transform8_avx2(uint32_t[8][8], const uint8_t * const[8]);
+
+#endif /* !_SHA256_AVX2_H_ */
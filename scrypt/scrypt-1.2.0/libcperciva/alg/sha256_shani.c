@@ -0,0 +1,139 @@
+#include "cpusupport.h"
+#ifdef CPUSUPPORT_X86_SHANI
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "sha256_shani.h"
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Load 16 bytes of the block as four big-endian words. */
+#define LOAD(i)							\
+	_mm_shuffle_epi8(_mm_loadu_si128(			\
+	    (const __m128i *)&block[(i) * 16]), MASK)
+
+/* Four rounds, using the message words in M. */
+#define RND4(M, i) do {						\
+	MSG = _mm_add_epi32(M,					\
+	    _mm_loadu_si128((const __m128i *)&Krnd[i]));	\
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);	\
+	MSG = _mm_shuffle_epi32(MSG, 0x0E);			\
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);	\
+} while (0)
+
+/* Finish computing the message words in N from those in M and P. */
+#define MSG2(N, M, P)						\
+	N = _mm_sha256msg2_epu32(				\
+	    _mm_add_epi32(N, _mm_alignr_epi8(M, P, 4)), M)
+
+/* Start computing the message words in P from those in M. */
+#define MSG1(P, M)						\
+	P = _mm_sha256msg1_epu32(P, M)
+
+/**
+ * SHA256_Transform_shani(state, block):
+ * Compute the SHA256 block compression function, transforming ${state} using
+ * the data in ${block}.  This implementation uses x86 SHA-NI instructions, and
+ * should only be used if CPUSUPPORT_X86_SHANI is defined and
+ * cpusupport_x86_shani() returns nonzero.
+ */
+void
+SHA256_Transform_shani(uint32_t state[8], const uint8_t block[64])
+{
+	__m128i STATE0, STATE1, SAVE0, SAVE1;
+	__m128i M0, M1, M2, M3;
+	__m128i MSG, TMP;
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+
+	/* Rearrange the state from ABCD EFGH into ABEF CDGH. */
+	TMP = _mm_shuffle_epi32(
+	    _mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+	STATE1 = _mm_shuffle_epi32(
+	    _mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+	SAVE0 = STATE0;
+	SAVE1 = STATE1;
+
+	/* Rounds 0 - 15 consume the block itself. */
+	M0 = LOAD(0);
+	RND4(M0, 0);
+	M1 = LOAD(1);
+	RND4(M1, 4);
+	MSG1(M0, M1);
+	M2 = LOAD(2);
+	RND4(M2, 8);
+	MSG1(M1, M2);
+	M3 = LOAD(3);
+	RND4(M3, 12);
+	MSG2(M0, M3, M2);
+	MSG1(M2, M3);
+
+	/* Rounds 16 - 51 extend the message schedule as they go. */
+	RND4(M0, 16);
+	MSG2(M1, M0, M3);
+	MSG1(M3, M0);
+	RND4(M1, 20);
+	MSG2(M2, M1, M0);
+	MSG1(M0, M1);
+	RND4(M2, 24);
+	MSG2(M3, M2, M1);
+	MSG1(M1, M2);
+	RND4(M3, 28);
+	MSG2(M0, M3, M2);
+	MSG1(M2, M3);
+	RND4(M0, 32);
+	MSG2(M1, M0, M3);
+	MSG1(M3, M0);
+	RND4(M1, 36);
+	MSG2(M2, M1, M0);
+	MSG1(M0, M1);
+	RND4(M2, 40);
+	MSG2(M3, M2, M1);
+	MSG1(M1, M2);
+	RND4(M3, 44);
+	MSG2(M0, M3, M2);
+	MSG1(M2, M3);
+	RND4(M0, 48);
+	MSG2(M1, M0, M3);
+	MSG1(M3, M0);
+
+	/* Rounds 52 - 63 finish the last message words. */
+	RND4(M1, 52);
+	MSG2(M2, M1, M0);
+	RND4(M2, 56);
+	MSG2(M3, M2, M1);
+	RND4(M3, 60);
+
+	/* Mix into the state and put it back into ABCD EFGH order. */
+	STATE0 = _mm_add_epi32(STATE0, SAVE0);
+	STATE1 = _mm_add_epi32(STATE1, SAVE1);
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+	_mm_storeu_si128((__m128i *)&state[0],
+	    _mm_blend_epi16(TMP, STATE1, 0xF0));
+	_mm_storeu_si128((__m128i *)&state[4],
+	    _mm_alignr_epi8(STATE1, TMP, 8));
+}
+
+#endif /* CPUSUPPORT_X86_SHANI */
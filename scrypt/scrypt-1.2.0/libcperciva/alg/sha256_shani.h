@@ -0,0 +1,15 @@
+#ifndef _SHA256_SHANI_H_
+#define _SHA256_SHANI_H_
+
+#include <stdint.h>
+
+/**
+ * SHA256_Transform_shani(state, block):
+ * Compute the SHA256 block compression function, transforming ${state} using
+ * the data in ${block}.  This implementation uses x86 SHA-NI instructions, and
+ * should only be used if CPUSUPPORT_X86_SHANI is defined and
+ * cpusupport_x86_shani() returns nonzero.
+ */
+void SHA256_Transform_shani(uint32_t[8], const uint8_t[64]);
+
+#endif /* !_SHA256_SHANI_H_ */
@@ -0,0 +1,13 @@
+#include <immintrin.h>
+
+static char a[32];
+
+int main(void)
+{
+	__m256i x;
+
+	x = _mm256_loadu_si256((__m256i *)a);
+	x = _mm256_add_epi32(x, x);
+	_mm256_storeu_si256((__m256i *)a, x);
+	return (a[0]);
+}
@@ -0,0 +1,17 @@
+#include <immintrin.h>
+
+static char a[64];
+
+int main(void)
+{
+	__m128i x;
+	__m512i y;
+
+	x = _mm_loadu_si128((__m128i *)a);
+	x = _mm_rol_epi32(x, 7);
+	_mm_storeu_si128((__m128i *)a, x);
+	y = _mm512_loadu_si512((void *)a);
+	y = _mm512_xor_si512(y, y);
+	_mm512_storeu_si512((void *)a, y);
+	return (a[0]);
+}
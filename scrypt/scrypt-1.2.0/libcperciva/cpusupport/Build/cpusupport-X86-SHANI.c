@@ -0,0 +1,14 @@
+#include <immintrin.h>
+
+static char a[16];
+
+int main(void)
+{
+	__m128i x;
+
+	x = _mm_loadu_si128((__m128i *)a);
+	x = _mm_sha256msg1_epu32(x, x);
+	x = _mm_blend_epi16(x, x, 0xf0);
+	_mm_storeu_si128((__m128i *)a, x);
+	return (a[0]);
+}
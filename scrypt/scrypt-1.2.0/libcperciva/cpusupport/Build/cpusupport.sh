@@ -38,4 +38,7 @@ feature() {
 
 feature X86 CPUID ""
 feature X86 SSE2 "" "-msse2" "-msse2 -Wno-cast-align"
+feature X86 AVX2 "" "-mavx2" "-mavx2 -Wno-cast-align"
+feature X86 AVX512VL "" "-mavx512f -mavx512vl" "-mavx512f -mavx512vl -Wno-cast-align"
+feature X86 SHANI "" "-msse4.1 -msha" "-msse4.1 -msha -Wno-cast-align"
 feature X86 AESNI "" "-maes" "-maes -Wno-cast-align" "-maes -Wno-missing-prototypes -Wno-cast-qual"
@@ -59,6 +59,9 @@
  * from this list so that the associated C files can be omitted.
  */
 CPUSUPPORT_FEATURE(x86, aesni);
+CPUSUPPORT_FEATURE(x86, avx2);
+CPUSUPPORT_FEATURE(x86, avx512vl);
+CPUSUPPORT_FEATURE(x86, shani);
 CPUSUPPORT_FEATURE(x86, sse2);
 
 #endif /* !_CPUSUPPORT_H_ */
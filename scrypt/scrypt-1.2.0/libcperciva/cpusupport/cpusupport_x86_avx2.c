@@ -0,0 +1,42 @@
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#include <cpuid.h>
+#endif
+
+#define CPUID_OSXSAVE_BIT (1 << 27)
+#define CPUID_AVX_BIT (1 << 28)
+#define CPUID_AVX2_BIT (1 << 5)
+#define XCR0_AVX_MASK 0x6
+
+CPUSUPPORT_FEATURE_DECL(x86, avx2)
+{
+#ifdef CPUSUPPORT_X86_CPUID
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0, xcr0hi;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (eax < 7)
+		goto unsupported;
+
+	/* The OS must have enabled AVX state saving via XSAVE. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (!(ecx & CPUID_OSXSAVE_BIT) || !(ecx & CPUID_AVX_BIT))
+		goto unsupported;
+	__asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+	if ((xcr0 & XCR0_AVX_MASK) != XCR0_AVX_MASK)
+		goto unsupported;
+
+	/* Ask about extended CPU features. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* Return the relevant feature bit. */
+	return (ebx & CPUID_AVX2_BIT);
+
+unsupported:
+#endif
+	return (0);
+}
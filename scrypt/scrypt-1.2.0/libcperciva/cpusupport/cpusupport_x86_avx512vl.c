@@ -0,0 +1,42 @@
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#include <cpuid.h>
+#endif
+
+#define CPUID_OSXSAVE_BIT (1 << 27)
+#define CPUID_AVX512F_BIT (1 << 16)
+#define CPUID_AVX512VL_BIT (1U << 31)
+#define XCR0_AVX512_MASK 0xe6
+
+CPUSUPPORT_FEATURE_DECL(x86, avx512vl)
+{
+#ifdef CPUSUPPORT_X86_CPUID
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0, xcr0hi;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (eax < 7)
+		goto unsupported;
+
+	/* The OS must save opmask, ZMM and upper YMM state via XSAVE. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (!(ecx & CPUID_OSXSAVE_BIT))
+		goto unsupported;
+	__asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+	if ((xcr0 & XCR0_AVX512_MASK) != XCR0_AVX512_MASK)
+		goto unsupported;
+
+	/* Ask about extended CPU features. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* We need both the foundation and the 128/256-bit encodings. */
+	return ((ebx & CPUID_AVX512F_BIT) && (ebx & CPUID_AVX512VL_BIT));
+
+unsupported:
+#endif
+	return (0);
+}
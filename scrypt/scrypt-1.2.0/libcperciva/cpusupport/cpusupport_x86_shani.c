@@ -0,0 +1,37 @@
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#include <cpuid.h>
+#endif
+
+#define CPUID_SSSE3_BIT (1 << 9)
+#define CPUID_SSE41_BIT (1 << 19)
+#define CPUID_SHANI_BIT (1 << 29)
+
+CPUSUPPORT_FEATURE_DECL(x86, shani)
+{
+#ifdef CPUSUPPORT_X86_CPUID
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (eax < 7)
+		goto unsupported;
+
+	/* The SHA-NI code also uses SSSE3 and SSE4.1 shuffles and blends. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		goto unsupported;
+	if (!(ecx & CPUID_SSSE3_BIT) || !(ecx & CPUID_SSE41_BIT))
+		goto unsupported;
+
+	/* Ask about extended CPU features. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* Return the relevant feature bit. */
+	return (ebx & CPUID_SHANI_BIT);
+
+unsupported:
+#endif
+	return (0);
+}
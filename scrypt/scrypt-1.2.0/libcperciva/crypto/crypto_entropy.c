@@ -1,5 +1,11 @@
 #include <assert.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "entropy.h"
@@ -14,35 +20,58 @@
  * specified in section 10.1.2 of the NIST SP 800-90 standard.  In this
  * implementation, the optional personalization_string and additional_input
  * specified in the standard are not implemented.
+ *
+ * Every thread has its own DRBG, so that threads never wait for each other,
+ * and small requests are served from a buffer of generated output, so that
+ * drawing a 32-byte salt costs about one HMAC rather than three.  A forked
+ * child reseeds every DRBG before using it, so that it never repeats the
+ * output of its parent.  On Windows there is a single DRBG behind a lock.
  */
 
-/* Internal HMAC_DRBG state. */
-static struct {
-	uint8_t Key[32];
-	uint8_t V[32];
-	uint32_t reseed_counter;
-} drbg;
-
-/* Set to non-zero once the PRNG has been instantiated. */
-static int instantiated = 0;
-
 /* Could be as high as 2^48 if we wanted... */
 #define RESEED_INTERVAL	256
 
 /* Limited to 2^16 by specification. */
 #define GENERATE_MAXLEN	65536
 
-static int instantiate(void);
-static void update(uint8_t *, size_t);
-static int reseed(void);
-static void generate(uint8_t *, size_t);
+/* Generated output buffered for small requests. */
+#define OUTBUF_LEN	1024
+
+/* Internal HMAC_DRBG state. */
+struct drbg {
+	uint8_t Key[32];
+	uint8_t V[32];
+	uint32_t reseed_counter;
+	unsigned int generation;	/* Fork generation, or 0. */
+	size_t bufpos;			/* First unused byte of buf. */
+	uint8_t buf[OUTBUF_LEN];
+};
+
+/* Incremented in a child process after fork. */
+static volatile unsigned int fork_generation = 1;
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+static pthread_key_t drbg_key;
+static int drbg_key_ok = 0;
+#elif defined(_WIN32)
+static SRWLOCK drbg_lock = SRWLOCK_INIT;
+static struct drbg drbg_single;
+#else
+#error "crypto_entropy needs pthreads or Windows threads"
+#endif
+
+static int instantiate(struct drbg *);
+static void update(struct drbg *, uint8_t *, size_t);
+static int reseed(struct drbg *);
+static void generate(struct drbg *, uint8_t *, size_t);
 
 /**
- * instantiate(void):
+ * instantiate(D):
  * Initialize the DRBG state.  (Section 10.1.2.3)
  */
 static int
-instantiate(void)
+instantiate(struct drbg * D)
 {
 	uint8_t seed_material[48];
 
@@ -51,12 +80,16 @@ instantiate(void)
 		return (-1);
 
 	/* Initialize Key, V, and reseed_counter. */
-	memset(drbg.Key, 0x00, 32);
-	memset(drbg.V, 0x01, 32);
-	drbg.reseed_counter = 1;
+	memset(D->Key, 0x00, 32);
+	memset(D->V, 0x01, 32);
+	D->reseed_counter = 1;
 
 	/* Mix the random seed into the state. */
-	update(seed_material, 48);
+	update(D, seed_material, 48);
+
+	/* Discard any output generated before a fork. */
+	insecure_memzero(D->buf, OUTBUF_LEN);
+	D->bufpos = OUTBUF_LEN;
 
 	/* Clean the stack. */
 	insecure_memzero(seed_material, 48);
@@ -66,19 +99,19 @@ instantiate(void)
 }
 
 /**
- * update(data, datalen):
+ * update(D, data, datalen):
  * Update the DRBG state using the provided data.  (Section 10.1.2.2)
  */
 static void
-update(uint8_t * data, size_t datalen)
+update(struct drbg * D, uint8_t * data, size_t datalen)
 {
 	HMAC_SHA256_CTX ctx;
 	uint8_t K[32];
 	uint8_t Vx[33];
 
 	/* Load (Key, V) into (K, Vx). */
-	memcpy(K, drbg.Key, 32);
-	memcpy(Vx, drbg.V, 32);
+	memcpy(K, D->Key, 32);
+	memcpy(Vx, D->V, 32);
 
 	/* K <- HMAC(K, V || 0x00 || data). */
 	Vx[32] = 0x00;
@@ -104,8 +137,8 @@ update(uint8_t * data, size_t datalen)
 	}
 
 	/* Copy (K, Vx) back to (Key, V). */
-	memcpy(drbg.Key, K, 32);
-	memcpy(drbg.V, Vx, 32);
+	memcpy(D->Key, K, 32);
+	memcpy(D->V, Vx, 32);
 
 	/* Clean the stack. */
 	insecure_memzero(K, 32);
@@ -113,11 +146,11 @@ update(uint8_t * data, size_t datalen)
 }
 
 /**
- * reseed(void):
+ * reseed(D):
  * Reseed the DRBG state (mix in new entropy).  (Section 10.1.2.4)
  */
 static int
-reseed(void)
+reseed(struct drbg * D)
 {
 	uint8_t seed_material[32];
 
@@ -126,10 +159,10 @@ reseed(void)
 		return (-1);
 
 	/* Mix the random seed into the state. */
-	update(seed_material, 32);
+	update(D, seed_material, 32);
 
 	/* Reset the reseed_counter. */
-	drbg.reseed_counter = 1;
+	D->reseed_counter = 1;
 
 	/* Clean the stack. */
 	insecure_memzero(seed_material, 32);
@@ -139,72 +172,170 @@ reseed(void)
 }
 
 /**
- * generate(buf, buflen):
+ * generate(D, buf, buflen):
  * Fill the provided buffer with random bits, assuming that reseed_counter
  * is less than RESEED_INTERVAL (the caller is responsible for calling
  * reseed() as needed) and ${buflen} is less than 2^16 (the caller is
  * responsible for splitting up larger requests).  (Section 10.1.2.5)
  */
 static void
-generate(uint8_t * buf, size_t buflen)
+generate(struct drbg * D, uint8_t * buf, size_t buflen)
 {
 	size_t bufpos;
 
 	assert(buflen <= GENERATE_MAXLEN);
-	assert(drbg.reseed_counter <= RESEED_INTERVAL);
+	assert(D->reseed_counter <= RESEED_INTERVAL);
 
 	/* Iterate until we've filled the buffer. */
 	for (bufpos = 0; bufpos < buflen; bufpos += 32) {
-		HMAC_SHA256_Buf(drbg.Key, 32, drbg.V, 32, drbg.V);
+		HMAC_SHA256_Buf(D->Key, 32, D->V, 32, D->V);
 		if (buflen - bufpos >= 32)
-			memcpy(&buf[bufpos], drbg.V, 32);
+			memcpy(&buf[bufpos], D->V, 32);
 		else
-			memcpy(&buf[bufpos], drbg.V, buflen - bufpos);
+			memcpy(&buf[bufpos], D->V, buflen - bufpos);
 	}
 
 	/* Mix up state. */
-	update(NULL, 0);
+	update(D, NULL, 0);
 
 	/* We're one data-generation step closer to needing a reseed. */
-	drbg.reseed_counter += 1;
+	D->reseed_counter += 1;
 }
 
 /**
- * crypto_entropy_read(buf, buflen):
- * Fill the buffer with unpredictable bits.
+ * step(D, buf, buflen):
+ * Reseed if needed, then fill the buffer, which must be no longer than
+ * GENERATE_MAXLEN bytes.
  */
-int
-crypto_entropy_read(uint8_t * buf, size_t buflen)
+static int
+step(struct drbg * D, uint8_t * buf, size_t buflen)
+{
+
+	/* Do we need to reseed? */
+	if (D->reseed_counter > RESEED_INTERVAL) {
+		if (reseed(D))
+			return (-1);
+	}
+
+	/* Generate bytes. */
+	generate(D, buf, buflen);
+
+	/* Success! */
+	return (0);
+}
+
+/* A forked child must not repeat the output of its parent. */
+static void
+drbg_atfork_child(void)
+{
+
+	fork_generation++;
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * drbg_destroy(cookie):
+ * Wipe and free the DRBG ${cookie} of a thread which is exiting.
+ */
+static void
+drbg_destroy(void * cookie)
+{
+
+	insecure_memzero(cookie, sizeof(struct drbg));
+	free(cookie);
+}
+
+static void
+drbg_init(void)
+{
+
+	if (pthread_key_create(&drbg_key, drbg_destroy) == 0)
+		drbg_key_ok = 1;
+	pthread_atfork(NULL, NULL, drbg_atfork_child);
+}
+#endif
+
+/**
+ * drbg_self(void):
+ * Return the calling thread's DRBG, creating it if it does not exist, or
+ * NULL on error.  The DRBG may not be instantiated yet.  On Windows this is
+ * the shared DRBG, which may only be used with drbg_lock held.
+ */
+static struct drbg *
+drbg_self(void)
+{
+#ifdef HAVE_PTHREAD
+	struct drbg * D;
+
+	if (pthread_once(&drbg_once, drbg_init) || !drbg_key_ok)
+		return (NULL);
+	if ((D = pthread_getspecific(drbg_key)) != NULL)
+		return (D);
+
+	/* Create a DRBG which has not been instantiated. */
+	if ((D = calloc(1, sizeof(struct drbg))) == NULL)
+		return (NULL);
+	if (pthread_setspecific(drbg_key, D)) {
+		free(D);
+		return (NULL);
+	}
+
+	return (D);
+#else
+	(void)drbg_atfork_child;
+
+	return (&drbg_single);
+#endif
+}
+
+/**
+ * drbg_read(D, buf, buflen):
+ * Fill the buffer with unpredictable bits from the DRBG ${D}.
+ */
+static int
+drbg_read(struct drbg * D, uint8_t * buf, size_t buflen)
 {
 	size_t bytes_to_provide;
 
-	/* Instantiate if needed. */
-	if (instantiated == 0) {
+	/* Instantiate if needed, or again in a forked child. */
+	if (D->generation != fork_generation) {
 		/* Try to instantiate the PRNG. */
-		if (instantiate())
+		if (instantiate(D))
 			return (-1);
 
 		/* We have instantiated the PRNG. */
-		instantiated = 1;
+		D->generation = fork_generation;
 	}
 
 	/* Loop until we've filled the buffer. */
 	while (buflen > 0) {
-		/* Do we need to reseed? */
-		if (drbg.reseed_counter > RESEED_INTERVAL) {
-			if (reseed())
+		if (buflen < OUTBUF_LEN) {
+			/* Refill the output buffer if it is used up. */
+			if (D->bufpos == OUTBUF_LEN) {
+				if (step(D, D->buf, OUTBUF_LEN))
+					return (-1);
+				D->bufpos = 0;
+			}
+
+			/* Hand out buffered bytes, and forget them. */
+			bytes_to_provide = OUTBUF_LEN - D->bufpos;
+			if (bytes_to_provide > buflen)
+				bytes_to_provide = buflen;
+			memcpy(buf, &D->buf[D->bufpos], bytes_to_provide);
+			insecure_memzero(&D->buf[D->bufpos], bytes_to_provide);
+			D->bufpos += bytes_to_provide;
+		} else {
+			/* How much data are we generating in this step? */
+			if (buflen > GENERATE_MAXLEN)
+				bytes_to_provide = GENERATE_MAXLEN;
+			else
+				bytes_to_provide = buflen;
+
+			/* Generate bytes straight into the buffer. */
+			if (step(D, buf, bytes_to_provide))
 				return (-1);
 		}
 
-		/* How much data are we generating in this step? */
-		if (buflen > GENERATE_MAXLEN)
-			bytes_to_provide = GENERATE_MAXLEN;
-		else
-			bytes_to_provide = buflen;
-
-		/* Generate bytes. */
-		generate(buf, bytes_to_provide);
-
 		/* We've done part of the buffer. */
 		buf += bytes_to_provide;
 		buflen -= bytes_to_provide;
@@ -213,3 +344,31 @@ crypto_entropy_read(uint8_t * buf, size_t buflen)
 	/* Success! */
 	return (0);
 }
+
+/**
+ * crypto_entropy_read(buf, buflen):
+ * Fill the buffer with unpredictable bits.
+ */
+int
+crypto_entropy_read(uint8_t * buf, size_t buflen)
+{
+	struct drbg * D;
+#ifndef HAVE_PTHREAD
+	int rc;
+#endif
+
+	/* Find this thread's DRBG. */
+	if ((D = drbg_self()) == NULL)
+		return (-1);
+
+#ifdef HAVE_PTHREAD
+	return (drbg_read(D, buf, buflen));
+#else
+	/* The DRBG is shared, so only one thread may use it at a time. */
+	AcquireSRWLockExclusive(&drbg_lock);
+	rc = drbg_read(D, buf, buflen);
+	ReleaseSRWLockExclusive(&drbg_lock);
+
+	return (rc);
+#endif
+}
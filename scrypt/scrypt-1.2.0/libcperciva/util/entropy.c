@@ -1,24 +1,56 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <limits.h>
 #include <stdint.h>
-#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "warnp.h"
 
 #include "entropy.h"
 
 /**
- * XXX Portability
- * XXX We obtain random bytes from the operating system by opening
- * XXX /dev/urandom and reading them from that device; this works on
- * XXX modern UNIX-like operating systems but not on systems like
- * XXX win32 where there is no concept of /dev/urandom.
+ * We obtain random bytes from the operating system with getrandom(2) where
+ * the kernel has it, with BCryptGenRandom on win32, and otherwise by opening
+ * /dev/urandom and reading them from that device.
  */
 
+/* getrandom(2) returns at most this many bytes without blocking on signals. */
+#define GETRANDOM_MAXLEN	256
+
 /**
  * entropy_read(buf, buflen):
  * Fill the given buffer with random bytes provided by the operating system.
  */
+#ifdef _WIN32
+int
+entropy_read(uint8_t * buf, size_t buflen)
+{
+
+	/* The system RNG takes the length as a ULONG. */
+	while (buflen > 0) {
+		ULONG len = (buflen > ULONG_MAX) ? ULONG_MAX : (ULONG)buflen;
+
+		if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, buf, len,
+		    BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+			warn0("BCryptGenRandom failed");
+			return (-1);
+		}
+		buf += len;
+		buflen -= len;
+	}
+
+	/* Success! */
+	return (0);
+}
+#else
 int
 entropy_read(uint8_t * buf, size_t buflen)
 {
@@ -33,6 +65,30 @@ entropy_read(uint8_t * buf, size_t buflen)
 		goto err0;
 	}
 
+#ifdef SYS_getrandom
+	/* Ask the kernel directly, which needs no file descriptor. */
+	while (buflen > 0) {
+		lenread = syscall(SYS_getrandom, buf,
+		    (buflen > GETRANDOM_MAXLEN) ? GETRANDOM_MAXLEN : buflen, 0);
+		if (lenread == -1) {
+			if (errno == EINTR)
+				continue;
+
+			/* Kernels older than 3.17 only have /dev/urandom. */
+			if (errno == ENOSYS)
+				break;
+			warnp("getrandom");
+			goto err0;
+		}
+
+		/* We've filled a portion of the buffer. */
+		buf += lenread;
+		buflen -= lenread;
+	}
+	if (buflen == 0)
+		return (0);
+#endif
+
 	/* Open /dev/urandom. */
 	if ((fd = open("/dev/urandom", O_RDONLY)) == -1) {
 		warnp("open(/dev/urandom)");
@@ -74,3 +130,4 @@ err0:
 	/* Failure! */
 	return (-1);
 }
+#endif
@@ -29,23 +29,63 @@
 // Forward declarations using Napi::Value and Napi::CallbackInfo
 Napi::Value paramsSync(const Napi::CallbackInfo& info);
 Napi::Value params(const Napi::CallbackInfo& info);
+Napi::Value paramsForThroughputSync(const Napi::CallbackInfo& info);
+Napi::Value paramsForThroughput(const Napi::CallbackInfo& info);
 Napi::Value kdfSync(const Napi::CallbackInfo& info);
 Napi::Value kdf(const Napi::CallbackInfo& info);
+Napi::Value kdfPromise(const Napi::CallbackInfo& info);
 Napi::Value kdfVerifySync(const Napi::CallbackInfo& info);
 Napi::Value kdfVerify(const Napi::CallbackInfo& info);
+Napi::Value kdfVerifyPromise(const Napi::CallbackInfo& info);
+Napi::Value kdfVerifyMany(const Napi::CallbackInfo& info);
 Napi::Value hashSync(const Napi::CallbackInfo& info);
 Napi::Value hash(const Napi::CallbackInfo& info);
+Napi::Value hashPromise(const Napi::CallbackInfo& info);
+Napi::Value hashMany(const Napi::CallbackInfo& info);
+Napi::Value hashIntoSync(const Napi::CallbackInfo& info);
+Napi::Value hashInto(const Napi::CallbackInfo& info);
+Napi::Value hashIntoPromise(const Napi::CallbackInfo& info);
+Napi::Value pbkdf2Sync(const Napi::CallbackInfo& info);
+Napi::Value pbkdf2(const Napi::CallbackInfo& info);
+Napi::Value pbkdf2Promise(const Napi::CallbackInfo& info);
+Napi::Value configure(const Napi::CallbackInfo& info);
+Napi::Value stats(const Napi::CallbackInfo& info);
+Napi::Value trim(const Napi::CallbackInfo& info);
+Napi::Value kernels(const Napi::CallbackInfo& info);
+Napi::Value warmup(const Napi::CallbackInfo& info);
+Napi::Value calibrate(const Napi::CallbackInfo& info);
+void configureDefaults();
 
 // Module initialization using Napi style
 Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
+  configureDefaults();
   exports.Set(Napi::String::New(env, "paramsSync"), Napi::Function::New(env, paramsSync));
   exports.Set(Napi::String::New(env, "params"), Napi::Function::New(env, params));
+  exports.Set(Napi::String::New(env, "paramsForThroughputSync"), Napi::Function::New(env, paramsForThroughputSync));
+  exports.Set(Napi::String::New(env, "paramsForThroughput"), Napi::Function::New(env, paramsForThroughput));
   exports.Set(Napi::String::New(env, "kdfSync"), Napi::Function::New(env, kdfSync));
   exports.Set(Napi::String::New(env, "kdf"), Napi::Function::New(env, kdf));
+  exports.Set(Napi::String::New(env, "kdfPromise"), Napi::Function::New(env, kdfPromise));
   exports.Set(Napi::String::New(env, "verifySync"), Napi::Function::New(env, kdfVerifySync));
   exports.Set(Napi::String::New(env, "verify"), Napi::Function::New(env, kdfVerify));
+  exports.Set(Napi::String::New(env, "verifyPromise"), Napi::Function::New(env, kdfVerifyPromise));
+  exports.Set(Napi::String::New(env, "verifyMany"), Napi::Function::New(env, kdfVerifyMany));
   exports.Set(Napi::String::New(env, "hashSync"), Napi::Function::New(env, hashSync));
   exports.Set(Napi::String::New(env, "hash"), Napi::Function::New(env, hash));
+  exports.Set(Napi::String::New(env, "hashPromise"), Napi::Function::New(env, hashPromise));
+  exports.Set(Napi::String::New(env, "hashMany"), Napi::Function::New(env, hashMany));
+  exports.Set(Napi::String::New(env, "hashIntoSync"), Napi::Function::New(env, hashIntoSync));
+  exports.Set(Napi::String::New(env, "hashInto"), Napi::Function::New(env, hashInto));
+  exports.Set(Napi::String::New(env, "hashIntoPromise"), Napi::Function::New(env, hashIntoPromise));
+  exports.Set(Napi::String::New(env, "pbkdf2Sync"), Napi::Function::New(env, pbkdf2Sync));
+  exports.Set(Napi::String::New(env, "pbkdf2"), Napi::Function::New(env, pbkdf2));
+  exports.Set(Napi::String::New(env, "pbkdf2Promise"), Napi::Function::New(env, pbkdf2Promise));
+  exports.Set(Napi::String::New(env, "configure"), Napi::Function::New(env, configure));
+  exports.Set(Napi::String::New(env, "stats"), Napi::Function::New(env, stats));
+  exports.Set(Napi::String::New(env, "trim"), Napi::Function::New(env, trim));
+  exports.Set(Napi::String::New(env, "kernels"), Napi::Function::New(env, kernels));
+  exports.Set(Napi::String::New(env, "warmup"), Napi::Function::New(env, warmup));
+  exports.Set(Napi::String::New(env, "calibrate"), Napi::Function::New(env, calibrate));
   return exports;
 }
 
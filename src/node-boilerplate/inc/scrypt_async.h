@@ -25,55 +25,153 @@ Barry Steyn barry.steyn@gmail.com
 #ifndef _SCRYPTASYNC_H_
 #define _SCRYPTASYNC_H_
 
+#include <napi.h>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
 #include "scrypt_common.h"
+#include "scrypt_pool.h"
+
+struct crypto_scrypt_job;
+
+namespace NodeScrypt {
+  //
+  // The scrypt computation of a worker which implements Begin and End
+  //
+  struct Derivation {
+    const uint8_t* key;
+    size_t keylen;
+    const uint8_t* salt;
+    size_t saltlen;
+    uint64_t logN;
+    uint32_t r;
+    uint32_t p;
+    uint8_t* buf;
+    size_t buflen;
+  };
+}
 
 //
 // Scrypt Async Worker
 //
 
-//Note: This class is implemented for common async
-// class properties that applies to Scrypt functionality
-// only. These properties are:
-//  (1) Creation of Scrypt specific Error Object
-//  (2) result integer that denotes the response from the Scrypt C library
-//  (3) ScryptPeristentObject that holds input arguments from JS land
-class ScryptAsyncWorker : public Nan::AsyncWorker {
+//Note: This class takes the place of Napi::AsyncWorker for the Scrypt
+// workers, keeping its Execute/OnOK/OnError shape. The differences are:
+//  (1) Execute runs on the native scrypt pool (see scrypt_pool.h), not
+//      on the libuv pool, so hashing never starves fs, dns or zlib
+//  (2) OnOK/OnError run on the JS thread of the isolate which queued the
+//      work, through a ThreadSafeFunction
+//  (3) The worker deletes itself on that JS thread once it is finished,
+//      and an isolate shutting down waits for (or cancels) its workers
+//  (4) Without a callback function the result settles a Promise instead
+//  (5) Worker memory is recycled, since a worker is made for every call
+//  (6) The pool may turn the work away (queue full, waited too long, deadline missed), in
+//      which case OnError gets a Scrypt error with a code and Execute never runs
+//  (7) An AbortSignal takes queued work off the pool, and sets aborted for
+//      Execute to hand to the scrypt computation, which then stops early,
+//      or stops waiting for the memory budget; so does a deadline which
+//      passes while the computation waits for memory
+//  (8) Work which is one scrypt computation may implement Begin and End
+//      instead of Execute. A long computation then runs in slices, queued
+//      again behind other work after each (see PoolSetTimeSlice) with its
+//      share of the memory budget handed back, and can report its progress
+class ScryptAsyncWorker : public NodeScrypt::PoolTask {
   public:
-    ScryptAsyncWorker(Nan::Callback* callback) : Nan::AsyncWorker(callback), result(0) {};
+    // A callback which is not a function makes a Promise-returning worker
+    explicit ScryptAsyncWorker(const Napi::Value& callback);
+    virtual ~ScryptAsyncWorker();
 
     //
-    // Overrides Nan, needed for creating Scrypt Error
+    // Takes the deadline (a Date.now() timestamp), priority, AbortSignal and
+    // onProgress function of an options object, which must be called before
+    // Queue; anything else is ignored
     //
-    void HandleErrorCallback() {
-      Nan::HandleScope scope;
-
-      v8::Local<v8::Value> argv[] = {
-          NodeScrypt::ScryptError(result)
-      };
-      callback->Call(1, argv, async_resource);
-    }
+    void Schedule(const Napi::Value& options);
 
     //
-    // Overrides Nan, needed for checking result
+    // Hands the work to the native pool
     //
-    void WorkComplete() {
-      Nan::HandleScope scope;
+    void Queue();
 
-      if (result == 0)
-        HandleOKCallback();
-      else
-        HandleErrorCallback();
+    //
+    // The Promise the result settles, or undefined for a callback worker
+    //
+    Napi::Value Promise() const;
 
-      delete callback;
-      callback = NULL;
-    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
 
   protected:
-    //
-    // Scrypt specific state
-    //
-    v8::Local<v8::Object> ScryptPeristentObject; // Anything persistent stored here
-    unsigned int result; // Result of Scrypt functions
+    // Executed on a pool thread; must not touch JavaScript values. By default
+    // it runs Begin, the scrypt computation Begin describes, then End
+    virtual void Execute();
+
+    // Executed on a pool thread before the scrypt computation: describes it,
+    // or returns false if there is nothing to compute (after SetError)
+    virtual bool Begin(NodeScrypt::Derivation& derivation);
+
+    // Executed on a pool thread after the scrypt computation, with its Scrypt error code
+    virtual void End(unsigned int result);
+
+    // Executed on the JS thread after Execute succeeds
+    virtual void OnOK() = 0;
+
+    // Executed on the JS thread after Execute calls SetError
+    virtual void OnError(const Napi::Error& e);
+
+    void SetError(const std::string& message);
+    Napi::Env Env() const;
+
+    // Calls back with (null, result), or resolves the Promise
+    void Resolve(const Napi::Value& result);
+
+    // Calls back with (error, undefined), or rejects the Promise
+    void Reject(const Napi::Error& e);
+
+    // Set on the JS thread once the signal aborts; the scrypt computation
+    // Execute runs watches it through a pointer
+    volatile int aborted;
+
+  private:
+    void Run() override;
+    void Shed(unsigned int error) override;
+    void Post();
+    bool Slice();
+    void Progress();
+    void Abort();
+    void Unlisten();
+    static Napi::Value OnAbort(const Napi::CallbackInfo& info);
+    static void CallJs(Napi::Env env, Napi::Function callback, ScryptAsyncWorker* worker);
+    static void Finalize(Napi::Env env, ScryptAsyncWorker* worker);
+    static void Abandon(void* arg);
+
+    napi_env env;
+    Napi::FunctionReference callback;
+    std::optional<Napi::Promise::Deferred> deferred;
+    Napi::ThreadSafeFunction tsfn;
+    std::string error;
+    unsigned int error_code; // Scrypt error code when the pool turned the work away
+    bool has_error;
+    bool missed; // The deadline passed while the computation waited for memory
+
+    // The AbortSignal and the "abort" listener added to it, until the result is delivered
+    Napi::ObjectReference signal;
+    Napi::FunctionReference listener;
+
+    // The computation Begin describes, and the job running it in slices
+    NodeScrypt::Derivation derivation;
+    struct crypto_scrypt_job* job;
+
+    // Called with the fraction done each time it grows by a percent
+    Napi::FunctionReference progress;
+    bool has_progress;
+    unsigned int progress_percent;
+
+    // Guards finished, which is set once the pool thread is done with the worker
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool finished;
 };
 
 #endif /* _SCRYPTASYNC_H_ */
@@ -27,6 +27,8 @@ Barry Steyn barry.steyn@gmail.com
 
 #include <napi.h> // Include Napi
 #include <cstdint> // Include for uint32_t
+#include <string> // For error messages
+#include <vector> // For string scratch
 
 namespace NodeScrypt {
 
@@ -45,10 +47,82 @@ namespace NodeScrypt {
       p(obj.Get("p").As<Napi::Number>().Uint32Value()) {}
   };
 
+  //
+  // Bytes of a key, salt, KDF or target argument: a string, Buffer,
+  // TypedArray, DataView or ArrayBuffer. Binary data is used in place and,
+  // unless told otherwise, referenced so that it outlives the call. Strings
+  // are encoded as UTF-8 straight into scratch, which is wiped afterwards.
+  // Create and destroy on the JS thread; Data() may be used anywhere.
+  //
+  class Bytes {
+    public:
+      Bytes();
+      explicit Bytes(const Napi::Value& value, bool reference = true);
+      Bytes(Bytes&&) = default;
+      Bytes& operator=(Bytes&&) = default;
+      ~Bytes();
+
+      uint8_t* Data() const { return data; }
+      size_t Length() const { return length; }
+
+      // The referenced binary value (JS thread)
+      Napi::Value Value() const { return ref.Value(); }
+
+      // Accepted by the constructor
+      static bool Is(const Napi::Value& value);
+
+      // Accepted by the constructor, and not a string
+      static bool IsBinary(const Napi::Value& value);
+
+    private:
+      Napi::ObjectReference ref;
+      std::vector<uint8_t> scratch;
+      uint8_t* data;
+      size_t length;
+  };
+
+  //
+  // True for a number which index.ts accepts as an integer (value === parseInt(value))
+  //
+  bool IsInteger(const Napi::Value& value);
+
+  //
+  // True for an object with integer N, r and p of its own, as index.ts demands
+  //
+  bool IsParams(const Napi::Value& value);
+
+  //
+  // True if length bytes fit into the binary target at offset (all three unchecked JS values)
+  //
+  bool FitsInto(const Napi::Value& target, const Napi::Value& offset, const Napi::Value& length);
+
+  //
+  // Hand data allocated with new[] to JavaScript as a Buffer, without copying it
+  //
+  Napi::Value OwnedBuffer(Napi::Env env, uint8_t* data, size_t length);
+
   //
   // Create a Scrypt error (already refactored in scrypt_common.cc, update signature here)
   //
   Napi::Error ScryptError(Napi::Env env, const unsigned int error);
+
+  //
+  // Describe a Scrypt error without touching JavaScript (safe off the JS thread)
+  //
+  std::string ScryptErrorMessage(const unsigned int error);
+
+  //
+  // While in scope, scrypt computations on this thread fail with error 18
+  // instead of waiting for the memory budget, so that a synchronous call
+  // never blocks the event loop behind asynchronous ones
+  //
+  class BudgetNoWait {
+    public:
+      BudgetNoWait();
+      ~BudgetNoWait();
+      BudgetNoWait(const BudgetNoWait&) = delete;
+      BudgetNoWait& operator=(const BudgetNoWait&) = delete;
+  };
 };
 
 #endif /* _SCRYPTCOMMON_H_ */
@@ -0,0 +1,122 @@
+#ifndef _SCRYPTHASHMANYASYNC_
+#define _SCRYPTHASHMANYASYNC_
+
+#include <napi.h>
+#include <atomic>
+#include <vector>
+#include <string> // For error messages
+#include "scrypt_common.h" // For Params struct and ScryptErrorMessage
+#include "scrypt_async.h" // For ScryptAsyncWorker
+#include "scrypt_pool.h" // For PoolParallel
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "hash.h" // For HashMany function
+}
+
+class ScryptHashManyAsyncWorker : public ScryptAsyncWorker {
+  public:
+    ScryptHashManyAsyncWorker(const Napi::CallbackInfo& info) :
+      ScryptAsyncWorker(info[4]), // Callback is the 5th argument
+      params(info[1].As<Napi::Object>()), // Params object is the 2nd argument
+      hash_size(info[2].As<Napi::Number>().Int64Value()), // Hash size is the 3rd argument
+      hash_result(0)
+    {
+      Napi::Env env = info.Env();
+      Napi::Array keys = info[0].As<Napi::Array>();
+      Napi::Array salts = info[3].As<Napi::Array>();
+      const uint32_t count = keys.Length();
+
+      // One array keeps every key and salt alive, whatever the caller does with theirs
+      Napi::Array inputs = Napi::Array::New(env, 2 * count);
+      bytes.reserve(2 * count);
+      key_ptrs.resize(count);
+      key_sizes.resize(count);
+      salt_ptrs.resize(count);
+      salt_sizes.resize(count);
+      for (uint32_t i = 0; i < count; i++) {
+        Napi::Value key = keys.Get(i);
+        Napi::Value salt = salts.Get(i);
+        inputs.Set(2 * i, key);
+        inputs.Set(2 * i + 1, salt);
+        bytes.emplace_back(key, false);
+        bytes.emplace_back(salt, false);
+        key_ptrs[i] = bytes[2 * i].Data();
+        key_sizes[i] = bytes[2 * i].Length();
+        salt_ptrs[i] = bytes[2 * i + 1].Data();
+        salt_sizes[i] = bytes[2 * i + 1].Length();
+      }
+      inputs_ref = Napi::Persistent(inputs);
+
+      // Every hash is written straight into one buffer, handed back as is
+      Napi::Buffer<uint8_t> result_buffer = Napi::Buffer<uint8_t>::New(env, count * hash_size);
+      result_ref = Napi::Persistent(result_buffer);
+      result_ptr = result_buffer.Data();
+    }
+
+    ~ScryptHashManyAsyncWorker() {} // Destructor
+
+    // Executed in background thread
+    void Execute() override {
+      // Spread the keys over the native pool; each range is hashed as one batch
+      NodeScrypt::PoolParallel(key_ptrs.size(), [this](size_t begin, size_t end) {
+        unsigned int result = HashMany(
+            &key_ptrs[begin], &key_sizes[begin],
+            &salt_ptrs[begin], &salt_sizes[begin],
+            end - begin,
+            params.N, params.r, params.p,
+            result_ptr + begin * hash_size, hash_size
+        );
+
+        // Keep the first error
+        unsigned int expected = 0;
+        hash_result.compare_exchange_strong(expected, result);
+      });
+
+      if (hash_result != 0) {
+        // Use the common error function description
+        SetError("Scrypt Hash failed: " + NodeScrypt::ScryptErrorMessage(hash_result));
+      }
+    }
+
+    // Executed in main thread after successful Execute
+    void OnOK() override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // Deliver the result buffer to the callback or Promise
+      Resolve(result_ref.Value());
+
+      // Release references
+      inputs_ref.Reset();
+      result_ref.Reset();
+    }
+
+    // Executed in main thread if Execute sets an error
+    void OnError(const Napi::Error& e) override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // Deliver the error to the callback or Promise
+      Reject(e);
+
+      // Release references
+      inputs_ref.Reset();
+      result_ref.Reset();
+    }
+
+  private:
+    Napi::Reference<Napi::Array> inputs_ref;
+    std::vector<NodeScrypt::Bytes> bytes;
+    Napi::Reference<Napi::Buffer<uint8_t>> result_ref;
+    std::vector<const uint8_t*> key_ptrs;
+    std::vector<size_t> key_sizes;
+    std::vector<const uint8_t*> salt_ptrs;
+    std::vector<size_t> salt_sizes;
+    const NodeScrypt::Params params;
+    const size_t hash_size;
+    uint8_t* result_ptr;
+    std::atomic<unsigned int> hash_result; // Store the first error from HashMany
+};
+
+#endif /* _SCRYPTHASHMANYASYNC_ */
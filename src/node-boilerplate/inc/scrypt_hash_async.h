@@ -26,56 +26,58 @@ Barry Steyn barry.steyn@gmail.com
 #define _SCRYPTHASHASYNC_
 
 #include <napi.h>
-#include <vector>
+#include <memory>
 #include <string> // For error messages
-#include "scrypt_common.h" // For Params struct and ScryptError
+#include "scrypt_common.h" // For Params struct and ScryptErrorMessage
+#include "scrypt_async.h" // For ScryptAsyncWorker
 
 // Scrypt is a C library and there needs c linkings
 extern "C" {
   #include "hash.h" // For Hash function (assuming it's in hash.h)
 }
 
-class ScryptHashAsyncWorker : public Napi::AsyncWorker {
+class ScryptHashAsyncWorker : public ScryptAsyncWorker {
   public:
-    ScryptHashAsyncWorker(const Napi::CallbackInfo& info) :
-      Napi::AsyncWorker(info[4].As<Napi::Function>()), // Callback is the 5th argument
+    // With into set, the hash is written to the target (5th argument) at the offset (6th argument)
+    ScryptHashAsyncWorker(const Napi::CallbackInfo& info, bool into = false) :
+      ScryptAsyncWorker(info[into ? 6 : 4]), // Callback follows the other arguments (none for a Promise)
+      key(info[0]), // Key is the 1st argument
       params(info[1].As<Napi::Object>()), // Params object is the 2nd argument
-      hash_size(info[2].As<Napi::Number>().Int64Value()) // Hash size is the 3rd argument
+      hash_size(info[2].As<Napi::Number>().Int64Value()), // Hash size is the 3rd argument
+      salt(info[3]) // Salt is the 4th argument
     {
-      // Get key buffer (1st argument)
-      Napi::Buffer<uint8_t> key_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-      key_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(key_buffer, 1); // Keep buffer alive
-      key_ptr = key_buffer.Data();
-      key_size = key_buffer.Length();
-
-      // Get salt buffer (4th argument)
-      Napi::Buffer<uint8_t> salt_buffer = info[3].As<Napi::Buffer<uint8_t>>();
-      salt_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(salt_buffer, 1); // Keep buffer alive
-      salt_ptr = salt_buffer.Data();
-      salt_size = salt_buffer.Length();
-
-      // Allocate space for the hash result
-      result_data.resize(hash_size);
+      if (into) {
+        target = NodeScrypt::Bytes(info[4]);
+        hash_ptr = target.Data() + info[5].As<Napi::Number>().Int64Value();
+      } else {
+        // Allocate space for the hash result, handed to JavaScript as is
+        result.reset(new uint8_t[hash_size]);
+        hash_ptr = result.get();
+      }
 
       hash_result = 0; // Initialize result code
     }
 
     ~ScryptHashAsyncWorker() {} // Destructor
 
-    // Executed in background thread
-    void Execute() override {
-      // Call the core scrypt Hash function
-      // Assuming signature: Hash(key_ptr, key_size, params.N, params.r, params.p, salt_ptr, salt_size, result_data.data(), hash_size)
-      hash_result = Hash(
-          key_ptr, key_size,
-          salt_ptr, salt_size,
-          params.N, params.r, params.p,
-          result_data.data(), hash_size
-      );
+    // Executed in background thread: the hash is the scrypt computation itself
+    bool Begin(NodeScrypt::Derivation& derivation) override {
+      derivation = {
+          key.Data(), key.Length(),
+          salt.Data(), salt.Length(),
+          static_cast<uint64_t>(params.N), params.r, params.p,
+          hash_ptr, hash_size
+      };
+      return true;
+    }
+
+    // Executed in background thread once the computation is done (or stopped by an AbortSignal)
+    void End(unsigned int result) override {
+      hash_result = result;
 
       if (hash_result != 0) {
         // Use the common error function description
-        SetError("Scrypt Hash failed: " + std::string(NodeScrypt::ScryptError(Env(), hash_result).Message()));
+        SetError("Scrypt Hash failed: " + NodeScrypt::ScryptErrorMessage(hash_result));
       }
     }
 
@@ -84,40 +86,21 @@ class ScryptHashAsyncWorker : public Napi::AsyncWorker {
       Napi::Env env = Env();
       Napi::HandleScope scope(env);
 
-      // Create a new buffer with the hash result
-      Napi::Buffer<uint8_t> result_buffer = Napi::Buffer<uint8_t>::Copy(env, result_data.data(), hash_size);
-
-      // Call the JS callback with null error and the result buffer
-      Callback().Call({env.Null(), result_buffer});
-
-      // Release references
-      key_ref.Reset();
-      salt_ref.Reset();
-    }
-
-    // Executed in main thread if Execute sets an error
-    void OnError(const Napi::Error& e) override {
-      Napi::Env env = Env();
-      Napi::HandleScope scope(env);
-
-      // Call the JS callback with the error
-      Callback().Call({e.Value(), env.Undefined()});
+      // The result is the target, or a buffer which takes over the hash
+      Napi::Value result_value = result ? NodeScrypt::OwnedBuffer(env, result.release(), hash_size) : target.Value();
 
-      // Release references
-      key_ref.Reset();
-      salt_ref.Reset();
+      // Deliver the result buffer to the callback or Promise
+      Resolve(result_value);
     }
 
   private:
-    Napi::Reference<Napi::Buffer<uint8_t>> key_ref;
-    Napi::Reference<Napi::Buffer<uint8_t>> salt_ref;
-    const uint8_t* key_ptr;
-    size_t key_size;
+    const NodeScrypt::Bytes key;
     const NodeScrypt::Params params;
     const size_t hash_size;
-    const uint8_t* salt_ptr;
-    size_t salt_size;
-    std::vector<uint8_t> result_data;
+    const NodeScrypt::Bytes salt;
+    NodeScrypt::Bytes target;
+    std::unique_ptr<uint8_t[]> result;
+    uint8_t* hash_ptr;
     int hash_result; // Store result from Hash
 };
 
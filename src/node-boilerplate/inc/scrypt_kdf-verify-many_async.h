@@ -0,0 +1,117 @@
+#ifndef _KDF_VERIFY_MANY_ASYNC_H
+#define _KDF_VERIFY_MANY_ASYNC_H
+
+#include <napi.h>
+#include <atomic>
+#include <vector>
+#include <string> // For error messages
+#include "scrypt_common.h" // For ScryptErrorMessage
+#include "scrypt_async.h" // For ScryptAsyncWorker
+#include "scrypt_pool.h" // For PoolParallel
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "keyderivation.h" // For VerifyMany function
+}
+
+class ScryptKDFVerifyManyAsyncWorker : public ScryptAsyncWorker {
+  public:
+    ScryptKDFVerifyManyAsyncWorker(const Napi::CallbackInfo& info) :
+      ScryptAsyncWorker(info[2]), // Callback is the 3rd argument
+      verify_result(0)
+    {
+      Napi::Env env = info.Env();
+      Napi::Array kdfs = info[0].As<Napi::Array>();
+      Napi::Array keys = info[1].As<Napi::Array>();
+      const uint32_t count = kdfs.Length();
+
+      // One array keeps every KDF and key alive, whatever the caller does with theirs
+      Napi::Array inputs = Napi::Array::New(env, 2 * count);
+      bytes.reserve(2 * count);
+      kdf_ptrs.resize(count);
+      kdf_sizes.resize(count);
+      key_ptrs.resize(count);
+      key_sizes.resize(count);
+      for (uint32_t i = 0; i < count; i++) {
+        Napi::Value kdf = kdfs.Get(i);
+        Napi::Value key = keys.Get(i);
+        inputs.Set(2 * i, kdf);
+        inputs.Set(2 * i + 1, key);
+        bytes.emplace_back(kdf, false);
+        bytes.emplace_back(key, false);
+        kdf_ptrs[i] = bytes[2 * i].Data();
+        kdf_sizes[i] = bytes[2 * i].Length();
+        key_ptrs[i] = bytes[2 * i + 1].Data();
+        key_sizes[i] = bytes[2 * i + 1].Length();
+      }
+      inputs_ref = Napi::Persistent(inputs);
+
+      matches.resize(count);
+    }
+
+    ~ScryptKDFVerifyManyAsyncWorker() {} // Destructor
+
+    // Executed in background thread
+    void Execute() override {
+      // Spread the pairs over the native pool; each range is verified as one batch
+      NodeScrypt::PoolParallel(kdf_ptrs.size(), [this](size_t begin, size_t end) {
+        unsigned int result = VerifyMany(
+            &kdf_ptrs[begin], &kdf_sizes[begin],
+            &key_ptrs[begin], &key_sizes[begin],
+            end - begin,
+            &matches[begin]
+        );
+
+        // Keep the first error
+        unsigned int expected = 0;
+        verify_result.compare_exchange_strong(expected, result);
+      });
+
+      if (verify_result != 0) {
+        // Use the common error function description
+        SetError("Scrypt KDF verification failed: " + NodeScrypt::ScryptErrorMessage(verify_result));
+      }
+    }
+
+    // Executed in main thread after successful Execute
+    void OnOK() override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // One boolean per pair
+      Napi::Array result = Napi::Array::New(env, matches.size());
+      for (size_t i = 0; i < matches.size(); i++) {
+        result.Set(static_cast<uint32_t>(i), Napi::Boolean::New(env, matches[i] != 0));
+      }
+
+      // Deliver the boolean array to the callback or Promise
+      Resolve(result);
+
+      // Release references
+      inputs_ref.Reset();
+    }
+
+    // Executed in main thread if Execute sets an error
+    void OnError(const Napi::Error& e) override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // Deliver the error to the callback or Promise
+      Reject(e);
+
+      // Release references
+      inputs_ref.Reset();
+    }
+
+  private:
+    Napi::Reference<Napi::Array> inputs_ref;
+    std::vector<NodeScrypt::Bytes> bytes;
+    std::vector<const uint8_t*> kdf_ptrs;
+    std::vector<size_t> kdf_sizes;
+    std::vector<const uint8_t*> key_ptrs;
+    std::vector<size_t> key_sizes;
+    std::vector<uint8_t> matches;
+    std::atomic<unsigned int> verify_result; // Store the first error from VerifyMany
+};
+
+#endif /* _KDF_VERIFY_MANY_ASYNC_H */
@@ -26,46 +26,53 @@ Barry Steyn barry.steyn@gmail.com
 #define _KDF_VERIFY_ASYNC_H
 
 #include <napi.h>
-#include <vector>
 #include <string> // For error messages
 #include "scrypt_common.h" // For ScryptError (if needed for Verify errors)
+#include "scrypt_async.h" // For ScryptAsyncWorker
 
 // Scrypt is a C library and there needs c linkings
 extern "C" {
-  #include "keyderivation.h" // For Verify function
+  #include "keyderivation.h" // For VerifyBegin and VerifyEnd
+  #include "insecure_memzero.h" // For cleaning the derived key
 }
 
-class ScryptKDFVerifyAsyncWorker : public Napi::AsyncWorker {
+class ScryptKDFVerifyAsyncWorker : public ScryptAsyncWorker {
   public:
     ScryptKDFVerifyAsyncWorker(const Napi::CallbackInfo& info) :
-      Napi::AsyncWorker(info[2].As<Napi::Function>()) // Callback is the 3rd argument
+      ScryptAsyncWorker(info[2]), // Callback is the 3rd argument (none for a Promise)
+      kdf(info[0]), // KDF is the 1st argument
+      key(info[1]) // Key is the 2nd argument
     {
-      // Napi::Env env = info.Env(); // Unused variable
-      // Get KDF buffer (1st argument)
-      Napi::Buffer<uint8_t> kdf_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-      kdf_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(kdf_buffer, 1); // Keep buffer alive
-      kdf_ptr = kdf_buffer.Data();
-      // Assuming Verify function needs the KDF buffer size (often fixed, e.g., 96)
-      kdf_size = kdf_buffer.Length(); // Get size from buffer
-
-      // Get key buffer (2nd argument)
-      Napi::Buffer<uint8_t> key_buffer = info[1].As<Napi::Buffer<uint8_t>>();
-      key_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(key_buffer, 1); // Keep buffer alive
-      key_ptr = key_buffer.Data();
-      key_size = key_buffer.Length();
-
       match = false; // Initialize match result
       verify_result = 0; // Initialize verification result code
     }
 
     ~ScryptKDFVerifyAsyncWorker() {} // Destructor
 
-    // Executed in background thread
-    void Execute() override {
-      // Call the core scrypt KDF verification function
-      // Note: The original Verify function signature might differ slightly.
-      // Assuming it takes kdf_ptr, key_ptr, key_size
-      verify_result = Verify(kdf_ptr, key_ptr, key_size);
+    // Executed in background thread: the verification, around the scrypt computation
+    bool Begin(NodeScrypt::Derivation& derivation) override {
+      uint32_t logN = 0, r = 0, p = 0;
+
+      // Check the format and read the parameters (a KDF too short to hold the format is not a valid block)
+      verify_result = (kdf.Length() < 96) ? 7 : VerifyBegin(kdf.Data(), &logN, &r, &p);
+      if (verify_result != 0) {
+        SetError("Scrypt KDF verification failed: " + NodeScrypt::ScryptErrorMessage(verify_result));
+        return false;
+      }
+
+      derivation = {
+          key.Data(), key.Length(),
+          kdf.Data() + 16, 32,
+          logN, r, p,
+          dk, sizeof(dk)
+      };
+      return true;
+    }
+
+    // Executed in background thread once the computation is done (or stopped by an AbortSignal)
+    void End(unsigned int derived) override {
+      verify_result = derived ? derived : VerifyEnd(kdf.Data(), dk);
+      insecure_memzero(dk, sizeof(dk));
 
       // Check the result
       if (verify_result == 0) {
@@ -74,9 +81,7 @@ class ScryptKDFVerifyAsyncWorker : public Napi::AsyncWorker {
         match = false; // Verification failed (mismatch)
       } else {
         // Handle other potential errors from Verify
-        // Use the common error function description if available for Verify errors
-        // Or provide a generic error message.
-        SetError("Scrypt KDF verification failed with error code: " + std::to_string(verify_result));
+        SetError("Scrypt KDF verification failed: " + NodeScrypt::ScryptErrorMessage(verify_result));
       }
     }
 
@@ -88,34 +93,14 @@ class ScryptKDFVerifyAsyncWorker : public Napi::AsyncWorker {
       // Create a boolean result value
       Napi::Boolean result_value = Napi::Boolean::New(env, match);
 
-      // Call the JS callback with null error and the boolean result
-      Callback().Call({env.Null(), result_value});
-
-      // Release references
-      kdf_ref.Reset();
-      key_ref.Reset();
-    }
-
-    // Executed in main thread if Execute sets an error
-    void OnError(const Napi::Error& e) override {
-      Napi::Env env = Env();
-      Napi::HandleScope scope(env);
-
-      // Call the JS callback with the error
-      Callback().Call({e.Value(), env.Undefined()});
-
-      // Release references
-      kdf_ref.Reset();
-      key_ref.Reset();
+      // Deliver the boolean result to the callback or Promise
+      Resolve(result_value);
     }
 
   private:
-    Napi::Reference<Napi::Buffer<uint8_t>> kdf_ref;
-    Napi::Reference<Napi::Buffer<uint8_t>> key_ref;
-    const uint8_t* kdf_ptr;
-    size_t kdf_size; // Added size for KDF buffer
-    const uint8_t* key_ptr;
-    size_t key_size;
+    const NodeScrypt::Bytes kdf;
+    const NodeScrypt::Bytes key;
+    uint8_t dk[64]; // The derived keys which signed the KDF
     bool match;
     int verify_result; // Store result from Verify
 };
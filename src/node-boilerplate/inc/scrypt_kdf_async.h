@@ -26,66 +26,60 @@ Barry Steyn barry.steyn@gmail.com
 #define _SCRYPT_KDF_ASYNC_H
 
 #include <napi.h>
-#include <vector>
+#include <cstring>
+#include <memory>
 #include <string> // For error messages
-#include "scrypt_common.h" // For Params struct and ScryptError
+#include "scrypt_common.h" // For Params struct and ScryptErrorMessage
+#include "scrypt_async.h" // For ScryptAsyncWorker
 
 // Scrypt is a C library and there needs c linkings
 extern "C" {
-  #include "keyderivation.h" // For KDF wrapper function
+  #include "keyderivation.h" // For KDFBegin and KDFEnd
+  #include "insecure_memzero.h" // For cleaning the derived key
 }
 
-class ScryptKDFAsyncWorker : public Napi::AsyncWorker {
+class ScryptKDFAsyncWorker : public ScryptAsyncWorker {
   public:
     ScryptKDFAsyncWorker(const Napi::CallbackInfo& info) :
-      Napi::AsyncWorker(info[3].As<Napi::Function>()), // Callback is the 4th argument
-      params(info[1].As<Napi::Object>()) // Params object is the 2nd argument
+      ScryptAsyncWorker(info[2]), // Callback is the 3rd argument (none for a Promise)
+      key(info[0]), // Key is the 1st argument
+      params(info[1].As<Napi::Object>()), // Params object is the 2nd argument
+      result(new uint8_t[96]) // The KDF format is 96 bytes long, handed to JavaScript as is
     {
-      // Napi::Env env = info.Env(); // Removed unused variable
-      // Get key buffer (1st argument)
-      Napi::Buffer<uint8_t> key_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-      key_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(key_buffer, 1); // Keep buffer alive
-      key_ptr = key_buffer.Data();
-      key_size = key_buffer.Length();
-
-      // Get salt buffer (3rd argument)
-      Napi::Buffer<uint8_t> salt_buffer = info[2].As<Napi::Buffer<uint8_t>>();
-      salt_ref = Napi::Reference<Napi::Buffer<uint8_t>>::New(salt_buffer, 1); // Keep buffer alive
-      salt_ptr = salt_buffer.Data();
-      salt_size = salt_buffer.Length(); // Need salt size for crypto_scrypt
-
-      // Determine output buffer size (hardcoded as 96 in original code)
-      // TODO: Make this configurable or derive from parameters if possible
-      result_size = 96;
-      result_data.resize(result_size);
-
       scrypt_result = 0; // Initialize result code
     }
 
     ~ScryptKDFAsyncWorker() {} // Destructor
 
-    // Executed in background thread
-    void Execute() override {
-      // Ensure pointers are still valid (though References should handle this)
-      // Re-acquire pointers just in case, Napi::Reference::Value() might be safer
-      // but requires Env which is not available here. Assuming direct pointers are okay for now.
-      // uint8_t* current_key_ptr = key_ref.Value().Data();
-      // uint8_t* current_salt_ptr = salt_ref.Value().Data();
-
-      // Call the KDF wrapper function
-      // KDF(const uint8_t* key_ptr, size_t key_size, uint8_t* result_ptr, uint32_t N, uint32_t r, uint32_t p, const uint8_t* salt_ptr)
-      scrypt_result = KDF(
-          key_ptr, key_size,
-          result_data.data(), // Output buffer
-          params.N, params.r, params.p,
-          salt_ptr // Salt buffer
-      );
-      // Note: salt_size and result_size are not passed directly to KDF wrapper
+    // Executed in background thread: the KDF wrapper, around the scrypt computation
+    bool Begin(NodeScrypt::Derivation& derivation) override {
+      // The parameters and salt go first (the salt is drawn on this pool thread)
+      scrypt_result = KDFBegin(result.get(), params.N, params.r, params.p, NULL);
+      if (scrypt_result != 0) {
+        SetError("Scrypt KDF failed: " + NodeScrypt::ScryptErrorMessage(scrypt_result));
+        return false;
+      }
+
+      derivation = {
+          key.Data(), key.Length(),
+          result.get() + 16, 32,
+          static_cast<uint64_t>(params.N), params.r, params.p,
+          dk, sizeof(dk)
+      };
+      return true;
+    }
+
+    // Executed in background thread once the computation is done (or stopped by an AbortSignal)
+    void End(unsigned int derived) override {
+      scrypt_result = derived;
 
       if (scrypt_result != 0) {
         // Use the common error function description
-        SetError("Scrypt KDF failed: " + std::string(NodeScrypt::ScryptError(Env(), scrypt_result).Message()));
+        SetError("Scrypt KDF failed: " + NodeScrypt::ScryptErrorMessage(scrypt_result));
+      } else {
+        KDFEnd(result.get(), dk);
       }
+      insecure_memzero(dk, sizeof(dk));
     }
 
     // Executed in main thread after successful Execute
@@ -93,40 +87,15 @@ class ScryptKDFAsyncWorker : public Napi::AsyncWorker {
       Napi::Env env = Env();
       Napi::HandleScope scope(env);
 
-      // Create a new buffer with the derived key
-      Napi::Buffer<uint8_t> result_buffer = Napi::Buffer<uint8_t>::Copy(env, result_data.data(), result_size);
-
-      // Call the JS callback with null error and the result buffer
-      Callback().Call({env.Null(), result_buffer});
-
-      // Release references
-      key_ref.Reset();
-      salt_ref.Reset();
-    }
-
-    // Executed in main thread if Execute sets an error
-    void OnError(const Napi::Error& e) override {
-      Napi::Env env = Env();
-      Napi::HandleScope scope(env);
-
-      // Call the JS callback with the error
-      Callback().Call({e.Value(), env.Undefined()});
-
-      // Release references
-      key_ref.Reset();
-      salt_ref.Reset();
+      // Deliver a buffer which takes over the derived key to the callback or Promise
+      Resolve(NodeScrypt::OwnedBuffer(env, result.release(), 96));
     }
 
   private:
-    Napi::Reference<Napi::Buffer<uint8_t>> key_ref;
-    Napi::Reference<Napi::Buffer<uint8_t>> salt_ref;
-    const uint8_t* key_ptr;
-    size_t key_size;
-    const uint8_t* salt_ptr;
-    size_t salt_size;
+    const NodeScrypt::Bytes key;
     const NodeScrypt::Params params;
-    size_t result_size;
-    std::vector<uint8_t> result_data;
+    std::unique_ptr<uint8_t[]> result;
+    uint8_t dk[64]; // The derived keys which sign the KDF
     int scrypt_result;
 };
 
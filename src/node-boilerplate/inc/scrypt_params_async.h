@@ -25,7 +25,8 @@ Barry Steyn barry.steyn@gmail.com
 #ifndef _SCRYPT_PARAMS_ASYNC_H
 #define _SCRYPT_PARAMS_ASYNC_H
 
-#include <napi.h> // Replace scrypt_async.h and nan includes implicitly
+#include <napi.h>
+#include "scrypt_async.h" // For ScryptAsyncWorker
 #include <string> // For std::to_string in error handling
 
 // Scrypt is a C library and there needs c linkings
@@ -33,11 +34,11 @@ extern "C" {
   #include "pickparams.h" // Keep C library include
 }
 
-// Async class derived from Napi::AsyncWorker
-class ScryptParamsAsyncWorker : public Napi::AsyncWorker {
+// Async class derived from ScryptAsyncWorker
+class ScryptParamsAsyncWorker : public ScryptAsyncWorker {
   public:
     ScryptParamsAsyncWorker(const Napi::CallbackInfo& info) :
-      Napi::AsyncWorker(info[4].As<Napi::Function>()), // Pass callback directly
+      ScryptAsyncWorker(info[4]), // Pass callback directly
       maxtime(info[0].As<Napi::Number>().DoubleValue()),
       maxmemfrac(info[1].As<Napi::Number>().DoubleValue()),
       maxmem(info[2].As<Napi::Number>().Int64Value()), // Assuming size_t fits int64_t for Node.js limits
@@ -49,7 +50,7 @@ class ScryptParamsAsyncWorker : public Napi::AsyncWorker {
       result = 0; // Initialize result
     }
 
-    ~ScryptParamsAsyncWorker() {} // Destructor needed for Napi::AsyncWorker
+    ~ScryptParamsAsyncWorker() {} // Destructor
 
     // This method is executed in a separate thread.
     void Execute() override {
@@ -73,16 +74,16 @@ class ScryptParamsAsyncWorker : public Napi::AsyncWorker {
       obj.Set(Napi::String::New(env, "r"), Napi::Number::New(env, r));
       obj.Set(Napi::String::New(env, "p"), Napi::Number::New(env, p));
 
-      // Call the JS callback with null error and the result object
-      Callback().Call({env.Null(), obj});
+      // Deliver the result object to the callback or Promise
+      Resolve(obj);
     }
 
     // Optional: Handle errors if Execute fails
     void OnError(const Napi::Error& e) override {
         Napi::Env env = Env();
         Napi::HandleScope scope(env);
-        // Call the JS callback with the error object
-        Callback().Call({e.Value(), env.Undefined()});
+        // Deliver the error object to the callback or Promise
+        Reject(e);
     }
 
 
@@ -98,4 +99,61 @@ class ScryptParamsAsyncWorker : public Napi::AsyncWorker {
     int result; // Store result from pickparams
 };
 
+// Async class for params for a throughput, derived from ScryptAsyncWorker
+class ScryptParamsThroughputAsyncWorker : public ScryptAsyncWorker {
+  public:
+    ScryptParamsThroughputAsyncWorker(const Napi::CallbackInfo& info) :
+      ScryptAsyncWorker(info[4]), // Pass callback directly
+      verifies(info[0].As<Napi::Number>().DoubleValue()),
+      concurrency(info[1].As<Napi::Number>().Uint32Value()),
+      maxmem(info[2].As<Napi::Number>().Int64Value()),
+      osfreemem(info[3].As<Napi::Number>().Int64Value()),
+      logN(0),
+      r(0),
+      p(0),
+      result(0)
+    {}
+
+    // This method is executed in a separate thread (which measures concurrency hashes at once the first time)
+    void Execute() override {
+      result = pickparams_throughput(&logN, &r, &p, verifies, concurrency, maxmem, osfreemem);
+      if (result != 0) {
+         SetError("Scrypt pickparams failed with error code: " + std::to_string(result));
+      }
+    }
+
+    // This method is executed in the main thread after Execute() completes.
+    void OnOK() override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // Returned params in JSON object
+      Napi::Object obj = Napi::Object::New(env);
+      obj.Set(Napi::String::New(env, "N"), Napi::Number::New(env, logN));
+      obj.Set(Napi::String::New(env, "r"), Napi::Number::New(env, r));
+      obj.Set(Napi::String::New(env, "p"), Napi::Number::New(env, p));
+
+      // Deliver the result object to the callback or Promise
+      Resolve(obj);
+    }
+
+    void OnError(const Napi::Error& e) override {
+        Napi::Env env = Env();
+        Napi::HandleScope scope(env);
+        // Deliver the error object to the callback or Promise
+        Reject(e);
+    }
+
+  private:
+    const double verifies;
+    const uint32_t concurrency;
+    const size_t maxmem;
+    const size_t osfreemem;
+
+    int logN;
+    uint32_t r;
+    uint32_t p;
+    int result; // Store result from pickparams_throughput
+};
+
 #endif /* _SCRYPT_PARAMS_ASYNC_H */
@@ -0,0 +1,64 @@
+#ifndef _SCRYPTPBKDF2ASYNC_
+#define _SCRYPTPBKDF2ASYNC_
+
+#include <napi.h>
+#include <memory>
+#include <string> // For error messages
+#include "scrypt_common.h" // For ScryptErrorMessage
+#include "scrypt_async.h" // For ScryptAsyncWorker
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "hash.h" // For Pbkdf2 function
+}
+
+class ScryptPbkdf2AsyncWorker : public ScryptAsyncWorker {
+  public:
+    ScryptPbkdf2AsyncWorker(const Napi::CallbackInfo& info) :
+      ScryptAsyncWorker(info[4]), // Callback is the 5th argument (none for a Promise)
+      key(info[0]), // Key is the 1st argument
+      salt(info[1]), // Salt is the 2nd argument
+      iterations(info[2].As<Napi::Number>().Int64Value()), // Iterations is the 3rd argument
+      key_length(info[3].As<Napi::Number>().Int64Value()), // Key length is the 4th argument
+      result(new uint8_t[key_length]) // The derived key, handed to JavaScript as is
+    {
+      pbkdf2_result = 0; // Initialize result code
+    }
+
+    ~ScryptPbkdf2AsyncWorker() {} // Destructor
+
+    // Executed in background thread
+    void Execute() override {
+      // PBKDF2-HMAC-SHA256, with the output blocks spread over threads
+      pbkdf2_result = Pbkdf2(
+          key.Data(), key.Length(),
+          salt.Data(), salt.Length(),
+          iterations,
+          result.get(), key_length
+      );
+
+      if (pbkdf2_result != 0) {
+        // Use the common error function description
+        SetError("Scrypt PBKDF2 failed: " + NodeScrypt::ScryptErrorMessage(pbkdf2_result));
+      }
+    }
+
+    // Executed in main thread after successful Execute
+    void OnOK() override {
+      Napi::Env env = Env();
+      Napi::HandleScope scope(env);
+
+      // Deliver a buffer which takes over the derived key to the callback or Promise
+      Resolve(NodeScrypt::OwnedBuffer(env, result.release(), key_length));
+    }
+
+  private:
+    const NodeScrypt::Bytes key;
+    const NodeScrypt::Bytes salt;
+    const uint64_t iterations;
+    const size_t key_length;
+    std::unique_ptr<uint8_t[]> result;
+    int pbkdf2_result; // Store result from Pbkdf2
+};
+
+#endif /* _SCRYPTPBKDF2ASYNC_ */
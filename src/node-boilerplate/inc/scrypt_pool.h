@@ -0,0 +1,106 @@
+#ifndef _SCRYPTPOOL_H_
+#define _SCRYPTPOOL_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace NodeScrypt {
+
+  //
+  // A unit of work for the native scrypt thread pool
+  //
+  class PoolTask {
+    public:
+      virtual ~PoolTask() {}
+
+      // Executed on a pool thread; the task may be freed as soon as this returns
+      virtual void Run() = 0;
+
+      // Executed instead of Run when the pool gives up on an admitted task,
+      // with the Scrypt error code saying why; the default runs it anyway
+      virtual void Shed(unsigned int error) { (void)error; Run(); }
+
+      // The caller's deadline; the queue runs the earliest first, and sheds a
+      // task still queued after it
+      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+      // Breaks ties between equal deadlines (including none): higher runs first
+      int priority = 0;
+
+      // Set by PoolAdmit from the maximum queue wait; a task still queued after this is shed
+      std::chrono::steady_clock::time_point expires = std::chrono::steady_clock::time_point::max();
+  };
+
+  //
+  // Statistics returned by PoolStats
+  //
+  struct PoolStatistics {
+    size_t threads; // Threads currently running
+    size_t busy;    // Threads currently running a task
+    size_t queued;  // Tasks waiting for a thread
+    uint64_t rejected; // Tasks turned away because the queue was full
+    uint64_t expired;  // Tasks shed because they waited too long
+    uint64_t missed;   // Tasks shed because their deadline passed
+  };
+
+  //
+  // Scrypt error codes (see InternalErrorDescr) for tasks the pool turns away,
+  // and for tasks their caller aborts
+  //
+  const unsigned int PoolErrorQueueFull = 14;
+  const unsigned int PoolErrorQueueWait = 15;
+  const unsigned int PoolErrorDeadline = 16;
+  const unsigned int PoolErrorAborted = 17;
+
+  //
+  // The pool is process-wide: every isolate (main thread and worker_threads)
+  // which loads the addon shares it. Its threads are separate from the libuv
+  // pool, so long scrypt computations don't hold up fs, dns.lookup or zlib.
+  //
+
+  // Queue a task; threads are started lazily, up to the configured size. The
+  // queue is ordered by deadline, then priority, then arrival
+  void PoolSubmit(PoolTask* task);
+
+  // Queue a task on behalf of a caller, subject to the queue limits; returns 0,
+  // or PoolErrorQueueFull or PoolErrorDeadline if the task was turned away (and not queued)
+  unsigned int PoolAdmit(PoolTask* task);
+
+  // Remove a task which no thread has started yet; returns true if it was removed
+  bool PoolCancel(PoolTask* task);
+
+  // Split [0, count) into contiguous ranges, at most one per pool thread, and call
+  // fn(begin, end) for each. The calling thread takes the first range, plus any
+  // range no pool thread has started by the time it is done, so this is safe to
+  // call from a pool thread. Returns once every range is done.
+  void PoolParallel(size_t count, const std::function<void(size_t, size_t)>& fn);
+
+  // Set the number of threads (0 means one per CPU) and the CPUs they may run on (empty means any)
+  void PoolConfigure(size_t threads, const std::vector<int>& cpus);
+
+  // Get the configured number of threads (0 for one per CPU) and the CPUs they may run on
+  void PoolGetConfig(size_t* threads, std::vector<int>* cpus);
+
+  // Set the longest queue PoolAdmit accepts and the longest a task it admitted
+  // may wait for a thread, in milliseconds (0 means no limit for either)
+  void PoolSetLimits(size_t max_queue, uint64_t max_wait);
+
+  // Get the queue limits
+  void PoolGetLimits(size_t* max_queue, uint64_t* max_wait);
+
+  // Set the longest a task which runs in slices keeps a thread while other
+  // tasks are queued, in milliseconds, before it queues itself again behind
+  // them (0 means it never does)
+  void PoolSetTimeSlice(uint64_t time_slice);
+
+  // Get the time slice
+  uint64_t PoolGetTimeSlice();
+
+  // Get the pool statistics
+  void PoolStats(PoolStatistics* stats);
+};
+
+#endif /* _SCRYPTPOOL_H_ */
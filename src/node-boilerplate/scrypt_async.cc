@@ -0,0 +1,475 @@
+#include "scrypt_async.h" // Includes napi.h, scrypt_common.h, scrypt_pool.h
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "crypto_scrypt.h" // For the sliced jobs
+  #include "crypto_scrypt_budget.h" // For the memory budget
+  #include "hash.h" // For Hash and HashStart
+}
+
+#include <chrono>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+namespace {
+  // Freed workers of each size kept for reuse
+  const size_t RecycleDepth = 16;
+
+  //
+  // Freed worker memory, by size. A worker is created and deleted on the JS
+  // thread of its isolate, so every thread keeps its own lists without a lock
+  //
+  class WorkerRecycler {
+    public:
+      ~WorkerRecycler() {
+        for (auto& bin : bins) {
+          for (void* ptr : bin.second) {
+            ::operator delete(ptr);
+          }
+        }
+      }
+
+      void* Take(size_t size) {
+        for (auto& bin : bins) {
+          if (bin.first == size && !bin.second.empty()) {
+            void* ptr = bin.second.back();
+            bin.second.pop_back();
+            return ptr;
+          }
+        }
+        return ::operator new(size);
+      }
+
+      void Give(void* ptr, size_t size) {
+        for (auto& bin : bins) {
+          if (bin.first == size) {
+            if (bin.second.size() < RecycleDepth) {
+              bin.second.push_back(ptr);
+            } else {
+              ::operator delete(ptr);
+            }
+            return;
+          }
+        }
+        bins.emplace_back(size, std::vector<void*>(1, ptr));
+      }
+
+    private:
+      std::vector<std::pair<size_t, std::vector<void*>>> bins;
+  };
+
+  thread_local WorkerRecycler recycler;
+
+  //
+  // Whether a sliced job should give up its thread: only if something is
+  // queued. The job hands its share of the memory budget back while it
+  // waits (see crypto_scrypt_job_park), so the work it lets in never waits
+  // for memory which a queued job holds
+  //
+  bool ShouldYield() {
+    NodeScrypt::PoolStatistics pool;
+    NodeScrypt::PoolStats(&pool);
+    return pool.queued > 0;
+  }
+
+  //
+  // A steady_clock deadline as a time on the memory budget's own clock
+  // (see crypto_scrypt_budget_now)
+  //
+  void DeadlineTimespec(std::chrono::steady_clock::time_point deadline, struct timespec* ts) {
+    const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+    const long long nanoseconds = remaining > 0 ? remaining : 1;
+
+    crypto_scrypt_budget_now(ts);
+    ts->tv_sec += static_cast<time_t>(nanoseconds / 1000000000);
+    ts->tv_nsec += static_cast<long>(nanoseconds % 1000000000);
+    if (ts->tv_nsec >= 1000000000) {
+      ts->tv_sec++;
+      ts->tv_nsec -= 1000000000;
+    }
+  }
+}
+
+ScryptAsyncWorker::ScryptAsyncWorker(const Napi::Value& callback) :
+  aborted(0),
+  env(callback.Env()),
+  error_code(0),
+  has_error(false),
+  missed(false),
+  derivation(),
+  job(nullptr),
+  has_progress(false),
+  progress_percent(0),
+  finished(false)
+{
+  if (callback.IsFunction()) {
+    this->callback = Napi::Persistent(callback.As<Napi::Function>());
+  } else {
+    deferred.emplace(Napi::Promise::Deferred::New(env));
+  }
+}
+
+ScryptAsyncWorker::~ScryptAsyncWorker() {
+  // Only an isolate which exited leaves a job behind
+  if (job != nullptr) {
+    crypto_scrypt_job_free(job);
+  }
+}
+
+void* ScryptAsyncWorker::operator new(size_t size) {
+  return recycler.Take(size);
+}
+
+void ScryptAsyncWorker::operator delete(void* ptr, size_t size) {
+  recycler.Give(ptr, size);
+}
+
+//
+// Takes the deadline, priority, AbortSignal and onProgress function of an options object (JS thread)
+//
+void ScryptAsyncWorker::Schedule(const Napi::Value& options) {
+  if (!options.IsObject()) {
+    return;
+  }
+
+  Napi::Object schedule = options.As<Napi::Object>();
+  Napi::Value deadline = schedule.Get("deadline");
+  Napi::Value priority = schedule.Get("priority");
+  Napi::Value signal = schedule.Get("signal");
+  Napi::Value onprogress = schedule.Get("onProgress");
+
+  // The pool keeps time on the steady clock, JavaScript on the system clock
+  if (deadline.IsNumber()) {
+    const double remaining = deadline.As<Napi::Number>().DoubleValue() -
+      std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+    const auto now = std::chrono::steady_clock::now();
+
+    if (remaining <= 0) {
+      this->deadline = now - std::chrono::steady_clock::duration(1);
+    } else if (remaining < std::chrono::duration<double, std::milli>(std::chrono::steady_clock::time_point::max() - now).count()) {
+      this->deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(remaining));
+    }
+  }
+  if (priority.IsNumber()) {
+    this->priority = priority.As<Napi::Number>().Int32Value();
+  }
+
+  // An aborted signal fails the call in Queue; otherwise listen until the result is delivered
+  if (signal.IsObject()) {
+    Napi::Object object = signal.As<Napi::Object>();
+    Napi::Value add = object.Get("addEventListener");
+
+    if (object.Get("aborted").ToBoolean()) {
+      aborted = 1;
+    } else if (add.IsFunction()) {
+      Napi::Function onabort = Napi::Function::New(env, OnAbort, "onabort", this);
+      add.As<Napi::Function>().Call(object, {Napi::String::New(env, "abort"), onabort});
+      this->signal = Napi::Persistent(object);
+      listener = Napi::Persistent(onabort);
+    }
+  }
+
+  if (onprogress.IsFunction()) {
+    progress = Napi::Persistent(onprogress.As<Napi::Function>());
+    has_progress = true;
+  }
+}
+
+//
+// Hands the work to the native pool (JS thread)
+//
+void ScryptAsyncWorker::Queue() {
+  // The ThreadSafeFunction keeps the event loop alive until the result is delivered (a Promise worker has no function to give it)
+  tsfn = Napi::ThreadSafeFunction::New(env, deferred ? Napi::Function() : callback.Value(), "scrypt", 0, 1, this, Finalize);
+
+  // An isolate which exits must not free the inputs while a pool thread reads them
+  napi_add_env_cleanup_hook(env, Abandon, this);
+
+  // A full queue, a missed deadline or an aborted signal fails the call straight away, but still through the callback or Promise
+  const unsigned int result = aborted ? NodeScrypt::PoolErrorAborted : NodeScrypt::PoolAdmit(this);
+  if (result) {
+    Shed(result);
+  }
+}
+
+Napi::Value ScryptAsyncWorker::Promise() const {
+  return deferred ? deferred->Promise() : Env().Undefined();
+}
+
+//
+// Runs Begin, the scrypt computation and End, or starts the computation as a
+// job which Run carries on with (pool thread)
+//
+void ScryptAsyncWorker::Execute() {
+  if (!Begin(derivation)) {
+    return;
+  }
+
+  // Until the computation has its memory, its deadline and signal may still stop it
+  struct timespec wait_until;
+  if (deadline != std::chrono::steady_clock::time_point::max()) {
+    DeadlineTimespec(deadline, &wait_until);
+    crypto_scrypt_budget_wait(&wait_until);
+  }
+
+  // A job step is about a millisecond, so a job longer than the time slice is worth slicing
+  const uint64_t time_slice = NodeScrypt::PoolGetTimeSlice();
+  unsigned int result;
+  if (has_progress || (time_slice > 0 && crypto_scrypt_job_steps(static_cast<uint64_t>(1) << derivation.logN, derivation.r, derivation.p) > time_slice)) {
+    result = HashStart(&job, derivation.key, derivation.keylen, derivation.salt, derivation.saltlen,
+                       derivation.logN, derivation.r, derivation.p, derivation.buflen, &aborted);
+  } else {
+    result = Hash(derivation.key, derivation.keylen, derivation.salt, derivation.saltlen,
+                  derivation.logN, derivation.r, derivation.p, derivation.buf, derivation.buflen, &aborted);
+  }
+  crypto_scrypt_budget_wait(NULL);
+
+  missed = (result == NodeScrypt::PoolErrorDeadline);
+  if (job == nullptr) {
+    End(result);
+  }
+}
+
+bool ScryptAsyncWorker::Begin(NodeScrypt::Derivation& derivation) {
+  (void)derivation;
+  return false;
+}
+
+void ScryptAsyncWorker::End(unsigned int result) {
+  (void)result;
+}
+
+//
+// Default error handler: calls back with the error only
+//
+void ScryptAsyncWorker::OnError(const Napi::Error& e) {
+  Napi::Env env = Env();
+  Napi::HandleScope scope(env);
+
+  Reject(e);
+}
+
+void ScryptAsyncWorker::Resolve(const Napi::Value& result) {
+  if (deferred) {
+    deferred->Resolve(result);
+  } else {
+    callback.Call({Env().Null(), result});
+  }
+}
+
+void ScryptAsyncWorker::Reject(const Napi::Error& e) {
+  if (deferred) {
+    deferred->Reject(e.Value());
+  } else {
+    callback.Call({e.Value(), Env().Undefined()});
+  }
+}
+
+void ScryptAsyncWorker::SetError(const std::string& message) {
+  error = message;
+  has_error = true;
+}
+
+Napi::Env ScryptAsyncWorker::Env() const {
+  return Napi::Env(env);
+}
+
+//
+// Runs the work, then posts the result back (pool thread)
+//
+void ScryptAsyncWorker::Run() {
+  // A job carries on from its last slice, and may be queued again rather than finish
+  if (job == nullptr) {
+    Execute();
+  }
+  if (job != nullptr && !Slice()) {
+    return;
+  }
+
+  // The computation failed because it was stopped, or its deadline passed
+  // while it waited for memory, so report it the way the pool would have
+  if (aborted && has_error) {
+    error_code = NodeScrypt::PoolErrorAborted;
+  } else if (missed && has_error) {
+    error_code = NodeScrypt::PoolErrorDeadline;
+  }
+  Post();
+}
+
+//
+// Steps the job until it is done, or until it has had its time slice while
+// other work is queued; it then queues itself again behind that work, and
+// returns false without touching the worker again (pool thread)
+//
+bool ScryptAsyncWorker::Slice() {
+  const auto start = std::chrono::steady_clock::now();
+  const auto time_slice = std::chrono::milliseconds(NodeScrypt::PoolGetTimeSlice());
+
+  // A job which yielded takes its share of the memory budget back first;
+  // only its signal can stop that wait
+  const bool resumed = crypto_scrypt_job_resume(job, &aborted) == 0;
+
+  for (;;) {
+    if (!resumed || aborted) {
+      crypto_scrypt_job_free(job);
+      job = nullptr;
+      End(NodeScrypt::PoolErrorAborted);
+      return true;
+    }
+
+    const bool done = crypto_scrypt_job_step(job);
+    if (has_progress) {
+      Progress();
+    }
+    if (done) {
+      crypto_scrypt_job_finish(job, derivation.buf, derivation.buflen);
+      job = nullptr;
+      End(0);
+      return true;
+    }
+
+    if (time_slice.count() > 0 && std::chrono::steady_clock::now() - start >= time_slice && ShouldYield()) {
+      // The work has started, so its deadline and the queue wait limit no longer apply
+      deadline = std::chrono::steady_clock::time_point::max();
+      expires = std::chrono::steady_clock::time_point::max();
+      crypto_scrypt_job_park(job);
+      NodeScrypt::PoolSubmit(this);
+      return false;
+    }
+  }
+}
+
+//
+// Reports the progress of the job, each time it grows by a percent (pool thread)
+//
+void ScryptAsyncWorker::Progress() {
+  uint64_t done = 0, total = 0;
+  crypto_scrypt_job_progress(job, &done, &total);
+
+  const double fraction = static_cast<double>(done) / static_cast<double>(total);
+  const unsigned int percent = static_cast<unsigned int>(fraction * 100);
+  if (percent <= progress_percent) {
+    return;
+  }
+  progress_percent = percent;
+
+  // Queued ahead of the result, so every report arrives before it
+  tsfn.NonBlockingCall(this, [fraction](Napi::Env env, Napi::Function, ScryptAsyncWorker* worker) {
+    if (env != nullptr) {
+      Napi::HandleScope scope(env);
+      worker->progress.Call({Napi::Number::New(env, fraction)});
+    }
+  });
+}
+
+//
+// Fails the work without running it (pool thread, or JS thread if never queued)
+//
+void ScryptAsyncWorker::Shed(unsigned int error) {
+  // A job taken off the queue between slices hands its memory back straight away
+  if (job != nullptr) {
+    crypto_scrypt_job_free(job);
+    job = nullptr;
+  }
+
+  error_code = error;
+  has_error = true;
+  Post();
+}
+
+//
+// Stops the work: queued work fails at once, running work at its next check (JS thread)
+//
+void ScryptAsyncWorker::Abort() {
+  aborted = 1;
+  if (NodeScrypt::PoolCancel(this)) {
+    Shed(NodeScrypt::PoolErrorAborted);
+  }
+}
+
+//
+// The "abort" listener, with the worker as its data (JS thread)
+//
+Napi::Value ScryptAsyncWorker::OnAbort(const Napi::CallbackInfo& info) {
+  static_cast<ScryptAsyncWorker*>(info.Data())->Abort();
+  return info.Env().Undefined();
+}
+
+//
+// Takes the "abort" listener off the signal, which may outlive the worker (JS thread)
+//
+void ScryptAsyncWorker::Unlisten() {
+  if (signal.IsEmpty()) {
+    return;
+  }
+
+  Napi::Object object = signal.Value();
+  Napi::Value remove = object.Get("removeEventListener");
+  if (remove.IsFunction()) {
+    remove.As<Napi::Function>().Call(object, {Napi::String::New(Env(), "abort"), listener.Value()});
+  }
+  signal.Reset();
+  listener.Reset();
+}
+
+//
+// Posts the result back to the JS thread
+//
+void ScryptAsyncWorker::Post() {
+  // Finalize takes the same lock before deleting the worker
+  std::lock_guard<std::mutex> lock(mutex);
+  if (tsfn.BlockingCall(this, CallJs) == napi_ok) {
+    tsfn.Release();
+  }
+  finished = true;
+  cv.notify_all();
+}
+
+//
+// Delivers the result (JS thread)
+//
+void ScryptAsyncWorker::CallJs(Napi::Env env, Napi::Function callback, ScryptAsyncWorker* worker) {
+  // The isolate is shutting down, so there is no one to call back
+  if (env == nullptr) {
+    return;
+  }
+
+  Napi::HandleScope scope(env);
+  worker->Unlisten();
+  if (worker->error_code) {
+    worker->OnError(NodeScrypt::ScryptError(env, worker->error_code));
+  } else if (worker->has_error) {
+    worker->OnError(Napi::Error::New(env, worker->error));
+  } else {
+    worker->OnOK();
+  }
+}
+
+//
+// Deletes the worker once the ThreadSafeFunction is released (JS thread)
+//
+void ScryptAsyncWorker::Finalize(Napi::Env env, ScryptAsyncWorker* worker) {
+  {
+    // Wait for the pool thread to let go of the worker
+    std::lock_guard<std::mutex> lock(worker->mutex);
+  }
+
+  napi_remove_env_cleanup_hook(env, Abandon, worker);
+  delete worker;
+}
+
+//
+// Cancels the work, or waits for it, when its isolate exits (JS thread)
+//
+void ScryptAsyncWorker::Abandon(void* arg) {
+  ScryptAsyncWorker* worker = static_cast<ScryptAsyncWorker*>(arg);
+
+  if (NodeScrypt::PoolCancel(worker)) {
+    worker->tsfn.Release();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(worker->mutex);
+  worker->cv.wait(lock, [worker] { return worker->finished; });
+}
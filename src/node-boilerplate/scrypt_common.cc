@@ -29,8 +29,13 @@ Barry Steyn barry.steyn@gmail.com
 
 extern "C" {
   #include <errno.h>
+  #include "insecure_memzero.h" // For wiping string scratch
+  #include "crypto_scrypt_budget.h" // For failing synchronous calls fast
 }
 
+#include "scrypt_common.h"
+
+#include <cmath>
 #include <string>
 #include <string.h>
 
@@ -76,11 +81,41 @@ namespace {
         return "error writing output file";
       case 13:
         return "error reading input file";
+      case 14:
+        return "too many scrypt computations are queued";
+      case 15:
+        return "waited too long for a scrypt thread";
+      case 16:
+        return "deadline passed before the scrypt computation started";
+      case 17:
+        return "scrypt computation was aborted";
+      case 18:
+        return "the memory budget has no room for a synchronous scrypt computation";
       default:
         return "error unkown";
     }
   }
 
+  //
+  // Returns the code of errors JavaScript may want to tell apart, or NULL
+  //
+  const char* InternalErrorCode(const unsigned int error) {
+    switch(error) {
+      case 14:
+        return "ERR_SCRYPT_QUEUE_FULL";
+      case 15:
+        return "ERR_SCRYPT_QUEUE_TIMEOUT";
+      case 16:
+        return "ERR_SCRYPT_DEADLINE";
+      case 17:
+        return "ABORT_ERR";
+      case 18:
+        return "ERR_SCRYPT_MEMORY_BUDGET";
+      default:
+        return NULL;
+    }
+  }
+
   //
   // Returns error descriptions as generated by Scrypt
   //
@@ -101,6 +136,114 @@ namespace {
 
 namespace NodeScrypt {
 
+  //
+  // Bytes of an argument, read in place where possible
+  //
+  Bytes::Bytes() : data(nullptr), length(0) {}
+
+  Bytes::Bytes(const Napi::Value& value, bool reference) : data(nullptr), length(0) {
+    static uint8_t empty = 0;
+
+    if (value.IsString()) {
+      // Measure, then encode straight into scratch (with room for the NUL napi writes)
+      napi_get_value_string_utf8(value.Env(), value, nullptr, 0, &length);
+      scratch.resize(length + 1);
+      napi_get_value_string_utf8(value.Env(), value, reinterpret_cast<char*>(scratch.data()), scratch.size(), &length);
+      data = scratch.data();
+    } else if (value.IsTypedArray()) {
+      // napi hands back the data already adjusted for the byte offset
+      void* base = nullptr;
+      napi_get_typedarray_info(value.Env(), value, nullptr, nullptr, &base, nullptr, nullptr);
+      data = static_cast<uint8_t*>(base);
+      length = value.As<Napi::TypedArray>().ByteLength();
+    } else if (value.IsDataView()) {
+      Napi::DataView view = value.As<Napi::DataView>();
+      data = static_cast<uint8_t*>(view.Data());
+      length = view.ByteLength();
+    } else if (value.IsArrayBuffer()) {
+      Napi::ArrayBuffer buffer = value.As<Napi::ArrayBuffer>();
+      data = static_cast<uint8_t*>(buffer.Data());
+      length = buffer.ByteLength();
+    }
+
+    if (reference && !value.IsString()) {
+      ref = Napi::Persistent(value.As<Napi::Object>());
+    }
+
+    // Empty ArrayBuffers may have no storage at all
+    if (data == nullptr) {
+      data = &empty;
+    }
+  }
+
+  Bytes::~Bytes() {
+    if (!scratch.empty()) {
+      insecure_memzero(scratch.data(), scratch.size());
+    }
+  }
+
+  bool Bytes::Is(const Napi::Value& value) {
+    return value.IsString() || IsBinary(value);
+  }
+
+  bool Bytes::IsBinary(const Napi::Value& value) {
+    return value.IsTypedArray() || value.IsDataView() || value.IsArrayBuffer();
+  }
+
+  //
+  // Integers as parseInt sees them: finite, whole and printed without an exponent
+  //
+  bool IsInteger(const Napi::Value& value) {
+    if (!value.IsNumber()) {
+      return false;
+    }
+
+    const double number = value.As<Napi::Number>().DoubleValue();
+    return std::isfinite(number) && std::trunc(number) == number && std::fabs(number) < 1e21;
+  }
+
+  bool IsParams(const Napi::Value& value) {
+    if (!value.IsObject()) {
+      return false;
+    }
+
+    const Napi::Object params = value.As<Napi::Object>();
+    for (const char* name : {"N", "r", "p"}) {
+      if (!params.HasOwnProperty(name) || !IsInteger(params.Get(name))) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //
+  // Checks that a write of length bytes at offset stays inside target
+  //
+  bool FitsInto(const Napi::Value& target, const Napi::Value& offset, const Napi::Value& length) {
+    const size_t size = Bytes(target, false).Length();
+    const double start = offset.As<Napi::Number>().DoubleValue();
+    const double count = length.As<Napi::Number>().DoubleValue();
+
+    return start >= 0 && count >= 0 && start + count <= static_cast<double>(size);
+  }
+
+  //
+  // Wraps data in an external Buffer which frees it, or copies it where external Buffers are not allowed
+  //
+  Napi::Value OwnedBuffer(Napi::Env env, uint8_t* data, size_t length) {
+    napi_value result;
+
+    if (napi_create_external_buffer(env, length, data, [](napi_env, void* finalize_data, void*) {
+          delete[] static_cast<uint8_t*>(finalize_data);
+        }, nullptr, &result) != napi_ok) {
+      napi_create_buffer_copy(env, length, data, nullptr, &result);
+      delete[] data;
+    }
+
+    return Napi::Value(env, result);
+  }
+
   //
   // Creates a Scrypt specific JavaScript Error object
   //
@@ -109,6 +252,39 @@ namespace NodeScrypt {
   Napi::Error ScryptError(Napi::Env env, const unsigned int error) {
     // Call ScryptErrorDescr which now returns std::string
     // Use .c_str() here, which is safe as the string object is valid in this scope
-    return Napi::Error::New(env, ScryptErrorDescr(error).c_str());
+    Napi::Error e = Napi::Error::New(env, ScryptErrorDescr(error).c_str());
+
+    // Load shedding errors carry a code, so that callers can retry or back off
+    const char* code = InternalErrorCode(error & 0xffff);
+    if (code) {
+      e.Set("code", Napi::String::New(env, code));
+    }
+
+    // Aborted work fails the way fetch and the fs functions do
+    if ((error & 0xffff) == 17) {
+      e.Set("name", Napi::String::New(env, "AbortError"));
+    }
+
+    return e;
+  }
+
+  //
+  // A deadline of zero: fail rather than wait for the memory budget
+  //
+  static const struct timespec no_wait = { 0, 0 };
+
+  BudgetNoWait::BudgetNoWait() {
+    crypto_scrypt_budget_wait(&no_wait);
+  }
+
+  BudgetNoWait::~BudgetNoWait() {
+    crypto_scrypt_budget_wait(NULL);
+  }
+
+  //
+  // Describes a Scrypt error for workers on the native pool
+  //
+  std::string ScryptErrorMessage(const unsigned int error) {
+    return ScryptErrorDescr(error);
   }
 } //end NodeScrypt namespace
@@ -0,0 +1,403 @@
+#include <napi.h> // Replace nan.h and node.h
+#include <uv.h> // For the memory available to the process
+#include "scrypt_common.h" // For Params struct and ScryptError
+#include "scrypt_pool.h" // For the native thread pool
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "crypto_scrypt.h" // For crypto_scrypt_set_threads
+  #include "crypto_scrypt_arena.h" // For the scratch arena settings
+  #include "crypto_scrypt_budget.h" // For the memory budget
+  #include "hash.h" // For Hash function
+  #include "pickparams.h" // For the CPU calibration
+}
+
+#include <string>
+#include <vector>
+
+//
+// Names of the huge page modes, indexed by CRYPTO_SCRYPT_HUGEPAGES_*
+//
+static const char* const HugePagesNames[] = { "off", "thp", "hugetlb" };
+
+//
+// Whether the memory budget follows the memory available to the process
+//
+static bool MemoryBudgetAuto = true;
+
+//
+// Half of the memory available to the process, honouring cgroup limits
+//
+static size_t AutoMemoryBudget() {
+  uint64_t memory = uv_get_total_memory();
+  const uint64_t constrained = uv_get_constrained_memory();
+
+  if (constrained != 0 && constrained < memory) {
+    memory = constrained;
+  }
+
+  return static_cast<size_t>(memory / 2);
+}
+
+//
+// Applies the default memory budget, unless configure has set one already
+//
+void configureDefaults() {
+  crypto_scrypt_budget_set_default(AutoMemoryBudget());
+}
+
+//
+// Returns the current engine configuration as a JSON object
+//
+static Napi::Object ConfigObject(Napi::Env env) {
+  size_t threads = 0;
+  size_t thread_memory = 0;
+  size_t arena_high_water = 0;
+  int arena_policy = CRYPTO_SCRYPT_ARENA_KEEP;
+  const char* kernel = NULL;
+  size_t lanes = 0;
+  int kernel_forced = 0;
+  size_t pool_size = 0;
+  std::vector<int> pool_affinity;
+  size_t max_queue_length = 0;
+  uint64_t max_queue_wait = 0;
+  uint64_t time_slice = NodeScrypt::PoolGetTimeSlice();
+
+  crypto_scrypt_get_threads(&threads, &thread_memory);
+  crypto_scrypt_arena_get_config(&arena_high_water, &arena_policy);
+  crypto_scrypt_get_kernel(&kernel, &lanes, &kernel_forced);
+  NodeScrypt::PoolGetConfig(&pool_size, &pool_affinity);
+  NodeScrypt::PoolGetLimits(&max_queue_length, &max_queue_wait);
+
+  Napi::Array affinity = Napi::Array::New(env, pool_affinity.size());
+  for (size_t i = 0; i < pool_affinity.size(); i++) {
+    affinity.Set(static_cast<uint32_t>(i), Napi::Number::New(env, pool_affinity[i]));
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set(Napi::String::New(env, "threads"), Napi::Number::New(env, threads));
+  obj.Set(Napi::String::New(env, "threadMemory"), Napi::Number::New(env, thread_memory));
+  obj.Set(Napi::String::New(env, "arenaHighWater"), Napi::Number::New(env, arena_high_water));
+  obj.Set(Napi::String::New(env, "arenaPolicy"), Napi::String::New(env, arena_policy == CRYPTO_SCRYPT_ARENA_KEEP ? "keep" : "release"));
+  obj.Set(Napi::String::New(env, "hugePages"), Napi::String::New(env, HugePagesNames[crypto_scrypt_arena_get_hugepages()]));
+  obj.Set(Napi::String::New(env, "kernel"), Napi::String::New(env, kernel_forced ? kernel : "auto"));
+  obj.Set(Napi::String::New(env, "poolSize"), Napi::Number::New(env, pool_size));
+  obj.Set(Napi::String::New(env, "poolAffinity"), affinity);
+  obj.Set(Napi::String::New(env, "maxQueueLength"), Napi::Number::New(env, max_queue_length));
+  obj.Set(Napi::String::New(env, "maxQueueWait"), Napi::Number::New(env, static_cast<double>(max_queue_wait)));
+  obj.Set(Napi::String::New(env, "timeSlice"), Napi::Number::New(env, static_cast<double>(time_slice)));
+  if (MemoryBudgetAuto) {
+    obj.Set(Napi::String::New(env, "memoryBudget"), Napi::String::New(env, "auto"));
+  } else {
+    obj.Set(Napi::String::New(env, "memoryBudget"), Napi::Number::New(env, crypto_scrypt_budget_get()));
+  }
+
+  return obj;
+}
+
+//
+// Returns the compiled-in smix kernels and the one in use as a JSON object
+//
+static Napi::Object KernelsObject(Napi::Env env) {
+  const char* names[16];
+  int usable[16];
+  const size_t count = crypto_scrypt_list_kernels(names, usable, 16);
+  const char* active = NULL;
+  size_t lanes = 0;
+  int forced = 0;
+
+  crypto_scrypt_get_kernel(&active, &lanes, &forced);
+
+  Napi::Array kernels = Napi::Array::New(env, count);
+  for (size_t i = 0; i < count && i < 16; i++) {
+    Napi::Object kernel = Napi::Object::New(env);
+    kernel.Set(Napi::String::New(env, "name"), Napi::String::New(env, names[i]));
+    kernel.Set(Napi::String::New(env, "usable"), Napi::Boolean::New(env, usable[i] != 0));
+    kernels.Set(static_cast<uint32_t>(i), kernel);
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set(Napi::String::New(env, "active"), Napi::String::New(env, active));
+  obj.Set(Napi::String::New(env, "forced"), Napi::Boolean::New(env, forced != 0));
+  obj.Set(Napi::String::New(env, "batchLanes"), Napi::Number::New(env, lanes));
+  obj.Set(Napi::String::New(env, "kernels"), kernels);
+
+  return obj;
+}
+
+// Engine configuration using Napi
+Napi::Value configure(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  // Argument validation
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Expected 1 argument: optionsObject").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  //
+  // Arguments from JavaScript using Napi
+  //
+  Napi::Object options = info[0].As<Napi::Object>();
+  size_t threads = 0;
+  size_t thread_memory = 0;
+  size_t arena_high_water = 0;
+  int arena_policy = CRYPTO_SCRYPT_ARENA_KEEP;
+  size_t pool_size = 0;
+  std::vector<int> pool_affinity;
+  size_t max_queue_length = 0;
+  uint64_t max_queue_wait = 0;
+  uint64_t time_slice = NodeScrypt::PoolGetTimeSlice();
+
+  crypto_scrypt_get_threads(&threads, &thread_memory);
+  crypto_scrypt_arena_get_config(&arena_high_water, &arena_policy);
+  NodeScrypt::PoolGetConfig(&pool_size, &pool_affinity);
+  NodeScrypt::PoolGetLimits(&max_queue_length, &max_queue_wait);
+
+  if (options.Has("threads")) {
+    threads = options.Get("threads").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("threadMemory")) {
+    thread_memory = options.Get("threadMemory").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("arenaHighWater")) {
+    arena_high_water = options.Get("arenaHighWater").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("arenaPolicy")) {
+    const std::string policy = options.Get("arenaPolicy").As<Napi::String>().Utf8Value();
+    arena_policy = (policy == "release") ? CRYPTO_SCRYPT_ARENA_RELEASE : CRYPTO_SCRYPT_ARENA_KEEP;
+  }
+  if (options.Has("poolSize")) {
+    pool_size = options.Get("poolSize").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("poolAffinity")) {
+    Napi::Array cpus = options.Get("poolAffinity").As<Napi::Array>();
+    pool_affinity.clear();
+    for (uint32_t i = 0; i < cpus.Length(); i++) {
+      pool_affinity.push_back(cpus.Get(i).As<Napi::Number>().Int32Value());
+    }
+  }
+  if (options.Has("maxQueueLength")) {
+    max_queue_length = options.Get("maxQueueLength").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("maxQueueWait")) {
+    max_queue_wait = options.Get("maxQueueWait").As<Napi::Number>().Int64Value();
+  }
+  if (options.Has("timeSlice")) {
+    time_slice = options.Get("timeSlice").As<Napi::Number>().Int64Value();
+  }
+
+  //
+  // Scrypt: force an smix kernel (checked first, so that a bad name changes nothing)
+  //
+  if (options.Has("kernel")) {
+    const std::string kernel = options.Get("kernel").As<Napi::String>().Utf8Value();
+    if (crypto_scrypt_set_kernel(kernel.c_str())) {
+      Napi::RangeError::New(env, "kernel \"" + kernel + "\" is unknown or not supported by this CPU").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  //
+  // Scrypt: spread the p smix computations of a hash over threads
+  //
+  crypto_scrypt_set_threads(threads, thread_memory);
+
+  //
+  // Scrypt: how much scratch memory each thread keeps between hashes
+  //
+  crypto_scrypt_arena_set(arena_high_water, arena_policy);
+
+  //
+  // Scrypt: size of the native pool running async work, and the CPUs it may use
+  //
+  NodeScrypt::PoolConfigure(pool_size, pool_affinity);
+
+  //
+  // Scrypt: turn async calls away rather than let the queue grow without bound
+  //
+  NodeScrypt::PoolSetLimits(max_queue_length, max_queue_wait);
+
+  //
+  // Scrypt: how long a long async hash keeps a pool thread while other calls wait
+  //
+  NodeScrypt::PoolSetTimeSlice(time_slice);
+
+  //
+  // Scrypt: how much scratch memory all running hashes may use together
+  //
+  if (options.Has("memoryBudget")) {
+    Napi::Value budget = options.Get("memoryBudget");
+    MemoryBudgetAuto = budget.IsString();
+    crypto_scrypt_budget_set(MemoryBudgetAuto ? AutoMemoryBudget() : budget.As<Napi::Number>().Int64Value());
+  }
+
+  //
+  // Scrypt: back large scratch regions with huge pages
+  //
+  if (options.Has("hugePages")) {
+    const std::string huge_pages = options.Get("hugePages").As<Napi::String>().Utf8Value();
+    for (int mode = CRYPTO_SCRYPT_HUGEPAGES_OFF; mode <= CRYPTO_SCRYPT_HUGEPAGES_HUGETLB; mode++) {
+      if (huge_pages == HugePagesNames[mode]) {
+        crypto_scrypt_arena_set_hugepages(mode);
+      }
+    }
+  }
+
+  return ConfigObject(env);
+}
+
+// Engine statistics using Napi
+Napi::Value stats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  struct crypto_scrypt_arena_stats arena;
+  crypto_scrypt_arena_stats(&arena);
+
+  NodeScrypt::PoolStatistics pool;
+  NodeScrypt::PoolStats(&pool);
+
+  struct crypto_scrypt_budget_stats budget;
+  crypto_scrypt_budget_stats(&budget);
+
+  //
+  // Return values in JSON object using Napi
+  //
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set(Napi::String::New(env, "arenaBytes"), Napi::Number::New(env, arena.held));
+  obj.Set(Napi::String::New(env, "arenas"), Napi::Number::New(env, arena.arenas));
+  obj.Set(Napi::String::New(env, "arenaHits"), Napi::Number::New(env, arena.hits));
+  obj.Set(Napi::String::New(env, "arenaMisses"), Napi::Number::New(env, arena.misses));
+  obj.Set(Napi::String::New(env, "arenaTrims"), Napi::Number::New(env, arena.trims));
+  obj.Set(Napi::String::New(env, "arenaHugeTlb"), Napi::Number::New(env, arena.hugetlb));
+  obj.Set(Napi::String::New(env, "arenaThp"), Napi::Number::New(env, arena.thp));
+  obj.Set(Napi::String::New(env, "poolThreads"), Napi::Number::New(env, pool.threads));
+  obj.Set(Napi::String::New(env, "poolBusy"), Napi::Number::New(env, pool.busy));
+  obj.Set(Napi::String::New(env, "poolQueued"), Napi::Number::New(env, pool.queued));
+  obj.Set(Napi::String::New(env, "poolRejected"), Napi::Number::New(env, static_cast<double>(pool.rejected)));
+  obj.Set(Napi::String::New(env, "poolExpired"), Napi::Number::New(env, static_cast<double>(pool.expired)));
+  obj.Set(Napi::String::New(env, "poolMissed"), Napi::Number::New(env, static_cast<double>(pool.missed)));
+  obj.Set(Napi::String::New(env, "memoryBudget"), Napi::Number::New(env, budget.limit));
+  obj.Set(Napi::String::New(env, "memoryUsed"), Napi::Number::New(env, budget.used));
+  obj.Set(Napi::String::New(env, "memoryPeak"), Napi::Number::New(env, budget.peak));
+  obj.Set(Napi::String::New(env, "memoryWaiting"), Napi::Number::New(env, budget.waiting));
+  obj.Set(Napi::String::New(env, "memoryWaits"), Napi::Number::New(env, budget.waits));
+
+  return obj;
+}
+
+// Release idle scratch memory using Napi
+Napi::Value trim(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  crypto_scrypt_arena_trim();
+
+  return env.Undefined();
+}
+
+// Kernel introspection using Napi
+Napi::Value kernels(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  return KernelsObject(env);
+}
+
+// Eager start-up work using Napi
+Napi::Value warmup(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  // Argument validation
+  if (info.Length() > 0 && !info[0].IsUndefined() && !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Argument 1 must be an object (params)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  //
+  // Scrypt: run the kernel self-tests and select the kernels
+  //
+  crypto_scrypt_warmup();
+
+  //
+  // Scrypt: measure the CPU once for params and paramsSync (unless calibrate already has)
+  //
+  unsigned int result = pickparams_calibrate(0);
+  if (result) {
+    NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  //
+  // Scrypt: map and fault in this thread's scratch memory with one hash
+  //
+  if (info.Length() > 0 && info[0].IsObject()) {
+    const NodeScrypt::Params params(info[0].As<Napi::Object>());
+    static const uint8_t salt[] = "warmup";
+    uint8_t hash[64];
+
+    // Like the other synchronous calls, fail rather than wait for the memory budget
+    const NodeScrypt::BudgetNoWait no_wait;
+    result = Hash(salt, sizeof(salt) - 1, salt, sizeof(salt) - 1, params.N, params.r, params.p, hash, sizeof(hash), NULL);
+    if (result) {
+      NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  return KernelsObject(env);
+}
+
+// CPU calibration for params using Napi
+Napi::Value calibrate(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  struct pickparams_point points[PICKPARAMS_POINTS_MAX];
+  size_t npoints = 0;
+
+  //
+  // Scrypt: take over an earlier calibration, or measure the CPU (again if forced)
+  //
+  if (info.Length() > 2 && info[1].IsArray() && info[2].IsNumber()) {
+    Napi::Array saved = info[1].As<Napi::Array>();
+    for (uint32_t i = 0; i < saved.Length() && npoints < PICKPARAMS_POINTS_MAX; i++, npoints++) {
+      Napi::Object point = saved.Get(i).As<Napi::Object>();
+      points[npoints].memory = point.Get("memory").As<Napi::Number>().Int64Value();
+      points[npoints].r = point.Get("r").As<Napi::Number>().Uint32Value();
+      points[npoints].opps = point.Get("opsPerSecond").As<Napi::Number>().DoubleValue();
+    }
+    pickparams_set_calibration(points, npoints, info[2].As<Napi::Number>().DoubleValue());
+  } else {
+    const unsigned int result = pickparams_calibrate(info.Length() > 0 && info[0].ToBoolean().Value());
+    if (result) {
+      NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  double spread = 0;
+  const char* kernel = NULL;
+  pickparams_get_calibration(points, &npoints, &spread, &kernel);
+
+  Napi::Array model = Napi::Array::New(env, npoints);
+  for (size_t i = 0; i < npoints; i++) {
+    Napi::Object point = Napi::Object::New(env);
+    point.Set(Napi::String::New(env, "memory"), Napi::Number::New(env, static_cast<double>(points[i].memory)));
+    point.Set(Napi::String::New(env, "r"), Napi::Number::New(env, points[i].r));
+    point.Set(Napi::String::New(env, "opsPerSecond"), Napi::Number::New(env, points[i].opps));
+    model.Set(static_cast<uint32_t>(i), point);
+  }
+
+  //
+  // Return values in JSON object using Napi
+  //
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set(Napi::String::New(env, "kernel"), Napi::String::New(env, kernel));
+  obj.Set(Napi::String::New(env, "spread"), Napi::Number::New(env, spread));
+  obj.Set(Napi::String::New(env, "points"), model);
+
+  return obj;
+}
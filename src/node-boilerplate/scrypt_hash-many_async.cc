@@ -0,0 +1,48 @@
+#include "scrypt_hash-many_async.h" // Includes napi.h, scrypt_common.h, hash.h
+
+// Asynchronous batch Hash function using Napi
+Napi::Value hashMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation
+  if (info.Length() < 5) {
+    Napi::TypeError::New(env, "Expected 5 arguments: keysArray, paramsObject, hashSize, saltsArray, callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[0].IsArray()) {
+    Napi::TypeError::New(env, "Argument 1 must be an array (keys)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[1].IsObject()) {
+    Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[2].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 3 must be a number (hashSize)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[3].IsArray() || info[3].As<Napi::Array>().Length() != info[0].As<Napi::Array>().Length()) {
+    Napi::TypeError::New(env, "Argument 4 must be an array as long as argument 1 (salts)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[4].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 5 must be a function (callback)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Array keys = info[0].As<Napi::Array>();
+  Napi::Array salts = info[3].As<Napi::Array>();
+  for (uint32_t i = 0; i < keys.Length(); i++) {
+    if (!NodeScrypt::Bytes::Is(keys.Get(i)) || !NodeScrypt::Bytes::Is(salts.Get(i))) {
+      Napi::TypeError::New(env, "Every key and salt must be a string or binary data").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  // Create and queue the worker
+  ScryptHashManyAsyncWorker* worker = new ScryptHashManyAsyncWorker(info);
+  worker->Queue();
+
+  // Return undefined, result is handled by the callback
+  return env.Undefined();
+}
@@ -24,40 +24,128 @@ Barry Steyn barry.steyn@gmail.com
 
 #include "scrypt_hash_async.h" // Includes napi.h, scrypt_common.h, hash.h
 
+//
+// Validates the key, params, hash size and salt shared by hash and hashInto
+//
+static bool CheckHashArguments(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!info[1].IsObject()) {
+    Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!info[2].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 3 must be a number (hashSize)").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!NodeScrypt::Bytes::Is(info[3])) {
+    Napi::TypeError::New(env, "Argument 4 must be a string or binary data (salt)").ThrowAsJavaScriptException();
+    return false;
+  }
+
+  return true;
+}
+
 // Asynchronous Hash function using Napi
 Napi::Value hash(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
   // Argument validation
   if (info.Length() < 5) {
-    Napi::TypeError::New(env, "Expected 5 arguments: keyBuffer, paramsObject, hashSize, saltBuffer, callback").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected 5 arguments: key, paramsObject, hashSize, salt, callback").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 1 must be a buffer (key)").ThrowAsJavaScriptException();
+  if (!CheckHashArguments(info)) {
     return env.Undefined();
   }
-   if (!info[1].IsObject()) {
-    Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
+  if (!info[4].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 5 must be a function (callback)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-   if (!info[2].IsNumber()) {
-    Napi::TypeError::New(env, "Argument 3 must be a number (hashSize)").ThrowAsJavaScriptException();
+
+  // Create and queue the worker, with the optional scheduling options after the callback
+  ScryptHashAsyncWorker* worker = new ScryptHashAsyncWorker(info);
+  worker->Schedule(info[5]);
+  worker->Queue();
+
+  // Return undefined, result is handled by the callback
+  return env.Undefined();
+}
+
+// Asynchronous Hash into a caller's buffer using Napi
+Napi::Value hashInto(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation
+  if (info.Length() < 7) {
+    Napi::TypeError::New(env, "Expected 7 arguments: key, paramsObject, hashSize, salt, target, offset, callback").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[3].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 4 must be a buffer (salt)").ThrowAsJavaScriptException();
+  if (!CheckHashArguments(info)) {
     return env.Undefined();
   }
-  if (!info[4].IsFunction()) {
-    Napi::TypeError::New(env, "Argument 5 must be a function (callback)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::IsBinary(info[4])) {
+    Napi::TypeError::New(env, "Argument 5 must be binary data (target)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[5].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 6 must be a number (offset)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[6].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 7 must be a function (callback)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::FitsInto(info[4], info[5], info[2])) {
+    Napi::RangeError::New(env, "The hash does not fit into the target at this offset").ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
   // Create and queue the worker
-  ScryptHashAsyncWorker* worker = new ScryptHashAsyncWorker(info);
+  ScryptHashAsyncWorker* worker = new ScryptHashAsyncWorker(info, true);
   worker->Queue();
 
   // Return undefined, result is handled by the callback
   return env.Undefined();
 }
+
+// Promise-returning Hash using Napi: undefined when index.ts must check the arguments itself
+Napi::Value hashPromise(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation, as strict as index.ts
+  if (info.Length() != 4 || !NodeScrypt::Bytes::Is(info[0]) || !NodeScrypt::IsParams(info[1]) ||
+      !NodeScrypt::IsInteger(info[2]) || info[2].As<Napi::Number>().DoubleValue() < 0 || !NodeScrypt::Bytes::Is(info[3])) {
+    return env.Undefined();
+  }
+
+  // Create and queue the worker
+  ScryptHashAsyncWorker* worker = new ScryptHashAsyncWorker(info);
+  worker->Queue();
+
+  // The result settles the Promise
+  return worker->Promise();
+}
+
+// Promise-returning Hash into a caller's buffer using Napi: undefined when index.ts must check the arguments itself
+Napi::Value hashIntoPromise(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation, as strict as index.ts
+  if (info.Length() != 6 || !NodeScrypt::Bytes::Is(info[0]) || !NodeScrypt::IsParams(info[1]) ||
+      !NodeScrypt::IsInteger(info[2]) || !NodeScrypt::Bytes::Is(info[3]) || !NodeScrypt::Bytes::IsBinary(info[4]) ||
+      !NodeScrypt::IsInteger(info[5]) || !NodeScrypt::FitsInto(info[4], info[5], info[2])) {
+    return env.Undefined();
+  }
+
+  // Create and queue the worker
+  ScryptHashAsyncWorker* worker = new ScryptHashAsyncWorker(info, true);
+  worker->Queue();
+
+  // The result settles the Promise
+  return worker->Promise();
+}
@@ -6,67 +6,123 @@ extern "C" {
   #include "hash.h" // For Hash function
 }
 
-// Synchronous Hash function using Napi
-Napi::Value hashSync(const Napi::CallbackInfo& info) {
+//
+// Validates the key, params, hash size and salt shared by hashSync and hashIntoSync
+//
+static bool CheckHashArguments(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  Napi::HandleScope scope(env);
 
-  // Argument validation
-  if (info.Length() < 4) {
-    Napi::TypeError::New(env, "Expected 4 arguments: keyBuffer, paramsObject, hashSize, saltBuffer").ThrowAsJavaScriptException();
-    return env.Undefined();
-  }
-  if (!info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 1 must be a buffer (key)").ThrowAsJavaScriptException();
-    return env.Undefined();
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
+    return false;
   }
   if (!info[1].IsObject()) {
     Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return false;
   }
   if (!info[2].IsNumber()) {
     Napi::TypeError::New(env, "Argument 3 must be a number (hashSize)").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return false;
   }
-  if (!info[3].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 4 must be a buffer (salt)").ThrowAsJavaScriptException();
-    return env.Undefined();
+  if (!NodeScrypt::Bytes::Is(info[3])) {
+    Napi::TypeError::New(env, "Argument 4 must be a string or binary data (salt)").ThrowAsJavaScriptException();
+    return false;
   }
 
+  return true;
+}
+
+//
+// Hashes the key and salt arguments into hash_ptr, throwing on error
+//
+static bool HashArguments(const Napi::CallbackInfo& info, uint8_t* hash_ptr, size_t hash_size) {
   //
-  // Arguments from JavaScript using Napi
+  // Arguments from JavaScript using Napi, read in place
   //
-  Napi::Buffer<uint8_t> key_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-  const uint8_t* key_ptr = key_buffer.Data();
-  const size_t key_size = key_buffer.Length();
-
+  const NodeScrypt::Bytes key(info[0], false);
   const NodeScrypt::Params params(info[1].As<Napi::Object>());
+  const NodeScrypt::Bytes salt(info[3], false);
 
-  const size_t hash_size = info[2].As<Napi::Number>().Int64Value();
+  //
+  // Scrypt hash function, which fails rather than wait for the memory budget
+  //
+  const NodeScrypt::BudgetNoWait no_wait;
+  const unsigned int result = Hash(key.Data(), key.Length(), salt.Data(), salt.Length(), params.N, params.r, params.p, hash_ptr, hash_size, NULL);
+
+  //
+  // Error handling using Napi
+  //
+  if (result) {
+    NodeScrypt::ScryptError(info.Env(), result).ThrowAsJavaScriptException();
+    return false;
+  }
+
+  return true;
+}
+
+// Synchronous Hash function using Napi
+Napi::Value hashSync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
 
-  Napi::Buffer<uint8_t> salt_buffer = info[3].As<Napi::Buffer<uint8_t>>();
-  const uint8_t* salt_ptr = salt_buffer.Data();
-  const size_t salt_size = salt_buffer.Length();
+  // Argument validation
+  if (info.Length() < 4) {
+    Napi::TypeError::New(env, "Expected 4 arguments: key, paramsObject, hashSize, salt").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!CheckHashArguments(info)) {
+    return env.Undefined();
+  }
 
   //
   // Create result buffer using Napi
   //
+  const size_t hash_size = info[2].As<Napi::Number>().Int64Value();
   Napi::Buffer<uint8_t> hash_result_buffer = Napi::Buffer<uint8_t>::New(env, hash_size);
-  uint8_t* hash_ptr = hash_result_buffer.Data();
 
-  //
-  // Scrypt hash function
-  // Assuming signature: Hash(key_ptr, key_size, salt_ptr, salt_size, params.N, params.r, params.p, hash_ptr, hash_size)
-  //
-  const unsigned int result = Hash(key_ptr, key_size, salt_ptr, salt_size, params.N, params.r, params.p, hash_ptr, hash_size);
+  if (!HashArguments(info, hash_result_buffer.Data(), hash_size)) {
+    return env.Undefined(); // Return undefined on error
+  }
+
+  return hash_result_buffer; // Return the result buffer
+}
+
+// Synchronous Hash into a caller's buffer using Napi
+Napi::Value hashIntoSync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  // Argument validation
+  if (info.Length() < 6) {
+    Napi::TypeError::New(env, "Expected 6 arguments: key, paramsObject, hashSize, salt, target, offset").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!CheckHashArguments(info)) {
+    return env.Undefined();
+  }
+  if (!NodeScrypt::Bytes::IsBinary(info[4])) {
+    Napi::TypeError::New(env, "Argument 5 must be binary data (target)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[5].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 6 must be a number (offset)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::FitsInto(info[4], info[5], info[2])) {
+    Napi::RangeError::New(env, "The hash does not fit into the target at this offset").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
 
   //
-  // Error handling using Napi
+  // Write the hash straight into the target
   //
-  if (result) {
-    NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+  const NodeScrypt::Bytes target(info[4], false);
+  const size_t hash_size = info[2].As<Napi::Number>().Int64Value();
+  const size_t offset = info[5].As<Napi::Number>().Int64Value();
+
+  if (!HashArguments(info, target.Data() + offset, hash_size)) {
     return env.Undefined(); // Return undefined on error
   }
 
-  return hash_result_buffer; // Return the result buffer
+  return info[4]; // Return the target
 }
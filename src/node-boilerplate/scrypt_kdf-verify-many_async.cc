@@ -0,0 +1,40 @@
+#include "scrypt_kdf-verify-many_async.h" // Includes napi.h, keyderivation.h, etc.
+
+// Asynchronous batch KDF Verification function using Napi
+Napi::Value kdfVerifyMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation
+  if (info.Length() < 3) {
+    Napi::TypeError::New(env, "Expected 3 arguments: kdfsArray, keysArray, callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[0].IsArray()) {
+    Napi::TypeError::New(env, "Argument 1 must be an array (KDFs)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[1].IsArray() || info[1].As<Napi::Array>().Length() != info[0].As<Napi::Array>().Length()) {
+    Napi::TypeError::New(env, "Argument 2 must be an array as long as argument 1 (keys)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[2].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 3 must be a function (callback)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Array kdfs = info[0].As<Napi::Array>();
+  Napi::Array keys = info[1].As<Napi::Array>();
+  for (uint32_t i = 0; i < kdfs.Length(); i++) {
+    if (!NodeScrypt::Bytes::Is(kdfs.Get(i)) || !NodeScrypt::Bytes::Is(keys.Get(i))) {
+      Napi::TypeError::New(env, "Every KDF and key must be a string or binary data").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  // Create and queue the worker
+  ScryptKDFVerifyManyAsyncWorker* worker = new ScryptKDFVerifyManyAsyncWorker(info);
+  worker->Queue();
+
+  // Return undefined, result is handled by the callback
+  return env.Undefined();
+}
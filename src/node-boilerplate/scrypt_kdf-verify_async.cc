@@ -6,15 +6,15 @@ Napi::Value kdfVerify(const Napi::CallbackInfo& info) {
 
   // Argument validation
   if (info.Length() < 3) {
-    Napi::TypeError::New(env, "Expected 3 arguments: kdfBuffer, keyBuffer, callback").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected 3 arguments: kdf, key, callback").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 1 must be a buffer (KDF)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (KDF)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[1].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 2 must be a buffer (key)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::Is(info[1])) {
+    Napi::TypeError::New(env, "Argument 2 must be a string or binary data (key)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
   if (!info[2].IsFunction()) {
@@ -22,10 +22,28 @@ Napi::Value kdfVerify(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
-  // Create and queue the worker
+  // Create and queue the worker, with the optional scheduling options after the callback
   ScryptKDFVerifyAsyncWorker* worker = new ScryptKDFVerifyAsyncWorker(info);
+  worker->Schedule(info[3]);
   worker->Queue();
 
   // Return undefined, result is handled by the callback
   return env.Undefined();
 }
+
+// Promise-returning KDF Verification function using Napi: undefined when index.ts must check the arguments itself
+Napi::Value kdfVerifyPromise(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation, as strict as index.ts
+  if (info.Length() != 2 || !NodeScrypt::Bytes::Is(info[0]) || !NodeScrypt::Bytes::Is(info[1])) {
+    return env.Undefined();
+  }
+
+  // Create and queue the worker
+  ScryptKDFVerifyAsyncWorker* worker = new ScryptKDFVerifyAsyncWorker(info);
+  worker->Queue();
+
+  // The result settles the Promise
+  return worker->Promise();
+}
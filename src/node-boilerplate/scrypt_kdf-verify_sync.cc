@@ -13,35 +13,30 @@ Napi::Value kdfVerifySync(const Napi::CallbackInfo& info) {
 
   // Argument validation
   if (info.Length() < 2) {
-    Napi::TypeError::New(env, "Expected 2 arguments: kdfBuffer, keyBuffer").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected 2 arguments: kdf, key").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 1 must be a buffer (KDF)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (KDF)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[1].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 2 must be a buffer (key)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::Is(info[1])) {
+    Napi::TypeError::New(env, "Argument 2 must be a string or binary data (key)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
   //
-  // Arguments from JavaScript using Napi
+  // Arguments from JavaScript using Napi, read in place
   //
-  Napi::Buffer<uint8_t> kdf_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-  const uint8_t* kdf_ptr = kdf_buffer.Data();
-  // Assuming Verify needs the KDF buffer size - Not needed for Verify(kdf_ptr, key_ptr, key_size)
-  // const size_t kdf_size = kdf_buffer.Length(); // Unused variable
-
-  Napi::Buffer<uint8_t> key_buffer = info[1].As<Napi::Buffer<uint8_t>>();
-  const uint8_t* key_ptr = key_buffer.Data();
-  const size_t key_size = key_buffer.Length();
+  const NodeScrypt::Bytes kdf(info[0], false);
+  const NodeScrypt::Bytes key(info[1], false);
 
   //
-  // Scrypt KDF Verification
-  // Assuming Verify takes kdf_ptr, kdf_size, key_ptr, key_size
+  // Scrypt KDF Verification (a KDF too short to hold the format is not a valid block),
+  // which fails rather than wait for the memory budget
   //
-  const unsigned int result = Verify(kdf_ptr, key_ptr, key_size);
+  const NodeScrypt::BudgetNoWait no_wait;
+  const unsigned int result = (kdf.Length() < 96) ? 7 : Verify(kdf.Data(), key.Data(), key.Length(), NULL);
 
   //
   // Return result (or error) using Napi
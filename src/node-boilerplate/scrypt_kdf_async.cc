@@ -5,24 +5,38 @@ Napi::Value kdf(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
   // Argument validation
-  if (info.Length() < 4) {
-    Napi::TypeError::New(env, "Expected 4 arguments: keyBuffer, paramsObject, saltBuffer, callback").ThrowAsJavaScriptException();
+  if (info.Length() < 3) {
+    Napi::TypeError::New(env, "Expected 3 arguments: key, paramsObject, callback").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 1 must be a buffer (key)").ThrowAsJavaScriptException();
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
    if (!info[1].IsObject()) {
     Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[2].IsBuffer()) {
-    Napi::TypeError::New(env, "Argument 3 must be a buffer (salt)").ThrowAsJavaScriptException();
+  if (!info[2].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 3 must be a function (callback)").ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  if (!info[3].IsFunction()) {
-    Napi::TypeError::New(env, "Argument 4 must be a function (callback)").ThrowAsJavaScriptException();
+
+  // Create and queue the worker, with the optional scheduling options after the callback
+  ScryptKDFAsyncWorker* worker = new ScryptKDFAsyncWorker(info);
+  worker->Schedule(info[3]);
+  worker->Queue();
+
+  // Return undefined, result is handled by the callback
+  return env.Undefined();
+}
+
+// Promise-returning KDF function using Napi: undefined when index.ts must check the arguments itself
+Napi::Value kdfPromise(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation, as strict as index.ts
+  if (info.Length() != 2 || !NodeScrypt::Bytes::Is(info[0]) || !NodeScrypt::IsParams(info[1])) {
     return env.Undefined();
   }
 
@@ -30,6 +44,6 @@ Napi::Value kdf(const Napi::CallbackInfo& info) {
   ScryptKDFAsyncWorker* worker = new ScryptKDFAsyncWorker(info);
   worker->Queue();
 
-  // Return undefined, result is handled by the callback
-  return env.Undefined();
+  // The result settles the Promise
+  return worker->Promise();
 }
@@ -12,37 +12,27 @@ Napi::Value kdfSync(const Napi::CallbackInfo& info) {
     Napi::HandleScope scope(env);
 
     // Argument validation
-    if (info.Length() < 3) {
-        Napi::TypeError::New(env, "Expected 3 arguments: keyBuffer, paramsObject, saltBuffer").ThrowAsJavaScriptException();
+    if (info.Length() < 2) {
+        Napi::TypeError::New(env, "Expected 2 arguments: key, paramsObject").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    if (!info[0].IsBuffer()) {
-        Napi::TypeError::New(env, "Argument 1 must be a buffer (key)").ThrowAsJavaScriptException();
+    if (!NodeScrypt::Bytes::Is(info[0])) {
+        Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
         return env.Undefined();
     }
     if (!info[1].IsObject()) {
         Napi::TypeError::New(env, "Argument 2 must be an object (params)").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    if (!info[2].IsBuffer()) {
-        Napi::TypeError::New(env, "Argument 3 must be a buffer (salt)").ThrowAsJavaScriptException();
-        return env.Undefined();
-    }
 
     //
-    // Arguments from JavaScript using Napi
+    // Arguments from JavaScript using Napi, read in place
     //
-    Napi::Buffer<uint8_t> key_buffer = info[0].As<Napi::Buffer<uint8_t>>();
-    const uint8_t* key_ptr = key_buffer.Data();
-    const size_t keySize = key_buffer.Length();
+    const NodeScrypt::Bytes key(info[0], false);
 
     // Use the Params constructor (already refactored)
     const NodeScrypt::Params params(info[1].As<Napi::Object>());
 
-    Napi::Buffer<uint8_t> salt_buffer = info[2].As<Napi::Buffer<uint8_t>>();
-    const uint8_t* salt_ptr = salt_buffer.Data();
-    // Note: KDF wrapper might not need salt size explicitly, unlike crypto_scrypt
-
     //
     // Create result buffer using Napi (size hardcoded as 96 in original)
     //
@@ -52,9 +42,11 @@ Napi::Value kdfSync(const Napi::CallbackInfo& info) {
 
 
     //
-    // Scrypt key derivation function (using the existing KDF wrapper)
+    // Scrypt key derivation function (using the existing KDF wrapper, which draws the salt),
+    // which fails rather than wait for the memory budget
     //
-    const unsigned int result = KDF(key_ptr, keySize, kdfResult_ptr, params.N, params.r, params.p, salt_ptr);
+    const NodeScrypt::BudgetNoWait no_wait;
+    const unsigned int result = KDF(key.Data(), key.Length(), kdfResult_ptr, params.N, params.r, params.p, NULL, NULL);
 
     //
     // Error handling using Napi
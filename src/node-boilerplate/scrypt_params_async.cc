@@ -11,8 +11,28 @@ Napi::Value params(const Napi::CallbackInfo& info) {
   }
   // TODO: Add more robust validation for other arguments (types, ranges) if needed
 
-  // Create and queue the worker
+  // Create and queue the worker, with the optional scheduling options after the callback
   ScryptParamsAsyncWorker* worker = new ScryptParamsAsyncWorker(info);
+  worker->Schedule(info[5]);
+  worker->Queue();
+
+  // Return undefined, the result is passed asynchronously via the callback
+  return env.Undefined();
+}
+
+// Asynchronous access to scrypt params for a throughput using Napi
+Napi::Value paramsForThroughput(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Basic argument validation (ensure callback is a function)
+  if (info.Length() < 5 || !info[4].IsFunction()) {
+    Napi::TypeError::New(env, "Callback function expected as fifth argument").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Create and queue the worker, with the optional scheduling options after the callback
+  ScryptParamsThroughputAsyncWorker* worker = new ScryptParamsThroughputAsyncWorker(info);
+  worker->Schedule(info[5]);
   worker->Queue();
 
   // Return undefined, the result is passed asynchronously via the callback
@@ -58,3 +58,53 @@ Napi::Value paramsSync(const Napi::CallbackInfo& info) {
 
   return obj; // Return the result object
 }
+
+// Synchronous access to scrypt params for a throughput using Napi
+Napi::Value paramsForThroughputSync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env); // Napi HandleScope
+
+  // Basic argument validation
+  if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() || !info[3].IsNumber()) {
+      Napi::TypeError::New(env, "Expected 4 numeric arguments: verifiesPerSecond, concurrency, maxmem, osfreemem").ThrowAsJavaScriptException();
+      return env.Undefined();
+  }
+
+  //
+  // Variable Declaration
+  //
+  int logN = 0;
+  uint32_t r = 0;
+  uint32_t p = 0;
+
+  //
+  // Arguments from JavaScript using Napi
+  //
+  const double verifies = info[0].As<Napi::Number>().DoubleValue();
+  const uint32_t concurrency = info[1].As<Napi::Number>().Uint32Value();
+  const size_t maxmem = info[2].As<Napi::Number>().Int64Value();
+  const size_t osfreemem = info[3].As<Napi::Number>().Int64Value();
+
+  //
+  // Scrypt: calculate input parameters, measuring concurrency hashes at once the first time
+  //
+  const unsigned int result = pickparams_throughput(&logN, &r, &p, verifies, concurrency, maxmem, osfreemem);
+
+  //
+  // Error handling using Napi
+  //
+  if (result) {
+    NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  //
+  // Return values in JSON object using Napi
+  //
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set(Napi::String::New(env, "N"), Napi::Number::New(env, logN));
+  obj.Set(Napi::String::New(env, "r"), Napi::Number::New(env, r));
+  obj.Set(Napi::String::New(env, "p"), Napi::Number::New(env, p));
+
+  return obj;
+}
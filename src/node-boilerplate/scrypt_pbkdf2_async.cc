@@ -0,0 +1,59 @@
+#include "scrypt_pbkdf2_async.h" // Includes napi.h, scrypt_common.h, hash.h
+
+// Asynchronous PBKDF2 function using Napi
+Napi::Value pbkdf2(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation
+  if (info.Length() < 5) {
+    Napi::TypeError::New(env, "Expected 5 arguments: key, salt, iterations, keyLength, callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::Bytes::Is(info[1])) {
+    Napi::TypeError::New(env, "Argument 2 must be a string or binary data (salt)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[2].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 3 must be a number (iterations)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[3].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 4 must be a number (keyLength)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[4].IsFunction()) {
+    Napi::TypeError::New(env, "Argument 5 must be a function (callback)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Create and queue the worker
+  ScryptPbkdf2AsyncWorker* worker = new ScryptPbkdf2AsyncWorker(info);
+  worker->Queue();
+
+  // Return undefined, result is handled by the callback
+  return env.Undefined();
+}
+
+// Promise-returning PBKDF2 function using Napi: undefined when index.ts must check the arguments itself
+Napi::Value pbkdf2Promise(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  // Argument validation, as strict as index.ts
+  if (info.Length() != 4 || !NodeScrypt::Bytes::Is(info[0]) || !NodeScrypt::Bytes::Is(info[1]) ||
+      !NodeScrypt::IsInteger(info[2]) || info[2].As<Napi::Number>().DoubleValue() < 1 ||
+      !NodeScrypt::IsInteger(info[3]) || info[3].As<Napi::Number>().DoubleValue() < 0 ||
+      info[3].As<Napi::Number>().DoubleValue() > 4294967295.0 * 32) {
+    return env.Undefined();
+  }
+
+  // Create and queue the worker
+  ScryptPbkdf2AsyncWorker* worker = new ScryptPbkdf2AsyncWorker(info);
+  worker->Queue();
+
+  // The result settles the Promise
+  return worker->Promise();
+}
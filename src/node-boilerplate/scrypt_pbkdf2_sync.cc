@@ -0,0 +1,66 @@
+#include <napi.h> // Replace nan.h and node.h
+#include "scrypt_common.h" // For ScryptError
+
+// Scrypt is a C library and there needs c linkings
+extern "C" {
+  #include "hash.h" // For Pbkdf2 function
+}
+
+// Synchronous PBKDF2 function using Napi
+Napi::Value pbkdf2Sync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  // Argument validation
+  if (info.Length() < 4) {
+    Napi::TypeError::New(env, "Expected 4 arguments: key, salt, iterations, keyLength").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::Bytes::Is(info[0])) {
+    Napi::TypeError::New(env, "Argument 1 must be a string or binary data (key)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!NodeScrypt::Bytes::Is(info[1])) {
+    Napi::TypeError::New(env, "Argument 2 must be a string or binary data (salt)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[2].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 3 must be a number (iterations)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[3].IsNumber()) {
+    Napi::TypeError::New(env, "Argument 4 must be a number (keyLength)").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  //
+  // Arguments from JavaScript using Napi, read in place
+  //
+  const NodeScrypt::Bytes key(info[0], false);
+  const NodeScrypt::Bytes salt(info[1], false);
+
+  const uint64_t iterations = info[2].As<Napi::Number>().Int64Value();
+
+  const size_t key_length = info[3].As<Napi::Number>().Int64Value();
+
+  //
+  // Create result buffer using Napi
+  //
+  Napi::Buffer<uint8_t> derived_key_buffer = Napi::Buffer<uint8_t>::New(env, key_length);
+  uint8_t* derived_key_ptr = derived_key_buffer.Data();
+
+  //
+  // Scrypt: PBKDF2-HMAC-SHA256, with the output blocks spread over threads
+  //
+  const unsigned int result = Pbkdf2(key.Data(), key.Length(), salt.Data(), salt.Length(), iterations, derived_key_ptr, key_length);
+
+  //
+  // Error handling using Napi
+  //
+  if (result) {
+    NodeScrypt::ScryptError(env, result).ThrowAsJavaScriptException();
+    return env.Undefined(); // Return undefined on error
+  }
+
+  return derived_key_buffer; // Return the result buffer
+}
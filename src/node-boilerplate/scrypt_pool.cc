@@ -0,0 +1,441 @@
+#include "scrypt_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//
+// Anonymous namespace
+//
+namespace {
+  //
+  // Pool state. It is allocated once and never freed, so that detached
+  // threads still waiting on it at process exit never see it destroyed.
+  //
+  struct Pool {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<NodeScrypt::PoolTask*> queue;
+    size_t size = 0;           // Configured size, 0 for one thread per CPU
+    size_t threads = 0;        // Threads running
+    size_t busy = 0;           // Threads running a task
+    std::vector<int> cpus;     // CPUs the threads may run on, empty for any
+    unsigned long cpus_generation = 1; // Bumped whenever cpus changes
+    size_t max_queue = 0;      // Longest queue PoolAdmit accepts, 0 for no limit
+    uint64_t max_wait = 0;     // Longest wait for a thread in ms, 0 for no limit
+    uint64_t time_slice = 0;   // Longest run of a sliced task in ms while others wait, 0 for no limit
+    uint64_t rejected = 0;     // Tasks turned away by PoolAdmit
+    uint64_t expired = 0;      // Tasks shed after waiting too long
+    uint64_t missed = 0;       // Tasks shed after missing their deadline
+  };
+
+  Pool& GetPool() {
+    static Pool* pool = new Pool();
+    return *pool;
+  }
+
+  //
+  // Returns the number of threads the pool should have
+  //
+  size_t TargetSize(const Pool& pool) {
+    if (pool.size > 0) {
+      return pool.size;
+    }
+
+    const unsigned int cpus = std::thread::hardware_concurrency();
+    return (cpus > 0) ? cpus : 1;
+  }
+
+  //
+  // Pins the calling thread to the given CPUs, or lets it run anywhere
+  //
+  void SetAffinity(const std::vector<int>& cpus) {
+#ifdef __linux__
+    // The first thread records the affinity it inherited, to restore later
+    static const cpu_set_t any = [] {
+      cpu_set_t inherited;
+      if (pthread_getaffinity_np(pthread_self(), sizeof(inherited), &inherited)) {
+        CPU_ZERO(&inherited);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+          CPU_SET(cpu, &inherited);
+        }
+      }
+      return inherited;
+    }();
+    cpu_set_t set;
+
+    if (cpus.empty()) {
+      set = any;
+    } else {
+      CPU_ZERO(&set);
+      for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+          CPU_SET(cpu, &set);
+        }
+      }
+    }
+
+    // Best effort: a CPU the process may not use is ignored by the kernel
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+  }
+
+  //
+  // A task to be shed, and the Scrypt error code saying why
+  //
+  typedef std::pair<NodeScrypt::PoolTask*, unsigned int> Shedding;
+
+  //
+  // Takes the queued tasks whose deadline has passed or which have waited too
+  // long, to be shed once the lock is dropped (called with the lock held)
+  //
+  void TakeExpired(Pool& pool, std::vector<Shedding>* expired) {
+    const auto now = std::chrono::steady_clock::now();
+
+    // The queue is in deadline order, so the missed deadlines come first
+    while (!pool.queue.empty() && pool.queue.front()->deadline < now) {
+      expired->emplace_back(pool.queue.front(), NodeScrypt::PoolErrorDeadline);
+      pool.queue.pop_front();
+      pool.missed++;
+    }
+
+    // Waits expire in arrival order, which a deadline may have overtaken
+    if (pool.max_wait > 0) {
+      for (auto it = pool.queue.begin(); it != pool.queue.end();) {
+        if ((*it)->expires < now) {
+          expired->emplace_back(*it, NodeScrypt::PoolErrorQueueWait);
+          it = pool.queue.erase(it);
+          pool.expired++;
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+
+  //
+  // Sheds tasks taken by TakeExpired (called without the lock)
+  //
+  void ShedExpired(const std::vector<Shedding>& expired) {
+    for (const Shedding& shedding : expired) {
+      shedding.first->Shed(shedding.second); // The task may be freed from here on
+    }
+  }
+
+  //
+  // Queues a task behind every task with an earlier deadline, or the same
+  // deadline and at least its priority (called with the lock held)
+  //
+  void Enqueue(Pool& pool, NodeScrypt::PoolTask* task) {
+    auto it = pool.queue.end();
+
+    while (it != pool.queue.begin()) {
+      const NodeScrypt::PoolTask* prev = *(it - 1);
+      if (prev->deadline < task->deadline ||
+          (prev->deadline == task->deadline && prev->priority >= task->priority)) {
+        break;
+      }
+      --it;
+    }
+
+    pool.queue.insert(it, task);
+  }
+
+  //
+  // Body of every pool thread
+  //
+  void ThreadMain() {
+    Pool& pool = GetPool();
+    unsigned long cpus_generation = 0;
+    std::vector<Shedding> expired;
+    std::unique_lock<std::mutex> lock(pool.mutex);
+
+    for (;;) {
+      pool.cv.wait(lock, [&] {
+        return !pool.queue.empty() || pool.threads > TargetSize(pool) || cpus_generation != pool.cpus_generation;
+      });
+
+      // Apply a new CPU affinity before taking more work
+      if (cpus_generation != pool.cpus_generation) {
+        const std::vector<int> cpus = pool.cpus;
+        cpus_generation = pool.cpus_generation;
+        lock.unlock();
+        SetAffinity(cpus);
+        lock.lock();
+        continue;
+      }
+
+      // The pool has shrunk
+      if (pool.threads > TargetSize(pool)) {
+        pool.threads--;
+        return;
+      }
+
+      // Turn away whatever missed its deadline or waited too long before running the next task
+      TakeExpired(pool, &expired);
+      if (!expired.empty()) {
+        lock.unlock();
+        ShedExpired(expired);
+        expired.clear();
+        lock.lock();
+        continue;
+      }
+
+      NodeScrypt::PoolTask* task = pool.queue.front();
+      pool.queue.pop_front();
+      pool.busy++;
+
+      lock.unlock();
+      task->Run(); // The task may be freed from here on
+      lock.lock();
+
+      pool.busy--;
+    }
+  }
+
+  //
+  // One range of a PoolParallel call, run by a pool thread
+  //
+  class RangeTask : public NodeScrypt::PoolTask {
+    public:
+      RangeTask(const std::function<void(size_t, size_t)>& fn, size_t begin, size_t end,
+                std::mutex& mutex, std::condition_variable& cv, size_t& remaining) :
+        fn(fn), begin(begin), end(end), mutex(mutex), cv(cv), remaining(remaining) {}
+
+      void Run() override {
+        fn(begin, end);
+
+        // The caller's stack goes away as soon as remaining reaches 0
+        std::lock_guard<std::mutex> lock(mutex);
+        remaining--;
+        cv.notify_all();
+      }
+
+    private:
+      const std::function<void(size_t, size_t)>& fn;
+      const size_t begin;
+      const size_t end;
+      std::mutex& mutex;
+      std::condition_variable& cv;
+      size_t& remaining;
+  };
+
+  //
+  // Starts threads until the pool has enough for its queue (called with the lock held)
+  //
+  void Grow(Pool& pool) {
+    const size_t target = TargetSize(pool);
+
+    while (pool.threads < target && pool.threads < pool.busy + pool.queue.size()) {
+      std::thread(ThreadMain).detach();
+      pool.threads++;
+    }
+  }
+} /* end anonymous namespace */
+
+namespace NodeScrypt {
+
+  //
+  // Queue a task; threads are started lazily, up to the configured size
+  //
+  void PoolSubmit(PoolTask* task) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    Enqueue(pool, task);
+    Grow(pool);
+    pool.cv.notify_one();
+  }
+
+  //
+  // Queue a task on behalf of a caller, subject to the queue limits
+  //
+  unsigned int PoolAdmit(PoolTask* task) {
+    Pool& pool = GetPool();
+    std::vector<Shedding> expired;
+    unsigned int result = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      const auto now = std::chrono::steady_clock::now();
+
+      // Under load, clear out what can no longer be useful before judging the queue
+      TakeExpired(pool, &expired);
+
+      if (task->deadline < now) {
+        pool.missed++;
+        result = PoolErrorDeadline;
+      } else if (pool.max_queue > 0 && pool.queue.size() >= pool.max_queue) {
+        pool.rejected++;
+        result = PoolErrorQueueFull;
+      } else {
+        if (pool.max_wait > 0) {
+          task->expires = now + std::chrono::milliseconds(pool.max_wait);
+        }
+        Enqueue(pool, task);
+        Grow(pool);
+        pool.cv.notify_one();
+      }
+    }
+
+    ShedExpired(expired);
+    return result;
+  }
+
+  //
+  // Remove a task which no thread has started yet
+  //
+  bool PoolCancel(PoolTask* task) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    for (auto it = pool.queue.begin(); it != pool.queue.end(); ++it) {
+      if (*it == task) {
+        pool.queue.erase(it);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //
+  // Run fn over [0, count), split into ranges spread over the pool and the calling thread
+  //
+  void PoolParallel(size_t count, const std::function<void(size_t, size_t)>& fn) {
+    Pool& pool = GetPool();
+    size_t ranges;
+
+    {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      ranges = std::min(count, TargetSize(pool));
+    }
+    if (ranges <= 1) {
+      fn(0, count);
+      return;
+    }
+
+    const size_t chunk = (count + ranges - 1) / ranges;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = 0;
+    std::vector<std::unique_ptr<RangeTask>> tasks;
+
+    // Hand every range but the first to the pool
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+      tasks.emplace_back(new RangeTask(fn, begin, std::min(begin + chunk, count), mutex, cv, remaining));
+    }
+    remaining = tasks.size();
+    for (auto& task : tasks) {
+      PoolSubmit(task.get());
+    }
+
+    // Do the first range, then any range still waiting for a thread
+    fn(0, chunk);
+    for (auto& task : tasks) {
+      if (PoolCancel(task.get())) {
+        task->Run();
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return remaining == 0; });
+  }
+
+  //
+  // Set the number of threads and the CPUs they may run on
+  //
+  void PoolConfigure(size_t threads, const std::vector<int>& cpus) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    pool.size = threads;
+    if (cpus != pool.cpus) {
+      pool.cpus = cpus;
+      pool.cpus_generation++;
+    }
+
+    // Surplus threads exit once idle, and new threads start when there is work
+    Grow(pool);
+    pool.cv.notify_all();
+  }
+
+  //
+  // Get the configured number of threads and the CPUs they may run on
+  //
+  void PoolGetConfig(size_t* threads, std::vector<int>* cpus) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    *threads = pool.size;
+    *cpus = pool.cpus;
+  }
+
+  //
+  // Set the longest queue PoolAdmit accepts and the longest a task may wait
+  //
+  void PoolSetLimits(size_t max_queue, uint64_t max_wait) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    pool.max_queue = max_queue;
+    pool.max_wait = max_wait;
+  }
+
+  //
+  // Get the queue limits
+  //
+  void PoolGetLimits(size_t* max_queue, uint64_t* max_wait) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    *max_queue = pool.max_queue;
+    *max_wait = pool.max_wait;
+  }
+
+  //
+  // Set how long a task which runs in slices may keep a thread while others wait
+  //
+  void PoolSetTimeSlice(uint64_t time_slice) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    pool.time_slice = time_slice;
+  }
+
+  //
+  // Get the time slice
+  //
+  uint64_t PoolGetTimeSlice() {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    return pool.time_slice;
+  }
+
+  //
+  // Get the pool statistics
+  //
+  void PoolStats(PoolStatistics* stats) {
+    Pool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    stats->threads = pool.threads;
+    stats->busy = pool.busy;
+    stats->queued = pool.queue.size();
+    stats->rejected = pool.rejected;
+    stats->expired = pool.expired;
+    stats->missed = pool.missed;
+  }
+} //end NodeScrypt namespace
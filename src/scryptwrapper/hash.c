@@ -32,26 +32,112 @@ Barry Steyn barry.steyn@gmail.com
 #include "pickparams.h"
 #include "hash.h"
 
+//
+// Scrypt error for a failed computation: 17 if it was stopped, 16 if it ran
+// out of time waiting for memory and 18 if it was not allowed to wait, or
+// else 3 with errno in the upper bits
+//
+static unsigned int
+HashError(void) {
+  unsigned int error = 3;
+
+  switch (errno) {
+    case ECANCELED:
+      return (17);
+    case ETIMEDOUT:
+      return (16);
+    case EAGAIN:
+      return (18);
+  }
+
+  if (errno) {
+    error |= (errno << 16);
+  }
+
+  return (error);
+}
+
 //
 // This is the function that the hash and hashSync api functions use.
 // Does final modifications to parameters
 //
 unsigned int
-Hash(const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t logN, uint32_t r, uint32_t p, uint8_t *buf, size_t buflen) {
+Hash(const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t logN, uint32_t r, uint32_t p, uint8_t *buf, size_t buflen, const volatile int* cancel) {
   uint64_t N=1;
 
   N <<= logN;
-  return (ScryptHashFunction(key, keylen, salt, saltlen, N, r, p, buf, buflen));
+  return (ScryptHashFunction(key, keylen, salt, saltlen, N, r, p, buf, buflen, cancel));
 }
 
 //
 // This is the actual key derivation function.
 // It is binary safe and is exposed to this module for
-// access to the underlying key derivation function of Scrypt
+// access to the underlying key derivation function of Scrypt.
+// A non-NULL cancel flag which becomes nonzero stops the computation
+// early, and the result is then error 17
+//
+unsigned int
+ScryptHashFunction(const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,uint8_t *buf, size_t buflen, const volatile int* cancel) {
+  int rc = crypto_scrypt_cancellable(key, keylen, salt, saltlen, N, r, p, buf, buflen, cancel);
+
+  return ((rc == 0) ? 0 : HashError());
+}
+
+//
+// Starts Hash as a job instead, which crypto_scrypt_job_step advances a
+// slice at a time on any thread, and crypto_scrypt_job_finish completes.
+// The cancel flag only stops the wait for memory
+//
+unsigned int
+HashStart(struct crypto_scrypt_job** job, const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t logN, uint32_t r, uint32_t p, size_t buflen, const volatile int* cancel) {
+  uint64_t N=1;
+
+  N <<= logN;
+  *job = crypto_scrypt_job_init(key, keylen, salt, saltlen, N, r, p, buflen, cancel);
+
+  return ((*job == NULL) ? HashError() : 0);
+}
+
+//
+// This is the function that the hashMany api function uses.
+// Hashes count keys with their own salts but the same parameters,
+// writing hash k to buf + k * buflen. Keys are handed to scrypt in
+// groups so that their smix computations can share SIMD lanes
+//
+#define HASH_MANY_GROUP 64
+
+unsigned int
+HashMany(const uint8_t* const* keys, const size_t* keylens, const uint8_t* const* salts, const size_t* saltlens, size_t count, uint64_t logN, uint32_t r, uint32_t p, uint8_t *buf, size_t buflen) {
+  uint8_t* bufs[HASH_MANY_GROUP];
+  uint64_t N=1;
+  size_t k, j, n;
+  unsigned int error = 0;
+
+  N <<= logN;
+  for (k = 0; k < count; k += n) {
+    n = (count - k < HASH_MANY_GROUP) ? count - k : HASH_MANY_GROUP;
+    for (j = 0; j < n; j++)
+      bufs[j] = &buf[(k + j) * buflen];
+
+    if (crypto_scrypt_batch(&keys[k], &keylens[k], &salts[k], &saltlens[k], n, N, r, p, bufs, buflen)) {
+      error = 3;
+      if (errno) {
+        error |= (errno << 16);
+      }
+      break;
+    }
+  }
+
+  return (error);
+}
+
+//
+// This is the function that the pbkdf2 and pbkdf2Sync api functions use.
+// Computes PBKDF2-HMAC-SHA256 with the same thread budget as scrypt
 //
 unsigned int
-ScryptHashFunction(const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,uint8_t *buf, size_t buflen) {
-  int rc = crypto_scrypt(key, keylen, salt, saltlen, N, r, p, buf, buflen);
+Pbkdf2(const uint8_t* key, size_t keylen, const uint8_t *salt, size_t saltlen, uint64_t iterations, uint8_t *buf, size_t buflen) {
+  int rc = crypto_scrypt_pbkdf2(key, keylen, salt, saltlen, iterations, buf, buflen);
   unsigned int error = (rc == 0) ? 0 : 3;
 
   if (error && errno) {
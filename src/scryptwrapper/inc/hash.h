@@ -25,10 +25,21 @@ Barry Steyn barry.steyn@gmail.com
 #ifndef _KEYDERIVATION_H_
 #define _KEYDERIVATION_H_
 
+struct crypto_scrypt_job;
+
+unsigned int
+Hash(const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint32_t, uint32_t, uint8_t*, size_t, const volatile int*);
+
+unsigned int
+ScryptHashFunction(const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint32_t, uint32_t, uint8_t*, size_t, const volatile int*);
+
+unsigned int
+HashStart(struct crypto_scrypt_job**, const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint32_t, uint32_t, size_t, const volatile int*);
+
 unsigned int
-Hash(const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint32_t, uint32_t, uint8_t*, size_t);
+HashMany(const uint8_t* const*, const size_t*, const uint8_t* const*, const size_t*, size_t, uint64_t, uint32_t, uint32_t, uint8_t*, size_t);
 
 unsigned int
-ScryptHashFunction(const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint32_t, uint32_t, uint8_t*, size_t);
+Pbkdf2(const uint8_t*, size_t, const uint8_t*, size_t, uint64_t, uint8_t*, size_t);
 
 #endif /* !_KEYDERIVATION_H_ */
@@ -28,9 +28,24 @@ Barry Steyn barry.steyn@gmail.com
 #define _SCRYPTHASH_H_
 
 unsigned int
-KDF(const uint8_t*, size_t, uint8_t*, uint32_t, uint32_t, uint32_t, const uint8_t*);
+KDF(const uint8_t*, size_t, uint8_t*, uint32_t, uint32_t, uint32_t, const uint8_t*, const volatile int*);
 
 unsigned int
-Verify(const uint8_t*, const uint8_t*, size_t);
+Verify(const uint8_t*, const uint8_t*, size_t, const volatile int*);
+
+unsigned int
+KDFBegin(uint8_t*, uint32_t, uint32_t, uint32_t, const uint8_t*);
+
+void
+KDFEnd(uint8_t*, const uint8_t*);
+
+unsigned int
+VerifyBegin(const uint8_t*, uint32_t*, uint32_t*, uint32_t*);
+
+unsigned int
+VerifyEnd(const uint8_t*, const uint8_t*);
+
+unsigned int
+VerifyMany(const uint8_t* const*, const size_t*, const uint8_t* const*, const size_t*, size_t, uint8_t*);
 
 #endif /* !_SCRYPTHASH_H_ */
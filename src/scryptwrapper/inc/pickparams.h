@@ -27,7 +27,32 @@ Barry Steyn barry.steyn@gmail.com
 #ifndef _PICKPARAMS_H_
 #define _PICKPARAMS_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+//Most points a calibration of the cost model has
+#define PICKPARAMS_POINTS_MAX 16
+
+//A point of the cost model: salsa20/8 cores per second for hashes with block size r using memory bytes
+struct pickparams_point {
+    uint64_t memory;
+    uint32_t r;
+    double opps;
+};
+
 unsigned int
 pickparams(int*, uint32_t*, uint32_t*, double, size_t, double, size_t);
 
+unsigned int
+pickparams_throughput(int*, uint32_t*, uint32_t*, double, uint32_t, size_t, size_t);
+
+unsigned int
+pickparams_calibrate(int);
+
+void
+pickparams_set_calibration(const struct pickparams_point*, size_t, double);
+
+void
+pickparams_get_calibration(struct pickparams_point*, size_t*, double*, const char**);
+
 #endif /* !_PICKPARAMS_H_ */
@@ -25,29 +25,67 @@ Barry Steyn barry.steyn@gmail.com
 */
 
 #include "sha256.h"
+#include "crypto_entropy.h"
+#include "crypto_scrypt.h"
 #include "hash.h"
+#include "insecure_memzero.h"
+#include "keyderivation.h"
 #include "pickparams.h"
 #include "sysendian.h"
 
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+//
+// Number of password hashes VerifyMany hands to scrypt at once
+//
+#define VERIFY_MANY_GROUP 64
+
 //
 // Creates a password hash. This is the actual key derivation function
+// A NULL salt means a fresh one is drawn from this thread's DRBG, and
+// cancel is passed on to ScryptHashFunction
 //
 unsigned int
-KDF(const uint8_t* passwd, size_t passwdSize, uint8_t* kdf, uint32_t logN, uint32_t r, uint32_t p, const uint8_t* salt) {
+KDF(const uint8_t* passwd, size_t passwdSize, uint8_t* kdf, uint32_t logN, uint32_t r, uint32_t p, const uint8_t* salt, const volatile int* cancel) {
   uint64_t N=1;
-  uint8_t dk[64],
-          hbuf[32];
-  uint8_t *key_hmac = &dk[32];
-  SHA256_CTX ctx;
-  HMAC_SHA256_CTX hctx;
+  uint8_t dk[64];
+  unsigned int error;
+
+  /* Write the parameters and salt. */
+  if ((error = KDFBegin(kdf, logN, r, p, salt)))
+    return (error);
 
   /* Generate the derived keys. */
   N <<= logN;
-  if (ScryptHashFunction(passwd, passwdSize, salt, 32, N, r, p, dk, 64))
-    return (3);
+  if ((error = ScryptHashFunction(passwd, passwdSize, &kdf[16], 32, N, r, p, dk, 64, cancel)))
+    return (error);
+
+  /* Sign the hash with them. */
+  KDFEnd(kdf, dk);
+
+  /* Clean the stack. */
+  insecure_memzero(dk, sizeof(dk));
+
+  return 0; //success
+}
+
+//
+// The part of KDF before the scrypt computation: writes the parameters and
+// the salt (drawn if NULL) to the first 48 bytes of kdf. The derived key
+// is then computed from the salt at kdf + 16
+//
+unsigned int
+KDFBegin(uint8_t* kdf, uint32_t logN, uint32_t r, uint32_t p, const uint8_t* salt) {
+  /* Draw the salt if the caller has none. */
+  if (salt == NULL) {
+    if (crypto_entropy_read(&kdf[16], 32))
+      return (4);
+  } else {
+    memcpy(&kdf[16], salt, 32);
+  }
 
   /* Construct the hash. */
   memcpy(kdf, "scrypt", 6); //Sticking with Colin Percival's format of putting scrypt at the beginning
@@ -55,7 +93,21 @@ KDF(const uint8_t* passwd, size_t passwdSize, uint8_t* kdf, uint32_t logN, uint3
   kdf[7] = logN;
   be32enc(&kdf[8], r);
   be32enc(&kdf[12], p);
-  memcpy(&kdf[16], salt, 32);
+
+  return 0; //success
+}
+
+//
+// The part of KDF after the scrypt computation: adds the checksum and the
+// signature made with the 64-byte derived key dk
+//
+void
+KDFEnd(uint8_t* kdf, const uint8_t* dk) {
+  uint8_t hbuf[32];
+  const uint8_t *key_hmac = &dk[32];
+  SHA256_CTX ctx;
+  HMAC_SHA256_CTX hctx;
+  HMAC_SHA256_KEY hkey;
 
   /* Add hash checksum. */
   SHA256_Init(&ctx);
@@ -64,33 +116,59 @@ KDF(const uint8_t* passwd, size_t passwdSize, uint8_t* kdf, uint32_t logN, uint3
   memcpy(&kdf[48], hbuf, 16);
 
   /* Add hash signature (used for verifying password). */
-  HMAC_SHA256_Init(&hctx, key_hmac, 32);
+  HMAC_SHA256_Key(&hkey, key_hmac, 32);
+  HMAC_SHA256_Init_key(&hctx, &hkey);
   HMAC_SHA256_Update(&hctx, kdf, 64);
   HMAC_SHA256_Final(hbuf, &hctx);
   memcpy(&kdf[64], hbuf, 32);
 
-  return 0; //success
+  /* Clean the stack. */
+  insecure_memzero(&hkey, sizeof(hkey));
 }
 
 //
 //  Verifies password hash (also ensures hash integrity at same time)
+//  cancel is passed on to ScryptHashFunction
 //
-int
-Verify(const uint8_t* kdf, const uint8_t* passwd, size_t passwdSize) {
-  uint64_t N=0;
-  uint32_t r=0, p=0;
-  uint8_t dk[64],
-          salt[32],
-          hbuf[32];
-  uint8_t * key_hmac = &dk[32];
-  HMAC_SHA256_CTX hctx;
+unsigned int
+Verify(const uint8_t* kdf, const uint8_t* passwd, size_t passwdSize, const volatile int* cancel) {
+  uint64_t N=1;
+  uint32_t logN=0, r=0, p=0;
+  uint8_t dk[64];
+  unsigned int error,
+               rc;
+
+  /* Parse N, r, p and verify hash checksum. */
+  if ((error = VerifyBegin(kdf, &logN, &r, &p)))
+    return (error);
+
+  /* Compute Derived Key */
+  N <<= logN;
+  if ((error = ScryptHashFunction(passwd, passwdSize, &kdf[16], 32, N, r, p, dk, 64, cancel)))
+    return (error);
+
+  /* Check hash signature (i.e., verify password). */
+  rc = VerifyEnd(kdf, dk);
+
+  /* Clean the stack. */
+  insecure_memzero(dk, sizeof(dk));
+
+  return (rc); //0 is success
+}
+
+//
+// The part of Verify before the scrypt computation: checks the checksum and
+// reads the parameters. The derived key is then computed from the salt at kdf + 16
+//
+unsigned int
+VerifyBegin(const uint8_t* kdf, uint32_t* logN, uint32_t* r, uint32_t* p) {
+  uint8_t hbuf[32];
   SHA256_CTX ctx;
 
-  /* Parse N, r, p, salt. */
-  N = (uint64_t)1 << kdf[7]; //Remember, kdf[7] is actually LogN
-  r = be32dec(&kdf[8]);
-  p = be32dec(&kdf[12]);
-  memcpy(salt, &kdf[16], 32);
+  /* Parse N, r, p. */
+  *logN = kdf[7]; //Remember, kdf[7] is actually LogN
+  *r = be32dec(&kdf[8]);
+  *p = be32dec(&kdf[12]);
 
   /* Verify hash checksum. */
   SHA256_Init(&ctx);
@@ -99,16 +177,134 @@ Verify(const uint8_t* kdf, const uint8_t* passwd, size_t passwdSize) {
   if (memcmp(&kdf[48], hbuf, 16))
     return (7);
 
-  /* Compute Derived Key */
-  if (ScryptHashFunction(passwd, passwdSize, salt, 32, N, r, p, dk, 64))
-    return (3);
+  return 0; //success
+}
+
+//
+// The part of Verify after the scrypt computation: checks the signature
+// with the 64-byte derived key dk, returning 0 on a match or 11 if not
+//
+unsigned int
+VerifyEnd(const uint8_t* kdf, const uint8_t* dk) {
+  uint8_t hbuf[32];
+  const uint8_t * key_hmac = &dk[32];
+  HMAC_SHA256_CTX hctx;
+  HMAC_SHA256_KEY hkey;
+  unsigned int rc = 0;
 
   /* Check hash signature (i.e., verify password). */
-  HMAC_SHA256_Init(&hctx, key_hmac, 32);
+  HMAC_SHA256_Key(&hkey, key_hmac, 32);
+  HMAC_SHA256_Init_key(&hctx, &hkey);
   HMAC_SHA256_Update(&hctx, kdf, 64);
   HMAC_SHA256_Final(hbuf, &hctx);
   if (memcmp(hbuf, &kdf[64], 32))
-    return (11);
+    rc = 11;
+
+  /* Clean the stack. */
+  insecure_memzero(&hkey, sizeof(hkey));
+
+  return (rc); //0 is success
+}
+
+//
+// Whether the N (as logN), r and p of a password hash are ones scrypt can be
+// run with on its own: the checks crypto_scrypt makes, with one lane
+//
+static int
+ValidParams(uint32_t logN, uint32_t r, uint32_t p) {
+  if (logN == 0 || logN > 63 || r == 0 || p == 0)
+    return 0;
+  if ((uint64_t)r * p >= ((uint64_t)1 << 30))
+    return 0;
+  if (r > SIZE_MAX / 128 / p || ((uint64_t)1 << logN) > SIZE_MAX / 128 / r)
+    return 0;
+  return 1;
+}
+
+//
+//  Verifies count password hashes in one go: matches[k] is set to 1 if
+//  passwds[k] matches kdfs[k], and to 0 if it does not or if kdfs[k] is
+//  not a valid password hash. Consecutive hashes with the same parameters
+//  are derived together, so their smix computations can share SIMD lanes
+//
+unsigned int
+VerifyMany(const uint8_t* const* kdfs, const size_t* kdfSizes, const uint8_t* const* passwds, const size_t* passwdSizes, size_t count, uint8_t* matches) {
+  uint8_t dk[VERIFY_MANY_GROUP][64],
+          hbuf[32];
+  const uint8_t* gpasswds[VERIFY_MANY_GROUP];
+  const uint8_t* gsalts[VERIFY_MANY_GROUP];
+  size_t gpasswdSizes[VERIFY_MANY_GROUP],
+         gsaltSizes[VERIFY_MANY_GROUP],
+         index[VERIFY_MANY_GROUP];
+  uint8_t* bufs[VERIFY_MANY_GROUP];
+  HMAC_SHA256_CTX hctx;
+  HMAC_SHA256_KEY hkey;
+  SHA256_CTX ctx;
+  const uint8_t* kdf;
+  size_t k, next, n, j;
+  unsigned int error = 0;
+  int rc;
+
+  for (k = 0; k < count; k = next) {
+    /* Gather a group of valid hashes sharing N, r and p. */
+    for (n = 0, next = k; next < count && n < VERIFY_MANY_GROUP; next++) {
+      kdf = kdfs[next];
+      matches[next] = 0;
+
+      /* Verify length, parameters and hash checksum. */
+      if (kdfSizes[next] < 96 || !ValidParams(kdf[7], be32dec(&kdf[8]), be32dec(&kdf[12])))
+        continue;
+      SHA256_Init(&ctx);
+      SHA256_Update(&ctx, kdf, 48);
+      SHA256_Final(hbuf, &ctx);
+      if (memcmp(&kdf[48], hbuf, 16))
+        continue;
+
+      /* Different parameters start the next group. */
+      if (n > 0 && memcmp(&kdf[6], &kdfs[index[0]][6], 10))
+        break;
+
+      index[n] = next;
+      gpasswds[n] = passwds[next];
+      gpasswdSizes[n] = passwdSizes[next];
+      gsalts[n] = &kdf[16];
+      gsaltSizes[n] = 32;
+      bufs[n] = dk[n];
+      n++;
+    }
+    if (n == 0)
+      continue;
+
+    /* Compute Derived Keys */
+    kdf = kdfs[index[0]];
+    rc = crypto_scrypt_batch(gpasswds, gpasswdSizes, gsalts, gsaltSizes, n, (uint64_t)1 << kdf[7], be32dec(&kdf[8]), be32dec(&kdf[12]), bufs, 64);
+
+    /* A group which cannot run together runs one hash at a time, unless it gave up waiting for memory */
+    if (rc && errno != ETIMEDOUT && errno != ECANCELED) {
+      for (j = 0, rc = 0; rc == 0 && j < n; j++)
+        rc = crypto_scrypt(gpasswds[j], gpasswdSizes[j], gsalts[j], gsaltSizes[j], (uint64_t)1 << kdf[7], be32dec(&kdf[8]), be32dec(&kdf[12]), bufs[j], 64);
+    }
+    if (rc) {
+      error = 3;
+      if (errno) {
+        error |= (errno << 16);
+      }
+      break;
+    }
+
+    /* Check hash signatures (i.e., verify passwords). */
+    for (j = 0; j < n; j++) {
+      HMAC_SHA256_Key(&hkey, &dk[j][32], 32);
+      HMAC_SHA256_Init_key(&hctx, &hkey);
+      HMAC_SHA256_Update(&hctx, kdfs[index[j]], 64);
+      HMAC_SHA256_Final(hbuf, &hctx);
+      matches[index[j]] = (memcmp(hbuf, &kdfs[index[j]][64], 32) == 0);
+    }
+  }
+
+  /* Clean the stack. */
+  insecure_memzero(dk, sizeof(dk));
+  insecure_memzero(&hkey, sizeof(hkey));
 
-  return (0); //Success
+  return (error);
 }
@@ -24,9 +24,17 @@ freely, subject to the following restrictions:
 Barry Steyn barry.steyn@gmail.com
 */
 
+#include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include "crypto_scrypt.h"
 #include "pickparams.h"
 #include "scryptenc_cpuperf.h"
 #include "util/memlimit.h"
@@ -37,64 +45,381 @@ Barry Steyn barry.steyn@gmail.com
 #include <stdio.h>
 //end remove
 
+/*
+ * The locks around the calibrations: pthread mutexes, or slim reader/writer locks on Windows
+ */
+#ifdef HAVE_PTHREAD
+typedef pthread_mutex_t calibration_lock_t;
+#define CALIBRATION_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define LOCK(lock) pthread_mutex_lock(lock)
+#define UNLOCK(lock) pthread_mutex_unlock(lock)
+#elif defined(_WIN32)
+typedef SRWLOCK calibration_lock_t;
+#define CALIBRATION_LOCK_INITIALIZER SRWLOCK_INIT
+#define LOCK(lock) AcquireSRWLockExclusive(lock)
+#define UNLOCK(lock) ReleaseSRWLockExclusive(lock)
+#else
+#error "pickparams needs pthreads or Windows threads"
+#endif
+
+/*
+ * The calibration grid: the same three sizes of V (in cache, around the size of a large L3
+ * cache, and a hash's usual memory) timed with three values of r, so that the cost model sees
+ * where this CPU's caches run out and how r changes the memory throughput. A point with r = 12
+ * uses 3/4 as much memory as the points with r = 8 and 16 next to it
+ */
+static const struct {
+    uint64_t N;
+    uint32_t r;
+    unsigned int samples; // Fewer for the slower points; their median is taken
+} calibration_grid[] = {
+    { 512, 8, 7 }, { 256, 12, 7 }, { 256, 16, 7 },          // 512 KiB
+    { 8192, 8, 5 }, { 4096, 12, 5 }, { 4096, 16, 5 },       // 8 MiB
+    { 32768, 8, 3 }, { 16384, 12, 3 }, { 16384, 16, 3 },    // 32 MiB
+};
+#define CALIBRATION_POINTS (sizeof(calibration_grid) / sizeof(calibration_grid[0]))
+#define CALIBRATION_ROW 3 // Points of each size of V
+
+/*
+ * The calibration: the cost model's points taken with the kernel named calibrated_kernel, and
+ * the noisiest of their samples. calibrated_npoints is 0 until the first calibration
+ */
+static struct pickparams_point calibrated_points[PICKPARAMS_POINTS_MAX];
+static size_t calibrated_npoints = 0;
+static double calibrated_spread = 0;
+static const char* calibrated_kernel = NULL;
+static calibration_lock_t calibration_mutex = CALIBRATION_LOCK_INITIALIZER;
+
+/*
+ * Calibrates unless there is already a calibration for the kernel in use (or force is set),
+ * and copies its points into points. Concurrent callers wait for one calibration
+ */
+static unsigned int
+calibration(int force, struct pickparams_point *points, size_t *npoints) {
+    const char *kernel;
+    size_t lanes;
+    int forced;
+    double opps, spread;
+    size_t i;
+    int rc = 0;
+
+    crypto_scrypt_get_kernel(&kernel, &lanes, &forced);
+
+    LOCK(&calibration_mutex);
+    if (force || calibrated_npoints == 0 || strcmp(kernel, calibrated_kernel) != 0) {
+        calibrated_npoints = 0;
+        calibrated_spread = 0;
+        for (i = 0; i < CALIBRATION_POINTS; i++) {
+            if ((rc = scryptenc_cpuperf_sampled(calibration_grid[i].N, calibration_grid[i].r, 1, calibration_grid[i].samples, &opps, &spread)) != 0)
+                break;
+
+            calibrated_points[i].memory = 128 * calibration_grid[i].N * calibration_grid[i].r;
+            calibrated_points[i].r = calibration_grid[i].r;
+            calibrated_points[i].opps = opps;
+            if (spread > calibrated_spread)
+                calibrated_spread = spread;
+        }
+        if (rc == 0) {
+            calibrated_npoints = CALIBRATION_POINTS;
+            calibrated_kernel = kernel;
+        }
+    }
+    memcpy(points, calibrated_points, calibrated_npoints * sizeof(struct pickparams_point));
+    *npoints = calibrated_npoints;
+    UNLOCK(&calibration_mutex);
+
+    return ((unsigned int)(rc));
+}
+
+//Contended calibrations kept, for the last few concurrencies asked for
+#define CONTENDED_CACHE 4
+
+/*
+ * Calibrations taken with as many hashes running at once as threads, of the first rows of the
+ * grid (those which fit in the memory limit), with the kernel named kernel; and the entry the
+ * next new calibration replaces
+ */
+static struct {
+    uint32_t threads;
+    size_t rows;
+    const char* kernel;
+    struct pickparams_point points[CALIBRATION_POINTS];
+} contended[CONTENDED_CACHE];
+static size_t contended_next = 0;
+static calibration_lock_t contended_mutex = CALIBRATION_LOCK_INITIALIZER;
+
+/*
+ * Calibrates with threads hashes running at once, on the rows of the grid whose hashes all fit
+ * in memlimit together, unless that has been done already for the kernel in use; and copies the
+ * points into points. If not even the first row fits, only as many hashes as fit run at once.
+ * One thread is the plain calibration
+ */
+static unsigned int
+contended_calibration(uint32_t threads, size_t memlimit, struct pickparams_point *points, size_t *npoints) {
+    const char *kernel;
+    size_t lanes;
+    int forced;
+    double opps, spread;
+    size_t rows, entry, i;
+    int rc = 0;
+
+    /* Not even the first row fits: run only as many hashes at once as fit */
+    if ((double)(128 * calibration_grid[0].N * calibration_grid[0].r) * threads > memlimit)
+        threads = (uint32_t)(memlimit / (128 * calibration_grid[0].N * calibration_grid[0].r));
+
+    if (threads <= 1)
+        return (calibration(0, points, npoints));
+
+    for (rows = 1; rows < CALIBRATION_POINTS / CALIBRATION_ROW; rows++) {
+        if ((double)(128 * calibration_grid[rows * CALIBRATION_ROW].N * calibration_grid[rows * CALIBRATION_ROW].r) * threads > memlimit)
+            break;
+    }
+
+    crypto_scrypt_get_kernel(&kernel, &lanes, &forced);
+
+    LOCK(&contended_mutex);
+    for (entry = 0; entry < CONTENDED_CACHE; entry++) {
+        if (contended[entry].threads == threads && contended[entry].rows == rows && contended[entry].kernel != NULL && strcmp(kernel, contended[entry].kernel) == 0)
+            break;
+    }
+    if (entry == CONTENDED_CACHE) {
+        entry = contended_next;
+        contended_next = (contended_next + 1) % CONTENDED_CACHE;
+        contended[entry].threads = 0;
+
+        for (i = 0; i < rows * CALIBRATION_ROW; i++) {
+            if ((rc = scryptenc_cpuperf_sampled(calibration_grid[i].N, calibration_grid[i].r, threads, calibration_grid[i].samples, &opps, &spread)) != 0)
+                break;
+
+            contended[entry].points[i].memory = 128 * calibration_grid[i].N * calibration_grid[i].r;
+            contended[entry].points[i].r = calibration_grid[i].r;
+            contended[entry].points[i].opps = opps;
+        }
+        if (rc == 0) {
+            contended[entry].threads = threads;
+            contended[entry].rows = rows;
+            contended[entry].kernel = kernel;
+        }
+    }
+    if (rc == 0) {
+        memcpy(points, contended[entry].points, rows * CALIBRATION_ROW * sizeof(struct pickparams_point));
+        *npoints = rows * CALIBRATION_ROW;
+    }
+    UNLOCK(&contended_mutex);
+
+    return ((unsigned int)(rc));
+}
+
+/*
+ * Salsa20/8 cores per second the cost model predicts for a hash with block size r which uses
+ * memory bytes: interpolated between the points with that r on a log scale of memory. Below the
+ * first point the rate is flat; above the last it keeps falling as it did between the last two
+ * points (DRAM only gets slower as V outgrows the TLB), down to half of the last rate. Returns 0
+ * if no point has that r
+ */
+static double
+model(const struct pickparams_point *points, size_t npoints, uint32_t r, double memory) {
+    const struct pickparams_point *below = NULL, *above = NULL, *last = NULL, *before_last = NULL;
+    double f, opps;
+    size_t i;
+
+    for (i = 0; i < npoints; i++) {
+        if (points[i].r != r)
+            continue;
+        if (points[i].memory <= memory && (below == NULL || points[i].memory > below->memory))
+            below = &points[i];
+        if (points[i].memory >= memory && (above == NULL || points[i].memory < above->memory))
+            above = &points[i];
+        if (last == NULL || points[i].memory > last->memory) {
+            before_last = last;
+            last = &points[i];
+        } else if (points[i].memory < last->memory && (before_last == NULL || points[i].memory > before_last->memory)) {
+            before_last = &points[i];
+        }
+    }
+
+    if (below == NULL)
+        return (above == NULL ? 0 : above->opps);
+    if (above == NULL) {
+        if (before_last == NULL || before_last->opps <= last->opps)
+            return (last->opps);
+        f = log(memory / last->memory) / log((double)(last->memory) / before_last->memory);
+        opps = last->opps - f * (before_last->opps - last->opps);
+        return (opps < last->opps / 2 ? last->opps / 2 : opps);
+    }
+    if (above->memory == below->memory)
+        return (below->opps);
+
+    f = log(memory / below->memory) / log((double)(above->memory) / below->memory);
+    return (below->opps + f * (above->opps - below->opps));
+}
+
+/*
+ * Measures how fast the CPU is, once per kernel unless force is set, so that
+ * pickparams can use the result instead of spending time on its own measurement
+ */
+unsigned int
+pickparams_calibrate(int force) {
+    struct pickparams_point points[PICKPARAMS_POINTS_MAX];
+    size_t npoints;
+
+    return (calibration(force, points, &npoints));
+}
+
+/*
+ * Uses a calibration taken earlier (in another process, say) for the kernel in use
+ */
+void
+pickparams_set_calibration(const struct pickparams_point *points, size_t npoints, double spread) {
+    const char *kernel;
+    size_t lanes;
+    int forced;
+
+    crypto_scrypt_get_kernel(&kernel, &lanes, &forced);
+    if (npoints > PICKPARAMS_POINTS_MAX)
+        npoints = PICKPARAMS_POINTS_MAX;
+
+    LOCK(&calibration_mutex);
+    memcpy(calibrated_points, points, npoints * sizeof(struct pickparams_point));
+    calibrated_npoints = npoints;
+    calibrated_spread = spread;
+    calibrated_kernel = kernel;
+    UNLOCK(&calibration_mutex);
+}
+
+/*
+ * Gets the calibration (at most PICKPARAMS_POINTS_MAX points) and the kernel it was taken with,
+ * or no points (and a NULL kernel) if there is none
+ */
+void
+pickparams_get_calibration(struct pickparams_point *points, size_t *npoints, double *spread, const char **kernel) {
+    LOCK(&calibration_mutex);
+    memcpy(points, calibrated_points, calibrated_npoints * sizeof(struct pickparams_point));
+    *npoints = calibrated_npoints;
+    *spread = calibrated_spread;
+    *kernel = calibrated_kernel;
+    UNLOCK(&calibration_mutex);
+}
+
+/*
+ * Picks N (as logN), r and p for hashes of at most memlimit bytes taking at most maxtime seconds
+ * by the cost model of points
+ */
+static void
+search(const struct pickparams_point *points, size_t npoints, double maxtime, size_t memlimit, int *logN, uint32_t *r, uint32_t *p) {
+    double memory, best_memory, work, best_work;
+    double opps, opslimit, maxrp;
+    uint32_t candidate_r, candidate_p;
+    size_t i, j;
+    int candidate_logN;
+
+    /* Fall back to Colin Percival's defaults if nothing below fits. */
+    *logN = 1;
+    *r = 8; // r is the underlying block size, Colin Percival defaults to 8 in his reference implementation
+    *p = 1;
+    best_memory = 0;
+    best_work = 0;
+
+    /*
+    * Try every r the model has points for (the first listed wins a tie), and every N which
+    * fits in the memory limit and whose single smix the model says takes no longer than
+    * maxtime (allowing a minimum of 2^15 salsa20/8 cores). The most memory wins, as the
+    * hardest to attack; among equals, the most work, so that the hash takes as close to
+    * maxtime as it can. p fills the time left over.
+    */
+    for (i = 0; i < npoints; i++) {
+        candidate_r = points[i].r;
+        for (j = 0; j < i && points[j].r != candidate_r; j++)
+            continue;
+        if (j < i)
+            continue;
+
+        for (candidate_logN = 1; candidate_logN < 63; candidate_logN++) {
+            memory = 128.0 * candidate_r * (double)((uint64_t)(1) << candidate_logN);
+            if (memory > memlimit)
+                break;
+
+            opps = model(points, npoints, candidate_r, memory);
+            opslimit = opps * maxtime;
+            if (opslimit < 32768)
+                opslimit = 32768;
+            if (4.0 * candidate_r * (double)((uint64_t)(1) << candidate_logN) > opslimit)
+                break;
+
+            maxrp = (opslimit / 4) / ((uint64_t)(1) << candidate_logN);
+            if (maxrp > 0x3fffffff)
+                maxrp = 0x3fffffff;
+            candidate_p = (uint32_t)(maxrp) / candidate_r;
+            if (candidate_p < 1)
+                candidate_p = 1;
+
+            work = memory * candidate_p;
+            if (memory > best_memory || (memory == best_memory && work > best_work)) {
+                best_memory = memory;
+                best_work = work;
+                *logN = candidate_logN;
+                *r = candidate_r;
+                *p = candidate_p;
+            }
+        }
+    }
+}
+
 /*
  * Given maxmem, maxmemfrac and maxtime, this functions calculates the N,r,p variables.
- * Values for N,r,p are machine dependent. This is copied directly from Colin Percival's srypt reference code
+ * Values for N,r,p are machine dependent. The memory limit is worked out as in Colin Percival's
+ * scrypt reference code; the time a hash takes comes from a cost model calibrated on this machine
  */
 unsigned int
 pickparams(int *logN, uint32_t *r, uint32_t *p, double maxtime, size_t maxmem, double maxmemfrac, size_t osfreemem) {
     //Note: logN (as opposed to N) is calculated here. This is because it is compact (it can be represented by an int)
     //      and it is easy (and quick) to convert to N by right shifting bits. Most importantly, using logN only requires
     //      32 bits to be stored. Seeing as it is embedded inside the hash, the smaller the better
+    struct pickparams_point points[PICKPARAMS_POINTS_MAX];
+    size_t npoints;
     size_t memlimit;
-    double opps;
-    double opslimit;
-    double maxN, maxrp;
     int rc;
 
     /* Figure out how much memory to use. */
     if (memtouse(maxmem, maxmemfrac, osfreemem, &memlimit))
         return (1);
 
-    /* Figure out how fast the CPU is. */
-    if ((rc = scryptenc_cpuperf(&opps)) != 0)
+    /* Figure out how fast the CPU is: measured once, then looked up, so that every call agrees. */
+    if ((rc = calibration(0, points, &npoints)) != 0)
         return ((unsigned int)(rc)); // type cast works since Colin is only using positive integers
-    opslimit = opps * maxtime;
 
-    /* Allow a minimum of 2^15 salsa20/8 cores. */
-    if (opslimit < 32768)
-        opslimit = 32768;
+    search(points, npoints, maxtime, memlimit, logN, r, p);
 
-    /* Set r to 8 */
-    *r = 8; // r is the underlying block size, Colin Percival defaults to 8 in his reference implementation
+    /* Success! */
+    return (0);
+}
 
-    /*
-    * The memory limit requires that 128Nr <= memlimit, while the CPU
-    * limit requires that 4Nrp <= opslimit. If opslimit < memlimit/32,
-    * opslimit imposes the stronger limit on N.
-    */
-    if (opslimit < memlimit/32) {
-        /* Set p = 1 and choose N based on the CPU limit. */
-        *p = 1;
-        maxN = opslimit / (*r * 4);
-        for (*logN = 1; *logN < 63; *logN += 1) {
-            if ((uint64_t)(1) << *logN > maxN / 2)
-                break;
-        }
-    } else {
-        /* Set N based on the memory limit. */
-        maxN = (double)(memlimit / (*r * 128));
-        for (*logN = 1; *logN < 63; *logN += 1) {
-            if ((uint64_t)(1) << *logN > maxN / 2)
-            break;
-        }
+/*
+ * Given a rate of verifications per second and how many run at once, this function calculates
+ * the N,r,p variables for hashes which keep up with that rate when as many run at once as
+ * concurrency. Each may take concurrency / verifies seconds, measured with that many running at
+ * once (so that they contend for memory bandwidth as they will in production), and they share
+ * the memory limit of maxmem, worked out as for pickparams with a maxmemfrac of 0.5
+ */
+unsigned int
+pickparams_throughput(int *logN, uint32_t *r, uint32_t *p, double verifies, uint32_t concurrency, size_t maxmem, size_t osfreemem) {
+    struct pickparams_point points[PICKPARAMS_POINTS_MAX];
+    size_t npoints;
+    size_t memlimit;
+    int rc;
 
-        /* Choose p based on the CPU limit. */
-        maxrp = (opslimit / 4) / ((uint64_t)(1) << *logN);
-        if (maxrp > 0x3fffffff)
-            maxrp = 0x3fffffff;
-        *p = (uint32_t)(maxrp) / *r;
-    }
+    /* Figure out how much memory all the hashes may use together; each gets at least 1 MiB. */
+    if (memtouse(maxmem, 0.5, osfreemem, &memlimit))
+        return (1);
+
+    /* Figure out how fast each hash runs while concurrency of them run at once. */
+    if ((rc = contended_calibration(concurrency, memlimit, points, &npoints)) != 0)
+        return ((unsigned int)(rc));
+
+    memlimit /= concurrency;
+    if (memlimit < 1048576)
+        memlimit = 1048576;
+    search(points, npoints, concurrency / verifies, memlimit, logN, r, p);
 
     /* Success! */
     return (0);
@@ -1,6 +1,10 @@
 // TypeScript migration of scrypt-tests.js
 
 import { Buffer } from "node:buffer";
+import * as Crypto from "node:crypto";
+import * as Fs from "node:fs";
+import * as Os from "node:os";
+import * as Path from "node:path";
 import { expect, use as chaiUse } from "chai";
 import chaiAsPromised from "chai-as-promised";
 
@@ -182,7 +186,7 @@ describe("Scrypt Node Module Tests", function () {
       });
 
       it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-        expect(() => scrypt.kdfSync(1123, { N: 1, r: 1, p: 1 })).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+        expect(() => scrypt.kdfSync(1123, { N: 1, r: 1, p: 1 })).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
       });
 
       it("Will throw a TypeError if the Scrypt params object is incorrect", function () {
@@ -224,7 +228,7 @@ describe("Scrypt Node Module Tests", function () {
       });
 
       it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-        expect(() => scrypt.kdf(1123, { N: 1, r: 1, p: 1 }, () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+        expect(() => scrypt.kdf(1123, { N: 1, r: 1, p: 1 }, () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
       });
 
       it("Will throw a TypeError if the Scrypt params object is incorrect", function () {
@@ -252,6 +256,13 @@ describe("Scrypt Node Module Tests", function () {
             done();
           });
         });
+
+        it("Will draw a fresh salt for every KDF", async function () {
+          const results = await Promise.all(Array.from({ length: 8 }, () => scrypt.kdf("password", { N: 4, r: 1, p: 1 })!));
+          const salts = new Set(results.map((result) => result.subarray(16, 48).toString("hex")));
+          expect(salts.size).to.equal(results.length);
+          results.forEach((result) => expect(scrypt.verifyKdfSync(result, "password")).to.be.true);
+        });
       }
     });
   });
@@ -265,7 +276,7 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-          expect(() => scrypt.hashSync(1123, { N: 1, r: 1, p: 1 }, 32, "NaCl")).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.hashSync(1123, { N: 1, r: 1, p: 1 }, 32, "NaCl")).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw a TypeError if the Scrypt params object is incorrect", function () {
@@ -278,7 +289,7 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the salt is not a string or a Buffer object", function () {
-          expect(() => scrypt.hashSync("hash something", { N: 1, r: 1, p: 1 }, 32, 45)).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.hashSync("hash something", { N: 1, r: 1, p: 1 }, 32, 45)).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
       });
 
@@ -316,7 +327,7 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-          expect(() => scrypt.hash(1123, { N: 16, r: 1, p: 1 }, 32, "NaCl", () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.hash(1123, { N: 16, r: 1, p: 1 }, 32, "NaCl", () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw a TypeError if the Scrypt params object is incorrect", function () {
@@ -329,7 +340,7 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the salt is not a string or a Buffer object", function () {
-          expect(() => scrypt.hash("hash something", { N: 16, r: 1, p: 1 }, 32, 45, () => {})).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.hash("hash something", { N: 16, r: 1, p: 1 }, 32, 45, () => {})).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
       });
 
@@ -355,6 +366,16 @@ describe("Scrypt Node Module Tests", function () {
               done();
             });
           });
+
+          it("Will produce the same hash as the callback form", async function () {
+            const result = await scrypt.hash("hash something", { N: 16, r: 1, p: 1 }, hash_length, "NaCl")!;
+            expect(result.equals(scrypt.hashSync("hash something", { N: 16, r: 1, p: 1 }, hash_length, "NaCl"))).to.be.true;
+          });
+
+          it("Will still throw the full argument errors", function () {
+            expect(() => scrypt.hash("hash something", { N: 16.5, r: 1, p: 1 }, hash_length, "NaCl")).to.throw(TypeError).to.match(/^TypeError: Scrypt params object 'N' property is not an integer$/);
+            expect(() => scrypt.hash("hash something", { N: 16, r: 1, p: 1 }, hash_length, 45)).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
+          });
         }
       });
     });
@@ -366,11 +387,11 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the KDF is not a string or a Buffer object", function () {
-          expect(() => scrypt.verifyKdfSync(1232, "key")).to.throw(TypeError).to.match(/^TypeError: KDF type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.verifyKdfSync(1232, "key")).to.throw(TypeError).to.match(/^TypeError: KDF type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-          expect(() => scrypt.verifyKdfSync("KDF", 1232)).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.verifyKdfSync("KDF", 1232)).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw an Error if KDF buffer is not a valid scrypt-encrypted block", function () {
@@ -414,11 +435,11 @@ describe("Scrypt Node Module Tests", function () {
         });
 
         it("Will throw a TypeError if the KDF is not a string or a Buffer object", function () {
-          expect(() => scrypt.verifyKdf(1232, "key", () => {})).to.throw(TypeError).to.match(/^TypeError: KDF type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.verifyKdf(1232, "key", () => {})).to.throw(TypeError).to.match(/^TypeError: KDF type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw a TypeError if the key is not a string or a Buffer object", function () {
-          expect(() => scrypt.verifyKdfSync("KDF", 1232, () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string or Buffer$/);
+          expect(() => scrypt.verifyKdfSync("KDF", 1232, () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
         });
 
         it("Will throw an Error if KDF buffer is not a valid scrypt-encrypted block", function () {
@@ -600,4 +621,815 @@ describe("Scrypt Node Module Tests", function () {
       });
     });
   });
-});
\ No newline at end of file
+
+  // Scrypt binary input and hashInto tests
+  describe("Scrypt Binary Inputs", function () {
+    const vector2 = "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640";
+    const password = new Uint8Array(Buffer.from("password"));
+    const salt = Buffer.from("NaCl");
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will accept a TypedArray, DataView or ArrayBuffer wherever a Buffer is accepted", function () {
+        expect(scrypt.hashSync(password, { N: 10, r: 8, p: 16 }, 64, new DataView(salt.buffer, salt.byteOffset, salt.length)).toString("hex")).to.equal(vector2);
+        expect(scrypt.hashSync(password.buffer, { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+        expect(scrypt.verifyKdfSync(new Uint8Array(scrypt.kdfSync("password", { N: 4, r: 1, p: 1 })), password)).to.be.true;
+      });
+
+      it("Will write the hash into the target at the offset", function () {
+        const target = new Uint8Array(80);
+        expect(scrypt.hashIntoSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl", target, 8)).to.equal(target);
+        expect(Buffer.from(target.buffer, 8, 64).toString("hex")).to.equal(vector2);
+        expect(target.subarray(0, 8).every((byte) => byte === 0)).to.be.true;
+        expect(target.subarray(72).every((byte) => byte === 0)).to.be.true;
+      });
+    });
+
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw a RangeError if the hash does not fit into the target at the offset", function () {
+        expect(() => scrypt.hashIntoSync("password", { N: 4, r: 1, p: 1 }, 64, "NaCl", Buffer.alloc(64), 1)).to.throw(RangeError).to.match(/^RangeError: The hash does not fit into the target at this offset$/);
+        expect(() => scrypt.hashIntoSync("password", { N: 4, r: 1, p: 1 }, 64, "NaCl", Buffer.alloc(64), -1)).to.throw(RangeError).to.match(/^RangeError: The hash does not fit into the target at this offset$/);
+      });
+
+      it("Will throw a TypeError if the target is not binary data", function () {
+        expect(() => scrypt.hashIntoSync("password", { N: 4, r: 1, p: 1 }, 64, "NaCl", "target")).to.throw(TypeError).to.match(/^TypeError: Target type is incorrect: It can only be of type Buffer, TypedArray, DataView or ArrayBuffer$/);
+      });
+    });
+
+    describe("Asynchronous functionality with correct arguments", function () {
+      it("Will write the hash into an ArrayBuffer, defaulting the offset to 0", function (done) {
+        const target = new ArrayBuffer(64);
+        scrypt.hashInto(password, { N: 10, r: 8, p: 16 }, 64, salt, target, (err: Error | null, result: ArrayBuffer) => {
+          expect(err).to.not.exist;
+          expect(result).to.equal(target);
+          expect(Buffer.from(target).toString("hex")).to.equal(vector2);
+          done();
+        });
+      });
+    });
+  });
+
+  // Scrypt Batch Function tests
+  describe("Scrypt Batch Functions", function () {
+    const vector2 = "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640";
+
+    describe("Asynchronous functionality with incorrect arguments", function () {
+      it("Will throw a TypeError if the keys or salts are not arrays of strings or binary data", function () {
+        expect(() => scrypt.hashMany("password", { N: 10, r: 8, p: 16 }, 64, ["NaCl"], () => {})).to.throw(TypeError).to.match(/^TypeError: Keys type is incorrect: It must be an array of strings or binary data$/);
+        expect(() => scrypt.hashMany(["password"], { N: 10, r: 8, p: 16 }, 64, ["NaCl", "NaCl"], () => {})).to.throw(TypeError).to.match(/^TypeError: Salts type is incorrect: It must be an array of strings or binary data, one for each key$/);
+        expect(() => scrypt.hashMany(["password", 1], { N: 10, r: 8, p: 16 }, 64, ["NaCl", "NaCl"], () => {})).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
+      });
+
+      it("Will throw a TypeError if the pairs are not [KDF, key] pairs", function () {
+        expect(() => scrypt.verifyKdfMany("pairs", () => {})).to.throw(TypeError).to.match(/^TypeError: Pairs type is incorrect: It must be an array of \[KDF, key\] pairs$/);
+        expect(() => scrypt.verifyKdfMany([["kdf"]], () => {})).to.throw(TypeError).to.match(/^TypeError: Pairs type is incorrect: It must be an array of \[KDF, key\] pairs$/);
+      });
+    });
+
+    describe("Asynchronous functionality with correct arguments", function () {
+      it("Will produce the same hashes as hashSync, one buffer per key", function (done) {
+        const keys = Array.from({ length: 21 }, (_, i) => i === 0 ? "password" : `key ${i}`);
+        const salts = keys.map((_, i) => i === 0 ? "NaCl" : Buffer.from(`salt ${i}`));
+        scrypt.hashMany(keys, { N: 10, r: 8, p: 16 }, 64, salts, (err: Error | null, hashes: Buffer[]) => {
+          expect(err).to.not.exist;
+          expect(hashes).to.have.length(keys.length);
+          expect(hashes[0].toString("hex")).to.equal(vector2);
+          hashes.forEach((hash, i) => expect(hash.equals(scrypt.hashSync(keys[i], { N: 10, r: 8, p: 16 }, 64, salts[i]))).to.be.true);
+          done();
+        });
+      });
+
+      it("Will match hashSync for every batch size up to one more than the SIMD lanes", function () {
+        // Keys and salts of differing lengths fill full, partial and left-over groups of lanes
+        const lanes = scrypt.kernels().batchLanes;
+        const sizes = Array.from({ length: lanes + 1 }, (_, i) => i + 1);
+        return Promise.all(sizes.map((count) => {
+          const keys = Array.from({ length: count }, (_, i) => "k".repeat(i + 1));
+          const salts = keys.map((_, i) => Buffer.alloc((i * 7) % 17, i));
+          return scrypt.hashMany(keys, { N: 4, r: 8, p: 1 }, 32, salts)!.then((hashes: Buffer[]) => {
+            hashes.forEach((hash, i) => expect(hash.toString("hex")).to.equal(scrypt.hashSync(keys[i], { N: 4, r: 8, p: 1 }, 32, salts[i]).toString("hex")));
+          });
+        }));
+      });
+
+      it("Will verify pairs with mixed parameters, wrong keys and corrupt KDFs", function (done) {
+        const keys = Array.from({ length: 12 }, (_, i) => `key ${i}`);
+        const kdfs = keys.map((key, i) => scrypt.kdfSync(key, { N: i < 6 ? 10 : 11, r: 8, p: 1 }));
+        const corrupt = Buffer.from(kdfs[3]);
+        corrupt[50] ^= 1;
+        const pairs: [Buffer, string][] = kdfs.map((kdf, i) => [i === 3 ? corrupt : kdf, i === 7 ? "wrong" : keys[i]]);
+        scrypt.verifyKdfMany(pairs, (err: Error | null, matches: boolean[]) => {
+          expect(err).to.not.exist;
+          expect(matches).to.deep.equal(keys.map((_, i) => i !== 3 && i !== 7));
+          done();
+        });
+      });
+
+      it("Will not match KDFs whose checksum is valid but whose N, r or p scrypt rejects, and verify the rest", function () {
+        const kdf = scrypt.kdfSync("key", { N: 10, r: 8, p: 1 });
+        const withParams = (logN: number, r: number, p: number) => {
+          const bad = Buffer.from(kdf);
+          bad[7] = logN;
+          bad.writeUInt32BE(r, 8);
+          bad.writeUInt32BE(p, 12);
+          Crypto.createHash("sha256").update(bad.subarray(0, 48)).digest().copy(bad, 48, 0, 16);
+          return bad;
+        };
+        const pairs: [Buffer, string][] = [
+          [kdf, "key"],
+          [withParams(0, 8, 1), "key"],
+          [withParams(10, 0, 1), "key"],
+          [withParams(10, 8, 0), "key"],
+          [withParams(10, 1 << 15, 1 << 15), "key"],
+          [kdf, "key"],
+        ];
+        return scrypt.verifyKdfMany(pairs)!.then((matches: boolean[]) => {
+          expect(matches).to.deep.equal([true, false, false, false, false, true]);
+        });
+      });
+    });
+
+    describe("Promise asynchronous functionality with correct arguments", function () {
+      if (typeof Promise !== "undefined") {
+        it("Will resolve with the hashes and the matches", function (done) {
+          scrypt.hashMany(["password"], { N: 10, r: 8, p: 16 }, 64, ["NaCl"])!.then((hashes: Buffer[]) => {
+            expect(hashes[0].toString("hex")).to.equal(vector2);
+            const kdf = scrypt.kdfSync("password", { N: 10, r: 8, p: 1 });
+            return scrypt.verifyKdfMany([[kdf, "password"], [kdf, "Password"]])!;
+          }).then((matches: boolean[]) => {
+            expect(matches).to.deep.equal([true, false]);
+            done();
+          });
+        });
+      }
+    });
+  });
+
+  // Scrypt PBKDF2 Function tests
+  describe("Scrypt PBKDF2 Function", function () {
+    const vector1 = "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783";
+    const vector2 = "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d";
+
+    afterEach(function () {
+      scrypt.configure({ threads: 1 });
+    });
+
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw SyntexError exception if called without arguments", function () {
+        expect(() => scrypt.pbkdf2Sync()).to.throw(SyntaxError).to.match(/^SyntaxError: At least four arguments are needed - the key, the salt, the number of iterations and the output length of the key$/);
+      });
+
+      it("Will throw a TypeError if the key or salt is not a string or a Buffer object", function () {
+        expect(() => scrypt.pbkdf2Sync(1123, "salt", 1, 32)).to.throw(TypeError).to.match(/^TypeError: Key type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
+        expect(() => scrypt.pbkdf2Sync("passwd", 45, 1, 32)).to.throw(TypeError).to.match(/^TypeError: Salt type is incorrect: It can only be of type string, Buffer, TypedArray, DataView or ArrayBuffer$/);
+      });
+
+      it("Will throw a RangeError if the iterations are less than 1", function () {
+        expect(() => scrypt.pbkdf2Sync("passwd", "salt", 0, 32)).to.throw(RangeError).to.match(/^RangeError: Iterations must be greater than 0$/);
+        expect(() => scrypt.pbkdf2Sync("passwd", "salt", 1.5, 32)).to.throw(TypeError).to.match(/^TypeError: Iterations must be an integer$/);
+      });
+
+      it("Will throw a RangeError if the key length is out of range", function () {
+        expect(() => scrypt.pbkdf2Sync("passwd", "salt", 1, -1)).to.throw(RangeError).to.match(/^RangeError: Key length must be between 0 and \(2\^32 - 1\) \* 32$/);
+        expect(() => scrypt.pbkdf2Sync("passwd", "salt", 1, "64")).to.throw(TypeError).to.match(/^TypeError: Key length must be an integer$/);
+      });
+    });
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will produce the RFC 7914 PBKDF2-HMAC-SHA256 test vectors", function () {
+        expect(scrypt.pbkdf2Sync("passwd", "salt", 1, 64).toString("hex")).to.equal(vector1);
+        expect(scrypt.pbkdf2Sync(Buffer.from("Password"), Buffer.from("NaCl"), 80000, 64).toString("hex")).to.equal(vector2);
+      });
+
+      it("Will match Node's PBKDF2 when the output blocks are spread over threads", function () {
+        scrypt.configure({ threads: 4 });
+        for (const [iterations, keylen] of [[1, 1024 * 1024 + 5], [3, 100000], [2000, 1000]]) {
+          expect(scrypt.pbkdf2Sync("passwd", "salt", iterations, keylen).equals(Crypto.pbkdf2Sync("passwd", "salt", iterations, keylen, "sha256"))).to.be.true;
+        }
+      });
+
+      it("Will match Node's PBKDF2 for keys longer than a block and more than one iteration", function () {
+        const key = Buffer.alloc(100, "k");
+        for (const saltlen of [0, 3, 51, 52, 60, 64, 119]) {
+          const salt = Buffer.alloc(saltlen, "s");
+          for (const [iterations, keylen] of [[1, 300], [1, 256 + 31], [3, 300], [3, 33]]) {
+            expect(scrypt.pbkdf2Sync(key, salt, iterations, keylen).equals(Crypto.pbkdf2Sync(key, salt, iterations, keylen, "sha256"))).to.be.true;
+          }
+        }
+      });
+    });
+
+    describe("Asynchronous functionality with correct arguments", function () {
+      it("Will produce the RFC 7914 PBKDF2-HMAC-SHA256 test vector", function (done) {
+        scrypt.pbkdf2("passwd", "salt", 1, 64, (err: Error | null, result: Buffer) => {
+          expect(err).to.not.exist;
+          expect(result.toString("hex")).to.equal(vector1);
+          done();
+        });
+      });
+    });
+
+    describe("Promise asynchronous functionality with correct arguments", function () {
+      if (typeof Promise !== "undefined") {
+        it("Will produce the RFC 7914 PBKDF2-HMAC-SHA256 test vector", function (done) {
+          scrypt.pbkdf2("Password", "NaCl", 80000, 64)!.then((result: Buffer) => {
+            expect(result.toString("hex")).to.equal(vector2);
+            done();
+          });
+        });
+      }
+    });
+  });
+
+  // Scrypt Configure Function tests
+  describe("Scrypt Configure Function", function () {
+    const vector2 = "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640";
+
+    afterEach(function () {
+      scrypt.configure({ threads: 1, threadMemory: 0, arenaHighWater: 256 * 1024 * 1024, arenaPolicy: "keep", hugePages: "off", kernel: "auto", poolSize: 0, poolAffinity: [], maxQueueLength: 0, maxQueueWait: 0, timeSlice: 0, memoryBudget: "auto" });
+    });
+
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw a TypeError if the options are not an object", function () {
+        expect(() => scrypt.configure(1)).to.throw(TypeError).to.match(/^TypeError: Configuration options type is incorrect: It must be a JSON object$/);
+      });
+
+      it("Will throw a TypeError if threads is not an integer", function () {
+        expect(() => scrypt.configure({ threads: 1.5 })).to.throw(TypeError).to.match(/^TypeError: threads must be an integer$/);
+      });
+
+      it("Will throw a RangeError if threadMemory is less than 0", function () {
+        expect(() => scrypt.configure({ threadMemory: -1 })).to.throw(RangeError).to.match(/^RangeError: threadMemory must be greater than or equal to 0$/);
+      });
+
+      it("Will throw a TypeError if arenaPolicy is not a known policy", function () {
+        expect(() => scrypt.configure({ arenaPolicy: "sometimes" })).to.throw(TypeError).to.match(/^TypeError: arenaPolicy must be either "keep" or "release"$/);
+      });
+
+      it("Will throw a TypeError if hugePages is not a known mode", function () {
+        expect(() => scrypt.configure({ hugePages: "1g" })).to.throw(TypeError).to.match(/^TypeError: hugePages must be one of "off", "thp" or "hugetlb"$/);
+      });
+
+      it("Will throw a TypeError if kernel is not a string", function () {
+        expect(() => scrypt.configure({ kernel: 1 })).to.throw(TypeError).to.match(/^TypeError: kernel must be a string$/);
+      });
+
+      it("Will throw a TypeError if poolAffinity is not an array of CPU numbers", function () {
+        expect(() => scrypt.configure({ poolAffinity: [0, -1] })).to.throw(TypeError).to.match(/^TypeError: poolAffinity must be an array of CPU numbers$/);
+      });
+
+      it("Will throw a RangeError if maxQueueWait is less than 0", function () {
+        expect(() => scrypt.configure({ maxQueueWait: -1 })).to.throw(RangeError).to.match(/^RangeError: maxQueueWait must be greater than or equal to 0$/);
+      });
+
+      it("Will throw a TypeError if a hash deadline is not a number", function () {
+        expect(() => scrypt.hash("password", { N: 1, r: 1, p: 1 }, 64, "NaCl", { deadline: "soon" }, () => {})).to.throw(TypeError).to.match(/^TypeError: deadline must be a timestamp in milliseconds, as returned by Date.now\(\)$/);
+      });
+
+      it("Will throw a TypeError if a kdf signal is not an AbortSignal", function () {
+        expect(() => scrypt.kdf("password", { N: 1, r: 1, p: 1 }, { signal: {} }, () => {})).to.throw(TypeError).to.match(/^TypeError: signal must be an AbortSignal$/);
+      });
+
+      it("Will throw a TypeError if a kdf onProgress is not a function", function () {
+        expect(() => scrypt.kdf("password", { N: 1, r: 1, p: 1 }, { onProgress: 1 }, () => {})).to.throw(TypeError).to.match(/^TypeError: onProgress must be a function$/);
+      });
+
+      it("Will throw a TypeError if memoryBudget is neither an integer nor \"auto\"", function () {
+        expect(() => scrypt.configure({ memoryBudget: "half" })).to.throw(TypeError).to.match(/^TypeError: memoryBudget must be an integer or "auto"$/);
+      });
+
+      it("Will throw a RangeError if kernel is not a known kernel, and change nothing", function () {
+        expect(() => scrypt.configure({ threads: 4, kernel: "neon9000" })).to.throw(RangeError).to.match(/^RangeError: kernel "neon9000" is unknown or not supported by this CPU$/);
+        expect(scrypt.configure()).to.include({ threads: 1, kernel: "auto" });
+      });
+    });
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will return the current configuration", function () {
+        expect(scrypt.configure()).to.deep.equal({ threads: 1, threadMemory: 0, arenaHighWater: 256 * 1024 * 1024, arenaPolicy: "keep", hugePages: "off", kernel: "auto", poolSize: 0, poolAffinity: [], maxQueueLength: 0, maxQueueWait: 0, timeSlice: 0, memoryBudget: "auto" });
+        expect(scrypt.configure({ threads: 4 })).to.include({ threads: 4, threadMemory: 0 });
+        expect(scrypt.configure({ threadMemory: 1 << 20 })).to.include({ threads: 4, threadMemory: 1 << 20 });
+        expect(scrypt.configure({ arenaPolicy: "release" })).to.include({ threads: 4, arenaPolicy: "release" });
+      });
+
+      it("Will produce test vector 2 with p spread over threads", function () {
+        scrypt.configure({ threads: 4 });
+        expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+      });
+
+      it("Will produce test vector 2 when the thread memory caps the fan-out", function (done) {
+        scrypt.configure({ threads: 16, threadMemory: 3 * 1024 * 1024 });
+        scrypt.hash("password", { N: 10, r: 8, p: 16 }, 64, "NaCl", (err: Error | null, result: Buffer) => {
+          expect(err).to.not.exist;
+          expect(result.toString("hex")).to.equal(vector2);
+          done();
+        });
+      });
+
+      it("Will produce test vector 2 on a resized, pinned native pool", function (done) {
+        expect(scrypt.configure({ poolSize: 2, poolAffinity: [0] })).to.deep.include({ poolSize: 2, poolAffinity: [0] });
+        Promise.all([0, 1, 2].map(() => scrypt.hash("password", { N: 10, r: 8, p: 16 }, 64, "NaCl"))).then((results: Buffer[]) => {
+          results.forEach((result) => expect(result.toString("hex")).to.equal(vector2));
+          // A thread still counts as busy until it has handed its result over
+          const idle = () => {
+            const stats = scrypt.stats();
+            if (stats.poolBusy !== 0) {
+              return setTimeout(idle, 1);
+            }
+            expect(stats.poolThreads).to.be.within(1, 2);
+            expect(stats.poolQueued).to.equal(0);
+            done();
+          };
+          idle();
+        });
+      });
+
+      it("Will derive the memory budget from the memory available", function () {
+        expect(scrypt.configure({ memoryBudget: "auto" })).to.include({ memoryBudget: "auto" });
+        expect(scrypt.stats().memoryBudget).to.be.within(1, Os.totalmem() / 2);
+      });
+
+      it("Will produce test vector 2 with huge page backing, falling back when none are available", function () {
+        for (const hugePages of ["thp", "hugetlb"]) {
+          expect(scrypt.configure({ hugePages })).to.include({ hugePages });
+          expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+        }
+      });
+
+      it("Will produce test vector 2 with every usable kernel forced", function () {
+        const usable = scrypt.kernels().kernels.filter((kernel) => kernel.usable).map((kernel) => kernel.name);
+        expect(usable).to.include("generic");
+
+        for (const kernel of usable) {
+          expect(scrypt.configure({ kernel })).to.include({ kernel });
+          expect(scrypt.kernels()).to.include({ active: kernel, forced: true });
+          expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+        }
+
+        expect(scrypt.configure({ kernel: "auto" })).to.include({ kernel: "auto" });
+        expect(scrypt.kernels()).to.include({ active: usable[0], forced: false });
+      });
+
+      it("Will reuse the scratch arena across hashes", function () {
+        scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl");
+        const before = scrypt.stats();
+        expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+        const after = scrypt.stats();
+        expect(after.arenaHits).to.equal(before.arenaHits + 1);
+        expect(after.arenaMisses).to.equal(before.arenaMisses);
+        expect(after.arenaBytes).to.be.at.least(128 * 8 * 1024);
+      });
+
+      it("Will release the scratch arena when trimmed or when the policy says so", function () {
+        scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl");
+        scrypt.trim();
+        expect(scrypt.stats().arenaBytes).to.equal(0);
+
+        scrypt.configure({ arenaPolicy: "release" });
+        expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+        expect(scrypt.stats().arenaBytes).to.equal(0);
+      });
+    });
+
+    describe("Scheduling of asynchronous calls", function () {
+      it("Will turn away async calls once the queue is full", function (done) {
+        scrypt.configure({ poolSize: 1, maxQueueLength: 1 });
+        const before = scrypt.stats();
+        const calls = [0, 1, 2, 3].map(() => scrypt.hash("password", { N: 14, r: 8, p: 1 }, 64, "NaCl").then(() => null, (err: any) => err));
+        Promise.all(calls).then((errors: any[]) => {
+          expect(errors[0]).to.be.null;
+          expect(errors[3]).to.be.an.instanceof(Error);
+          expect(errors[3].code).to.equal("ERR_SCRYPT_QUEUE_FULL");
+          expect(scrypt.stats().poolRejected).to.be.above(before.poolRejected);
+          done();
+        });
+      });
+
+      it("Will fail async calls which waited too long for a thread", function (done) {
+        scrypt.configure({ poolSize: 1, maxQueueWait: 1 });
+        const before = scrypt.stats();
+        const calls = [0, 1, 2].map(() => scrypt.hash("password", { N: 14, r: 8, p: 1 }, 64, "NaCl").then(() => null, (err: any) => err));
+        Promise.all(calls).then((errors: any[]) => {
+          expect(errors[0]).to.be.null;
+          expect(errors[2].code).to.equal("ERR_SCRYPT_QUEUE_TIMEOUT");
+          expect(errors[2].message).to.equal("waited too long for a scrypt thread");
+          expect(scrypt.stats().poolExpired).to.be.above(before.poolExpired);
+          done();
+        });
+      });
+
+      it("Will run async calls earliest deadline first, then by priority", function (done) {
+        scrypt.configure({ poolSize: 1 });
+        const order: string[] = [];
+        const params = { N: 14, r: 8, p: 1 };
+        const run = (name: string, schedule?: any) => (schedule ? scrypt.hash("password", params, 64, "NaCl", schedule) : scrypt.hash("password", params, 64, "NaCl")).then(() => { order.push(name); });
+
+        // Hold the pool thread with a call which runs until it is aborted, so the others all queue up behind it
+        const controller = new AbortController();
+        const holder = scrypt.hash("password", { N: 18, r: 8, p: 1 }, 64, "NaCl", { signal: controller.signal }).then(() => null, (err: any) => err);
+        const held = () => {
+          if (scrypt.stats().memoryUsed === 0) {
+            return setTimeout(held, 1);
+          }
+          const calls = [
+            run("background", { priority: -1 }),
+            run("plain"),
+            run("urgent", { priority: 1 }),
+            run("login", { deadline: Date.now() + 60000 }),
+          ];
+          controller.abort();
+          Promise.all([holder, ...calls]).then(([err]: any[]) => {
+            expect(err.name).to.equal("AbortError");
+            expect(order).to.deep.equal(["login", "urgent", "plain", "background"]);
+            done();
+          });
+        };
+        held();
+      });
+
+      it("Will fail async calls whose deadline passed before they started", function (done) {
+        const before = scrypt.stats();
+        scrypt.kdf("password", { N: 1, r: 1, p: 1 }, { deadline: Date.now() - 1 }, (err: any) => {
+          expect(err).to.be.an.instanceof(Error);
+          expect(err.code).to.equal("ERR_SCRYPT_DEADLINE");
+          expect(scrypt.stats().poolMissed).to.equal(before.poolMissed + 1);
+          scrypt.verifyKdf(scrypt.kdfSync("password", { N: 1, r: 1, p: 1 }), "password", { deadline: Date.now() + 60000, priority: 2 }).then((match: boolean) => {
+            expect(match).to.be.true;
+            done();
+          });
+        });
+      });
+
+      it("Will take aborted async calls off the queue", function (done) {
+        scrypt.configure({ poolSize: 1 });
+        const controller = new AbortController();
+        const first = scrypt.hash("password", { N: 14, r: 8, p: 1 }, 64, "NaCl");
+        const aborted = scrypt.verifyKdf(scrypt.kdfSync("password", { N: 1, r: 1, p: 1 }), "password", { signal: controller.signal });
+        controller.abort();
+        Promise.all([first, aborted.then(() => null, (err: any) => err)]).then(([result, err]: [Buffer, any]) => {
+          expect(result.length).to.equal(64);
+          expect(err).to.be.an.instanceof(Error);
+          expect(err.name).to.equal("AbortError");
+          expect(err.code).to.equal("ABORT_ERR");
+          scrypt.params(0.1, { signal: AbortSignal.abort() }, (err: any) => {
+            expect(err.code).to.equal("ABORT_ERR");
+            done();
+          });
+        });
+      });
+
+      it("Will stop a running async call when its signal aborts, and release its memory", function (done) {
+        const controller = new AbortController();
+        scrypt.hash("password", { N: 18, r: 8, p: 1 }, 64, "NaCl", { signal: controller.signal }, (err: any) => {
+          expect(err).to.be.an.instanceof(Error);
+          expect(err.name).to.equal("AbortError");
+          expect(err.code).to.equal("ABORT_ERR");
+          expect(err.message).to.equal("scrypt computation was aborted");
+          expect(scrypt.stats().memoryUsed).to.equal(0);
+          done();
+        });
+        setTimeout(() => controller.abort(), 20);
+      });
+
+      it("Will report the progress of an async call before producing test vector 2", function (done) {
+        const fractions: number[] = [];
+        scrypt.hash("password", { N: 10, r: 8, p: 16 }, 64, "NaCl", { onProgress: (fraction: number) => fractions.push(fraction) }, (err: any, result: Buffer) => {
+          expect(err).to.not.exist;
+          expect(result.toString("hex")).to.equal(vector2);
+          expect(fractions.length).to.be.above(1);
+          fractions.slice(1).forEach((fraction, i) => expect(fraction).to.be.above(fractions[i]));
+          expect(fractions[fractions.length - 1]).to.equal(1);
+          scrypt.kdf("password", { N: 10, r: 8, p: 1 }, { onProgress: () => {} }).then((kdf: Buffer) => scrypt.verifyKdf(kdf, "password", { onProgress: () => {} })).then((match: boolean) => {
+            expect(match).to.be.true;
+            done();
+          });
+        });
+      });
+
+      it("Will let a short async call run while a long one waits out its time slice", function (done) {
+        expect(scrypt.configure({ poolSize: 1, timeSlice: 1 })).to.include({ timeSlice: 1 });
+        const controller = new AbortController();
+        const long = scrypt.hash("password", { N: 18, r: 8, p: 1 }, 64, "NaCl", { signal: controller.signal }).then(() => null, (err: any) => err);
+
+        // Once the long call holds the pool thread, the short one queues up behind it and
+        // must finish first; the long one is then aborted rather than left to finish
+        const held = () => {
+          if (scrypt.stats().memoryUsed === 0) {
+            return setTimeout(held, 1);
+          }
+          scrypt.hash("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").then((result: Buffer) => {
+            expect(result.toString("hex")).to.equal(vector2);
+            controller.abort();
+            return long;
+          }).then((err: any) => {
+            expect(err).to.be.an.instanceof(Error);
+            expect(err.name).to.equal("AbortError");
+            expect(scrypt.stats().memoryUsed).to.equal(0);
+            done();
+          });
+        };
+        held();
+      });
+
+      it("Will let an async call which needs the memory budget run while a sliced one waits", function (done) {
+        scrypt.configure({ poolSize: 1, timeSlice: 1, memoryBudget: 72 << 20 });
+        const long = scrypt.hash("password", { N: 15, r: 8, p: 1 }, 64, "NaCl");
+
+        // The long call holds under half the budget, and the other needs more than the rest
+        const held = () => {
+          if (scrypt.stats().memoryUsed === 0) {
+            return setTimeout(held, 1);
+          }
+          const large = scrypt.hash("password", { N: 16, r: 8, p: 1 }, 64, "NaCl");
+          Promise.all([long, large]).then(([longResult, largeResult]: Buffer[]) => {
+            expect(longResult.length).to.equal(64);
+            expect(scrypt.stats().memoryUsed).to.equal(0);
+            expect(largeResult.toString("hex")).to.equal(scrypt.hashSync("password", { N: 16, r: 8, p: 1 }, 64, "NaCl").toString("hex"));
+            done();
+          });
+        };
+        held();
+      });
+
+      it("Will produce test vector 2 when the memory budget admits one hash at a time", function (done) {
+        expect(scrypt.configure({ memoryBudget: 1 << 20 })).to.include({ memoryBudget: 1 << 20 });
+        expect(scrypt.stats().memoryBudget).to.equal(1 << 20);
+        const before = scrypt.stats();
+        Promise.all([0, 1, 2, 3].map(() => scrypt.hash("password", { N: 10, r: 8, p: 16 }, 64, "NaCl"))).then((results: Buffer[]) => {
+          results.forEach((result) => expect(result.toString("hex")).to.equal(vector2));
+          const after = scrypt.stats();
+          expect(after.memoryUsed).to.equal(0);
+          expect(after.memoryWaiting).to.equal(0);
+          expect(after.memoryWaits).to.be.at.least(before.memoryWaits);
+          expect(after.memoryPeak).to.be.at.least(128 * 8 * 1024);
+          done();
+        });
+      });
+
+      it("Will fail synchronous calls at once when the memory budget has no room for them", function (done) {
+        scrypt.configure({ memoryBudget: 1 << 20, poolSize: 1 });
+        const kdf = scrypt.kdfSync("password", { N: 10, r: 8, p: 1 });
+        const controller = new AbortController();
+        const holder = scrypt.hash("password", { N: 17, r: 8, p: 1 }, 64, "NaCl", { signal: controller.signal }).then(() => null, (err: any) => err);
+
+        // Once the async call holds more than the whole budget, nothing else fits
+        const held = () => {
+          if (scrypt.stats().memoryUsed === 0) {
+            return setTimeout(held, 1);
+          }
+          for (const call of [
+            () => scrypt.hashSync("password", { N: 10, r: 8, p: 1 }, 64, "NaCl"),
+            () => scrypt.kdfSync("password", { N: 10, r: 8, p: 1 }),
+            () => scrypt.verifyKdfSync(kdf, "password"),
+          ]) {
+            let error: any = null;
+            try { call(); } catch (err) { error = err; }
+            expect(error).to.be.an.instanceof(Error);
+            expect(error.code).to.equal("ERR_SCRYPT_MEMORY_BUDGET");
+          }
+          controller.abort();
+          holder.then((err: any) => {
+            expect(err.name).to.equal("AbortError");
+            expect(scrypt.stats().memoryUsed).to.equal(0);
+            expect(scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl").toString("hex")).to.equal(vector2);
+            done();
+          });
+        };
+        held();
+      });
+
+      it("Will stop async calls waiting for the memory budget when their signal aborts or deadline passes", function (done) {
+        scrypt.configure({ memoryBudget: 1 << 20, poolSize: 3 });
+        const controller = new AbortController();
+        const holder = scrypt.hash("password", { N: 17, r: 8, p: 1 }, 64, "NaCl", { signal: controller.signal }).then(() => null, (err: any) => err);
+
+        // Queue two calls for memory behind the one holding it, then stop both
+        const held = () => {
+          if (scrypt.stats().memoryUsed === 0) {
+            return setTimeout(held, 1);
+          }
+          const waiter = new AbortController();
+          const aborted = scrypt.hash("password", { N: 10, r: 8, p: 1 }, 64, "NaCl", { signal: waiter.signal }).then(() => null, (err: any) => err);
+          const missed = scrypt.kdf("password", { N: 10, r: 8, p: 1 }, { deadline: Date.now() + 100 }).then(() => null, (err: any) => err);
+          const waiting = () => {
+            if (scrypt.stats().memoryWaiting < 2) {
+              return setTimeout(waiting, 1);
+            }
+            waiter.abort();
+            Promise.all([aborted, missed]).then(([abortError, deadlineError]: any[]) => {
+              expect(abortError.name).to.equal("AbortError");
+              expect(abortError.code).to.equal("ABORT_ERR");
+              expect(deadlineError.code).to.equal("ERR_SCRYPT_DEADLINE");
+              expect(scrypt.stats().memoryWaiting).to.equal(0);
+              controller.abort();
+              return holder;
+            }).then((err: any) => {
+              expect(err.name).to.equal("AbortError");
+              expect(scrypt.stats().memoryUsed).to.equal(0);
+              done();
+            });
+          };
+          waiting();
+        };
+        held();
+      });
+    });
+  });
+
+  // Scrypt Warmup Function tests
+  describe("Scrypt Warmup Function", function () {
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw a TypeError if the Scrypt params object is incorrect", function () {
+        expect(() => scrypt.warmup({ N: 10, r: 8 })).to.throw(TypeError).to.match(/^TypeError: Scrypt params object does not have 'p' property present$/);
+      });
+    });
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will report the kernels without any params", function () {
+        const kernels = scrypt.warmup();
+        expect(kernels.kernels.map((kernel) => kernel.name)).to.include("generic");
+        expect(kernels.kernels.filter((kernel) => kernel.usable).map((kernel) => kernel.name)).to.include(kernels.active);
+        expect(kernels.batchLanes).to.be.at.least(1);
+      });
+
+      it("Will leave scratch memory for the given params ready for the next hash", function () {
+        scrypt.trim();
+        scrypt.warmup({ N: 10, r: 8, p: 16 });
+        const before = scrypt.stats();
+        expect(before.arenaBytes).to.be.at.least(128 * 8 * 1024);
+        scrypt.hashSync("password", { N: 10, r: 8, p: 16 }, 64, "NaCl");
+        expect(scrypt.stats().arenaMisses).to.equal(before.arenaMisses);
+      });
+    });
+  });
+
+  // Scrypt Params For Throughput Function tests
+  describe("Scrypt Params For Throughput Function", function () {
+    this.timeout(30000);
+
+    afterEach(function () {
+      scrypt.configure({ memoryBudget: "auto" });
+    });
+
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw a SyntaxError if no arguments are present", function () {
+        expect(() => (scrypt.paramsForThroughputSync as any)()).to.throw(SyntaxError).to.match(/^SyntaxError: At least one argument is needed - the throughput options object$/);
+      });
+
+      it("Will throw a TypeError if the options are not an object", function () {
+        expect(() => scrypt.paramsForThroughputSync(5000 as any)).to.throw(TypeError).to.match(/^TypeError: Throughput options type is incorrect: It must be a JSON object$/);
+      });
+
+      it("Will throw a RangeError if verifiesPerSecond is not greater than 0", function () {
+        expect(() => scrypt.paramsForThroughputSync({ verifiesPerSecond: 0 })).to.throw(RangeError).to.match(/^RangeError: verifiesPerSecond must be greater than 0$/);
+      });
+
+      it("Will throw a TypeError if concurrency is not an integer", function () {
+        expect(() => scrypt.paramsForThroughputSync({ verifiesPerSecond: 100, concurrency: 1.5 })).to.throw(TypeError).to.match(/^TypeError: concurrency must be an integer$/);
+      });
+
+      it("Will throw a RangeError if concurrency is out of range", function () {
+        expect(() => scrypt.paramsForThroughputSync({ verifiesPerSecond: 100, concurrency: 0 })).to.throw(RangeError).to.match(/^RangeError: concurrency must be between 1 and 1024 inclusive$/);
+      });
+
+      it("Will throw a RangeError if maxmem is less than 0", function () {
+        expect(() => scrypt.paramsForThroughputSync({ verifiesPerSecond: 100, maxmem: -1 })).to.throw(RangeError).to.match(/^RangeError: maxmem must be greater than or equal to 0$/);
+      });
+    });
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will pick the same params as paramsSync for the same time when one hash runs at once", function () {
+        const maxmem = 256 * 1024 * 1024;
+        [10, 100, 1000].forEach((verifiesPerSecond) => {
+          const params = scrypt.paramsForThroughputSync({ verifiesPerSecond, concurrency: 1, maxmem });
+          examine(params);
+          expect(params).to.deep.equal(scrypt.paramsSync(1 / verifiesPerSecond, maxmem, 0.5));
+        });
+      });
+
+      it("Will pick params the cost model says take as long as each hash may, and no longer", function () {
+        // The calibration's rate for block size r and memory bytes, interpolated as pickparams.c does
+        const opsPerSecond = (points: { memory: number; r: number; opsPerSecond: number }[], r: number, memory: number) => {
+          const same = points.filter((point) => point.r === r).sort((a, b) => a.memory - b.memory);
+          const below = same.filter((point) => point.memory <= memory).pop();
+          const above = same.find((point) => point.memory >= memory);
+          if (!below) return above!.opsPerSecond;
+          if (!above) {
+            const [before, last] = same.slice(-2);
+            if (same.length < 2 || before.opsPerSecond <= last.opsPerSecond) return last.opsPerSecond;
+            const f = Math.log(memory / last.memory) / Math.log(last.memory / before.memory);
+            return Math.max(last.opsPerSecond - f * (before.opsPerSecond - last.opsPerSecond), last.opsPerSecond / 2);
+          }
+          if (above.memory === below.memory) return below.opsPerSecond;
+          const f = Math.log(memory / below.memory) / Math.log(above.memory / below.memory);
+          return below.opsPerSecond + f * (above.opsPerSecond - below.opsPerSecond);
+        };
+
+        // With one hash at once the model is the calibration's; each hash does 4 N r p salsa20/8 cores
+        const { points } = scrypt.calibrate();
+        [10, 100, 1000].forEach((verifiesPerSecond) => {
+          const { N, r, p } = scrypt.paramsForThroughputSync({ verifiesPerSecond, concurrency: 1, maxmem: 256 * 1024 * 1024 });
+          const cores = Math.max(opsPerSecond(points, r, 128 * r * 2 ** N) / verifiesPerSecond, 32768);
+          expect(4 * 2 ** N * r * p).to.be.at.most(cores * (1 + 1e-9));
+          expect(4 * 2 ** N * r * (p + 1)).to.be.above(cores * (1 - 1e-9));
+        });
+      });
+
+      it("Will pick more costly params for a lower rate with as many hashes at once as concurrency", function () {
+        const params = scrypt.paramsForThroughputSync({ verifiesPerSecond: 100, concurrency: 2, maxmem: 256 * 1024 * 1024 });
+        examine(params);
+        expect(scrypt.paramsForThroughputSync({ verifiesPerSecond: 10, concurrency: 2, maxmem: 256 * 1024 * 1024 }).N).to.be.above(params.N);
+      });
+
+      it("Will calibrate outside the memory budget, running no more hashes at once than fit in maxmem", function () {
+        scrypt.configure({ memoryBudget: 1 << 20 });
+        const before = scrypt.stats();
+        examine(scrypt.paramsForThroughputSync({ verifiesPerSecond: 1000, concurrency: 1024, maxmem: 4 * 1024 * 1024 }));
+        const after = scrypt.stats();
+        expect(after.memoryWaits).to.equal(before.memoryWaits);
+        expect(after.memoryUsed).to.equal(0);
+      });
+    });
+
+    describe("Asynchronous functionality with correct arguments", function () {
+      it("Will return the params with a callback and with a Promise", function (done) {
+        scrypt.paramsForThroughput({ verifiesPerSecond: 100, concurrency: 1 }, function (err: Error | null, params: any) {
+          examine(params, err);
+          (scrypt.paramsForThroughput({ verifiesPerSecond: 100, concurrency: 1 }, { priority: 1 }) as Promise<any>).then((result: any) => {
+            expect(result).to.deep.equal(params);
+            done();
+          });
+        });
+      });
+
+      it("Will reject the Promise if verifiesPerSecond is not a number", function () {
+        return expect(scrypt.paramsForThroughput({ verifiesPerSecond: "fast" as any })).to.be.rejectedWith(TypeError, "verifiesPerSecond must be a number");
+      });
+    });
+  });
+
+  // Scrypt Calibrate Function tests
+  describe("Scrypt Calibrate Function", function () {
+    const file = Path.join(Os.tmpdir(), `scrypt-calibration-${process.pid}.json`);
+
+    afterEach(function () {
+      Fs.rmSync(file, { force: true });
+    });
+
+    describe("Synchronous functionality with incorrect arguments", function () {
+      it("Will throw a TypeError if the options are not an object", function () {
+        expect(() => scrypt.calibrate(1 as any)).to.throw(TypeError).to.match(/^TypeError: Calibration options type is incorrect: It must be a JSON object$/);
+      });
+
+      it("Will throw a TypeError if file is not a path", function () {
+        expect(() => scrypt.calibrate({ file: "" })).to.throw(TypeError).to.match(/^TypeError: file must be a path$/);
+      });
+
+      it("Will throw a TypeError if force is not a boolean", function () {
+        expect(() => scrypt.calibrate({ force: 1 as any })).to.throw(TypeError).to.match(/^TypeError: force must be a boolean$/);
+      });
+    });
+
+    describe("Synchronous functionality with correct arguments", function () {
+      it("Will measure the CPU once, so that params always agrees with itself", function () {
+        const calibration = scrypt.calibrate();
+        expect(calibration.kernel).to.equal(scrypt.kernels().active);
+        expect(calibration.spread).to.be.at.least(0);
+        expect(calibration.points.map((point) => point.r)).to.include.members([8, 12, 16]);
+        calibration.points.forEach((point) => expect(point.opsPerSecond).to.be.above(0));
+        expect(scrypt.calibrate()).to.deep.equal(calibration);
+        expect(scrypt.paramsSync(0.1, 1 << 30)).to.deep.equal(scrypt.paramsSync(0.1, 1 << 30));
+      });
+
+      it("Will keep the calibration in a file, and use it from there", function () {
+        const calibration = scrypt.calibrate({ file });
+        const key = `${calibration.cpu} / ${calibration.kernel}`;
+        const profiles = JSON.parse(Fs.readFileSync(file, "utf8"));
+        expect(profiles[key]).to.deep.equal(calibration);
+
+        // A much slower CPU in the file gives much cheaper params
+        const before = scrypt.paramsSync(1, 1 << 30);
+        profiles[key].points.forEach((point: any) => { point.opsPerSecond /= 64; });
+        Fs.writeFileSync(file, JSON.stringify(profiles));
+        expect(scrypt.calibrate({ file }).points).to.deep.equal(profiles[key].points);
+        expect(scrypt.paramsSync(1, 1 << 30).N).to.be.below(before.N);
+
+        expect(scrypt.calibrate({ file, force: true }).points[0].opsPerSecond).to.be.above(profiles[key].points[0].opsPerSecond);
+      });
+
+      it("Will measure afresh if the file cannot be parsed", function () {
+        Fs.writeFileSync(file, "not json");
+        expect(scrypt.calibrate({ file }).points).to.not.be.empty;
+        expect(JSON.parse(Fs.readFileSync(file, "utf8"))).to.be.an("object");
+      });
+
+      it("Will pick params whose hash takes close to maxtime, searching r as well as N and p", function () {
+        const params = scrypt.paramsSync(0.2, 1 << 30);
+        expect([8, 12, 16]).to.include(params.r);
+        const started = process.hrtime.bigint();
+        scrypt.hashSync("password", params, 64, "NaCl");
+        const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+        expect(seconds).to.be.within(0.2 / 2.5, 0.2 * 2);
+      });
+    });
+  });
+});